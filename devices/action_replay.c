@@ -6,22 +6,21 @@
  */
 #include "action_replay.h"
 #include "sat/sat.h"
+#include "rle/rle01.h"
 
 #ifdef INCLUDE_ACTION_REPLAY
 
 
 DEVICE_HANDLER g_ActionReplay_Handler = {0};
 
+// last partition decompressed into cartridge RAM and the header it came from
+// so paging through a listing only decompresses on the first page
+static PARTITION_INFO g_ActionReplay_Partition = {0};
+static RLE01_HEADER g_ActionReplay_Header = {0};
+
 // utility functions
 
 static SLINGA_ERROR decompress_partition(const unsigned char *src, unsigned int src_size, PPARTITION_INFO partition_info);
-static SLINGA_ERROR decompress_RLE01(unsigned char rle_key, const unsigned char *src, unsigned int src_size, unsigned char *dest, unsigned int* bytes_needed);
-
-/*
-// for writing not implemented yet
-int calcRLEKey(unsigned char* src, unsigned int size, unsigned char* key);
-int compressRLE01(unsigned char rleKey, unsigned char *src, unsigned int srcSize, unsigned char *dest, unsigned int* bytesNeeded);
-*/
 
 SLINGA_ERROR ActionReplay_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler)
 {
@@ -44,6 +43,7 @@ SLINGA_ERROR ActionReplay_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDL
     g_ActionReplay_Handler.stat = ActionReplay_Stat;
     g_ActionReplay_Handler.query_file = ActionReplay_QueryFile;
     g_ActionReplay_Handler.list = ActionReplay_List;
+    g_ActionReplay_Handler.list_page = ActionReplay_ListPage;
     g_ActionReplay_Handler.read = ActionReplay_Read;
     g_ActionReplay_Handler.write = ActionReplay_Write;
     g_ActionReplay_Handler.delete = ActionReplay_Delete;
@@ -286,6 +286,40 @@ SLINGA_ERROR ActionReplay_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METAD
     return SLINGA_SUCCESS;
 }
 
+SLINGA_ERROR ActionReplay_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    if(device_type != DEVICE_ACTION_REPLAY)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    // later pages reuse the partition unless the cart changed since
+    if(cursor == SLINGA_LIST_START ||
+       !g_ActionReplay_Partition.partition_buf ||
+       memcmp(&g_ActionReplay_Header, (const void*)(CARTRIDGE_MEMORY + ACTION_REPLAY_SAVES_OFFSET), sizeof(RLE01_HEADER)) != 0)
+    {
+        result = decompress_partition((const unsigned char*)(CARTRIDGE_MEMORY + ACTION_REPLAY_SAVES_OFFSET),
+                                      ACTION_REPLAY_COMPRESSED_PARTITION_MAX_SIZE,
+                                      &partition_info);
+        if(result != SLINGA_SUCCESS)
+        {
+            // failed to decompress
+            return result;
+        }
+    }
+
+    return sat_list_page(&g_ActionReplay_Partition,
+                         cursor,
+                         page,
+                         page_len,
+                         saves_found,
+                         next_cursor);
+}
 
 SLINGA_ERROR ActionReplay_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
 {
@@ -385,9 +419,9 @@ static SLINGA_ERROR decompress_partition(const unsigned char *src, unsigned int
     PRLE01_HEADER header = NULL;
     unsigned char* dest = NULL;
     unsigned int dest_size = 0;
-    int result = 0;
+    SLINGA_ERROR result = 0;
 
-    if(!src || !src_size || !dest || !dest_size)
+    if(!src || !src_size || !partition_info)
     {
         return SLINGA_INVALID_PARAMETER;
     }
@@ -417,8 +451,8 @@ static SLINGA_ERROR decompress_partition(const unsigned char *src, unsigned int
     //
     // decompress the Action Replay compressed save buffer
     //
-    result = decompress_RLE01(header->rle_key, src + sizeof(RLE01_HEADER), header->compressed_size - sizeof(RLE01_HEADER), NULL, &dest_size);
-    if(result < 0)
+    result = rle01_decompress(header->rle_key, src + sizeof(RLE01_HEADER), header->compressed_size - sizeof(RLE01_HEADER), NULL, 0, &dest_size);
+    if(result != SLINGA_SUCCESS)
     {
         return SLINGA_ACTION_REPLAY_FAILED_DECOMPRESS_1;
     }
@@ -428,11 +462,14 @@ static SLINGA_ERROR decompress_partition(const unsigned char *src, unsigned int
         return SLINGA_ACTION_REPLAY_PARTITION_TOO_LARGE;
     }
 
+    // the cached partition is about to be overwritten
+    memset(&g_ActionReplay_Partition, 0, sizeof(g_ActionReplay_Partition));
+
     dest = CARTRIDGE_RAM_BANK_1;
     memset(dest, 0, CARTRIDGE_RAM_BANK_SIZE);
 
-    result = decompress_RLE01(header->rle_key, src  + sizeof(RLE01_HEADER), header->compressed_size - sizeof(RLE01_HEADER), dest, &dest_size);
-    if(result < 0)
+    result = rle01_decompress(header->rle_key, src + sizeof(RLE01_HEADER), header->compressed_size - sizeof(RLE01_HEADER), dest, CARTRIDGE_RAM_BANK_SIZE, &dest_size);
+    if(result != SLINGA_SUCCESS)
     {
         return SLINGA_ACTION_REPLAY_FAILED_DECOMPRESS_2;
     }
@@ -442,98 +479,10 @@ static SLINGA_ERROR decompress_partition(const unsigned char *src, unsigned int
     partition_info->block_size = ACTION_REPLAY_BLOCK_SIZE;
     partition_info->skip_bytes = 0;
 
-    return SLINGA_SUCCESS;
-}
-
-// Decompresses RLE01 compressed buffer into dest
-// To calculate number of bytes needed, set dest to NULL
-// This function was reversed from function 0x002897dc in ARP_202C.BIN
-static SLINGA_ERROR decompress_RLE01(unsigned char rle_key, const unsigned char *src, unsigned int src_size, unsigned char *dest, unsigned int* bytes_needed)
-{
-    unsigned int i = 0;
-    unsigned int j = 0;
-    unsigned int k = 0;
-
-    if(src == NULL || bytes_needed == NULL)
-    {
-        return -1;
-    }
-
-    j = 0;
-    i = 0;
-
-    do
-    {
-        unsigned int count = 0;
-        unsigned char val = 0;
+    g_ActionReplay_Partition = *partition_info;
+    memcpy(&g_ActionReplay_Header, header, sizeof(RLE01_HEADER));
 
-        // three compressed cases
-        // 1) not key
-        // - copy the byte directly
-        // - src + 1, dest + 1
-        // 2) key followed by zero
-        // -- copy key
-        // -- src + 2, dest + 1
-        // 3) key followed by non-zero, followed by val
-        // -- copy val count times
-        // -- src + 3, dest + count
-
-        if (src[i] == rle_key)
-        {
-            count = (int)(char)src[i + 1] & 0xff;
-            if (count == 0)
-            {
-                if(dest)
-                {
-                    dest[j] = rle_key;
-                }
-
-                i = i + 2;
-                goto continue_loop;
-            }
-
-            val = src[i + 2];
-            i = i + 3;
-            k = 0;
-
-            if (count != 0)
-            {
-                do
-                {
-                    if(dest)
-                    {
-                        dest[j] = val;
-                    }
-
-                    j = j + 1;
-                    k = k + 1;
-
-                } while (k < count);
-            }
-        }
-        else
-        {
-            if(dest)
-            {
-                dest[j] = src[i];
-            }
-
-            i = i + 1;
-continue_loop:
-            j = j + 1;
-        }
-
-        // check if we are at the end
-        if (src_size <= i)
-        {
-            if(bytes_needed)
-            {
-                *bytes_needed = j;
-            }
-
-            return 0;
-        }
-    } while(1);
+    return SLINGA_SUCCESS;
 }
 
 #endif
@@ -50,6 +50,7 @@ SLINGA_ERROR ActionReplay_IsWriteable(DEVICE_TYPE type);
 SLINGA_ERROR ActionReplay_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
 SLINGA_ERROR ActionReplay_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
 SLINGA_ERROR ActionReplay_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR ActionReplay_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
 
 SLINGA_ERROR ActionReplay_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
 SLINGA_ERROR ActionReplay_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
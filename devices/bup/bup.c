@@ -0,0 +1,239 @@
+/** @file bup.c
+ *
+ *  @author Slinga
+ *  @brief .BUP save file format. Shared by devices that store saves as files (ODEs, serial, CD)
+ *  @bug No known bugs.
+ */
+#include "bup.h"
+
+#include <stdio.h>
+
+static unsigned int read_be32(const unsigned char* src);
+static void write_be32(unsigned char* dst, unsigned int val);
+
+/**
+ * @brief Parse a .BUP header into SAVE_METADATA
+ *
+ * @param[in] buffer Start of the .BUP file
+ * @param[in] size Size of buffer in bytes. Must be at least BUP_HEADER_SIZE
+ * @param[out] metadata Filled out metadata on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR bup_parse_header(const unsigned char* buffer, unsigned int size, PSAVE_METADATA metadata)
+{
+    const BUP_HEADER* header = (const BUP_HEADER*)buffer;
+
+    if(!buffer || !metadata)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(size < BUP_HEADER_SIZE)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    if(memcmp(header->magic, BUP_MAGIC, BUP_MAGIC_LEN) != 0)
+    {
+        return SLINGA_BUP_INVALID_HEADER;
+    }
+
+    memset(metadata, 0, sizeof(SAVE_METADATA));
+
+    // header strings are NULL terminated on disk but don't trust them
+    memcpy(metadata->savename, header->savename, MAX_SAVENAME - 1);
+    memcpy(metadata->comment, header->comment, MAX_COMMENT - 1);
+
+    snprintf(metadata->filename, sizeof(metadata->filename), "%s" BUP_EXTENSION, metadata->savename);
+
+    metadata->language = header->language;
+    metadata->timestamp = read_be32(header->timestamp);
+    metadata->data_size = read_be32(header->data_size);
+    metadata->block_size = bup_calc_blocks(metadata->data_size);
+
+    if(metadata->language >= MAX_LANGUAGE || metadata->data_size > MAX_SAVE_SIZE)
+    {
+        return SLINGA_BUP_INVALID_HEADER;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Build a .BUP header from SAVE_METADATA
+ *
+ * @param[in] metadata Save metadata (savename, comment, language, timestamp)
+ * @param[in] data_size Size of the save data in bytes. Overrides metadata->data_size
+ * @param[out] buffer Header bytes on success
+ * @param[in] size Size of buffer in bytes. Must be at least BUP_HEADER_SIZE
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR bup_build_header(const PSAVE_METADATA metadata, unsigned int data_size, unsigned char* buffer, unsigned int size)
+{
+    PBUP_HEADER header = (PBUP_HEADER)buffer;
+
+    if(!metadata || !buffer)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(size < BUP_HEADER_SIZE)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memset(header, 0, BUP_HEADER_SIZE);
+
+    memcpy(header->magic, BUP_MAGIC, BUP_MAGIC_LEN);
+    memcpy(header->savename, metadata->savename, LIBSLINGA_MIN(strlen(metadata->savename), BUP_SAVENAME_LEN - 1));
+    memcpy(header->comment, metadata->comment, LIBSLINGA_MIN(strlen(metadata->comment), BUP_COMMENT_LEN - 1));
+    header->language = metadata->language;
+    write_be32(header->timestamp, metadata->timestamp);
+    write_be32(header->data_size, data_size);
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Strips the optional .BUP extension from a filename
+ *
+ * @param[in] filename Either the save name ("SAVENAME") or the file name ("SAVENAME.BUP")
+ * @param[out] savename Save name on success
+ * @param[in] savename_size Size of savename in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR bup_get_savename(const char* filename, char* savename, unsigned int savename_size)
+{
+    unsigned int len = 0;
+
+    if(!filename || !savename || !savename_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    len = strlen(filename);
+    if(bup_is_bup_filename(filename) == SLINGA_SUCCESS)
+    {
+        len -= BUP_EXTENSION_LEN;
+    }
+
+    if(len == 0 || len >= BUP_SAVENAME_LEN || len >= savename_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memcpy(savename, filename, len);
+    savename[len] = '\0';
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Builds the path of a save in the SATSAVES directory
+ *
+ * @param[in] filename Either the save name ("SAVENAME") or the file name ("SAVENAME.BUP")
+ * @param[out] path "SATSAVES/SAVENAME.BUP" on success
+ * @param[in] path_size Size of path in bytes. BUP_MAX_PATH is always large enough
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR bup_get_path(const char* filename, char* path, unsigned int path_size)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    SLINGA_ERROR result = 0;
+    int len = 0;
+
+    if(!path || !path_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = bup_get_savename(filename, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    len = snprintf(path, path_size, "%s/%s" BUP_EXTENSION, SAVES_DIRECTORY, savename);
+    if(len < 0 || (unsigned int)len >= path_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Checks if filename ends in .BUP (case insensitive)
+ *
+ * @param[in] filename File name to check
+ *
+ * @return SLINGA_SUCCESS if filename ends in .BUP, SLINGA_NOT_FOUND otherwise
+ */
+SLINGA_ERROR bup_is_bup_filename(const char* filename)
+{
+    unsigned int len = 0;
+    const char* ext = NULL;
+
+    if(!filename)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    len = strlen(filename);
+    if(len <= BUP_EXTENSION_LEN)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    ext = filename + len - BUP_EXTENSION_LEN;
+
+    for(unsigned int i = 0; i < BUP_EXTENSION_LEN; i++)
+    {
+        char c = ext[i];
+
+        if(c >= 'a' && c <= 'z')
+        {
+            c = c - 'a' + 'A';
+        }
+
+        if(c != BUP_EXTENSION[i])
+        {
+            return SLINGA_NOT_FOUND;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Number of BUP_BLOCK_SIZE blocks needed to hold data_size bytes
+ *
+ * @param[in] data_size Size of the save data in bytes
+ *
+ * @return number of blocks
+ */
+unsigned short bup_calc_blocks(unsigned int data_size)
+{
+    return (unsigned short)((data_size + BUP_BLOCK_SIZE - 1) / BUP_BLOCK_SIZE);
+}
+
+//
+// helper functions
+//
+
+static unsigned int read_be32(const unsigned char* src)
+{
+    return ((unsigned int)src[0] << 24) | ((unsigned int)src[1] << 16) | ((unsigned int)src[2] << 8) | (unsigned int)src[3];
+}
+
+static void write_be32(unsigned char* dst, unsigned int val)
+{
+    dst[0] = (unsigned char)(val >> 24);
+    dst[1] = (unsigned char)(val >> 16);
+    dst[2] = (unsigned char)(val >> 8);
+    dst[3] = (unsigned char)val;
+}
@@ -0,0 +1,62 @@
+/** @file bup.h
+ *
+ *  @author Slinga
+ *  @brief .BUP save file format. Shared by devices that store saves as files (ODEs, serial, CD)
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#include "../../libslinga.h"
+
+//
+// .BUP files are a 64-byte header followed by the raw save data. All multi-byte
+// fields are big-endian so the files are identical whether they were written
+// by the Saturn or by a host tool.
+//
+// 0x00 magic "Vmem"
+// 0x04 save id (unused, written as 0)
+// 0x08 BUP library stats (unused, written as 0)
+// 0x0C reserved
+// 0x20 save name (11 characters + NULL)
+// 0x2C comment (10 characters + NULL)
+// 0x37 language
+// 0x38 timestamp
+// 0x3C data size
+// 0x40 save data
+//
+
+#define BUP_MAGIC               "Vmem"
+#define BUP_MAGIC_LEN           4
+#define BUP_EXTENSION           ".BUP"
+#define BUP_EXTENSION_LEN       4
+#define BUP_SAVENAME_LEN        12
+#define BUP_COMMENT_LEN         11
+#define BUP_BLOCK_SIZE          64 ///< @brief File backed devices don't use blocks, report everything in 64 byte units
+
+#define BUP_MAX_PATH            (sizeof(SAVES_DIRECTORY) + MAX_FILENAME + 1) ///< @brief "SATSAVES/" + filename
+
+#pragma pack(1)
+typedef struct _BUP_HEADER
+{
+    char magic[BUP_MAGIC_LEN];          // "Vmem"
+    unsigned char save_id[4];           // unused
+    unsigned char stats[4];             // unused
+    unsigned char reserved[20];
+    char savename[BUP_SAVENAME_LEN];    // NULL terminated
+    char comment[BUP_COMMENT_LEN];      // NULL terminated
+    unsigned char language;             // language of the save (LANGUAGE_JAPANESE (0) to LANGUAGE_ITALIAN (5))
+    unsigned char timestamp[4];         // big-endian, seconds since 1/1/1980
+    unsigned char data_size[4];         // big-endian, in bytes
+}BUP_HEADER, *PBUP_HEADER;
+#pragma pack()
+
+#define BUP_HEADER_SIZE sizeof(BUP_HEADER)
+
+SLINGA_ERROR bup_parse_header(const unsigned char* buffer, unsigned int size, PSAVE_METADATA metadata);
+SLINGA_ERROR bup_build_header(const PSAVE_METADATA metadata, unsigned int data_size, unsigned char* buffer, unsigned int size);
+SLINGA_ERROR bup_get_savename(const char* filename, char* savename, unsigned int savename_size);
+SLINGA_ERROR bup_get_path(const char* filename, char* path, unsigned int path_size);
+SLINGA_ERROR bup_is_bup_filename(const char* filename);
+unsigned short bup_calc_blocks(unsigned int data_size);
@@ -0,0 +1,1008 @@
+/** @file cd.c
+ *
+ *  @author Slinga
+ *  @brief CD file system (ISO9660)
+ *  @bug Read-only. Requires a CD_SECTOR_READER to be attached with CD_SetSectorReader().
+ */
+#include "cd.h"
+
+#ifdef INCLUDE_CD
+
+// ISO9660 volume descriptor
+#define ISO_VD_TYPE_OFFSET              0
+#define ISO_VD_ID_OFFSET                1
+#define ISO_VD_ID                       "CD001"
+#define ISO_VD_ID_LEN                   5
+#define ISO_VD_PRIMARY                  1
+#define ISO_VD_TERMINATOR               255
+#define ISO_PVD_VOLUME_SIZE_OFFSET      84  // big-endian half of the both-endian field
+#define ISO_PVD_BLOCK_SIZE_OFFSET       130 // big-endian half of the both-endian field
+#define ISO_PVD_ROOT_RECORD_OFFSET      156
+
+// ISO9660 directory record
+#define ISO_DR_LBA_OFFSET               6   // big-endian half of the both-endian field
+#define ISO_DR_SIZE_OFFSET              14  // big-endian half of the both-endian field
+#define ISO_DR_FLAGS_OFFSET             25
+#define ISO_DR_NAME_LEN_OFFSET          32
+#define ISO_DR_NAME_OFFSET              33
+#define ISO_DR_MIN_SIZE                 34
+#define ISO_DR_MAX_SIZE                 255
+#define ISO_DR_FLAG_DIRECTORY           0x02
+
+DEVICE_HANDLER g_CD_Handler = {0};
+
+/** @brief Sector source, NULL if none */
+PCD_SECTOR_READER g_CD_Reader = NULL;
+
+/** @brief Sector I/O counters */
+CD_STATS g_CD_Stats = {0};
+
+/** @brief Cached SATSAVES directory */
+CD_FILE g_CD_Files[CD_MAX_FILES] = {0};
+unsigned int g_CD_Num_Files = 0;
+unsigned char g_CD_Cache_Valid = 0;
+unsigned int g_CD_Volume_Sectors = 0;
+
+/** @brief Read-ahead window, holds g_CD_Window_Count sectors starting at g_CD_Window_LBA */
+unsigned char g_CD_Window[CD_READ_AHEAD_SECTORS * CD_SECTOR_SIZE] = {0};
+unsigned int g_CD_Window_LBA = 0;
+unsigned int g_CD_Window_Count = 0;
+
+/** @brief g_CD_Files indexes sorted by LBA */
+unsigned char g_CD_Order[CD_MAX_FILES] = {0};
+
+static SLINGA_ERROR load_directory(void);
+static SLINGA_ERROR load_metadata(PCD_FILE file);
+static SLINGA_ERROR load_all_metadata(void);
+static SLINGA_ERROR find_file(const char* filename, PCD_FILE* file);
+static SLINGA_ERROR read_root_record(unsigned int* lba, unsigned int* size);
+static SLINGA_ERROR walk_directory(unsigned int lba, unsigned int size, const char* find_name, unsigned int* found_lba, unsigned int* found_size);
+
+// sector I/O
+static SLINGA_ERROR read_bytes(unsigned int lba, unsigned int offset, unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR read_sectors(unsigned int lba, unsigned int count, unsigned char* buffer);
+static SLINGA_ERROR fill_window(unsigned int lba);
+
+static unsigned int read_be32(const unsigned char* src);
+static unsigned int read_be16(const unsigned char* src);
+static int compare_names(const char* a, const char* b);
+
+SLINGA_ERROR CD_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!device_handler)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_CD_Handler.init = CD_Init;
+    g_CD_Handler.fini = CD_Fini;
+    g_CD_Handler.get_device_name = CD_GetDeviceName;
+    g_CD_Handler.is_present = CD_IsPresent;
+    g_CD_Handler.is_readable = CD_IsReadable;
+    g_CD_Handler.is_writeable = CD_IsWriteable;
+    g_CD_Handler.stat = CD_Stat;
+    g_CD_Handler.query_file = CD_QueryFile;
+    g_CD_Handler.list = CD_List;
+    g_CD_Handler.list_page = CD_ListPage;
+    g_CD_Handler.read = CD_Read;
+    g_CD_Handler.write = CD_Write;
+    g_CD_Handler.delete = CD_Delete;
+    g_CD_Handler.format = CD_Format;
+
+    *device_handler = &g_CD_Handler;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Attach the sector source
+ *
+ * @param[in] reader Reader to use. Must remain valid until detached. NULL to detach
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR CD_SetSectorReader(PCD_SECTOR_READER reader)
+{
+    if(reader && !reader->read_sectors)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_CD_Reader = reader;
+    g_Context.isPresent[DEVICE_CD] = 0;
+
+    return CD_Invalidate();
+}
+
+/**
+ * @brief Drop the cached directory and read-ahead. Call after the disc changes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR CD_Invalidate(void)
+{
+    g_CD_Cache_Valid = 0;
+    g_CD_Num_Files = 0;
+    g_CD_Volume_Sectors = 0;
+    g_CD_Window_Count = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Get the sector I/O counters
+ *
+ * @param[out] stats Counters since the last CD_ResetStats()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR CD_GetStats(PCD_STATS stats)
+{
+    if(!stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memcpy(stats, &g_CD_Stats, sizeof(CD_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Zero the sector I/O counters
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR CD_ResetStats(void)
+{
+    memset(&g_CD_Stats, 0, sizeof(CD_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_Init(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_Fini(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return CD_Invalidate();
+}
+
+SLINGA_ERROR CD_GetDeviceName(DEVICE_TYPE device_type, char** device_name)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!device_name)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    *device_name = "CD File System (Read-Only)";
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_IsPresent(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(g_Context.isPresent[device_type])
+    {
+        // we already know device is present
+        return SLINGA_SUCCESS;
+    }
+
+    // without a reader there is no way to get at the disc
+    if(!g_CD_Reader)
+    {
+        return SLINGA_DEVICE_NOT_PRESENT;
+    }
+
+    g_Context.isPresent[device_type] = 1;
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_IsReadable(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_IsWriteable(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    // CDs are read-only
+    return SLINGA_NOT_SUPPORTED;
+}
+
+SLINGA_ERROR CD_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
+{
+    SLINGA_ERROR result = 0;
+
+    result = CD_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stat)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = load_directory();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    memset(stat, 0, sizeof(BACKUP_STAT));
+
+    //
+    // fill out stats
+    // the disc doesn't use save blocks, report in BUP_BLOCK_SIZE units
+    // nothing is ever free on a CD
+    //
+    stat->block_size = BUP_BLOCK_SIZE;
+    stat->total_blocks = LIBSLINGA_MIN(g_CD_Volume_Sectors, 0xFFFFFFFF / CD_SECTOR_SIZE) * (CD_SECTOR_SIZE / BUP_BLOCK_SIZE);
+    stat->total_bytes = stat->total_blocks * BUP_BLOCK_SIZE;
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
+{
+    PCD_FILE file = NULL;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = CD_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !save)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = find_file(filename, &file);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_metadata(file);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    memcpy(save, &file->metadata, sizeof(SAVE_METADATA));
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    unsigned int found = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = CD_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_directory();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_all_metadata();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < g_CD_Num_Files; i++)
+    {
+        if(g_CD_Files[i].header_result != SLINGA_SUCCESS)
+        {
+            // corrupt or foreign file, skip it
+            continue;
+        }
+
+        if(saves)
+        {
+            // check if we are finished looking for saves
+            if(found >= num_saves)
+            {
+                // no more room in our saves array
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            memcpy(&saves[found], &g_CD_Files[i].metadata, sizeof(SAVE_METADATA));
+        }
+
+        found++;
+    }
+
+    if(saves_found)
+    {
+        *saves_found = found;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    unsigned int found = 0;
+    unsigned int i = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = CD_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_directory();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    //
+    // the cursor is the directory index to resume from
+    // only the headers of this page are read
+    //
+    for(i = cursor; i < g_CD_Num_Files && found < page_len; i++)
+    {
+        result = load_metadata(&g_CD_Files[i]);
+        if(!g_CD_Files[i].has_metadata)
+        {
+            // the header couldn't be read
+            return result;
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            // corrupt or foreign file, skip it
+            continue;
+        }
+
+        memcpy(&page[found], &g_CD_Files[i].metadata, sizeof(SAVE_METADATA));
+        found++;
+    }
+
+    *saves_found = found;
+    *next_cursor = (i < g_CD_Num_Files) ? i : SLINGA_LIST_END;
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    PCD_FILE file = NULL;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = CD_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !buffer || !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = find_file(filename, &file);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_metadata(file);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(file->metadata.data_size > size)
+    {
+        // buffer isn't big enough to hold the save
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    if(file->metadata.data_size > file->size - BUP_HEADER_SIZE)
+    {
+        // header claims more data than the file has
+        return SLINGA_BUP_INVALID_HEADER;
+    }
+
+    // whole sectors of the save go straight into buffer
+    result = read_bytes(file->lba, BUP_HEADER_SIZE, buffer, file->metadata.data_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(bytes_read)
+    {
+        *bytes_read = file->metadata.data_size;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR CD_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
+{
+    UNUSED(flags);
+    UNUSED(filename);
+    UNUSED(save_metadata);
+    UNUSED(buffer);
+    UNUSED(size);
+
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_NOT_SUPPORTED;
+}
+
+SLINGA_ERROR CD_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
+{
+    UNUSED(flags);
+    UNUSED(filename);
+
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_NOT_SUPPORTED;
+}
+
+SLINGA_ERROR CD_Format(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_CD)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_NOT_SUPPORTED;
+}
+
+//
+// helper functions
+//
+
+/**
+ * @brief Parse the volume descriptors and cache the SATSAVES directory. Only runs once per disc
+ *
+ * @return SLINGA_SUCCESS on success. A disc without SATSAVES has no saves, that's not an error
+ */
+static SLINGA_ERROR load_directory(void)
+{
+    unsigned int root_lba = 0;
+    unsigned int root_size = 0;
+    unsigned int saves_lba = 0;
+    unsigned int saves_size = 0;
+    SLINGA_ERROR result = 0;
+
+    if(g_CD_Cache_Valid)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    CD_Invalidate();
+
+    result = read_root_record(&root_lba, &root_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = walk_directory(root_lba, root_size, SAVES_DIRECTORY, &saves_lba, &saves_size);
+    if(result == SLINGA_NOT_FOUND)
+    {
+        // no saves on this disc
+        g_CD_Cache_Valid = 1;
+        return SLINGA_SUCCESS;
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // NULL find_name caches every .BUP
+    result = walk_directory(saves_lba, saves_size, NULL, NULL, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        g_CD_Num_Files = 0;
+        return result;
+    }
+
+    // remember the disc order so headers can be read with a single sweep
+    for(unsigned int i = 0; i < g_CD_Num_Files; i++)
+    {
+        unsigned int j = i;
+
+        while(j > 0 && g_CD_Files[g_CD_Order[j - 1]].lba > g_CD_Files[i].lba)
+        {
+            g_CD_Order[j] = g_CD_Order[j - 1];
+            j--;
+        }
+
+        g_CD_Order[j] = (unsigned char)i;
+    }
+
+    g_CD_Cache_Valid = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR load_metadata(PCD_FILE file)
+{
+    unsigned char header[BUP_HEADER_SIZE] = {0};
+    SLINGA_ERROR result = 0;
+
+    if(file->has_metadata)
+    {
+        return file->header_result;
+    }
+
+    if(file->size < BUP_HEADER_SIZE)
+    {
+        file->header_result = SLINGA_BUP_INVALID_HEADER;
+        file->has_metadata = 1;
+        return file->header_result;
+    }
+
+    result = read_bytes(file->lba, 0, header, sizeof(header));
+    if(result != SLINGA_SUCCESS)
+    {
+        // read errors aren't cached, try again next time
+        return result;
+    }
+
+    file->header_result = bup_parse_header(header, sizeof(header), &file->metadata);
+    file->has_metadata = 1;
+
+    if(file->header_result == SLINGA_SUCCESS)
+    {
+        // the name on the disc wins over the name in the header
+        strcpy(file->metadata.filename, file->name);
+    }
+
+    return file->header_result;
+}
+
+/**
+ * @brief Read every uncached header in disc order so the read-ahead window covers neighbours
+ */
+static SLINGA_ERROR load_all_metadata(void)
+{
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; i < g_CD_Num_Files; i++)
+    {
+        result = load_metadata(&g_CD_Files[g_CD_Order[i]]);
+        if(result == SLINGA_CD_READ_ERROR || result == SLINGA_CD_NO_READER)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR find_file(const char* filename, PCD_FILE* file)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    SLINGA_ERROR result = 0;
+
+    result = bup_get_savename(filename, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_directory();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < g_CD_Num_Files; i++)
+    {
+        char file_savename[MAX_SAVENAME + 1] = {0};
+
+        if(bup_get_savename(g_CD_Files[i].name, file_savename, sizeof(file_savename)) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        if(compare_names(file_savename, savename) == 0)
+        {
+            *file = &g_CD_Files[i];
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Find the primary volume descriptor and return the root directory extent
+ */
+static SLINGA_ERROR read_root_record(unsigned int* lba, unsigned int* size)
+{
+    unsigned char descriptor[ISO_PVD_ROOT_RECORD_OFFSET + ISO_DR_MIN_SIZE] = {0};
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; i < CD_MAX_VOLUME_DESCRIPTORS; i++)
+    {
+        result = read_bytes(CD_PVD_LBA + i, 0, descriptor, sizeof(descriptor));
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(memcmp(descriptor + ISO_VD_ID_OFFSET, ISO_VD_ID, ISO_VD_ID_LEN) != 0 ||
+           descriptor[ISO_VD_TYPE_OFFSET] == ISO_VD_TERMINATOR)
+        {
+            break;
+        }
+
+        if(descriptor[ISO_VD_TYPE_OFFSET] != ISO_VD_PRIMARY)
+        {
+            // boot record, supplementary (Joliet), etc
+            continue;
+        }
+
+        if(read_be16(descriptor + ISO_PVD_BLOCK_SIZE_OFFSET) != CD_SECTOR_SIZE)
+        {
+            return SLINGA_CD_INVALID_FILESYSTEM;
+        }
+
+        g_CD_Volume_Sectors = read_be32(descriptor + ISO_PVD_VOLUME_SIZE_OFFSET);
+
+        *lba = read_be32(descriptor + ISO_PVD_ROOT_RECORD_OFFSET + ISO_DR_LBA_OFFSET);
+        *size = read_be32(descriptor + ISO_PVD_ROOT_RECORD_OFFSET + ISO_DR_SIZE_OFFSET);
+
+        // the volume size bounds read-ahead, anything past it is bogus
+        if(*lba >= g_CD_Volume_Sectors)
+        {
+            return SLINGA_CD_INVALID_FILESYSTEM;
+        }
+
+        return SLINGA_SUCCESS;
+    }
+
+    return SLINGA_CD_INVALID_FILESYSTEM;
+}
+
+/**
+ * @brief Walk a directory extent
+ *
+ * @param[in] lba First sector of the directory
+ * @param[in] size Size of the directory in bytes
+ * @param[in] find_name Subdirectory to look for. NULL to cache every .BUP file in g_CD_Files instead
+ * @param[out] found_lba First sector of find_name
+ * @param[out] found_size Size of find_name in bytes
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if find_name doesn't exist
+ */
+static SLINGA_ERROR walk_directory(unsigned int lba, unsigned int size, const char* find_name, unsigned int* found_lba, unsigned int* found_size)
+{
+    unsigned char record[ISO_DR_MAX_SIZE] = {0};
+    unsigned int pos = 0;
+    SLINGA_ERROR result = 0;
+
+    while(pos < size)
+    {
+        unsigned int record_size = 0;
+        unsigned int name_len = 0;
+        char name[MAX_FILENAME + 1] = {0};
+
+        result = read_bytes(lba, pos, record, 1);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        record_size = record[0];
+        if(record_size == 0)
+        {
+            // records don't cross sectors, the rest of this one is padding
+            pos = (pos / CD_SECTOR_SIZE + 1) * CD_SECTOR_SIZE;
+            continue;
+        }
+
+        if(record_size < ISO_DR_MIN_SIZE || pos + record_size > size)
+        {
+            return SLINGA_CD_INVALID_FILESYSTEM;
+        }
+
+        result = read_bytes(lba, pos, record, record_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        pos += record_size;
+
+        name_len = record[ISO_DR_NAME_LEN_OFFSET];
+        if(ISO_DR_NAME_OFFSET + name_len > record_size)
+        {
+            return SLINGA_CD_INVALID_FILESYSTEM;
+        }
+
+        if(name_len == 1 && record[ISO_DR_NAME_OFFSET] <= 1)
+        {
+            // "." and ".."
+            continue;
+        }
+
+        if(name_len > MAX_FILENAME)
+        {
+            // too long to be one of ours
+            continue;
+        }
+
+        memcpy(name, record + ISO_DR_NAME_OFFSET, name_len);
+
+        // "NAME.BUP;1" -> "NAME.BUP"
+        for(unsigned int i = 0; i < name_len; i++)
+        {
+            if(name[i] == ';')
+            {
+                name[i] = '\0';
+                break;
+            }
+        }
+
+        if(find_name)
+        {
+            if((record[ISO_DR_FLAGS_OFFSET] & ISO_DR_FLAG_DIRECTORY) && compare_names(name, find_name) == 0)
+            {
+                *found_lba = read_be32(record + ISO_DR_LBA_OFFSET);
+                *found_size = read_be32(record + ISO_DR_SIZE_OFFSET);
+                return SLINGA_SUCCESS;
+            }
+
+            continue;
+        }
+
+        if((record[ISO_DR_FLAGS_OFFSET] & ISO_DR_FLAG_DIRECTORY) || bup_is_bup_filename(name) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        if(g_CD_Num_Files >= CD_MAX_FILES)
+        {
+            // we don't support more saves than MAX_SAVES anyway
+            break;
+        }
+
+        memset(&g_CD_Files[g_CD_Num_Files], 0, sizeof(CD_FILE));
+        strcpy(g_CD_Files[g_CD_Num_Files].name, name);
+        g_CD_Files[g_CD_Num_Files].lba = read_be32(record + ISO_DR_LBA_OFFSET);
+        g_CD_Files[g_CD_Num_Files].size = read_be32(record + ISO_DR_SIZE_OFFSET);
+        g_CD_Num_Files++;
+    }
+
+    return find_name ? SLINGA_NOT_FOUND : SLINGA_SUCCESS;
+}
+
+//
+// Sector I/O
+//
+
+/**
+ * @brief Read size bytes starting offset bytes into sector lba
+ *
+ * Bytes already in the read-ahead window are copied from it. Runs of whole
+ * sectors are read with one call straight into buffer. Partial sectors are
+ * read through the window, which pulls in the following sectors as well.
+ */
+static SLINGA_ERROR read_bytes(unsigned int lba, unsigned int offset, unsigned char* buffer, unsigned int size)
+{
+    SLINGA_ERROR result = 0;
+
+    lba += offset / CD_SECTOR_SIZE;
+    offset %= CD_SECTOR_SIZE;
+
+    while(size)
+    {
+        unsigned int copy_size = 0;
+
+        if(g_CD_Window_Count && lba >= g_CD_Window_LBA && lba < g_CD_Window_LBA + g_CD_Window_Count)
+        {
+            unsigned int window_offset = (lba - g_CD_Window_LBA) * CD_SECTOR_SIZE + offset;
+
+            copy_size = LIBSLINGA_MIN(size, g_CD_Window_Count * CD_SECTOR_SIZE - window_offset);
+            memcpy(buffer, g_CD_Window + window_offset, copy_size);
+            g_CD_Stats.window_hits++;
+        }
+        else if(offset == 0 && size >= CD_SECTOR_SIZE)
+        {
+            unsigned int count = size / CD_SECTOR_SIZE;
+
+            // stop where the window starts so we don't read those sectors twice
+            if(g_CD_Window_Count && g_CD_Window_LBA > lba)
+            {
+                count = LIBSLINGA_MIN(count, g_CD_Window_LBA - lba);
+            }
+
+            result = read_sectors(lba, count, buffer);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+
+            copy_size = count * CD_SECTOR_SIZE;
+        }
+        else
+        {
+            result = fill_window(lba);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+
+            continue;
+        }
+
+        buffer += copy_size;
+        size -= copy_size;
+        offset += copy_size;
+        lba += offset / CD_SECTOR_SIZE;
+        offset %= CD_SECTOR_SIZE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR read_sectors(unsigned int lba, unsigned int count, unsigned char* buffer)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!g_CD_Reader)
+    {
+        return SLINGA_CD_NO_READER;
+    }
+
+    result = g_CD_Reader->read_sectors(g_CD_Reader->context, lba, count, buffer);
+    if(result != SLINGA_SUCCESS)
+    {
+        return SLINGA_CD_READ_ERROR;
+    }
+
+    g_CD_Stats.read_calls++;
+    g_CD_Stats.sectors_read += count;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Read lba and the sectors after it into the window
+ */
+static SLINGA_ERROR fill_window(unsigned int lba)
+{
+    unsigned int count = 1;
+    SLINGA_ERROR result = 0;
+
+    // until the volume size is known we can't tell how far it's safe to read ahead
+    if(g_CD_Volume_Sectors)
+    {
+        if(lba >= g_CD_Volume_Sectors)
+        {
+            return SLINGA_CD_INVALID_FILESYSTEM;
+        }
+
+        count = LIBSLINGA_MIN(CD_READ_AHEAD_SECTORS, g_CD_Volume_Sectors - lba);
+    }
+
+    g_CD_Window_Count = 0;
+
+    result = read_sectors(lba, count, g_CD_Window);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    g_CD_Window_LBA = lba;
+    g_CD_Window_Count = count;
+
+    return SLINGA_SUCCESS;
+}
+
+static unsigned int read_be32(const unsigned char* src)
+{
+    return ((unsigned int)src[0] << 24) | ((unsigned int)src[1] << 16) | ((unsigned int)src[2] << 8) | (unsigned int)src[3];
+}
+
+static unsigned int read_be16(const unsigned char* src)
+{
+    return ((unsigned int)src[0] << 8) | (unsigned int)src[1];
+}
+
+/**
+ * @brief Case insensitive compare. ISO9660 names are upper case, saves often aren't
+ *
+ * @return 0 if the names match
+ */
+static int compare_names(const char* a, const char* b)
+{
+    while(*a && *b)
+    {
+        char ca = *a++;
+        char cb = *b++;
+
+        if(ca >= 'a' && ca <= 'z')
+        {
+            ca = ca - 'a' + 'A';
+        }
+
+        if(cb >= 'a' && cb <= 'z')
+        {
+            cb = cb - 'a' + 'A';
+        }
+
+        if(ca != cb)
+        {
+            return 1;
+        }
+    }
+
+    return (*a || *b) ? 1 : 0;
+}
+
+#endif
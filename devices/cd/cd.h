@@ -0,0 +1,95 @@
+/** @file cd.h
+ *
+ *  @author Slinga
+ *  @brief CD file system (ISO9660) prototypes and constants
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#ifdef INCLUDE_CD
+
+#include "../../libslinga.h"
+#include "../bup/bup.h"
+
+//
+// The CD device reads .BUP saves from the SATSAVES directory of an ISO9660
+// disc. It's read-only.
+//
+// Seeking dominates the cost of CD access, so:
+// - the SATSAVES directory is parsed once and cached, along with each save's
+//   .BUP header once it has been read
+// - headers are loaded in disc order
+// - every small read pulls in CD_READ_AHEAD_SECTORS sectors, which usually
+//   covers the next few saves since mastering tools lay files out back to back
+// - runs of whole sectors are read with a single call straight into the
+//   caller's buffer
+//
+// Sector I/O lives behind CD_SECTOR_READER so the device can run against the
+// Saturn CD block or an .iso image on a host.
+//
+
+#define CD_SECTOR_SIZE              2048
+#define CD_READ_AHEAD_SECTORS       16      ///< @brief Sectors pulled in by a small read
+#define CD_MAX_FILES                MAX_SAVES ///< @brief Maximum files cached from SATSAVES
+#define CD_PVD_LBA                  16      ///< @brief First volume descriptor
+#define CD_MAX_VOLUME_DESCRIPTORS   32      ///< @brief Give up looking for the primary volume descriptor after this many
+
+/** @brief Sector source for the CD device */
+typedef struct _CD_SECTOR_READER
+{
+    void* context;  ///< @brief Passed to read_sectors()
+
+    /**
+     * @brief Read count CD_SECTOR_SIZE sectors starting at lba into buffer
+     * @return SLINGA_SUCCESS on success
+     */
+    SLINGA_ERROR (*read_sectors)(void* context, unsigned int lba, unsigned int count, unsigned char* buffer);
+} CD_SECTOR_READER, *PCD_SECTOR_READER;
+
+/** @brief Sector I/O counters */
+typedef struct _CD_STATS
+{
+    unsigned int read_calls;        ///< @brief Calls to read_sectors()
+    unsigned int sectors_read;      ///< @brief Sectors read from the disc
+    unsigned int window_hits;       ///< @brief Reads served from the read-ahead window
+} CD_STATS, *PCD_STATS;
+
+/** @brief Cached SATSAVES directory entry */
+typedef struct _CD_FILE
+{
+    char name[MAX_FILENAME + 1];    ///< @brief File name without the ";1" version
+    unsigned int lba;               ///< @brief First sector of the file
+    unsigned int size;              ///< @brief File size in bytes
+    unsigned char has_metadata;     ///< @brief 1 once the .BUP header was read
+    SLINGA_ERROR header_result;     ///< @brief Result of parsing the .BUP header
+    SAVE_METADATA metadata;         ///< @brief Parsed .BUP header
+} CD_FILE, *PCD_FILE;
+
+SLINGA_ERROR CD_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler);
+
+SLINGA_ERROR CD_SetSectorReader(PCD_SECTOR_READER reader);
+SLINGA_ERROR CD_Invalidate(void);
+SLINGA_ERROR CD_GetStats(PCD_STATS stats);
+SLINGA_ERROR CD_ResetStats(void);
+
+SLINGA_ERROR CD_Init(DEVICE_TYPE device_type);
+SLINGA_ERROR CD_Fini(DEVICE_TYPE device_type);
+
+SLINGA_ERROR CD_GetDeviceName(DEVICE_TYPE device_type, char** device_name);
+SLINGA_ERROR CD_IsPresent(DEVICE_TYPE device_type);
+SLINGA_ERROR CD_IsReadable(DEVICE_TYPE device_type);
+SLINGA_ERROR CD_IsWriteable(DEVICE_TYPE device_type);
+
+SLINGA_ERROR CD_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+SLINGA_ERROR CD_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
+SLINGA_ERROR CD_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR CD_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
+SLINGA_ERROR CD_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+SLINGA_ERROR CD_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR CD_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
+SLINGA_ERROR CD_Format(DEVICE_TYPE device_type);
+
+#endif
@@ -0,0 +1,119 @@
+/** @file cd_image.c
+ *
+ *  @author Slinga
+ *  @brief CD sector reader backed by a host disc image
+ *  @bug No known bugs.
+ */
+#include "cd_image.h"
+
+#if defined(INCLUDE_CD_IMAGE) && defined(INCLUDE_CD)
+
+static const unsigned char g_CD_Raw_Sync[12] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+
+static SLINGA_ERROR image_read_sectors(void* context, unsigned int lba, unsigned int count, unsigned char* buffer);
+
+/**
+ * @brief Open a disc image and fill out a reader for CD_SetSectorReader()
+ *
+ * @param[out] image Image state, must remain valid while reader is in use
+ * @param[in] path Path to the .iso or .bin
+ * @param[out] reader Reader backed by image
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR CD_Image_Open(PCD_IMAGE image, const char* path, PCD_SECTOR_READER reader)
+{
+    unsigned char sync[sizeof(g_CD_Raw_Sync)] = {0};
+
+    if(!image || !path || !reader)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(image, 0, sizeof(CD_IMAGE));
+
+    image->file = fopen(path, "rb");
+    if(!image->file)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    image->sector_size = CD_SECTOR_SIZE;
+    image->data_offset = 0;
+
+    // a cooked image starts with the (usually zeroed) system area, never the sync pattern
+    if(fread(sync, 1, sizeof(sync), image->file) == sizeof(sync) && memcmp(sync, g_CD_Raw_Sync, sizeof(sync)) == 0)
+    {
+        image->sector_size = CD_RAW_SECTOR_SIZE;
+        image->data_offset = CD_RAW_DATA_OFFSET;
+    }
+
+    reader->context = image;
+    reader->read_sectors = image_read_sectors;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Close an image opened with CD_Image_Open(). Detach the reader first
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR CD_Image_Close(PCD_IMAGE image)
+{
+    if(!image)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(image->file)
+    {
+        fclose(image->file);
+        image->file = NULL;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR image_read_sectors(void* context, unsigned int lba, unsigned int count, unsigned char* buffer)
+{
+    PCD_IMAGE image = (PCD_IMAGE)context;
+
+    if(!image || !image->file || !buffer)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // cooked images are contiguous, read the whole run at once
+    if(image->sector_size == CD_SECTOR_SIZE)
+    {
+        if(fseek(image->file, (long)lba * CD_SECTOR_SIZE, SEEK_SET) != 0)
+        {
+            return SLINGA_CD_READ_ERROR;
+        }
+
+        if(fread(buffer, CD_SECTOR_SIZE, count, image->file) != count)
+        {
+            return SLINGA_CD_READ_ERROR;
+        }
+
+        return SLINGA_SUCCESS;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        if(fseek(image->file, (long)(lba + i) * CD_RAW_SECTOR_SIZE + image->data_offset, SEEK_SET) != 0)
+        {
+            return SLINGA_CD_READ_ERROR;
+        }
+
+        if(fread(buffer + i * CD_SECTOR_SIZE, CD_SECTOR_SIZE, 1, image->file) != 1)
+        {
+            return SLINGA_CD_READ_ERROR;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+#endif
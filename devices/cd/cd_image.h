@@ -0,0 +1,37 @@
+/** @file cd_image.h
+ *
+ *  @author Slinga
+ *  @brief CD sector reader backed by a host disc image
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#if defined(INCLUDE_CD_IMAGE) && defined(INCLUDE_CD)
+
+#include <stdio.h>
+#include "cd.h"
+
+//
+// Lets the CD device run on a host against a disc image. Both cooked .iso
+// (2048 byte sectors) and raw mode 1 .bin (2352 byte sectors) are supported,
+// raw images are detected by the sync pattern at the start of the first sector.
+//
+
+#define CD_RAW_SECTOR_SIZE      2352
+#define CD_RAW_DATA_OFFSET      16  ///< @brief Sync (12) + header (4)
+
+/** @brief Open disc image. Treat as opaque */
+typedef struct _CD_IMAGE
+{
+    FILE* file;                     ///< @brief Image file
+    unsigned int sector_size;       ///< @brief CD_SECTOR_SIZE or CD_RAW_SECTOR_SIZE
+    unsigned int data_offset;       ///< @brief Offset of the user data in each sector
+} CD_IMAGE, *PCD_IMAGE;
+
+SLINGA_ERROR CD_Image_Open(PCD_IMAGE image, const char* path, PCD_SECTOR_READER reader);
+SLINGA_ERROR CD_Image_Close(PCD_IMAGE image);
+
+#endif
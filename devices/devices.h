@@ -25,5 +25,8 @@ typedef enum
     DEVICE_SATIATIOR = 6,      ///< @brief SATIATOR ODE
     DEVICE_MODE = 7,           ///< @brief MODE ODE
 
+    // virtual devices
+    DEVICE_SPAN = 8,           ///< @brief Several devices presented as one
+
     MAX_DEVICE_TYPE,          ///< @brief Max device value
 } DEVICE_TYPE;
@@ -0,0 +1,1121 @@
+/** @file ode.c
+ *
+ *  @author Slinga
+ *  @brief Optical Drive Emulators (Satiator, MODE)
+ *  @bug Requires an ODE_TRANSPORT to be attached with ODE_SetTransport().
+ */
+#include "ode.h"
+
+#include <stdio.h>
+
+#if defined(INCLUDE_SATIATIOR) || defined(INCLUDE_MODE)
+
+#define ODE_NUM_DEVICES 2
+#define ODE_TAG_SLOT_MASK 0xFF
+#define ODE_TAG_SEQUENCE_SHIFT 8
+
+/** @brief State of a single ODE */
+typedef struct _ODE_DEVICE
+{
+    PODE_TRANSPORT transport;                       ///< @brief Attached transport, NULL if none
+    ODE_STATS stats;                                ///< @brief Usage counters
+    ODE_COMMAND queue[ODE_MAX_OUTSTANDING];         ///< @brief Commands in flight
+    PODE_RESPONSE responses[ODE_MAX_OUTSTANDING];   ///< @brief Where to copy each command's response. Can be NULL
+    unsigned char busy[ODE_MAX_OUTSTANDING];        ///< @brief 1 if the queue slot is in flight
+    unsigned int outstanding;                       ///< @brief Number of commands in flight
+    unsigned int sequence;                          ///< @brief Used to make tags unique
+    SLINGA_ERROR error;                             ///< @brief First failed response since the last flush
+} ODE_DEVICE, *PODE_DEVICE;
+
+DEVICE_HANDLER g_ODE_Handler = {0};
+ODE_DEVICE g_ODE_Devices[ODE_NUM_DEVICES] = {0};
+
+/** @brief Staging for directory listings, one batch per queue slot */
+ODE_DIR_ENTRY g_ODE_Dir_Entries[ODE_MAX_OUTSTANDING][ODE_DIR_BATCH] = {0};
+
+/** @brief Staging for .BUP headers. Must stay valid until the command completes */
+unsigned char g_ODE_Header[BUP_HEADER_SIZE] = {0};
+
+static SLINGA_ERROR get_ode(DEVICE_TYPE device_type, PODE_DEVICE* ode);
+static unsigned int get_window(const PODE_DEVICE ode);
+static unsigned int get_max_transfer(const PODE_DEVICE ode);
+static SLINGA_ERROR list_batches(PODE_DEVICE ode, unsigned int first_entry, PODE_RESPONSE responses, unsigned int* num_batches);
+
+// command pipeline
+static SLINGA_ERROR ode_submit(PODE_DEVICE ode, const PODE_COMMAND command, PODE_RESPONSE response);
+static SLINGA_ERROR ode_complete_one(PODE_DEVICE ode);
+static SLINGA_ERROR ode_flush(PODE_DEVICE ode);
+static void ode_reset(PODE_DEVICE ode);
+
+SLINGA_ERROR ODE_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!device_handler)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_ODE_Handler.init = ODE_Init;
+    g_ODE_Handler.fini = ODE_Fini;
+    g_ODE_Handler.get_device_name = ODE_GetDeviceName;
+    g_ODE_Handler.is_present = ODE_IsPresent;
+    g_ODE_Handler.is_readable = ODE_IsReadable;
+    g_ODE_Handler.is_writeable = ODE_IsWriteable;
+    g_ODE_Handler.stat = ODE_Stat;
+    g_ODE_Handler.query_file = ODE_QueryFile;
+    g_ODE_Handler.list = ODE_List;
+    g_ODE_Handler.list_page = ODE_ListPage;
+    g_ODE_Handler.read = ODE_Read;
+    g_ODE_Handler.write = ODE_Write;
+    g_ODE_Handler.delete = ODE_Delete;
+    g_ODE_Handler.format = ODE_Format;
+
+    *device_handler = &g_ODE_Handler;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Attach the transport used to talk to the ODE
+ *
+ * @param[in] device_type DEVICE_SATIATIOR or DEVICE_MODE
+ * @param[in] transport Transport to use. Must remain valid until detached. NULL to detach
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR ODE_SetTransport(DEVICE_TYPE device_type, PODE_TRANSPORT transport)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(transport && (!transport->submit || !transport->complete))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    ode_reset(ode);
+    ode->transport = transport;
+    g_Context.isPresent[device_type] = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Get the transport usage counters
+ *
+ * @param[in] device_type DEVICE_SATIATIOR or DEVICE_MODE
+ * @param[out] stats Counters since the last ODE_ResetStats()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR ODE_GetStats(DEVICE_TYPE device_type, PODE_STATS stats)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memcpy(stats, &ode->stats, sizeof(ODE_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Zero the transport usage counters
+ *
+ * @param[in] device_type DEVICE_SATIATIOR or DEVICE_MODE
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR ODE_ResetStats(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    memset(&ode->stats, 0, sizeof(ODE_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_Init(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+
+    return get_ode(device_type, &ode);
+}
+
+SLINGA_ERROR ODE_Fini(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    ode_reset(ode);
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_GetDeviceName(DEVICE_TYPE device_type, char** device_name)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!device_name)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(device_type == DEVICE_SATIATIOR)
+    {
+        *device_name = "Satiator ODE";
+    }
+    else
+    {
+        *device_name = "MODE ODE";
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_IsPresent(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(g_Context.isPresent[device_type])
+    {
+        // we already know device is present
+        return SLINGA_SUCCESS;
+    }
+
+    // without a transport there is no way to talk to the ODE
+    if(!ode->transport)
+    {
+        return SLINGA_DEVICE_NOT_PRESENT;
+    }
+
+    g_Context.isPresent[device_type] = 1;
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_IsReadable(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+
+    return get_ode(device_type, &ode);
+}
+
+SLINGA_ERROR ODE_IsWriteable(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+
+    return get_ode(device_type, &ode);
+}
+
+SLINGA_ERROR ODE_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_COMMAND command = {0};
+    ODE_RESPONSE response = {0};
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stat)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(stat, 0, sizeof(BACKUP_STAT));
+
+    command.type = ODE_CMD_STAT_FS;
+    strcpy(command.path, SAVES_DIRECTORY);
+
+    result = ode_submit(ode, &command, &response);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ode_flush(ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    //
+    // fill out stats
+    // ODEs don't have blocks, report in BUP_BLOCK_SIZE units
+    //
+    stat->block_size = BUP_BLOCK_SIZE;
+    stat->total_blocks = response.total_bytes / BUP_BLOCK_SIZE;
+    stat->total_bytes = stat->total_blocks * BUP_BLOCK_SIZE;
+    stat->free_blocks = response.free_bytes / BUP_BLOCK_SIZE;
+    stat->free_bytes = stat->free_blocks * BUP_BLOCK_SIZE;
+
+    // smallest possible save is a header plus one block of data
+    stat->max_saves_possible = stat->free_bytes / (BUP_HEADER_SIZE + BUP_BLOCK_SIZE);
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_COMMAND command = {0};
+    ODE_RESPONSE response = {0};
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!save)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    command.type = ODE_CMD_READ;
+    command.offset = 0;
+    command.length = BUP_HEADER_SIZE;
+    command.buffer = g_ODE_Header;
+
+    result = bup_get_path(filename, command.path, sizeof(command.path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ode_submit(ode, &command, &response);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ode_flush(ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(response.length < BUP_HEADER_SIZE)
+    {
+        return SLINGA_BUP_INVALID_HEADER;
+    }
+
+    return bup_parse_header(g_ODE_Header, BUP_HEADER_SIZE, save);
+}
+
+SLINGA_ERROR ODE_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_RESPONSE responses[ODE_MAX_OUTSTANDING] = {0};
+    unsigned int first_entry = 0;
+    unsigned int num_batches = 0;
+    unsigned int found = 0;
+    unsigned char done = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    while(!done)
+    {
+        // one round trip for up to window * ODE_DIR_BATCH entries
+        result = list_batches(ode, first_entry, responses, &num_batches);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        for(unsigned int i = 0; i < num_batches && !done; i++)
+        {
+            for(unsigned int j = 0; j < responses[i].length; j++)
+            {
+                PODE_DIR_ENTRY entry = &g_ODE_Dir_Entries[i][j];
+                SAVE_METADATA metadata = {0};
+
+                if(bup_is_bup_filename(entry->name) != SLINGA_SUCCESS || entry->size < BUP_HEADER_SIZE)
+                {
+                    // not a save
+                    continue;
+                }
+
+                result = bup_parse_header(entry->header, BUP_HEADER_SIZE, &metadata);
+                if(result != SLINGA_SUCCESS)
+                {
+                    // corrupt or foreign file, skip it
+                    continue;
+                }
+
+                if(saves)
+                {
+                    // check if we are finished looking for saves
+                    if(found >= num_saves)
+                    {
+                        // no more room in our saves array
+                        return SLINGA_BUFFER_TOO_SMALL;
+                    }
+
+                    memcpy(&saves[found], &metadata, sizeof(SAVE_METADATA));
+                }
+
+                found++;
+            }
+
+            // a short batch means we reached the end of the directory
+            if(responses[i].length < ODE_DIR_BATCH)
+            {
+                done = 1;
+            }
+        }
+
+        first_entry += num_batches * ODE_DIR_BATCH;
+    }
+
+    if(saves_found)
+    {
+        *saves_found = found;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_RESPONSE responses[ODE_MAX_OUTSTANDING] = {0};
+    unsigned int first_entry = cursor;
+    unsigned int num_batches = 0;
+    unsigned int found = 0;
+    unsigned char done = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // the cursor is the directory entry to resume from
+    while(!done)
+    {
+        result = list_batches(ode, first_entry, responses, &num_batches);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        for(unsigned int i = 0; i < num_batches && !done; i++)
+        {
+            for(unsigned int j = 0; j < responses[i].length; j++)
+            {
+                PODE_DIR_ENTRY entry = &g_ODE_Dir_Entries[i][j];
+
+                if(found >= page_len)
+                {
+                    // page is full, the next page starts at this entry
+                    *saves_found = found;
+                    *next_cursor = first_entry + (i * ODE_DIR_BATCH) + j;
+                    return SLINGA_SUCCESS;
+                }
+
+                if(bup_is_bup_filename(entry->name) != SLINGA_SUCCESS || entry->size < BUP_HEADER_SIZE)
+                {
+                    // not a save
+                    continue;
+                }
+
+                if(bup_parse_header(entry->header, BUP_HEADER_SIZE, &page[found]) != SLINGA_SUCCESS)
+                {
+                    // corrupt or foreign file, skip it
+                    continue;
+                }
+
+                found++;
+            }
+
+            // a short batch means we reached the end of the directory
+            if(responses[i].length < ODE_DIR_BATCH)
+            {
+                done = 1;
+            }
+        }
+
+        first_entry += num_batches * ODE_DIR_BATCH;
+    }
+
+    *saves_found = found;
+    *next_cursor = SLINGA_LIST_END;
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_COMMAND command = {0};
+    ODE_RESPONSE header_response = {0};
+    SAVE_METADATA metadata = {0};
+    unsigned int max_transfer = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !buffer || !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = bup_get_path(filename, command.path, sizeof(command.path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    //
+    // Queue the header read and every data chunk up front. We don't know the
+    // save size until the header arrives, so read up to size bytes. Chunks past
+    // the end of the file come back short, which is cheap compared to a
+    // second round trip.
+    //
+    command.type = ODE_CMD_READ;
+    command.offset = 0;
+    command.length = BUP_HEADER_SIZE;
+    command.buffer = g_ODE_Header;
+
+    result = ode_submit(ode, &command, &header_response);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    max_transfer = get_max_transfer(ode);
+
+    for(unsigned int offset = 0; offset < size; offset += max_transfer)
+    {
+        command.offset = BUP_HEADER_SIZE + offset;
+        command.length = LIBSLINGA_MIN(max_transfer, size - offset);
+        command.buffer = buffer + offset;
+
+        result = ode_submit(ode, &command, NULL);
+        if(result != SLINGA_SUCCESS)
+        {
+            ode_flush(ode);
+            return result;
+        }
+    }
+
+    result = ode_flush(ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(header_response.length < BUP_HEADER_SIZE)
+    {
+        return SLINGA_BUP_INVALID_HEADER;
+    }
+
+    result = bup_parse_header(g_ODE_Header, BUP_HEADER_SIZE, &metadata);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(metadata.data_size > size)
+    {
+        // buffer isn't big enough to hold the save
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    if(bytes_read)
+    {
+        *bytes_read = metadata.data_size;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR ODE_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_COMMAND command = {0};
+    unsigned int max_transfer = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !save_metadata || !buffer || !size || size > MAX_SAVE_SIZE)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = bup_get_path(filename, command.path, sizeof(command.path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = bup_build_header(save_metadata, size, g_ODE_Header, sizeof(g_ODE_Header));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // header first, it creates\truncates the file
+    command.type = ODE_CMD_WRITE;
+    command.flags = ODE_FLAG_CREATE | ODE_FLAG_TRUNCATE;
+    command.offset = 0;
+    command.length = BUP_HEADER_SIZE;
+    command.buffer = g_ODE_Header;
+
+    if((flags & OVERWRITE_EXISTING_SAVE) == 0)
+    {
+        command.flags |= ODE_FLAG_EXCLUSIVE;
+    }
+
+    result = ode_submit(ode, &command, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if((flags & OVERWRITE_EXISTING_SAVE) == 0)
+    {
+        // the data writes must not be queued until we know the exclusive
+        // create succeeded, otherwise they would clobber the existing save
+        result = ode_flush(ode);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    max_transfer = get_max_transfer(ode);
+
+    command.flags = 0;
+    for(unsigned int offset = 0; offset < size; offset += max_transfer)
+    {
+        command.offset = BUP_HEADER_SIZE + offset;
+        command.length = LIBSLINGA_MIN(max_transfer, size - offset);
+        command.buffer = (unsigned char*)buffer + offset;
+
+        result = ode_submit(ode, &command, NULL);
+        if(result != SLINGA_SUCCESS)
+        {
+            ode_flush(ode);
+            return result;
+        }
+    }
+
+    return ode_flush(ode);
+}
+
+SLINGA_ERROR ODE_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_COMMAND command = {0};
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    command.type = ODE_CMD_DELETE;
+
+    result = bup_get_path(filename, command.path, sizeof(command.path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ode_submit(ode, &command, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return ode_flush(ode);
+}
+
+SLINGA_ERROR ODE_Format(DEVICE_TYPE device_type)
+{
+    PODE_DEVICE ode = NULL;
+    ODE_RESPONSE responses[ODE_MAX_OUTSTANDING] = {0};
+    ODE_COMMAND command = {0};
+    unsigned int kept = 0;
+    unsigned int num_batches = 0;
+    unsigned char done = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_ode(device_type, &ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ODE_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    //
+    // Formatting deletes every .BUP file in SATSAVES. The directory order is
+    // stable, so once the saves in a listed range are deleted the only entries
+    // left in front of the next unlisted one are the files we kept.
+    //
+    while(!done)
+    {
+        result = list_batches(ode, kept, responses, &num_batches);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        for(unsigned int i = 0; i < num_batches && !done; i++)
+        {
+            for(unsigned int j = 0; j < responses[i].length; j++)
+            {
+                PODE_DIR_ENTRY entry = &g_ODE_Dir_Entries[i][j];
+                int len = 0;
+
+                if(bup_is_bup_filename(entry->name) != SLINGA_SUCCESS)
+                {
+                    kept++;
+                    continue;
+                }
+
+                memset(&command, 0, sizeof(command));
+                command.type = ODE_CMD_DELETE;
+
+                len = snprintf(command.path, sizeof(command.path), "%s/%s", SAVES_DIRECTORY, entry->name);
+                if(len < 0 || (unsigned int)len >= sizeof(command.path))
+                {
+                    kept++;
+                    continue;
+                }
+
+                result = ode_submit(ode, &command, NULL);
+                if(result != SLINGA_SUCCESS)
+                {
+                    ode_flush(ode);
+                    return result;
+                }
+            }
+
+            if(responses[i].length < ODE_DIR_BATCH)
+            {
+                done = 1;
+            }
+        }
+
+        result = ode_flush(ode);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// helper functions
+//
+
+static SLINGA_ERROR get_ode(DEVICE_TYPE device_type, PODE_DEVICE* ode)
+{
+    if(!ode)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+#ifdef INCLUDE_SATIATIOR
+    if(device_type == DEVICE_SATIATIOR)
+    {
+        *ode = &g_ODE_Devices[0];
+        return SLINGA_SUCCESS;
+    }
+#endif
+
+#ifdef INCLUDE_MODE
+    if(device_type == DEVICE_MODE)
+    {
+        *ode = &g_ODE_Devices[1];
+        return SLINGA_SUCCESS;
+    }
+#endif
+
+    return SLINGA_INVALID_DEVICE_TYPE;
+}
+
+static unsigned int get_window(const PODE_DEVICE ode)
+{
+    if(!ode->transport->max_outstanding || ode->transport->max_outstanding > ODE_MAX_OUTSTANDING)
+    {
+        return ODE_MAX_OUTSTANDING;
+    }
+
+    return ode->transport->max_outstanding;
+}
+
+static unsigned int get_max_transfer(const PODE_DEVICE ode)
+{
+    if(!ode->transport->max_transfer || ode->transport->max_transfer > ODE_MAX_TRANSFER)
+    {
+        return ODE_MAX_TRANSFER;
+    }
+
+    return ode->transport->max_transfer;
+}
+
+/**
+ * @brief List a window's worth of SATSAVES directory batches in one round trip
+ *
+ * @param[in] ode ODE to list
+ * @param[in] first_entry Index of the first directory entry to return
+ * @param[out] responses One response per batch. responses[i].length entries are in g_ODE_Dir_Entries[i]
+ * @param[out] num_batches Number of batches listed
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR list_batches(PODE_DEVICE ode, unsigned int first_entry, PODE_RESPONSE responses, unsigned int* num_batches)
+{
+    ODE_COMMAND command = {0};
+    unsigned int window = 0;
+    SLINGA_ERROR result = 0;
+
+    window = get_window(ode);
+
+    command.type = ODE_CMD_LIST_DIR;
+    command.length = ODE_DIR_BATCH;
+    strcpy(command.path, SAVES_DIRECTORY);
+
+    for(unsigned int i = 0; i < window; i++)
+    {
+        memset(&responses[i], 0, sizeof(ODE_RESPONSE));
+
+        command.offset = first_entry + (i * ODE_DIR_BATCH);
+        command.buffer = (unsigned char*)g_ODE_Dir_Entries[i];
+
+        result = ode_submit(ode, &command, &responses[i]);
+        if(result != SLINGA_SUCCESS)
+        {
+            ode_flush(ode);
+            return result;
+        }
+    }
+
+    result = ode_flush(ode);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < window; i++)
+    {
+        // don't trust the transport
+        if(responses[i].length > ODE_DIR_BATCH)
+        {
+            return SLINGA_ODE_BAD_RESPONSE;
+        }
+    }
+
+    *num_batches = window;
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// Command pipeline
+//
+
+/**
+ * @brief Queue a command. Only blocks if the transport's window is full
+ *
+ * @param[in] ode ODE to send the command to
+ * @param[in] command Command to send. The tag is filled in by this function
+ * @param[out] response Where to copy the response when it arrives. Can be NULL
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR ode_submit(PODE_DEVICE ode, const PODE_COMMAND command, PODE_RESPONSE response)
+{
+    unsigned int window = 0;
+    unsigned int slot = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!ode->transport)
+    {
+        return SLINGA_ODE_NO_TRANSPORT;
+    }
+
+    window = get_window(ode);
+
+    // wait for room in the window
+    while(ode->outstanding >= window)
+    {
+        result = ode_complete_one(ode);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    for(slot = 0; slot < ODE_MAX_OUTSTANDING; slot++)
+    {
+        if(!ode->busy[slot])
+        {
+            break;
+        }
+    }
+
+    if(slot == ODE_MAX_OUTSTANDING)
+    {
+        // should never get here
+        return SLINGA_ODE_BAD_RESPONSE;
+    }
+
+    memcpy(&ode->queue[slot], command, sizeof(ODE_COMMAND));
+    ode->queue[slot].tag = (ode->sequence++ << ODE_TAG_SEQUENCE_SHIFT) | slot;
+    ode->responses[slot] = response;
+
+    result = ode->transport->submit(ode->transport->context, &ode->queue[slot]);
+    if(result != SLINGA_SUCCESS)
+    {
+        return SLINGA_ODE_TRANSPORT_ERROR;
+    }
+
+    ode->busy[slot] = 1;
+    ode->outstanding++;
+    ode->stats.commands++;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Wait for one response and retire its command
+ *
+ * @param[in] ode ODE to wait on
+ *
+ * @return SLINGA_SUCCESS if a response was received, even if the command failed
+ */
+static SLINGA_ERROR ode_complete_one(PODE_DEVICE ode)
+{
+    ODE_RESPONSE response = {0};
+    PODE_COMMAND command = NULL;
+    unsigned int slot = 0;
+    SLINGA_ERROR result = 0;
+
+    result = ode->transport->complete(ode->transport->context, &response);
+    if(result != SLINGA_SUCCESS)
+    {
+        // we have no idea what state the ODE is in
+        ode_reset(ode);
+        return SLINGA_ODE_TRANSPORT_ERROR;
+    }
+
+    slot = response.tag & ODE_TAG_SLOT_MASK;
+    if(slot >= ODE_MAX_OUTSTANDING || !ode->busy[slot] || ode->queue[slot].tag != response.tag)
+    {
+        ode_reset(ode);
+        return SLINGA_ODE_BAD_RESPONSE;
+    }
+
+    command = &ode->queue[slot];
+
+    if(response.result == SLINGA_SUCCESS)
+    {
+        switch(command->type)
+        {
+            case ODE_CMD_READ:
+                ode->stats.bytes_read += response.length;
+                break;
+            case ODE_CMD_WRITE:
+                ode->stats.bytes_written += response.length;
+                break;
+            case ODE_CMD_LIST_DIR:
+                ode->stats.dir_entries += response.length;
+                break;
+            default:
+                break;
+        }
+    }
+    else if(ode->error == SLINGA_SUCCESS)
+    {
+        // remember the first failure, reported by ode_flush()
+        ode->error = response.result;
+    }
+
+    if(ode->responses[slot])
+    {
+        memcpy(ode->responses[slot], &response, sizeof(ODE_RESPONSE));
+    }
+
+    ode->busy[slot] = 0;
+    ode->responses[slot] = NULL;
+    ode->outstanding--;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Wait for every outstanding command. This is the only place we pay a full round trip
+ *
+ * @param[in] ode ODE to wait on
+ *
+ * @return SLINGA_SUCCESS if every command since the last flush succeeded, otherwise the first error
+ */
+static SLINGA_ERROR ode_flush(PODE_DEVICE ode)
+{
+    SLINGA_ERROR result = 0;
+
+    if(ode->outstanding)
+    {
+        ode->stats.round_trips++;
+    }
+
+    while(ode->outstanding)
+    {
+        result = ode_complete_one(ode);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = ode->error;
+    ode->error = SLINGA_SUCCESS;
+
+    return result;
+}
+
+static void ode_reset(PODE_DEVICE ode)
+{
+    memset(ode->queue, 0, sizeof(ode->queue));
+    memset(ode->responses, 0, sizeof(ode->responses));
+    memset(ode->busy, 0, sizeof(ode->busy));
+    ode->outstanding = 0;
+    ode->error = SLINGA_SUCCESS;
+}
+
+#endif
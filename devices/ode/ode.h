@@ -0,0 +1,131 @@
+/** @file ode.h
+ *
+ *  @author Slinga
+ *  @brief Optical Drive Emulators (Satiator, MODE) prototypes and constants
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#if defined(INCLUDE_SATIATIOR) || defined(INCLUDE_MODE)
+
+#include "../../libslinga.h"
+#include "../bup/bup.h"
+
+//
+// ODEs store saves as .BUP files in the SATSAVES directory of the SD card.
+// File I/O on an ODE is command\response based, and every wait on a response
+// costs a full round trip over the cartridge or CD block interface. To keep
+// the round trips down:
+// - up to ODE_MAX_OUTSTANDING commands are kept in flight at once
+// - reads and writes are split into large ODE_MAX_TRANSFER chunks that are all
+//   queued before waiting on any of them
+// - directory listings return ODE_DIR_BATCH entries per command, each with the
+//   .BUP header inline so listing doesn't need a read per save
+//
+// The ODE specific code lives behind ODE_TRANSPORT. A transport must execute
+// commands in the order they were submitted, but may return responses as soon
+// as they are ready.
+//
+
+#define ODE_MAX_OUTSTANDING     4           ///< @brief Maximum number of commands in flight
+#define ODE_MAX_TRANSFER        (32 * 1024) ///< @brief Maximum bytes moved by a single read\write command
+#define ODE_DIR_BATCH           16          ///< @brief Directory entries returned by a single list command
+
+/** @brief Commands understood by an ODE transport */
+typedef enum
+{
+    ODE_CMD_STAT_FS = 1,    ///< @brief Total and free bytes on the storage
+    ODE_CMD_LIST_DIR = 2,   ///< @brief Up to length ODE_DIR_ENTRYs starting at entry index offset
+    ODE_CMD_READ = 3,       ///< @brief Read length bytes at offset into buffer
+    ODE_CMD_WRITE = 4,      ///< @brief Write length bytes from buffer at offset
+    ODE_CMD_DELETE = 5,     ///< @brief Delete the file at path
+} ODE_COMMAND_TYPE;
+
+/** @brief Flags for ODE_CMD_WRITE */
+typedef enum
+{
+    ODE_FLAG_CREATE = 1 << 0,       ///< @brief Create the file (and its directory) if missing
+    ODE_FLAG_TRUNCATE = 1 << 1,     ///< @brief Truncate the file before writing
+    ODE_FLAG_EXCLUSIVE = 1 << 2,    ///< @brief Fail with SLINGA_FILE_EXISTS if the file already exists
+} ODE_COMMAND_FLAGS;
+
+/** @brief Directory entry returned by ODE_CMD_LIST_DIR */
+typedef struct _ODE_DIR_ENTRY
+{
+    char name[MAX_FILENAME + 1];            ///< @brief File name, no directory
+    unsigned int size;                      ///< @brief File size in bytes
+    unsigned char header[BUP_HEADER_SIZE];  ///< @brief First BUP_HEADER_SIZE bytes of the file
+} ODE_DIR_ENTRY, *PODE_DIR_ENTRY;
+
+/** @brief Command sent to the ODE */
+typedef struct _ODE_COMMAND
+{
+    unsigned int tag;               ///< @brief Echoed back in the response
+    ODE_COMMAND_TYPE type;          ///< @brief Command to execute
+    unsigned int flags;             ///< @brief ODE_COMMAND_FLAGS
+    char path[BUP_MAX_PATH];        ///< @brief File or directory the command operates on
+    unsigned int offset;            ///< @brief File offset or first directory entry
+    unsigned int length;            ///< @brief Bytes or directory entries
+    unsigned char* buffer;          ///< @brief Destination for reads\listings, source for writes. Must stay valid until the response arrives
+} ODE_COMMAND, *PODE_COMMAND;
+
+/** @brief Response to an ODE_COMMAND */
+typedef struct _ODE_RESPONSE
+{
+    unsigned int tag;               ///< @brief Tag of the command this response is for
+    SLINGA_ERROR result;            ///< @brief SLINGA_SUCCESS or SLINGA_NOT_FOUND, SLINGA_FILE_EXISTS, etc
+    unsigned int length;            ///< @brief Bytes transferred or directory entries returned
+    unsigned int total_bytes;       ///< @brief ODE_CMD_STAT_FS only
+    unsigned int free_bytes;        ///< @brief ODE_CMD_STAT_FS only
+} ODE_RESPONSE, *PODE_RESPONSE;
+
+typedef SLINGA_ERROR (*ODE_SUBMIT)(void*, const PODE_COMMAND);
+typedef SLINGA_ERROR (*ODE_COMPLETE)(void*, PODE_RESPONSE);
+
+/** @brief Moves commands and responses between libslinga and the ODE */
+typedef struct _ODE_TRANSPORT
+{
+    void* context;                  ///< @brief Passed to submit and complete
+    ODE_SUBMIT submit;              ///< @brief Queue a command. Must not block waiting on the response
+    ODE_COMPLETE complete;          ///< @brief Block until a response is available
+    unsigned int max_outstanding;   ///< @brief Commands the ODE can queue. 0 or > ODE_MAX_OUTSTANDING means ODE_MAX_OUTSTANDING
+    unsigned int max_transfer;      ///< @brief Largest read\write the ODE accepts. 0 or > ODE_MAX_TRANSFER means ODE_MAX_TRANSFER
+} ODE_TRANSPORT, *PODE_TRANSPORT;
+
+/** @brief Transport usage counters */
+typedef struct _ODE_STATS
+{
+    unsigned int commands;          ///< @brief Commands submitted
+    unsigned int round_trips;       ///< @brief Times libslinga had to wait for every outstanding command to finish
+    unsigned int bytes_read;        ///< @brief Bytes read from files
+    unsigned int bytes_written;     ///< @brief Bytes written to files
+    unsigned int dir_entries;       ///< @brief Directory entries returned
+} ODE_STATS, *PODE_STATS;
+
+SLINGA_ERROR ODE_RegisterHandler(DEVICE_TYPE type, PDEVICE_HANDLER* device_handler);
+SLINGA_ERROR ODE_SetTransport(DEVICE_TYPE device_type, PODE_TRANSPORT transport);
+SLINGA_ERROR ODE_GetStats(DEVICE_TYPE device_type, PODE_STATS stats);
+SLINGA_ERROR ODE_ResetStats(DEVICE_TYPE device_type);
+
+SLINGA_ERROR ODE_Init(DEVICE_TYPE device_type);
+SLINGA_ERROR ODE_Fini(DEVICE_TYPE device_type);
+
+SLINGA_ERROR ODE_GetDeviceName(DEVICE_TYPE type, char** device_name);
+SLINGA_ERROR ODE_IsPresent(DEVICE_TYPE type);
+SLINGA_ERROR ODE_IsReadable(DEVICE_TYPE type);
+SLINGA_ERROR ODE_IsWriteable(DEVICE_TYPE type);
+
+SLINGA_ERROR ODE_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+SLINGA_ERROR ODE_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
+SLINGA_ERROR ODE_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR ODE_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
+
+SLINGA_ERROR ODE_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+SLINGA_ERROR ODE_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR ODE_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
+SLINGA_ERROR ODE_Format(DEVICE_TYPE device_type);
+
+#endif
@@ -0,0 +1,443 @@
+/** @file ode_sim.c
+ *
+ *  @author Slinga
+ *  @brief In-process ODE transport backed by a host directory
+ *  @bug Host only, requires POSIX.
+ */
+#include "ode_sim.h"
+
+#if defined(INCLUDE_ODE_SIMULATOR) && (defined(INCLUDE_SATIATIOR) || defined(INCLUDE_MODE))
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+static SLINGA_ERROR sim_submit(void* context, const PODE_COMMAND command);
+static SLINGA_ERROR sim_complete(void* context, PODE_RESPONSE response);
+
+// command handlers
+static void sim_stat_fs(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response);
+static void sim_list_dir(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response);
+static void sim_read(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response);
+static void sim_write(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response);
+static void sim_delete(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response);
+
+static SLINGA_ERROR get_host_path(const PODE_SIM sim, const char* path, char* host_path, unsigned int host_path_size);
+static int filter_entry(const struct dirent* entry);
+
+/**
+ * @brief Initialize the simulator and fill out a transport that uses it
+ *
+ * @param[out] sim Simulator state. Must remain valid while the transport is attached
+ * @param[in] root Host directory. Saves live in root/SATSAVES
+ * @param[in] config Link model. NULL for an instant link
+ * @param[out] transport Transport to pass to ODE_SetTransport()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR ODE_Sim_Init(PODE_SIM sim, const char* root, const PODE_SIM_CONFIG config, PODE_TRANSPORT transport)
+{
+    if(!sim || !root || !transport)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(strlen(root) >= sizeof(sim->root))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(sim, 0, sizeof(ODE_SIM));
+    strcpy(sim->root, root);
+
+    if(config)
+    {
+        memcpy(&sim->config, config, sizeof(ODE_SIM_CONFIG));
+    }
+
+    memset(transport, 0, sizeof(ODE_TRANSPORT));
+    transport->context = sim;
+    transport->submit = sim_submit;
+    transport->complete = sim_complete;
+    transport->max_outstanding = sim->config.max_outstanding;
+    transport->max_transfer = sim->config.max_transfer;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Virtual time spent waiting on the simulated ODE
+ *
+ * @param[in] sim Simulator
+ * @param[out] elapsed_us Microseconds since ODE_Sim_Init() or ODE_Sim_ResetClock()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR ODE_Sim_GetElapsed(const PODE_SIM sim, unsigned long long* elapsed_us)
+{
+    if(!sim || !elapsed_us)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    *elapsed_us = sim->now_us;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Reset the virtual clock. Only valid when no commands are in flight
+ *
+ * @param[in] sim Simulator
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR ODE_Sim_ResetClock(PODE_SIM sim)
+{
+    if(!sim)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(sim->count)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    sim->now_us = 0;
+    sim->link_free_us = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// transport callbacks
+//
+
+static SLINGA_ERROR sim_submit(void* context, const PODE_COMMAND command)
+{
+    PODE_SIM sim = (PODE_SIM)context;
+    PODE_RESPONSE response = NULL;
+    unsigned long long start_us = 0;
+    unsigned int index = 0;
+    unsigned int payload = 0;
+
+    if(!sim || !command)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(sim->count >= ODE_SIM_MAX_QUEUE)
+    {
+        return SLINGA_ODE_TRANSPORT_ERROR;
+    }
+
+    index = (sim->head + sim->count) % ODE_SIM_MAX_QUEUE;
+    response = &sim->queue[index];
+
+    memset(response, 0, sizeof(ODE_RESPONSE));
+    response->tag = command->tag;
+
+    // commands execute in submission order, so run it now
+    switch(command->type)
+    {
+        case ODE_CMD_STAT_FS:
+            sim_stat_fs(sim, command, response);
+            break;
+        case ODE_CMD_LIST_DIR:
+            sim_list_dir(sim, command, response);
+            payload = response->length * sizeof(ODE_DIR_ENTRY);
+            break;
+        case ODE_CMD_READ:
+            sim_read(sim, command, response);
+            payload = response->length;
+            break;
+        case ODE_CMD_WRITE:
+            sim_write(sim, command, response);
+            payload = command->length;
+            break;
+        case ODE_CMD_DELETE:
+            sim_delete(sim, command, response);
+            break;
+        default:
+            response->result = SLINGA_NOT_SUPPORTED;
+            break;
+    }
+
+    //
+    // model the link: the command waits for the link, occupies it for its
+    // overhead plus payload, then the response takes latency_us to arrive
+    //
+    start_us = (sim->link_free_us > sim->now_us) ? sim->link_free_us : sim->now_us;
+    sim->link_free_us = start_us + sim->config.command_us;
+
+    if(sim->config.bytes_per_ms)
+    {
+        sim->link_free_us += ((unsigned long long)payload * 1000) / sim->config.bytes_per_ms;
+    }
+
+    sim->ready_us[index] = sim->link_free_us + sim->config.latency_us;
+    sim->count++;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR sim_complete(void* context, PODE_RESPONSE response)
+{
+    PODE_SIM sim = (PODE_SIM)context;
+
+    if(!sim || !response)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(!sim->count)
+    {
+        // nothing in flight, the caller would block forever
+        return SLINGA_ODE_TRANSPORT_ERROR;
+    }
+
+    // responses arrive in order on a single link
+    if(sim->ready_us[sim->head] > sim->now_us)
+    {
+        sim->now_us = sim->ready_us[sim->head];
+    }
+
+    memcpy(response, &sim->queue[sim->head], sizeof(ODE_RESPONSE));
+
+    sim->head = (sim->head + 1) % ODE_SIM_MAX_QUEUE;
+    sim->count--;
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// command handlers
+//
+
+static void sim_stat_fs(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response)
+{
+    struct statvfs fs = {0};
+    unsigned long long total = 0;
+    unsigned long long avail = 0;
+
+    UNUSED(command);
+
+    if(statvfs(sim->root, &fs) != 0)
+    {
+        response->result = SLINGA_DEVICE_NOT_PRESENT;
+        return;
+    }
+
+    total = (unsigned long long)fs.f_blocks * fs.f_frsize;
+    avail = (unsigned long long)fs.f_bavail * fs.f_frsize;
+
+    // SD cards are bigger than 4GB, clamp
+    response->total_bytes = (unsigned int)LIBSLINGA_MIN(total, 0xFFFFFFFFULL);
+    response->free_bytes = (unsigned int)LIBSLINGA_MIN(avail, 0xFFFFFFFFULL);
+    response->result = SLINGA_SUCCESS;
+}
+
+static void sim_list_dir(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response)
+{
+    char host_path[512] = {0};
+    struct dirent** names = NULL;
+    PODE_DIR_ENTRY entries = (PODE_DIR_ENTRY)command->buffer;
+    int num_names = 0;
+
+    if(!entries || get_host_path(sim, command->path, host_path, sizeof(host_path)) != SLINGA_SUCCESS)
+    {
+        response->result = SLINGA_INVALID_PARAMETER;
+        return;
+    }
+
+    // sorted so the order is stable between batches
+    num_names = scandir(host_path, &names, filter_entry, alphasort);
+    if(num_names < 0)
+    {
+        // a missing SATSAVES directory is just an empty device
+        response->result = (errno == ENOENT) ? SLINGA_SUCCESS : SLINGA_DEVICE_NOT_PRESENT;
+        return;
+    }
+
+    for(int i = 0; i < num_names; i++)
+    {
+        unsigned int index = (unsigned int)i;
+
+        if(index >= command->offset && response->length < command->length)
+        {
+            PODE_DIR_ENTRY entry = &entries[response->length];
+            char file_path[1024] = {0};
+            struct stat st = {0};
+            FILE* fp = NULL;
+            size_t name_len = 0;
+
+            memset(entry, 0, sizeof(ODE_DIR_ENTRY));
+            // a name too long for the entry can't be a save, leave it empty
+            name_len = strlen(names[i]->d_name);
+            if(name_len < sizeof(entry->name))
+            {
+                memcpy(entry->name, names[i]->d_name, name_len + 1);
+            }
+
+            snprintf(file_path, sizeof(file_path), "%s/%s", host_path, names[i]->d_name);
+            if(stat(file_path, &st) == 0)
+            {
+                entry->size = (unsigned int)st.st_size;
+            }
+
+            // the .BUP header rides along with the listing
+            fp = fopen(file_path, "rb");
+            if(fp)
+            {
+                if(fread(entry->header, 1, BUP_HEADER_SIZE, fp) != BUP_HEADER_SIZE)
+                {
+                    memset(entry->header, 0, BUP_HEADER_SIZE);
+                }
+                fclose(fp);
+            }
+
+            response->length++;
+        }
+
+        free(names[i]);
+    }
+
+    free(names);
+    response->result = SLINGA_SUCCESS;
+}
+
+static void sim_read(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response)
+{
+    char host_path[512] = {0};
+    FILE* fp = NULL;
+
+    if(!command->buffer || get_host_path(sim, command->path, host_path, sizeof(host_path)) != SLINGA_SUCCESS)
+    {
+        response->result = SLINGA_INVALID_PARAMETER;
+        return;
+    }
+
+    fp = fopen(host_path, "rb");
+    if(!fp)
+    {
+        response->result = SLINGA_NOT_FOUND;
+        return;
+    }
+
+    if(fseek(fp, command->offset, SEEK_SET) == 0)
+    {
+        response->length = fread(command->buffer, 1, command->length, fp);
+    }
+
+    fclose(fp);
+    response->result = SLINGA_SUCCESS;
+}
+
+static void sim_write(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response)
+{
+    char host_path[512] = {0};
+    struct stat st = {0};
+    int exists = 0;
+    FILE* fp = NULL;
+
+    if(!command->buffer || get_host_path(sim, command->path, host_path, sizeof(host_path)) != SLINGA_SUCCESS)
+    {
+        response->result = SLINGA_INVALID_PARAMETER;
+        return;
+    }
+
+    exists = (stat(host_path, &st) == 0);
+
+    if(exists && (command->flags & ODE_FLAG_EXCLUSIVE))
+    {
+        response->result = SLINGA_FILE_EXISTS;
+        return;
+    }
+
+    if(!exists && !(command->flags & ODE_FLAG_CREATE))
+    {
+        response->result = SLINGA_NOT_FOUND;
+        return;
+    }
+
+    if(!exists)
+    {
+        // create SATSAVES if needed
+        char dir_path[512] = {0};
+
+        if(get_host_path(sim, SAVES_DIRECTORY, dir_path, sizeof(dir_path)) == SLINGA_SUCCESS)
+        {
+            mkdir(dir_path, 0755);
+        }
+    }
+
+    fp = fopen(host_path, (!exists || (command->flags & ODE_FLAG_TRUNCATE)) ? "wb" : "r+b");
+    if(!fp)
+    {
+        response->result = SLINGA_NOT_ENOUGH_SPACE;
+        return;
+    }
+
+    if(fseek(fp, command->offset, SEEK_SET) == 0)
+    {
+        response->length = fwrite(command->buffer, 1, command->length, fp);
+    }
+
+    fclose(fp);
+
+    response->result = (response->length == command->length) ? SLINGA_SUCCESS : SLINGA_NOT_ENOUGH_SPACE;
+}
+
+static void sim_delete(PODE_SIM sim, const PODE_COMMAND command, PODE_RESPONSE response)
+{
+    char host_path[512] = {0};
+
+    if(get_host_path(sim, command->path, host_path, sizeof(host_path)) != SLINGA_SUCCESS)
+    {
+        response->result = SLINGA_INVALID_PARAMETER;
+        return;
+    }
+
+    if(remove(host_path) != 0)
+    {
+        response->result = (errno == ENOENT) ? SLINGA_NOT_FOUND : SLINGA_INVALID_PARAMETER;
+        return;
+    }
+
+    response->result = SLINGA_SUCCESS;
+}
+
+//
+// helper functions
+//
+
+static SLINGA_ERROR get_host_path(const PODE_SIM sim, const char* path, char* host_path, unsigned int host_path_size)
+{
+    int len = 0;
+
+    // don't let commands escape the root
+    if(!path || strstr(path, ".."))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    len = snprintf(host_path, host_path_size, "%s/%s", sim->root, path);
+    if(len < 0 || (unsigned int)len >= host_path_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static int filter_entry(const struct dirent* entry)
+{
+    // skip ".", "..", and hidden files
+    return entry->d_name[0] != '.';
+}
+
+#endif
@@ -0,0 +1,56 @@
+/** @file ode_sim.h
+ *
+ *  @author Slinga
+ *  @brief In-process ODE transport backed by a host directory
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#if defined(INCLUDE_ODE_SIMULATOR) && (defined(INCLUDE_SATIATIOR) || defined(INCLUDE_MODE))
+
+#include "ode.h"
+
+//
+// The ODE simulator executes commands against a directory on the host
+// (root/SATSAVES/*.BUP) and models the link to the ODE with a virtual clock:
+// - commands are executed in order over a single link of bytes_per_ms bandwidth
+// - every command pays command_us of overhead on the link
+// - every response arrives latency_us after its command finished on the link
+//
+// Nothing sleeps, complete() just advances the clock, so the elapsed time and
+// round trips of an operation can be measured exactly and repeatably.
+//
+
+#define ODE_SIM_MAX_QUEUE 64 ///< @brief Maximum responses the simulator holds
+
+/** @brief Link model for the simulator */
+typedef struct _ODE_SIM_CONFIG
+{
+    unsigned int latency_us;        ///< @brief Delay between a command finishing and its response arriving
+    unsigned int command_us;        ///< @brief Per command overhead on the link
+    unsigned int bytes_per_ms;      ///< @brief Link bandwidth. 0 means infinitely fast
+    unsigned int max_outstanding;   ///< @brief Copied to ODE_TRANSPORT.max_outstanding
+    unsigned int max_transfer;      ///< @brief Copied to ODE_TRANSPORT.max_transfer
+} ODE_SIM_CONFIG, *PODE_SIM_CONFIG;
+
+/** @brief Simulator state. Treat as opaque */
+typedef struct _ODE_SIM
+{
+    char root[256];                             ///< @brief Host directory holding SATSAVES
+    ODE_SIM_CONFIG config;                      ///< @brief Link model
+    ODE_RESPONSE queue[ODE_SIM_MAX_QUEUE];      ///< @brief Responses not yet completed
+    unsigned long long ready_us[ODE_SIM_MAX_QUEUE]; ///< @brief Time each response arrives
+    unsigned int head;                          ///< @brief Oldest response
+    unsigned int count;                         ///< @brief Responses in the queue
+    unsigned long long now_us;                  ///< @brief Virtual clock
+    unsigned long long link_free_us;            ///< @brief Time the link finishes the last queued command
+} ODE_SIM, *PODE_SIM;
+
+SLINGA_ERROR ODE_Sim_Init(PODE_SIM sim, const char* root, const PODE_SIM_CONFIG config, PODE_TRANSPORT transport);
+SLINGA_ERROR ODE_Sim_GetElapsed(const PODE_SIM sim, unsigned long long* elapsed_us);
+SLINGA_ERROR ODE_Sim_ResetClock(PODE_SIM sim);
+
+#endif
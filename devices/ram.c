@@ -8,8 +8,36 @@
 
 #ifdef INCLUDE_RAM
 
+#include "../libslinga/payload_cache.h"
+
 DEVICE_HANDLER g_RAM_Handler = {0};
 
+/** @brief Region holding the bundle, set with RAM_SetRegion() */
+unsigned char* g_RAM_Region = NULL;
+
+/** @brief Size of g_RAM_Region in bytes */
+unsigned int g_RAM_Region_Size = 0;
+
+/** @brief One page of the listing of the device being dumped */
+SAVE_METADATA g_RAM_Page[SLINGA_LIST_PAGE_LEN] = {0};
+
+static SLINGA_ERROR get_bundle(PRAM_BUNDLE_HEADER* header);
+static SLINGA_ERROR find_save(const PRAM_BUNDLE_HEADER header, const char* filename, unsigned int* index);
+static SLINGA_ERROR get_save_data(const PRAM_BUNDLE_HEADER header, unsigned int index, unsigned char** data, unsigned int* data_size);
+static void entry_to_metadata(const PRAM_BUNDLE_ENTRY entry, PSAVE_METADATA metadata);
+static SLINGA_ERROR check_space(const PRAM_BUNDLE_HEADER header, unsigned int data_size, const unsigned int* replaced);
+static void append_save(PRAM_BUNDLE_HEADER header, const PSAVE_METADATA metadata, unsigned int data_size);
+static void remove_save(PRAM_BUNDLE_HEADER header, unsigned int index);
+static unsigned int get_gap(const PRAM_BUNDLE_HEADER header, unsigned int index);
+
+static PRAM_BUNDLE_ENTRY get_entries(const PRAM_BUNDLE_HEADER header);
+static unsigned int get_directory_end(unsigned int capacity);
+static unsigned int align_size(unsigned int size);
+static unsigned int read_be16(const unsigned char* src);
+static unsigned int read_be32(const unsigned char* src);
+static void write_be16(unsigned char* dst, unsigned int val);
+static void write_be32(unsigned char* dst, unsigned int val);
+
 SLINGA_ERROR RAM_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler)
 {
     if(device_type != DEVICE_RAM)
@@ -30,6 +58,8 @@ SLINGA_ERROR RAM_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* devic
     g_RAM_Handler.is_writeable = RAM_IsWriteable;
     g_RAM_Handler.stat = RAM_Stat;
     g_RAM_Handler.list = RAM_List;
+    g_RAM_Handler.list_page = RAM_ListPage;
+    g_RAM_Handler.query_file = RAM_QueryFile;
     g_RAM_Handler.read = RAM_Read;
     g_RAM_Handler.write = RAM_Write;
     g_RAM_Handler.delete = RAM_Delete;
@@ -40,6 +70,202 @@ SLINGA_ERROR RAM_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* devic
     return SLINGA_SUCCESS;
 }
 
+/**
+ * @brief Set the RAM region the bundle lives in
+ *
+ * The region is used as is. If it already holds a bundle (for example one
+ * uploaded by Save Game Copier) its saves can be listed and read right away,
+ * otherwise call Slinga_Format() first.
+ *
+ * @param[in] region Start of the region. NULL to detach
+ * @param[in] size Size of region in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR RAM_SetRegion(unsigned char* region, unsigned int size)
+{
+    if(region && size < sizeof(RAM_BUNDLE_HEADER) + sizeof(RAM_BUNDLE_ENTRY))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_RAM_Region = region;
+    g_RAM_Region_Size = region ? size : 0;
+    g_Context.isPresent[DEVICE_RAM] = 0;
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    // a different region holds different saves
+    Slinga_InvalidatePayloadCache(DEVICE_RAM);
+#endif
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Number of bytes of the region used by the bundle. This is how much to copy out after a dump
+ *
+ * @param[out] size Bundle size in bytes on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR RAM_GetBundleSize(unsigned int* size)
+{
+    PRAM_BUNDLE_HEADER header = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    *size = read_be32(header->data_end);
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Replace the bundle with every save on another device
+ *
+ * Each save is read straight into its place in the bundle.
+ *
+ * @param[in] source Device to dump
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR RAM_DumpDevice(DEVICE_TYPE source)
+{
+    PRAM_BUNDLE_HEADER header = NULL;
+    unsigned int cursor = SLINGA_LIST_START;
+    unsigned int num_saves = 0;
+    SLINGA_ERROR result = 0;
+
+    if(source == DEVICE_RAM)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    // list the first page before formatting so a bad source leaves the bundle alone
+    result = Slinga_ListPage(source, 0, cursor, g_RAM_Page, SLINGA_LIST_PAGE_LEN, &num_saves, &cursor);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    // the bundle is rebuilt in place, not through Slinga_Write()
+    Slinga_InvalidatePayloadCache(DEVICE_RAM);
+#endif
+
+    result = RAM_Format(DEVICE_RAM);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(;;)
+    {
+        for(unsigned int i = 0; i < num_saves; i++)
+        {
+            unsigned int data_end = read_be32(header->data_end);
+            unsigned int bytes_read = 0;
+
+            result = check_space(header, g_RAM_Page[i].data_size, NULL);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+
+            // SAT devices only read into a buffer the exact size of the save
+            result = Slinga_Read(source, 0, g_RAM_Page[i].savename, g_RAM_Region + data_end, g_RAM_Page[i].data_size, &bytes_read);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+
+            // the data is already in place, just index it
+            append_save(header, &g_RAM_Page[i], bytes_read);
+        }
+
+        if(cursor == SLINGA_LIST_END)
+        {
+            break;
+        }
+
+        result = Slinga_ListPage(source, 0, cursor, g_RAM_Page, SLINGA_LIST_PAGE_LEN, &num_saves, &cursor);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Write every save in the bundle to another device
+ *
+ * @param[in] destination Device to restore to
+ * @param[in] flags Passed to Slinga_Write(). OVERWRITE_EXISTING_SAVE to replace saves already on the device
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR RAM_RestoreDevice(DEVICE_TYPE destination, FLAGS flags)
+{
+    PRAM_BUNDLE_HEADER header = NULL;
+    PRAM_BUNDLE_ENTRY entries = NULL;
+    unsigned int num_saves = 0;
+    SLINGA_ERROR result = 0;
+
+    if(destination == DEVICE_RAM)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    entries = get_entries(header);
+    num_saves = read_be16(header->num_saves);
+
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        SAVE_METADATA metadata = {0};
+        unsigned char* data = NULL;
+        unsigned int data_size = 0;
+
+        result = get_save_data(header, i, &data, &data_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        entry_to_metadata(&entries[i], &metadata);
+
+        result = Slinga_Write(destination, flags, metadata.savename, &metadata, data, data_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
 SLINGA_ERROR RAM_Init(DEVICE_TYPE device_type)
 {
     if(device_type != DEVICE_RAM)
@@ -90,7 +316,12 @@ SLINGA_ERROR RAM_IsPresent(DEVICE_TYPE device_type)
         return SLINGA_SUCCESS;
     }
 
-    // RAM is always present
+    // RAM is always there, but we need to know where the bundle lives
+    if(!g_RAM_Region)
+    {
+        return SLINGA_DEVICE_NOT_PRESENT;
+    }
+
     g_Context.isPresent[device_type] = 1;
     return SLINGA_SUCCESS;
 }
@@ -117,100 +348,601 @@ SLINGA_ERROR RAM_IsWriteable(DEVICE_TYPE device_type)
 
 SLINGA_ERROR RAM_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
 {
-    UNUSED(stat);
+    PRAM_BUNDLE_HEADER header = NULL;
+    unsigned int directory_end = 0;
+    unsigned int free_saves = 0;
+    SLINGA_ERROR result = 0;
 
     if(device_type != DEVICE_RAM)
     {
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    //
-    // Stating RAM doesn't make sense
-    //
+    if(!stat)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
 
-    return SLINGA_NOT_SUPPORTED;
+    memset(stat, 0, sizeof(BACKUP_STAT));
+
+    directory_end = get_directory_end(read_be16(header->capacity));
+    free_saves = read_be16(header->capacity) - read_be16(header->num_saves);
+
+    stat->block_size = RAM_BUNDLE_BLOCK_SIZE;
+    stat->total_blocks = (g_RAM_Region_Size - directory_end) / RAM_BUNDLE_BLOCK_SIZE;
+    stat->total_bytes = stat->total_blocks * RAM_BUNDLE_BLOCK_SIZE;
+    stat->free_blocks = (g_RAM_Region_Size - read_be32(header->data_end)) / RAM_BUNDLE_BLOCK_SIZE;
+    stat->free_bytes = stat->free_blocks * RAM_BUNDLE_BLOCK_SIZE;
+
+    // limited by both the directory and the space left
+    stat->max_saves_possible = LIBSLINGA_MIN(free_saves, stat->free_blocks);
+
+    return SLINGA_SUCCESS;
 }
 
 SLINGA_ERROR RAM_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
 {
+    PRAM_BUNDLE_HEADER header = NULL;
+    PRAM_BUNDLE_ENTRY entries = NULL;
+    unsigned int count = 0;
+    SLINGA_ERROR result = 0;
+
     UNUSED(flags);
-    UNUSED(saves);
-    UNUSED(num_saves);
-    UNUSED(saves_found);
 
     if(device_type != DEVICE_RAM)
     {
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    //
-    // Listing RAM doesn't make sense
-    //
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
 
-    return SLINGA_NOT_SUPPORTED;
+    entries = get_entries(header);
+    count = read_be16(header->num_saves);
+
+    if(saves)
+    {
+        if(count > num_saves)
+        {
+            // no more room in our saves array
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        // the directory has everything, no need to look at the save data
+        for(unsigned int i = 0; i < count; i++)
+        {
+            entry_to_metadata(&entries[i], &saves[i]);
+        }
+    }
+
+    if(saves_found)
+    {
+        *saves_found = count;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR RAM_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    PRAM_BUNDLE_HEADER header = NULL;
+    PRAM_BUNDLE_ENTRY entries = NULL;
+    unsigned int count = 0;
+    unsigned int found = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    if(device_type != DEVICE_RAM)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    entries = get_entries(header);
+    count = read_be16(header->num_saves);
+
+    // the cursor is the directory index to resume from
+    for(unsigned int i = cursor; i < count && found < page_len; i++)
+    {
+        entry_to_metadata(&entries[i], &page[found]);
+        found++;
+    }
+
+    *saves_found = found;
+    *next_cursor = (cursor + found < count) ? cursor + found : SLINGA_LIST_END;
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR RAM_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
+{
+    PRAM_BUNDLE_HEADER header = NULL;
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    if(device_type != DEVICE_RAM)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!filename || !save)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(header, filename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    entry_to_metadata(&get_entries(header)[index], save);
+
+    return SLINGA_SUCCESS;
 }
 
 SLINGA_ERROR RAM_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
 {
+    PRAM_BUNDLE_HEADER header = NULL;
+    unsigned char* data = NULL;
+    unsigned int data_size = 0;
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
     UNUSED(flags);
-    UNUSED(filename);
-    UNUSED(buffer);
-    UNUSED(size);
-    UNUSED(bytes_read);
 
     if(device_type != DEVICE_RAM)
     {
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    return SLINGA_NOT_IMPLEMENTED;
+    if(!filename || !buffer || !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(header, filename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_save_data(header, index, &data, &data_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(data_size > size)
+    {
+        // buffer isn't big enough to hold the save
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(buffer, data, data_size);
+
+    if(bytes_read)
+    {
+        *bytes_read = data_size;
+    }
+
+    return SLINGA_SUCCESS;
 }
 
 SLINGA_ERROR RAM_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
 {
-    UNUSED(flags);
-    UNUSED(filename);
-    UNUSED(save_metadata);
-    UNUSED(buffer);
-    UNUSED(size);
+    PRAM_BUNDLE_HEADER header = NULL;
+    SAVE_METADATA metadata = {0};
+    unsigned int index = 0;
+    unsigned char exists = 0;
+    SLINGA_ERROR result = 0;
 
     if(device_type != DEVICE_RAM)
     {
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    return SLINGA_NOT_IMPLEMENTED;
+    if(!filename || !save_metadata || !buffer || !size || size > MAX_SAVE_SIZE)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(!filename[0] || strlen(filename) >= RAM_BUNDLE_SAVENAME_LEN)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(header, filename, &index);
+    if(result == SLINGA_SUCCESS)
+    {
+        unsigned char* data = NULL;
+        unsigned int data_size = 0;
+
+        if((flags & OVERWRITE_EXISTING_SAVE) == 0)
+        {
+            return SLINGA_FILE_EXISTS;
+        }
+
+        // validates the old entry before its space is counted
+        result = get_save_data(header, index, &data, &data_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        exists = 1;
+    }
+    else if(result != SLINGA_NOT_FOUND)
+    {
+        return result;
+    }
+
+    // only remove the old save once we know the new one fits
+    result = check_space(header, size, exists ? &index : NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(exists)
+    {
+        remove_save(header, index);
+    }
+
+    memcpy(&metadata, save_metadata, sizeof(SAVE_METADATA));
+    strcpy(metadata.savename, filename);
+
+    memcpy(g_RAM_Region + read_be32(header->data_end), buffer, size);
+
+    append_save(header, &metadata, size);
+
+    return SLINGA_SUCCESS;
 }
 
 SLINGA_ERROR RAM_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
 {
-    UNUSED(flags);
-    UNUSED(filename);
+    PRAM_BUNDLE_HEADER header = NULL;
+    unsigned char* data = NULL;
+    unsigned int data_size = 0;
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
 
     if(device_type != DEVICE_RAM)
     {
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    //
-    // deleting from RAM doesn't make sense
-    //
+    if(!filename)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_bundle(&header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(header, filename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(flags & ZERO_DELETE)
+    {
+        result = get_save_data(header, index, &data, &data_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        memset(data, 0, data_size);
+    }
+
+    remove_save(header, index);
 
-    return SLINGA_NOT_SUPPORTED;
+    return SLINGA_SUCCESS;
 }
 
 SLINGA_ERROR RAM_Format(DEVICE_TYPE device_type)
 {
+    PRAM_BUNDLE_HEADER header = NULL;
+    unsigned int capacity = 0;
+
     if(device_type != DEVICE_RAM)
     {
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    //
-    // Foramtting RAM doesn't make sense
-    //
+    if(!g_RAM_Region)
+    {
+        return SLINGA_DEVICE_NOT_PRESENT;
+    }
+
+    // room for MAX_SAVES entries unless the region is tiny
+    capacity = (g_RAM_Region_Size - sizeof(RAM_BUNDLE_HEADER)) / (sizeof(RAM_BUNDLE_ENTRY) + RAM_BUNDLE_ALIGN);
+    capacity = LIBSLINGA_MIN(capacity, MAX_SAVES);
+    if(!capacity)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    header = (PRAM_BUNDLE_HEADER)g_RAM_Region;
+
+    memset(header, 0, sizeof(RAM_BUNDLE_HEADER));
+    memcpy(header->magic, RAM_BUNDLE_MAGIC, RAM_BUNDLE_MAGIC_LEN);
+    write_be16(header->version, RAM_BUNDLE_VERSION);
+    write_be16(header->capacity, capacity);
+    write_be16(header->num_saves, 0);
+    write_be32(header->data_end, get_directory_end(capacity));
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// helper functions
+//
+
+/**
+ * @brief Validate the bundle header
+ *
+ * Only the header is checked so this is O(1). Entries are checked as they are used.
+ *
+ * @param[out] header Bundle header on success
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FORMATTED if the region doesn't hold a bundle
+ */
+static SLINGA_ERROR get_bundle(PRAM_BUNDLE_HEADER* header)
+{
+    PRAM_BUNDLE_HEADER bundle = (PRAM_BUNDLE_HEADER)g_RAM_Region;
+    unsigned int capacity = 0;
+    unsigned int data_end = 0;
+
+    if(!g_RAM_Region)
+    {
+        return SLINGA_DEVICE_NOT_PRESENT;
+    }
+
+    if(memcmp(bundle->magic, RAM_BUNDLE_MAGIC, RAM_BUNDLE_MAGIC_LEN) != 0 || read_be16(bundle->version) != RAM_BUNDLE_VERSION)
+    {
+        return SLINGA_NOT_FORMATTED;
+    }
+
+    capacity = read_be16(bundle->capacity);
+    data_end = read_be32(bundle->data_end);
+
+    if(!capacity || capacity > MAX_SAVES || read_be16(bundle->num_saves) > capacity ||
+       get_directory_end(capacity) > data_end || data_end > g_RAM_Region_Size)
+    {
+        // doesn't fit in the region, probably a bundle from a bigger region
+        return SLINGA_NOT_FORMATTED;
+    }
+
+    *header = bundle;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR find_save(const PRAM_BUNDLE_HEADER header, const char* filename, unsigned int* index)
+{
+    PRAM_BUNDLE_ENTRY entries = get_entries(header);
+    unsigned int num_saves = read_be16(header->num_saves);
+
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        if(strncmp(entries[i].savename, filename, RAM_BUNDLE_SAVENAME_LEN) == 0)
+        {
+            *index = i;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+static SLINGA_ERROR get_save_data(const PRAM_BUNDLE_HEADER header, unsigned int index, unsigned char** data, unsigned int* data_size)
+{
+    PRAM_BUNDLE_ENTRY entry = &get_entries(header)[index];
+    unsigned int offset = read_be32(entry->data_offset);
+    unsigned int size = read_be32(entry->data_size);
+
+    // don't trust offsets in a bundle that came from somewhere else
+    if(offset < get_directory_end(read_be16(header->capacity)) || offset > read_be32(header->data_end) ||
+       size > read_be32(header->data_end) - offset)
+    {
+        return SLINGA_NOT_FORMATTED;
+    }
+
+    *data = g_RAM_Region + offset;
+    *data_size = size;
+
+    return SLINGA_SUCCESS;
+}
 
-    return SLINGA_NOT_SUPPORTED;
+static void entry_to_metadata(const PRAM_BUNDLE_ENTRY entry, PSAVE_METADATA metadata)
+{
+    memset(metadata, 0, sizeof(SAVE_METADATA));
+
+    // entry strings are NULL terminated but don't trust them
+    memcpy(metadata->savename, entry->savename, RAM_BUNDLE_SAVENAME_LEN - 1);
+    memcpy(metadata->comment, entry->comment, RAM_BUNDLE_COMMENT_LEN - 1);
+    strcpy(metadata->filename, metadata->savename);
+
+    metadata->language = entry->language;
+    metadata->timestamp = read_be32(entry->timestamp);
+    metadata->data_size = read_be32(entry->data_size);
+    metadata->block_size = (unsigned short)((metadata->data_size + RAM_BUNDLE_BLOCK_SIZE - 1) / RAM_BUNDLE_BLOCK_SIZE);
+}
+
+/**
+ * @brief Check that a save fits in the bundle
+ *
+ * This is the only place space is checked, call it before anything is
+ * removed or copied.
+ *
+ * @param[in] header Bundle header
+ * @param[in] data_size Size of the new save in bytes
+ * @param[in] replaced Index of the save it replaces, NULL for a new save
+ *
+ * @return SLINGA_SUCCESS if it fits, SLINGA_NOT_ENOUGH_SPACE otherwise
+ */
+static SLINGA_ERROR check_space(const PRAM_BUNDLE_HEADER header, unsigned int data_size, const unsigned int* replaced)
+{
+    unsigned int available = g_RAM_Region_Size - read_be32(header->data_end);
+
+    if(replaced)
+    {
+        // only what remove_save() actually gives back
+        available += get_gap(header, *replaced);
+    }
+    else if(read_be16(header->num_saves) >= read_be16(header->capacity))
+    {
+        // directory is full
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    if(data_size > available)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Index save data already copied to data_end. Caller checked there is room with check_space()
+ */
+static void append_save(PRAM_BUNDLE_HEADER header, const PSAVE_METADATA metadata, unsigned int data_size)
+{
+    unsigned int num_saves = read_be16(header->num_saves);
+    unsigned int data_end = read_be32(header->data_end);
+    PRAM_BUNDLE_ENTRY entry = &get_entries(header)[num_saves];
+
+    memset(entry, 0, sizeof(RAM_BUNDLE_ENTRY));
+    memcpy(entry->savename, metadata->savename, LIBSLINGA_MIN(strlen(metadata->savename), RAM_BUNDLE_SAVENAME_LEN - 1));
+    memcpy(entry->comment, metadata->comment, LIBSLINGA_MIN(strlen(metadata->comment), RAM_BUNDLE_COMMENT_LEN - 1));
+    entry->language = metadata->language;
+    write_be32(entry->timestamp, metadata->timestamp);
+    write_be32(entry->data_size, data_size);
+    write_be32(entry->data_offset, data_end);
+
+    // the padding of the last save can run past the region, that's fine
+    data_end = LIBSLINGA_MIN(data_end + align_size(data_size), g_RAM_Region_Size);
+
+    write_be16(header->num_saves, num_saves + 1);
+    write_be32(header->data_end, data_end);
+}
+
+/**
+ * @brief Remove a save, closing the gap it leaves in both the directory and the data
+ */
+static void remove_save(PRAM_BUNDLE_HEADER header, unsigned int index)
+{
+    PRAM_BUNDLE_ENTRY entries = get_entries(header);
+    unsigned int num_saves = read_be16(header->num_saves);
+    unsigned int data_end = read_be32(header->data_end);
+    unsigned int offset = read_be32(entries[index].data_offset);
+    unsigned int gap = get_gap(header, index);
+
+    // data is stored in directory order, so everything after the gap belongs to later entries
+    memmove(g_RAM_Region + offset, g_RAM_Region + offset + gap, data_end - offset - gap);
+
+    for(unsigned int i = index + 1; i < num_saves; i++)
+    {
+        write_be32(entries[i].data_offset, read_be32(entries[i].data_offset) - gap);
+        memcpy(&entries[i - 1], &entries[i], sizeof(RAM_BUNDLE_ENTRY));
+    }
+
+    memset(&entries[num_saves - 1], 0, sizeof(RAM_BUNDLE_ENTRY));
+
+    write_be16(header->num_saves, num_saves - 1);
+    write_be32(header->data_end, data_end - gap);
+}
+
+/**
+ * @brief Bytes remove_save() frees. The padding of the last save may have been cut off at the end of the region
+ */
+static unsigned int get_gap(const PRAM_BUNDLE_HEADER header, unsigned int index)
+{
+    PRAM_BUNDLE_ENTRY entry = &get_entries(header)[index];
+    unsigned int offset = read_be32(entry->data_offset);
+
+    return LIBSLINGA_MIN(align_size(read_be32(entry->data_size)), read_be32(header->data_end) - offset);
+}
+
+static PRAM_BUNDLE_ENTRY get_entries(const PRAM_BUNDLE_HEADER header)
+{
+    return (PRAM_BUNDLE_ENTRY)((unsigned char*)header + sizeof(RAM_BUNDLE_HEADER));
+}
+
+static unsigned int get_directory_end(unsigned int capacity)
+{
+    return align_size(sizeof(RAM_BUNDLE_HEADER) + capacity * sizeof(RAM_BUNDLE_ENTRY));
+}
+
+static unsigned int align_size(unsigned int size)
+{
+    return (size + RAM_BUNDLE_ALIGN - 1) & ~(RAM_BUNDLE_ALIGN - 1);
+}
+
+static unsigned int read_be16(const unsigned char* src)
+{
+    return ((unsigned int)src[0] << 8) | (unsigned int)src[1];
+}
+
+static unsigned int read_be32(const unsigned char* src)
+{
+    return ((unsigned int)src[0] << 24) | ((unsigned int)src[1] << 16) | ((unsigned int)src[2] << 8) | (unsigned int)src[3];
+}
+
+static void write_be16(unsigned char* dst, unsigned int val)
+{
+    dst[0] = (unsigned char)(val >> 8);
+    dst[1] = (unsigned char)val;
+}
+
+static void write_be32(unsigned char* dst, unsigned int val)
+{
+    dst[0] = (unsigned char)(val >> 24);
+    dst[1] = (unsigned char)(val >> 16);
+    dst[2] = (unsigned char)(val >> 8);
+    dst[3] = (unsigned char)val;
 }
 
 #endif
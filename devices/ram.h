@@ -17,6 +17,58 @@
 // same as the SRAM. This device is used to simplify dumping memory for Save
 // Game Copier.
 //
+// Saves are kept in a bundle in a caller provided region (RAM_SetRegion()).
+// A bundle is a header, a fixed size directory, then the save data packed
+// back to back. All multi-byte fields are big-endian so a bundle dumped by
+// the Saturn can be parsed anywhere.
+//
+// 0x00 header (RAM_BUNDLE_HEADER)
+// 0x14 directory, capacity * RAM_BUNDLE_ENTRY
+// .... save data, each save RAM_BUNDLE_ALIGN aligned, in directory order
+// .... data_end, the bundle is data_end bytes long
+//
+// Every directory entry carries the save's metadata and data offset, so list
+// and query never touch the save data. Dumping a device into a bundle and
+// restoring one are both a single pass with no copies besides the read or
+// write itself.
+//
+
+#define RAM_BUNDLE_MAGIC        "SLBUNDLE"
+#define RAM_BUNDLE_MAGIC_LEN    8
+#define RAM_BUNDLE_VERSION      1
+#define RAM_BUNDLE_ALIGN        4       ///< @brief Save data alignment
+#define RAM_BUNDLE_BLOCK_SIZE   64      ///< @brief RAM doesn't use blocks, report everything in 64 byte units
+#define RAM_BUNDLE_SAVENAME_LEN 12
+#define RAM_BUNDLE_COMMENT_LEN  11
+
+#pragma pack(1)
+/** @brief Start of a bundle */
+typedef struct _RAM_BUNDLE_HEADER
+{
+    char magic[RAM_BUNDLE_MAGIC_LEN];       // "SLBUNDLE"
+    unsigned char version[2];               // RAM_BUNDLE_VERSION
+    unsigned char capacity[2];              // number of directory entries
+    unsigned char num_saves[2];             // directory entries in use
+    unsigned char reserved[2];
+    unsigned char data_end[4];              // bundle size in bytes
+} RAM_BUNDLE_HEADER, *PRAM_BUNDLE_HEADER;
+
+/** @brief Directory entry, one per save */
+typedef struct _RAM_BUNDLE_ENTRY
+{
+    char savename[RAM_BUNDLE_SAVENAME_LEN]; // NULL terminated
+    char comment[RAM_BUNDLE_COMMENT_LEN];   // NULL terminated
+    unsigned char language;
+    unsigned char timestamp[4];
+    unsigned char data_size[4];
+    unsigned char data_offset[4];           // from the start of the bundle
+} RAM_BUNDLE_ENTRY, *PRAM_BUNDLE_ENTRY;
+#pragma pack()
+
+SLINGA_ERROR RAM_SetRegion(unsigned char* region, unsigned int size);
+SLINGA_ERROR RAM_GetBundleSize(unsigned int* size);
+SLINGA_ERROR RAM_DumpDevice(DEVICE_TYPE source);
+SLINGA_ERROR RAM_RestoreDevice(DEVICE_TYPE destination, FLAGS flags);
 
 
 SLINGA_ERROR RAM_RegisterHandler(DEVICE_TYPE type, PDEVICE_HANDLER* device_handler);
@@ -29,6 +81,7 @@ SLINGA_ERROR RAM_IsReadable(DEVICE_TYPE type);
 SLINGA_ERROR RAM_IsWriteable(DEVICE_TYPE type);
 SLINGA_ERROR RAM_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
 SLINGA_ERROR RAM_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR RAM_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
 SLINGA_ERROR RAM_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
 SLINGA_ERROR RAM_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
 SLINGA_ERROR RAM_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
@@ -0,0 +1,213 @@
+/** @file rle01.c
+ *
+ *  @author Slinga
+ *  @brief RLE01 compression. Shared by Action Replay and serial link
+ *  @bug No known bugs.
+ */
+#include "rle01.h"
+
+/**
+ * @brief Pick the least used byte in src as the RLE01 key
+ *
+ * Literal key bytes cost two bytes each, so the rarer the key the better.
+ *
+ * @param[in] src Data to be compressed
+ * @param[in] src_size Size of src in bytes
+ * @param[out] rle_key Key to pass to rle01_compress() on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR rle01_find_key(const unsigned char* src, unsigned int src_size, unsigned char* rle_key)
+{
+    unsigned int counts[256] = {0};
+    unsigned int best = 0;
+
+    if(!src || !rle_key)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    for(unsigned int i = 0; i < src_size; i++)
+    {
+        counts[src[i]]++;
+    }
+
+    for(unsigned int i = 1; i < 256; i++)
+    {
+        if(counts[i] < counts[best])
+        {
+            best = i;
+        }
+    }
+
+    *rle_key = (unsigned char)best;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Compress src with RLE01
+ *
+ * @param[in] rle_key Key byte, see rle01_find_key()
+ * @param[in] src Data to compress
+ * @param[in] src_size Size of src in bytes
+ * @param[out] dest Compressed data on success
+ * @param[in] dest_size Size of dest in bytes. 2 * src_size is always enough
+ * @param[out] bytes_written Size of the compressed data on success
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if dest filled up
+ */
+SLINGA_ERROR rle01_compress(unsigned char rle_key, const unsigned char* src, unsigned int src_size, unsigned char* dest, unsigned int dest_size, unsigned int* bytes_written)
+{
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    if(!src || !dest || !bytes_written)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(i < src_size)
+    {
+        unsigned char val = src[i];
+        unsigned int count = 1;
+
+        while(i + count < src_size && src[i + count] == val && count < RLE01_MAX_RUN)
+        {
+            count++;
+        }
+
+        if(count >= RLE01_MIN_RUN || (val == rle_key && count > 1))
+        {
+            // key, count, val
+            if(j + 3 > dest_size)
+            {
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            dest[j++] = rle_key;
+            dest[j++] = (unsigned char)count;
+            dest[j++] = val;
+            i += count;
+        }
+        else if(val == rle_key)
+        {
+            // escaped key
+            if(j + 2 > dest_size)
+            {
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            dest[j++] = rle_key;
+            dest[j++] = 0;
+            i++;
+        }
+        else
+        {
+            // short run, copy literally
+            if(j + count > dest_size)
+            {
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            for(unsigned int k = 0; k < count; k++)
+            {
+                dest[j++] = val;
+            }
+            i += count;
+        }
+    }
+
+    *bytes_written = j;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Decompress RLE01 data
+ *
+ * Originally reversed from function 0x002897dc in ARP_202C.BIN
+ *
+ * @param[in] rle_key Key byte used to compress
+ * @param[in] src Compressed data
+ * @param[in] src_size Size of src in bytes
+ * @param[out] dest Decompressed data on success. Set to NULL to only calculate the size
+ * @param[in] dest_size Size of dest in bytes. Ignored if dest is NULL
+ * @param[out] bytes_needed Size of the decompressed data on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR rle01_decompress(unsigned char rle_key, const unsigned char* src, unsigned int src_size, unsigned char* dest, unsigned int dest_size, unsigned int* bytes_needed)
+{
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    if(!src || !bytes_needed)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(i < src_size)
+    {
+        unsigned int count = 1;
+        unsigned char val = src[i];
+
+        // three compressed cases
+        // 1) not key
+        // - copy the byte directly
+        // - src + 1, dest + 1
+        // 2) key followed by zero
+        // -- copy key
+        // -- src + 2, dest + 1
+        // 3) key followed by non-zero, followed by val
+        // -- copy val count times
+        // -- src + 3, dest + count
+
+        if(val == rle_key)
+        {
+            if(i + 1 >= src_size)
+            {
+                // truncated
+                return SLINGA_INVALID_PARAMETER;
+            }
+
+            count = src[i + 1];
+            if(count == 0)
+            {
+                count = 1;
+                i += 2;
+            }
+            else
+            {
+                if(i + 2 >= src_size)
+                {
+                    // truncated
+                    return SLINGA_INVALID_PARAMETER;
+                }
+
+                val = src[i + 2];
+                i += 3;
+            }
+        }
+        else
+        {
+            i++;
+        }
+
+        if(dest)
+        {
+            if(j + count > dest_size)
+            {
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            memset(dest + j, val, count);
+        }
+
+        j += count;
+    }
+
+    *bytes_needed = j;
+
+    return SLINGA_SUCCESS;
+}
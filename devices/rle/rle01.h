@@ -0,0 +1,24 @@
+/** @file rle01.h
+ *
+ *  @author Slinga
+ *  @brief RLE01 compression. Shared by Action Replay and serial link
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "../../libslinga.h"
+
+//
+// RLE01 is the run length encoding used by the Action Replay cartridge. A key
+// byte (usually the least used byte in the data) introduces a run:
+// - not key               -> literal byte
+// - key, 0                -> literal key byte
+// - key, count, val       -> val repeated count (1-255) times
+//
+
+#define RLE01_MAX_RUN       0xFF ///< @brief Longest run a single key, count, val triple can encode
+#define RLE01_MIN_RUN       4    ///< @brief Shorter runs are cheaper as literals
+
+SLINGA_ERROR rle01_find_key(const unsigned char* src, unsigned int src_size, unsigned char* rle_key);
+SLINGA_ERROR rle01_compress(unsigned char rle_key, const unsigned char* src, unsigned int src_size, unsigned char* dest, unsigned int dest_size, unsigned int* bytes_written);
+SLINGA_ERROR rle01_decompress(unsigned char rle_key, const unsigned char* src, unsigned int src_size, unsigned char* dest, unsigned int dest_size, unsigned int* bytes_needed);
@@ -24,6 +24,24 @@
 // - this format is basically the same for cartridges (different sizes, addresses, block sizes, etc) and Action Replay (saves are compressed with RLE)
 //
 
+//
+// Multi-byte fields (tag, timestamp, data size and block ids) are big-endian
+// like the SH-2. They are only ever loaded and stored through read_be16(),
+// read_be32() and friends, which are plain loads on big-endian targets and
+// a load plus a byte swap on little-endian ones, so the same engine runs on
+// the console and on a PC. Compilers that don't say which byte order they
+// target assemble the values a byte at a time instead.
+//
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define SAT_HOST_TO_BE16(x) (x)
+#define SAT_HOST_TO_BE32(x) (x)
+#elif defined(__GNUC__)
+#define SAT_HOST_TO_BE16(x) __builtin_bswap16(x)
+#define SAT_HOST_TO_BE32(x) __builtin_bswap32(x)
+#else
+#define SAT_BYTEWISE_BYTE_ORDER 1
+#endif
+
 //
 // skip_bytes - I use this to handle the fact that for internal memory only every other byte of memory is valid. If skip_bytes = 0, every byte is used
 // if skip_bytes = 1, every other byte is read.
@@ -54,36 +72,109 @@
 /** @brief Bitmap representing blocks in a partition. Each bit represents one block */
 unsigned char g_SAT_bitmap[SAT_MAX_BITMAP] = {0};
 
+/** @brief One block with the skip bytes removed, used when diffing snapshots */
+unsigned char g_SAT_Block_Scratch[SAT_MAX_BLOCK_SIZE] = {0};
+
+/** @brief One block of a save being assembled by write_blocks(), skip bytes removed */
+unsigned char g_SAT_Write_Block[SAT_MAX_BLOCK_SIZE] = {0};
+
+//
+// Save chain cache
+// - g_SAT_Chains[] remembers the block vector of recently parsed saves
+// - the block lists live in g_SAT_Chain_Blocks[], allocated front to back. When it fills up the whole cache is dropped
+// - an entry is used only if the save header still matches, and is dropped when the save is overwritten or deleted
+//
+
+/** @brief Recently resolved save chains */
+SAT_CHAIN g_SAT_Chains[SAT_CHAIN_CACHE_ENTRIES] = {0};
+
+/** @brief Block indexes of all cached chains */
+unsigned short g_SAT_Chain_Blocks[SAT_CHAIN_POOL_BLOCKS] = {0};
+unsigned int g_SAT_Chain_Blocks_Used = 0;
+
+/** @brief Next entry to replace */
+unsigned int g_SAT_Chain_Next = 0;
+
+/** @brief Chain of the save being read or written when it isn't cached */
+unsigned short g_SAT_Chain_Scratch[SAT_MAX_CHAIN_BLOCKS] = {0};
+
+//
+// Reservations
+// - sat_reserve() writes a save up front and remembers its chain in g_SAT_Reservations[]
+// - writes to a reserved save copy the data straight into those blocks, skipping find_save() and allocation
+// - the chains live in g_SAT_Reserved_Blocks[], kept packed as reservations are released
+//
+
+/** @brief Saves with pre-allocated chains */
+SAT_RESERVATION g_SAT_Reservations[SAT_MAX_RESERVATIONS] = {0};
+
+/** @brief Block indexes of all reserved chains */
+unsigned short g_SAT_Reserved_Blocks[SAT_RESERVED_POOL_BLOCKS] = {0};
+unsigned int g_SAT_Reserved_Blocks_Used = 0;
+
 // block helper functions
 static SLINGA_ERROR calc_num_blocks(unsigned int save_size, unsigned int block_size, unsigned int skip_bytes, unsigned int* num_save_blocks);
 static SLINGA_ERROR convert_address_to_block_index(const unsigned char* address, const PPARTITION_INFO partition_info, unsigned int* block_index);
 static SLINGA_ERROR convert_block_index_to_address(unsigned int block_index, const PPARTITION_INFO partition_info, unsigned char** address);
 
 // parsing saves and metadata
-static SLINGA_ERROR copy_metadata(PSAVE_METADATA metadata, const unsigned char* save, unsigned int skip_bytes);
+static SLINGA_ERROR copy_metadata(PSAVE_METADATA metadata, const unsigned char* save, const PPARTITION_INFO partition_info);
 static SLINGA_ERROR find_save(const char* filename, const PPARTITION_INFO partition_info, unsigned char** save_start);
 static SLINGA_ERROR read_save_and_metadata(const PPARTITION_INFO partition_info, PSAVE_METADATA metadata, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
-static SLINGA_ERROR walk_partition(const PPARTITION_INFO partition_info, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found, unsigned int* used_blocks);
+static SLINGA_ERROR walk_partition(const PPARTITION_INFO partition_info, unsigned int start_block, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found, unsigned int* used_blocks, unsigned int* next_block);
 static SLINGA_ERROR walk_partition_bitmap(unsigned char* bitmap, unsigned int bitmap_size, const PPARTITION_INFO partition_info);
 static SLINGA_ERROR metadata_to_header(const PSAVE_METADATA metadata, PSAT_START_BLOCK_HEADER header);
 
 // Read saves
-static SLINGA_ERROR read_sat_table(const PPARTITION_INFO partition_info, const unsigned char* save_start, unsigned char* bitmap, unsigned int bitmap_size, unsigned int* start_block, unsigned int* start_data_block);
-static SLINGA_ERROR read_save_from_sat_table(unsigned char* buffer, unsigned int size, unsigned int* bytes_read, unsigned int start_block, unsigned int start_data_block, const unsigned char* bitmap, unsigned int bitmap_size, const PPARTITION_INFO partition_info);
-static SLINGA_ERROR read_sat_table_from_block(unsigned int block_index, unsigned char* bitmap, unsigned int bitmap_size, const PPARTITION_INFO partition_info, unsigned int start_block, unsigned int* start_data_block, unsigned int* written_sat_entries);
+static SLINGA_ERROR read_chain(const PPARTITION_INFO partition_info, const unsigned char* save_start, unsigned short* blocks, unsigned int max_blocks, unsigned char* bitmap, unsigned int bitmap_size, unsigned int* num_blocks, unsigned int* data_offset);
+static SLINGA_ERROR find_chain_block(const PPARTITION_INFO partition_info, const unsigned char* save_start, unsigned int usable_size, unsigned int chain_index, unsigned int* block_index);
+static SLINGA_ERROR read_chain_bytes(const PPARTITION_INFO partition_info, const unsigned short* blocks, unsigned int num_blocks, unsigned int offset, unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR get_usable_block_size(const PPARTITION_INFO partition_info, unsigned int* usable_size);
+
+// Save chain cache
+static SLINGA_ERROR get_save_chain(const PPARTITION_INFO partition_info, const unsigned char* save_start, const unsigned short** blocks, unsigned int* num_blocks, unsigned int* data_offset);
+static SLINGA_ERROR check_save_chain(const PPARTITION_INFO partition_info, const unsigned char* save_start, const unsigned short* blocks, unsigned int num_blocks);
+static SLINGA_ERROR add_save_chain(const PPARTITION_INFO partition_info, const PSAT_START_BLOCK_HEADER header, const unsigned short* blocks, unsigned int num_blocks, unsigned int data_offset);
+static void drop_save_chain(const PPARTITION_INFO partition_info, const unsigned char* save_start);
 
 // Write saves
-static SLINGA_ERROR write_header(unsigned int save_start_block, const char* filename, unsigned int size, const PSAVE_METADATA metadata, const PPARTITION_INFO partition_info);
-static SLINGA_ERROR write_block_indexes(unsigned int save_start_block, unsigned int num_blocks, const unsigned char* bitmap, unsigned int bitmap_size, const PPARTITION_INFO partition_info, unsigned int* save_data_start_block, unsigned int* save_data_start_offset);
-static SLINGA_ERROR write_data(unsigned int save_data_start_block, unsigned int save_data_start_offset, const unsigned char* data, unsigned int size, const unsigned char* bitmap, unsigned int bitmap_size, const PPARTITION_INFO partition_info);
+static SLINGA_ERROR alloc_save(const PSAVE_METADATA metadata, const unsigned char* buffer, unsigned int size, const PPARTITION_INFO partition_info, unsigned int* num_blocks, unsigned int* data_offset);
+static SLINGA_ERROR alloc_chain(const unsigned char* bitmap, unsigned int bitmap_size, unsigned int num_blocks, unsigned short* blocks);
+static SLINGA_ERROR write_blocks(const PPARTITION_INFO partition_info, const PSAT_START_BLOCK_HEADER header, const unsigned short* blocks, unsigned int num_blocks, const unsigned char* buffer, unsigned int size, unsigned int* data_offset);
+static void copy_region(unsigned char* dst, unsigned int dst_start, unsigned int dst_size, unsigned int region_start, const unsigned char* src, unsigned int src_size);
+
+// Reservations
+static SLINGA_ERROR write_reserved(FLAGS flags, const char* filename, const PSAVE_METADATA metadata, const unsigned char* buffer, unsigned int size, const PPARTITION_INFO partition_info);
+static SLINGA_ERROR can_reserve(unsigned int num_blocks);
+static PSAT_RESERVATION find_reservation(const PPARTITION_INFO partition_info, const char* savename);
+static SLINGA_ERROR add_reservation(const PPARTITION_INFO partition_info, const char* filename, const unsigned short* blocks, unsigned int num_blocks, unsigned int data_offset);
+static void release_reservation(const PPARTITION_INFO partition_info, const char* filename);
 
 // SAT bitmap helpers
 static SLINGA_ERROR get_bitmap_size(const PPARTITION_INFO partition_info, unsigned int max_bitmap_size, unsigned int* bitmap_size);
 static SLINGA_ERROR set_bitmap(unsigned int block_index, unsigned char* bitmap, unsigned int bitmap_size);
-static SLINGA_ERROR get_next_block_bitmap(unsigned int block_index, const unsigned char* bitmap, unsigned int bitmap_size, unsigned int* next_block_index);
 static SLINGA_ERROR count_bitmap(const unsigned char* bitmap, unsigned int bitmap_size, unsigned int* total);
 static SLINGA_ERROR invert_bitmap(unsigned char* bitmap, unsigned int bitmap_size);
 
+// snapshot helpers
+static SLINGA_ERROR check_snapshot(const PPARTITION_INFO partition_info, const unsigned char* buffer, unsigned int size, PSAT_SNAPSHOT_HEADER header, unsigned int* bitmap_size);
+static unsigned int hash_buffer(const unsigned char* buffer, unsigned int size);
+static int is_zero(const unsigned char* buffer, unsigned int size);
+
+// byte order
+static SLINGA_ERROR read_header(const unsigned char* save_start, PSAT_START_BLOCK_HEADER header, unsigned int skip_bytes);
+static SLINGA_ERROR read_tag(const unsigned char* block, unsigned int* tag, unsigned int skip_bytes);
+static void header_to_host(PSAT_START_BLOCK_HEADER header);
+static void header_to_partition(PSAT_START_BLOCK_HEADER header);
+static void snapshot_header_to_host(PSAT_SNAPSHOT_HEADER header);
+static void snapshot_header_to_be(PSAT_SNAPSHOT_HEADER header);
+static void diff_header_to_host(PSAT_DIFF_HEADER header);
+static void diff_header_to_be(PSAT_DIFF_HEADER header);
+static unsigned short read_be16(const unsigned char* src);
+static unsigned int read_be32(const unsigned char* src);
+static void write_be16(unsigned char* dst, unsigned short val);
+static void write_be32(unsigned char* dst, unsigned int val);
+
 // skip bytes
 static SLINGA_ERROR read_from_partition(unsigned char* dst, const unsigned char* src, unsigned int src_offset, unsigned int size, unsigned int skip_bytes);
 static SLINGA_ERROR write_to_partition(unsigned char* dst, unsigned int dst_offset, const unsigned char* src, unsigned int size, unsigned int skip_bytes);
@@ -109,10 +200,34 @@ SLINGA_ERROR sat_get_used_blocks(const PPARTITION_INFO partition_info,
 {
     // this is just a wrapper for walk_partition()
     return  walk_partition(partition_info,
+                           0,
                            NULL,
                            0,
                            NULL,
-                           used_blocks);
+                           used_blocks,
+                           NULL);
+}
+
+/**
+ * @brief Calculate how many blocks a save would use on the SAT partition
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] size Size of the save data in bytes
+ * @param[out] num_blocks Blocks needed for the header, SAT table and data on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR sat_calc_blocks(const PPARTITION_INFO partition_info,
+                             unsigned int size,
+                             unsigned int* num_blocks)
+{
+    if(!partition_info)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // same calculation sat_write() checks the free blocks against
+    return calc_num_blocks(size, partition_info->block_size, partition_info->skip_bytes, num_blocks);
 }
 
 /**
@@ -135,12 +250,48 @@ SLINGA_ERROR sat_list_saves(const PPARTITION_INFO partition_info,
 {
     // this is just a wrapper for walk_partition()
     return  walk_partition(partition_info,
+                           0,
                            saves,
                            num_saves,
                            saves_available,
+                           NULL,
                            NULL);
 }
 
+/**
+ * @brief List one page of saves on the SAT partition
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] cursor Block to resume scanning from, SLINGA_LIST_START for the first page
+ * @param[out] saves Filled out SAVE_METADATA array on success
+ * @param[in] num_saves size in elements of saves array
+ * @param[out] saves_found Number of saves written to saves on success
+ * @param[out] next_cursor Block the next page starts at, SLINGA_LIST_END if the partition was fully scanned
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR sat_list_page(const PPARTITION_INFO partition_info,
+                           unsigned int cursor,
+                           PSAVE_METADATA saves,
+                           unsigned int num_saves,
+                           unsigned int* saves_found,
+                           unsigned int* next_cursor)
+{
+    if(!saves || !num_saves || !next_cursor)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // this is just a wrapper for walk_partition()
+    return  walk_partition(partition_info,
+                           cursor,
+                           saves,
+                           num_saves,
+                           saves_found,
+                           NULL,
+                           next_cursor);
+}
+
 /**
  * @brief Query metadata for a save on the SAT partition
  *
@@ -195,6 +346,59 @@ SLINGA_ERROR sat_read(const char* filename,
                                   bytes_read);
 }
 
+/**
+ * @brief Get the blocks a save occupies, in chain order
+ *
+ * @param[in] filename Save to query
+ * @param[in] partition_info Save partition
+ * @param[out] blocks On success, the start block followed by the SAT table entries
+ * @param[in] max_blocks Size in elements of blocks
+ * @param[out] num_blocks Number of blocks in the chain on success
+ * @param[out] data_offset Offset of the first data byte in the chain on success
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if blocks is too small
+ */
+SLINGA_ERROR sat_query_chain(const char* filename,
+                             const PPARTITION_INFO partition_info,
+                             unsigned short* blocks,
+                             unsigned int max_blocks,
+                             unsigned int* num_blocks,
+                             unsigned int* data_offset)
+{
+    unsigned char* save_start = NULL;
+    const unsigned short* chain = NULL;
+    unsigned int chain_blocks = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!blocks || !num_blocks || !data_offset)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = find_save(filename, partition_info, &save_start);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_save_chain(partition_info, save_start, &chain, &chain_blocks, data_offset);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    *num_blocks = chain_blocks;
+
+    if(chain_blocks > max_blocks)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(blocks, chain, chain_blocks * sizeof(unsigned short));
+
+    return SLINGA_SUCCESS;
+}
+
 /**
  * @brief Writes save to the partition. Errors if save already exists unless
  * OVERWRITE_EXISTING_SAVE flag is set
@@ -220,13 +424,9 @@ SLINGA_ERROR sat_write(FLAGS flags,
 {
     UNUSED(flags); // TODO: add zero entire save option
 
-    unsigned int bitmap_size = 0;
     unsigned char* save_start = NULL;
-    unsigned int blocks_needed = 0;
-    unsigned int free_blocks = 0;
-    unsigned int save_start_block = 0;
-    unsigned int save_data_start_block = 0;
-    unsigned int save_data_start_offset = 0;
+    unsigned int num_blocks = 0;
+    unsigned int data_offset = 0;
     SLINGA_ERROR result = 0;
 
     if(!filename || !save_metadata || !buffer || !size)
@@ -250,6 +450,13 @@ SLINGA_ERROR sat_write(FLAGS flags,
         return SLINGA_INVALID_PARAMETER;
     }
 
+    // a reserved save already has its blocks, only the data has to be copied
+    result = write_reserved(flags, filename, save_metadata, buffer, size, partition_info);
+    if(result != SLINGA_NOT_FOUND)
+    {
+        return result;
+    }
+
     //
     // Writing is kind of complicated:
     // - check if the save exists and whether or not the OVERWRITE_EXISTING_SAVE is set
@@ -257,13 +464,11 @@ SLINGA_ERROR sat_write(FLAGS flags,
     // -- otherwise error out
     // - compute how many blocks the save needs
     // - parse the entire partition to compute how many free blocks there are
-    // -- I assume saves can't use blocks out of orders. But in case they do I have to parse all of the saves on the partition
+    // -- saves can use blocks in any order so all of the saves on the partition are parsed
     // - Writing the save
-    // -- header -> easy
-    // -- block indexes array pointing to all of the blocks we will use -> hard
-    // -- writing the save data -> medium
-    //
-    // Hope I get this right...
+    // -- pick the blocks, the lowest free ones in ascending order
+    // -- each block of the chain is assembled in memory from whatever part of the
+    //    header, block indexes array and save data falls in it, then written once
     //
 
     // locate the save
@@ -278,6 +483,8 @@ SLINGA_ERROR sat_write(FLAGS flags,
             return SLINGA_FILE_EXISTS;
         }
 
+        drop_save_chain(partition_info, save_start);
+
         // delete the save by overwriting the tag field to 0
         result = memset_partition(save_start, 0, 0, SAT_TAG_SIZE, partition_info->skip_bytes);
         if(result != SLINGA_SUCCESS)
@@ -286,102 +493,151 @@ SLINGA_ERROR sat_write(FLAGS flags,
         }
     }
 
-    // calculate how many blocks are needed for the save
-    result = calc_num_blocks(size, partition_info->block_size, partition_info->skip_bytes, &blocks_needed);
+    // header, SAT table and data
+    result = alloc_save(save_metadata,
+                        buffer,
+                        size,
+                        partition_info,
+                        &num_blocks,
+                        &data_offset);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // calculate how how much of the bitmap we actually need
-    result = get_bitmap_size(partition_info, sizeof(g_SAT_bitmap), &bitmap_size);
-    if(result != SLINGA_SUCCESS)
-    {
-        return result;
-    }
+    return SLINGA_SUCCESS;
+}
 
-    memset(g_SAT_bitmap, 0, bitmap_size);
+/**
+ * @brief Claims the blocks for a save up front so later writes of up to
+ * max_size bytes skip allocation.
+ *
+ * The save is written with max_size bytes of zeros, so the BIOS sees the
+ * space as used. Reserving an existing save whose blocks hold at least
+ * max_size bytes keeps its data. Writes to a reserved save store their own
+ * data_size and zero the rest of the blocks, which stay reserved for the
+ * next write. Only the first write doesn't need OVERWRITE_EXISTING_SAVE.
+ *
+ * @param[in] flags flags 0, OVERWRITE_EXISTING_SAVE to replace an existing save that is too small
+ * @param[in] filename Save to reserve
+ * @param[in] max_size Largest save data in bytes that will be written
+ * @param[in] partition_info Save partition
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR sat_reserve(FLAGS flags,
+                         const char* filename,
+                         unsigned int max_size,
+                         const PPARTITION_INFO partition_info)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned char* save_start = NULL;
+    const unsigned short* blocks = NULL;
+    unsigned int usable_size = 0;
+    unsigned int num_blocks = 0;
+    unsigned int data_offset = 0;
+    SLINGA_ERROR result = 0;
 
-    // record all of the busy blocks on the partition
-    result = walk_partition_bitmap(g_SAT_bitmap,
-                                   bitmap_size,
-                                   partition_info);
-    if(result != SLINGA_SUCCESS)
+    if(!filename || !filename[0] || !max_size)
     {
-        return result;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    // flip the bitmap so free blocks are set to 1
-    result = invert_bitmap(g_SAT_bitmap, bitmap_size);
-    if(result != SLINGA_SUCCESS)
+    if(!partition_info)
     {
-        return result;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    // count the free blocks
-    result = count_bitmap(g_SAT_bitmap, bitmap_size, &free_blocks);
-    if(result != SLINGA_SUCCESS)
+    // block size must be 64-byte aligned
+    if((partition_info->block_size % MIN_BLOCK_SIZE) != 0)
     {
-        return result;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    // make sure we have enough free blocks
-    if(free_blocks < blocks_needed)
+    if(partition_info->skip_bytes != 0 && partition_info->skip_bytes != 1)
     {
-        return SLINGA_NOT_ENOUGH_SPACE;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    //
-    // We have enough space, write the save
-    // - header
-    // - array of block indexes
-    // - save data
-    //
+    // reserving again replaces the old reservation
+    release_reservation(partition_info, filename);
 
-    result = get_next_block_bitmap(0, g_SAT_bitmap, bitmap_size, &save_start_block);
+    result = calc_num_blocks(max_size, partition_info->block_size, partition_info->skip_bytes, &num_blocks);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // header
-    result = write_header(save_start_block,
-                          filename,
-                          size,
-                          save_metadata,
-                          partition_info);
+    result = get_usable_block_size(partition_info, &usable_size);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // variable array of block indexes
-    result = write_block_indexes(save_start_block,
-                                 blocks_needed,
-                                 g_SAT_bitmap,
-                                 bitmap_size,
-                                 partition_info,
-                                 &save_data_start_block,
-                                 &save_data_start_offset);
+    // check first so a failure doesn't delete or leave behind a save
+    result = can_reserve(num_blocks);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // variable array of data bytes
-    result = write_data(save_data_start_block,
-                        save_data_start_offset,
-                        buffer,
-                        size,
-                        g_SAT_bitmap,
-                        bitmap_size,
-                        partition_info);
+    result = find_save(filename,
+                       partition_info,
+                       &save_start);
+    if(result == SLINGA_SUCCESS)
+    {
+        // a save written to an earlier reservation can be smaller than its blocks
+        result = get_save_chain(partition_info,
+                                save_start,
+                                &blocks,
+                                &num_blocks,
+                                &data_offset);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(num_blocks * usable_size - data_offset >= max_size)
+        {
+            // big enough already, just remember its blocks
+            return add_reservation(partition_info, filename, blocks, num_blocks, data_offset);
+        }
+
+        if((flags & OVERWRITE_EXISTING_SAVE) == 0)
+        {
+            return SLINGA_FILE_EXISTS;
+        }
+
+        drop_save_chain(partition_info, save_start);
+
+        // delete the save by overwriting the tag field to 0
+        result = memset_partition(save_start, 0, 0, SAT_TAG_SIZE, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+    else if(result != SLINGA_NOT_FOUND)
+    {
+        return result;
+    }
+
+    // everything but the name is filled in by the first write
+    strncpy(metadata.savename, filename, MAX_SAVENAME);
+
+    // no data, so whatever the blocks held before is zeroed
+    result = alloc_save(&metadata,
+                        NULL,
+                        max_size,
+                        partition_info,
+                        &num_blocks,
+                        &data_offset);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    return SLINGA_SUCCESS;
+    return add_reservation(partition_info, filename, g_SAT_Chain_Scratch, num_blocks, data_offset);
 }
 
 /**
@@ -426,6 +682,9 @@ SLINGA_ERROR sat_delete(const char* filename,
         return SLINGA_INVALID_PARAMETER;
     }
 
+    // the space goes back to the BIOS
+    release_reservation(partition_info, filename);
+
     // locate the save
     result = find_save(filename,
                        partition_info,
@@ -435,6 +694,8 @@ SLINGA_ERROR sat_delete(const char* filename,
         return result;
     }
 
+    drop_save_chain(partition_info, save_start);
+
     // delete the save by overwriting the tag field to 0
     result = memset_partition(save_start, 0, 0, SAT_TAG_SIZE, partition_info->skip_bytes);
     if(result != SLINGA_SUCCESS)
@@ -553,6 +814,10 @@ SLINGA_ERROR sat_format(const PPARTITION_INFO partition_info)
         num_lines = num_lines / 2;
     }
 
+    // every save is gone
+    drop_save_chain(partition_info, NULL);
+    release_reservation(partition_info, NULL);
+
     // TODO: why over /2 for size??
     result = memset_partition(partition_info->partition_buf, 0, 0, partition_info->partition_size/2, partition_info->skip_bytes);
     if(result != SLINGA_SUCCESS)
@@ -573,1610 +838,2745 @@ SLINGA_ERROR sat_format(const PPARTITION_INFO partition_info)
     return SLINGA_SUCCESS;
 }
 
-//
-// Block helper functions
-//
-
 /**
- * @brief Given a save size, calculate how many blocks it needs.
+ * @brief Copy the whole partition into a buffer in one pass
  *
- * @param[in] save_size How big the save is in bytes
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] num_save_blocks Number of blocks needed to record save_size bytes on success
+ * Only the valid bytes of skip byte memory are stored, and only blocks in
+ * use are stored at all. The layout is a SAT_SNAPSHOT_HEADER, the used
+ * block bitmap, then each used block in order.
+ *
+ * @param[in] partition_info Save partition
+ * @param[out] buffer Snapshot on success. NULL to only query the size
+ * @param[in] size Size of buffer in bytes
+ * @param[out] snapshot_size Size of the snapshot in bytes, also set on SLINGA_BUFFER_TOO_SMALL
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR calc_num_blocks(unsigned int save_size, unsigned int block_size, unsigned int skip_bytes, unsigned int* num_save_blocks)
+SLINGA_ERROR sat_snapshot(const PPARTITION_INFO partition_info,
+                          unsigned char* buffer,
+                          unsigned int size,
+                          unsigned int* snapshot_size)
 {
-    unsigned int total_bytes = 0;
-    unsigned int fixed_bytes = 0;
-    unsigned int num_blocks = 0;
-    unsigned int num_blocks2 = 0;
+    SAT_SNAPSHOT_HEADER header = {0};
+    unsigned int bitmap_size = 0;
+    unsigned int valid_block_size = 0;
+    unsigned int used_blocks = 0;
+    unsigned int total_size = 0;
+    unsigned char* dst = NULL;
+    SLINGA_ERROR result = 0;
 
-    if(!save_size || !num_save_blocks || !block_size)
+    if(!partition_info || !snapshot_size)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    if(skip_bytes != 0 && skip_bytes != 1)
+    if(partition_info->skip_bytes != 0 && partition_info->skip_bytes != 1)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    if(skip_bytes == 1)
+    result = get_bitmap_size(partition_info, sizeof(g_SAT_bitmap), &bitmap_size);
+    if(result != SLINGA_SUCCESS)
     {
-        block_size = block_size/2;
+        return result;
     }
 
-    // block size must be 64-byte aligned
-    if((block_size % MIN_BLOCK_SIZE) != 0)
+    memset(g_SAT_bitmap, 0, bitmap_size);
+
+    result = walk_partition_bitmap(g_SAT_bitmap,
+                                   bitmap_size,
+                                   partition_info);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        // a damaged partition is exactly what a raw copy is for, keep every block
+        memset(g_SAT_bitmap, 0xFF, bitmap_size);
     }
 
-    //
-    // The stored save consists of:
-    // - the save metadata header
-    // - the variable length SAT table
-    // - the save data itself
-    //
-    // What makes this tricky to compute is that the SAT table itself is stored
-    // on the blocks
-    //
+    result = count_bitmap(g_SAT_bitmap, bitmap_size, &used_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
 
-    fixed_bytes = sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE + save_size;
+    valid_block_size = partition_info->block_size >> partition_info->skip_bytes;
+    total_size = sizeof(SAT_SNAPSHOT_HEADER) + bitmap_size + (used_blocks * valid_block_size);
 
-    // calculate the number of SAT table entries required
-    num_blocks = fixed_bytes / (block_size - SAT_TAG_SIZE);
+    *snapshot_size = total_size;
 
-    // +1 for 0x0000 SAT table terminator
-    total_bytes = fixed_bytes + ((num_blocks + 1) * sizeof(unsigned short));
+    if(!buffer)
+    {
+        return SLINGA_SUCCESS;
+    }
 
-    // we need to do this in a loop because it's possible that by adding a SAT
-    // table entry we increased the number of bytes we need such that we need
-    // yet another SAT table entry.
-    do
+    if(size < total_size)
     {
-        num_blocks = num_blocks2;
-        total_bytes = fixed_bytes + ((num_blocks + 1) * sizeof(unsigned short));
-        num_blocks2 = total_bytes / (block_size - SAT_TAG_SIZE);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
 
-        if(total_bytes % (block_size - SAT_TAG_SIZE))
+    memcpy(header.magic, SAT_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SAT_SNAPSHOT_VERSION;
+    header.block_size = valid_block_size;
+    header.num_blocks = bitmap_size * 8;
+    header.used_blocks = used_blocks;
+    snapshot_header_to_be(&header);
+
+    memcpy(buffer, &header, sizeof(SAT_SNAPSHOT_HEADER));
+    memcpy(buffer + sizeof(SAT_SNAPSHOT_HEADER), g_SAT_bitmap, bitmap_size);
+    dst = buffer + sizeof(SAT_SNAPSHOT_HEADER) + bitmap_size;
+
+    for(unsigned int i = 0; i < bitmap_size * 8; i++)
+    {
+        if(!(g_SAT_bitmap[i / 8] & (1 << (i % 8))))
         {
-            num_blocks2++;
+            continue;
         }
 
-    }while(num_blocks != num_blocks2);
-
-    *num_save_blocks = num_blocks;
+        result = read_from_partition(dst, partition_info->partition_buf + (i * partition_info->block_size), 0, valid_block_size, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        dst += valid_block_size;
+    }
 
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Converts save address to block index
+ * @brief Overwrite the whole partition with a snapshot from sat_snapshot()
  *
- * @param[in] address address of save
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] block_index Address represented as a block index
+ * Blocks that weren't in use when the snapshot was taken are zeroed.
+ *
+ * @param[in] partition_info Save partition. Must have the same geometry the snapshot was taken from
+ * @param[in] buffer Snapshot
+ * @param[in] size Size of the snapshot in bytes
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR convert_address_to_block_index(const unsigned char* address,
-                                                   const PPARTITION_INFO partition_info,
-                                                   unsigned int* block_index)
+SLINGA_ERROR sat_restore(const PPARTITION_INFO partition_info,
+                         const unsigned char* buffer,
+                         unsigned int size)
 {
-    unsigned int index = 0;
+    SAT_SNAPSHOT_HEADER header = {0};
+    const unsigned char* bitmap = NULL;
+    const unsigned char* src = NULL;
+    unsigned int bitmap_size = 0;
+    SLINGA_ERROR result = 0;
 
-    if(!address || !partition_info)
+    result = check_snapshot(partition_info, buffer, size, &header, &bitmap_size);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return result;
     }
 
-    if(address < partition_info->partition_buf)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+    bitmap = buffer + sizeof(SAT_SNAPSHOT_HEADER);
 
-    if(address >= partition_info->partition_buf + partition_info->partition_size)
+    // every save may change
+    drop_save_chain(partition_info, NULL);
+    release_reservation(partition_info, NULL);
+
+    src = bitmap + bitmap_size;
+
+    for(unsigned int i = 0; i < header.num_blocks; i++)
     {
-        return SLINGA_INVALID_PARAMETER;
-    }
+        unsigned char* block = partition_info->partition_buf + (i * partition_info->block_size);
 
-    // index is just the number of blocks from the start of the partition
-    index = (address - partition_info->partition_buf)/partition_info->block_size;
+        if(!(bitmap[i / 8] & (1 << (i % 8))))
+        {
+            result = memset_partition(block, 0, 0, header.block_size, partition_info->skip_bytes);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+
+            continue;
+        }
+
+        result = write_to_partition(block, 0, src, header.block_size, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        src += header.block_size;
+    }
 
-    *block_index = index;
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Converts block index to save address
+ * @brief Store the blocks that changed since a snapshot from sat_snapshot()
  *
- * @param[in] Block index index of block to convert to address
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] address Block index represented as address on success
+ * The partition is walked once. Each used block is compared against the
+ * same block in base, blocks missing from base count as zeros. The diff is
+ * a SAT_DIFF_HEADER, the used block bitmap, the changed block bitmap, then
+ * each changed block in order, so it grows with the number of changed
+ * blocks rather than the partition size.
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] base Snapshot of the same partition to diff against
+ * @param[in] base_size Size of base in bytes
+ * @param[out] buffer Diff on success. NULL to only query the size
+ * @param[in] size Size of buffer in bytes
+ * @param[out] diff_size Size of the diff in bytes, also set on SLINGA_BUFFER_TOO_SMALL
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR convert_block_index_to_address(unsigned int block_index,
-                                                   const PPARTITION_INFO partition_info,
-                                                   unsigned char** address)
+SLINGA_ERROR sat_snapshot_diff(const PPARTITION_INFO partition_info,
+                               const unsigned char* base,
+                               unsigned int base_size,
+                               unsigned char* buffer,
+                               unsigned int size,
+                               unsigned int* diff_size)
 {
-    if(!address || !partition_info)
+    SAT_SNAPSHOT_HEADER base_header = {0};
+    SAT_DIFF_HEADER header = {0};
+    const unsigned char* base_bitmap = NULL;
+    const unsigned char* base_block = NULL;
+    unsigned char* changed_bitmap = NULL;
+    unsigned int bitmap_size = 0;
+    unsigned int total_size = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!diff_size)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    if(partition_info->skip_bytes != 0 && partition_info->skip_bytes != 1)
+    result = check_snapshot(partition_info, base, base_size, &base_header, &bitmap_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // blocks are compared without their skip bytes
+    if((partition_info->block_size >> partition_info->skip_bytes) > SAT_MAX_BLOCK_SIZE)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    // index is just the number of blocks from the start of the partition
-    *address = (unsigned char*)(partition_info->partition_buf + (block_index * partition_info->block_size));
+    memset(g_SAT_bitmap, 0, bitmap_size);
 
-    if(*address < partition_info->partition_buf)
+    result = walk_partition_bitmap(g_SAT_bitmap,
+                                   bitmap_size,
+                                   partition_info);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        // same as sat_snapshot(), keep every block of a damaged partition
+        memset(g_SAT_bitmap, 0xFF, bitmap_size);
     }
 
-    if(*address >= partition_info->partition_buf + partition_info->partition_size)
+    // bitmaps go in front of the blocks, fill them in as the blocks are compared
+    total_size = sizeof(SAT_DIFF_HEADER) + (2 * bitmap_size);
+    if(buffer && size >= total_size)
     {
-        return SLINGA_INVALID_PARAMETER;
+        changed_bitmap = buffer + sizeof(SAT_DIFF_HEADER) + bitmap_size;
+        memset(changed_bitmap, 0, bitmap_size);
+    }
+
+    base_bitmap = base + sizeof(SAT_SNAPSHOT_HEADER);
+    base_block = base_bitmap + bitmap_size;
+
+    for(unsigned int i = 0; i < base_header.num_blocks; i++)
+    {
+        const unsigned char* previous = NULL;
+        unsigned char* current = NULL;
+
+        if(base_bitmap[i / 8] & (1 << (i % 8)))
+        {
+            previous = base_block;
+            base_block += base_header.block_size;
+        }
+
+        if(!(g_SAT_bitmap[i / 8] & (1 << (i % 8))))
+        {
+            // free now, restored as zeros
+            continue;
+        }
+
+        // read straight into place when there's room, it's kept only if it changed
+        current = g_SAT_Block_Scratch;
+        if(changed_bitmap && total_size <= size && size - total_size >= base_header.block_size)
+        {
+            current = buffer + total_size;
+        }
+
+        result = read_from_partition(current, partition_info->partition_buf + (i * partition_info->block_size), 0, base_header.block_size, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(previous && memcmp(current, previous, base_header.block_size) == 0)
+        {
+            continue;
+        }
+
+        if(!previous && is_zero(current, base_header.block_size))
+        {
+            continue;
+        }
+
+        if(current != g_SAT_Block_Scratch)
+        {
+            changed_bitmap[i / 8] |= 1 << (i % 8);
+        }
+
+        header.changed_blocks++;
+        total_size += base_header.block_size;
     }
 
+    *diff_size = total_size;
+
+    if(!buffer)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    if(size < total_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(header.magic, SAT_DIFF_MAGIC, sizeof(header.magic));
+    header.version = SAT_SNAPSHOT_VERSION;
+    header.block_size = base_header.block_size;
+    header.num_blocks = base_header.num_blocks;
+    header.base_size = base_size;
+    header.base_hash = hash_buffer(base, base_size);
+    diff_header_to_be(&header);
+
+    memcpy(buffer, &header, sizeof(SAT_DIFF_HEADER));
+    memcpy(buffer + sizeof(SAT_DIFF_HEADER), g_SAT_bitmap, bitmap_size);
+
     return SLINGA_SUCCESS;
 }
 
-//
-// Parsing Save and Metadata
-//
-
 /**
- * @brief Reads metadata from a save start block
+ * @brief Overwrite the whole partition with a snapshot plus a diff from sat_snapshot_diff()
  *
- * @param[out] metadata Read metadata on success
- * @param[in] save Pointer to the start block
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * Changed blocks come from the diff, the other used blocks from base and
+ * free blocks are zeroed, all in one pass over the partition.
  *
- * @return SLINGA_SUCCESS on success
+ * @param[in] partition_info Save partition. Must have the same geometry the snapshots were taken from
+ * @param[in] base Snapshot the diff was taken against
+ * @param[in] base_size Size of base in bytes
+ * @param[in] diff Diff
+ * @param[in] diff_size Size of diff in bytes
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_SAT_INVALID_SNAPSHOT if diff wasn't taken against base
  */
-static SLINGA_ERROR copy_metadata(PSAVE_METADATA metadata, const unsigned char* save, unsigned int skip_bytes)
+SLINGA_ERROR sat_restore_diff(const PPARTITION_INFO partition_info,
+                              const unsigned char* base,
+                              unsigned int base_size,
+                              const unsigned char* diff,
+                              unsigned int diff_size)
 {
-    SAT_START_BLOCK_HEADER temp_save = {0};
+    SAT_SNAPSHOT_HEADER base_header = {0};
+    SAT_DIFF_HEADER header = {0};
+    const unsigned char* base_bitmap = NULL;
+    const unsigned char* base_block = NULL;
+    const unsigned char* used_bitmap = NULL;
+    const unsigned char* changed_bitmap = NULL;
+    const unsigned char* changed_block = NULL;
+    unsigned int bitmap_size = 0;
+    unsigned int changed_blocks = 0;
     SLINGA_ERROR result = 0;
 
-    if(!metadata || !save)
+    if(!diff)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    // copy the data locally to avoid having to deal with skip_bytes
-    result = read_from_partition((unsigned char*)&temp_save, (const unsigned char*)save, 0, sizeof(SAT_START_BLOCK_HEADER), skip_bytes);
+    result = check_snapshot(partition_info, base, base_size, &base_header, &bitmap_size);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    //
-    // save name, filename, and comment
-    //
-    memcpy(metadata->savename, temp_save.savename, MAX_SAVENAME);
-    metadata->savename[MAX_SAVENAME] = '\0'; //savename is MAX_SAVENAME + 1 bytes long
+    if(diff_size < sizeof(SAT_DIFF_HEADER) || diff_size - sizeof(SAT_DIFF_HEADER) < 2 * bitmap_size)
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
 
-    snprintf(metadata->filename, MAX_FILENAME, "%s.BUP", metadata->savename); // .BUP extension will always fit
-    metadata->filename[MAX_FILENAME] = '\0'; //filename is MAX_FILENAME + 1 bytes long
+    memcpy(&header, diff, sizeof(SAT_DIFF_HEADER));
+    diff_header_to_host(&header);
 
-    memcpy(metadata->comment, temp_save.comment, MAX_COMMENT);
-    metadata->comment[MAX_COMMENT] = '\0'; //comment is MAX_COMMMENT + 2 bytes long
+    if(memcmp(header.magic, SAT_DIFF_MAGIC, sizeof(header.magic)) != 0 || header.version != SAT_SNAPSHOT_VERSION)
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
 
-    //
-    // language, timestamp, data size, and block size
-    //
-    metadata->language = temp_save.language;
-    metadata->timestamp = temp_save.timestamp;
-    metadata->data_size = temp_save.data_size;
-    metadata->block_size = 0; // block size isn't needed (and isn't stored in the metadata)
+    if(header.block_size != base_header.block_size || header.num_blocks != base_header.num_blocks)
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    // layering a diff on the wrong base would silently mix two devices
+    if(header.base_size != base_size || header.base_hash != hash_buffer(base, base_size))
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    used_bitmap = diff + sizeof(SAT_DIFF_HEADER);
+    changed_bitmap = used_bitmap + bitmap_size;
+
+    result = count_bitmap(changed_bitmap, bitmap_size, &changed_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(changed_blocks != header.changed_blocks || diff_size != sizeof(SAT_DIFF_HEADER) + (2 * bitmap_size) + (changed_blocks * header.block_size))
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    // every save may change
+    drop_save_chain(partition_info, NULL);
+    release_reservation(partition_info, NULL);
+
+    base_bitmap = base + sizeof(SAT_SNAPSHOT_HEADER);
+    base_block = base_bitmap + bitmap_size;
+    changed_block = changed_bitmap + bitmap_size;
+
+    for(unsigned int i = 0; i < header.num_blocks; i++)
+    {
+        unsigned char* block = partition_info->partition_buf + (i * partition_info->block_size);
+        const unsigned char* src = NULL;
+
+        if(base_bitmap[i / 8] & (1 << (i % 8)))
+        {
+            src = base_block;
+            base_block += header.block_size;
+        }
+
+        if(changed_bitmap[i / 8] & (1 << (i % 8)))
+        {
+            src = changed_block;
+            changed_block += header.block_size;
+        }
+
+        if(!(used_bitmap[i / 8] & (1 << (i % 8))) || !src)
+        {
+            result = memset_partition(block, 0, 0, header.block_size, partition_info->skip_bytes);
+        }
+        else
+        {
+            result = write_to_partition(block, 0, src, header.block_size, partition_info->skip_bytes);
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
 
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Converts SAVE_METADATA to SAT_START_BLOCKP_HEADER
+ * @brief Forget everything cached about a partition. Call before its buffer is freed or reused
+ *
+ * @param[in] partition_info Save partition
  *
- * @param[in] metadata SAVE_METADATA
- * @param[out] header On success, filled out SAT_START_BLOCK_HEADER
-  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR metadata_to_header(const PSAVE_METADATA metadata, PSAT_START_BLOCK_HEADER header)
+SLINGA_ERROR sat_release(const PPARTITION_INFO partition_info)
 {
-    if(!metadata || !header)
+    if(!partition_info)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    memset(header, 0, sizeof(SAT_START_BLOCK_HEADER));
-
-    header->tag = SAT_START_BLOCK_TAG;
-    memcpy(header->savename, metadata->savename, SAT_MAX_SAVE_NAME);
-    header->language = metadata->language;
-    memcpy(header->comment, metadata->comment, SAT_MAX_SAVE_COMMENT);
-    header->timestamp = metadata->timestamp;
-    header->data_size = metadata->data_size;
+    // the caches are keyed by buffer address, a new buffer at the same address must not match
+    drop_save_chain(partition_info, NULL);
+    release_reservation(partition_info, NULL);
 
     return SLINGA_SUCCESS;
 }
 
-/**
- * @brief Finds save on the SAT partition
+//
+// Snapshot helper functions
+//
 
- * @param[in] filename Save to query
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] save_start Pointer to start of save on success
+/**
+ * @brief Validate a snapshot from sat_snapshot() against the partition
  *
- * @return SLINGA_SUCCESS on success
+ * @param[in] partition_info Save partition the snapshot will be used with
+ * @param[in] buffer Snapshot
+ * @param[in] size Size of the snapshot in bytes
+ * @param[out] header Snapshot header on success
+ * @param[out] bitmap_size Size of the used block bitmap in bytes on success
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_SAT_INVALID_SNAPSHOT if the snapshot is corrupt or doesn't match the partition
  */
-static SLINGA_ERROR find_save(const char* filename,
-                              const PPARTITION_INFO partition_info,
-                              unsigned char** save_start)
+static SLINGA_ERROR check_snapshot(const PPARTITION_INFO partition_info, const unsigned char* buffer, unsigned int size, PSAT_SNAPSHOT_HEADER header, unsigned int* bitmap_size)
 {
-    SAT_START_BLOCK_HEADER metadata = {0};
+    unsigned int used_blocks = 0;
     SLINGA_ERROR result = 0;
 
-    if(!filename || !partition_info || !save_start)
+    if(!partition_info || !buffer || !header || !bitmap_size)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    // loop through all blocks on the partition
+    if(partition_info->skip_bytes != 0 && partition_info->skip_bytes != 1)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(size < sizeof(SAT_SNAPSHOT_HEADER))
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    memcpy(header, buffer, sizeof(SAT_SNAPSHOT_HEADER));
+    snapshot_header_to_host(header);
+
+    if(memcmp(header->magic, SAT_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SAT_SNAPSHOT_VERSION)
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    result = get_bitmap_size(partition_info, sizeof(g_SAT_bitmap), bitmap_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // snapshots only go back to a partition shaped like the one they came from
+    if(header->block_size != (partition_info->block_size >> partition_info->skip_bytes) || header->num_blocks != *bitmap_size * 8)
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    if(size - sizeof(SAT_SNAPSHOT_HEADER) < *bitmap_size)
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    result = count_bitmap(buffer + sizeof(SAT_SNAPSHOT_HEADER), *bitmap_size, &used_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(used_blocks != header->used_blocks || size != sizeof(SAT_SNAPSHOT_HEADER) + *bitmap_size + (used_blocks * header->block_size))
+    {
+        return SLINGA_SAT_INVALID_SNAPSHOT;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Hash a buffer, used to tie a diff to the snapshot it was taken against
+ *
+ * FNV-1a over 32-bit little endian words in four independent lanes, so the
+ * main loop has no dependency between lanes and can be unrolled or
+ * vectorized. Not cryptographic.
+ *
+ * @param[in] buffer Bytes to hash
+ * @param[in] size Size of buffer in bytes
+ *
+ * @return Hash of buffer
+ */
+static unsigned int hash_buffer(const unsigned char* buffer, unsigned int size)
+{
+    unsigned int lanes[4] = {0x811C9DC5, 0x811C9DC5 ^ 1, 0x811C9DC5 ^ 2, 0x811C9DC5 ^ 3};
+    unsigned int hash = 0;
+    unsigned int i = 0;
+
+    for(i = 0; i + 16 <= size; i += 16)
+    {
+        for(unsigned int j = 0; j < 4; j++)
+        {
+            const unsigned char* word = buffer + i + (j * 4);
+
+            lanes[j] = (lanes[j] ^ (word[0] | (word[1] << 8) | (word[2] << 16) | ((unsigned int)word[3] << 24))) * 0x01000193;
+        }
+    }
+
+    for(; i < size; i++)
+    {
+        lanes[0] = (lanes[0] ^ buffer[i]) * 0x01000193;
+    }
+
+    hash = size;
+    for(unsigned int j = 0; j < 4; j++)
+    {
+        hash = (hash ^ lanes[j]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Check if a buffer is all zeros
+ *
+ * @param[in] buffer Bytes to check
+ * @param[in] size Size of buffer in bytes
+ *
+ * @return 1 if every byte is 0, 0 otherwise
+ */
+static int is_zero(const unsigned char* buffer, unsigned int size)
+{
+    unsigned char bits = 0;
+
+    for(unsigned int i = 0; i < size; i++)
+    {
+        bits |= buffer[i];
+    }
+
+    return bits == 0;
+}
+
+//
+// Block helper functions
+//
+
+/**
+ * @brief Given a save size, calculate how many blocks it needs.
+ *
+ * @param[in] save_size How big the save is in bytes
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[out] num_save_blocks Number of blocks needed to record save_size bytes on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR calc_num_blocks(unsigned int save_size, unsigned int block_size, unsigned int skip_bytes, unsigned int* num_save_blocks)
+{
+    unsigned int total_bytes = 0;
+    unsigned int fixed_bytes = 0;
+    unsigned int num_blocks = 0;
+    unsigned int num_blocks2 = 0;
+
+    if(!save_size || !num_save_blocks || !block_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(skip_bytes != 0 && skip_bytes != 1)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(skip_bytes == 1)
+    {
+        block_size = block_size/2;
+    }
+
+    // block size must be 64-byte aligned
+    if((block_size % MIN_BLOCK_SIZE) != 0)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    //
+    // The stored save consists of:
+    // - the save metadata header
+    // - the variable length SAT table
+    // - the save data itself
+    //
+    // What makes this tricky to compute is that the SAT table itself is stored
+    // on the blocks
+    //
+
+    fixed_bytes = sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE + save_size;
+
+    // calculate the number of SAT table entries required
+    num_blocks = fixed_bytes / (block_size - SAT_TAG_SIZE);
+
+    // +1 for 0x0000 SAT table terminator
+    total_bytes = fixed_bytes + ((num_blocks + 1) * sizeof(unsigned short));
+
+    // we need to do this in a loop because it's possible that by adding a SAT
+    // table entry we increased the number of bytes we need such that we need
+    // yet another SAT table entry.
+    do
+    {
+        num_blocks = num_blocks2;
+        total_bytes = fixed_bytes + ((num_blocks + 1) * sizeof(unsigned short));
+        num_blocks2 = total_bytes / (block_size - SAT_TAG_SIZE);
+
+        if(total_bytes % (block_size - SAT_TAG_SIZE))
+        {
+            num_blocks2++;
+        }
+
+    }while(num_blocks != num_blocks2);
+
+    *num_save_blocks = num_blocks;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Converts save address to block index
+ *
+ * @param[in] address address of save
+ * @param[in] partition_buf Start of the save partition
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[out] block_index Address represented as a block index
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR convert_address_to_block_index(const unsigned char* address,
+                                                   const PPARTITION_INFO partition_info,
+                                                   unsigned int* block_index)
+{
+    unsigned int index = 0;
+
+    if(!address || !partition_info)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(address < partition_info->partition_buf)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(address >= partition_info->partition_buf + partition_info->partition_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // index is just the number of blocks from the start of the partition
+    index = (address - partition_info->partition_buf)/partition_info->block_size;
+
+    *block_index = index;
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Converts block index to save address
+ *
+ * @param[in] Block index index of block to convert to address
+ * @param[in] partition_buf Start of the save partition
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[out] address Block index represented as address on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR convert_block_index_to_address(unsigned int block_index,
+                                                   const PPARTITION_INFO partition_info,
+                                                   unsigned char** address)
+{
+    if(!address || !partition_info)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(partition_info->skip_bytes != 0 && partition_info->skip_bytes != 1)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // index is just the number of blocks from the start of the partition
+    *address = (unsigned char*)(partition_info->partition_buf + (block_index * partition_info->block_size));
+
+    if(*address < partition_info->partition_buf)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(*address >= partition_info->partition_buf + partition_info->partition_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// Parsing Save and Metadata
+//
+
+/**
+ * @brief Reads metadata from a save start block
+ *
+ * @param[out] metadata Read metadata on success
+ * @param[in] save Pointer to the start block
+ * @param[in] partition_info Partition the save is on
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR copy_metadata(PSAVE_METADATA metadata, const unsigned char* save, const PPARTITION_INFO partition_info)
+{
+    SAT_START_BLOCK_HEADER temp_save = {0};
+    unsigned int num_blocks = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!metadata || !save || !partition_info)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // copy the data locally to avoid having to deal with skip_bytes
+    result = read_header(save, &temp_save, partition_info->skip_bytes);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    //
+    // save name, filename, and comment
+    //
+    memcpy(metadata->savename, temp_save.savename, MAX_SAVENAME);
+    metadata->savename[MAX_SAVENAME] = '\0'; //savename is MAX_SAVENAME + 1 bytes long
+
+    snprintf(metadata->filename, MAX_FILENAME, "%s.BUP", metadata->savename); // .BUP extension will always fit
+    metadata->filename[MAX_FILENAME] = '\0'; //filename is MAX_FILENAME + 1 bytes long
+
+    memcpy(metadata->comment, temp_save.comment, MAX_COMMENT);
+    metadata->comment[MAX_COMMENT] = '\0'; //comment is MAX_COMMMENT + 2 bytes long
+
+    //
+    // language, timestamp, data size, and block size
+    //
+    metadata->language = temp_save.language;
+    metadata->timestamp = temp_save.timestamp;
+    metadata->data_size = temp_save.data_size;
+
+    // not stored in the header, but the data size decides it
+    result = calc_num_blocks(temp_save.data_size, partition_info->block_size, partition_info->skip_bytes, &num_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    metadata->block_size = (unsigned short)num_blocks;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Converts SAVE_METADATA to SAT_START_BLOCKP_HEADER
+ *
+ * @param[in] metadata SAVE_METADATA
+ * @param[out] header On success, filled out SAT_START_BLOCK_HEADER
+  *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR metadata_to_header(const PSAVE_METADATA metadata, PSAT_START_BLOCK_HEADER header)
+{
+    if(!metadata || !header)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(header, 0, sizeof(SAT_START_BLOCK_HEADER));
+
+    header->tag = SAT_START_BLOCK_TAG;
+    memcpy(header->savename, metadata->savename, SAT_MAX_SAVE_NAME);
+    header->language = metadata->language;
+    memcpy(header->comment, metadata->comment, SAT_MAX_SAVE_COMMENT);
+    header->timestamp = metadata->timestamp;
+    header->data_size = metadata->data_size;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Finds save on the SAT partition
+
+ * @param[in] filename Save to query
+ * @param[in] partition_buf Start of the save partition
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[out] save_start Pointer to start of save on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR find_save(const char* filename,
+                              const PPARTITION_INFO partition_info,
+                              unsigned char** save_start)
+{
+    SAT_START_BLOCK_HEADER metadata = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!filename || !partition_info || !save_start)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // loop through all blocks on the partition
+    // the first two blocks are not used for saves
+    for(unsigned int i = (2 * partition_info->block_size); i < partition_info->partition_size; i += partition_info->block_size)
+    {
+        const unsigned char* current_block = (partition_info->partition_buf + i);
+
+        // validate range
+        if(current_block < partition_info->partition_buf || current_block >= partition_info->partition_buf + partition_info->partition_size)
+        {
+            return SLINGA_INVALID_PARAMETER;
+        }
+
+        result = read_header(current_block, &metadata, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        // every save starts with a tag
+        if(metadata.tag == SAT_START_BLOCK_TAG)
+        {
+            // check if this is our save
+            result = strncmp(filename, metadata.savename, SAT_MAX_SAVE_NAME);
+            if(result != 0)
+            {
+                // not our save
+                continue;
+            }
+
+            *save_start = (unsigned char*)current_block;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Read save and metadata on the SAT parittion
+
+ * @param[in] filename Save to query
+ * @param[in] partition_buf Start of the save partition
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[out] save_start Pointer to start of save on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR read_save_and_metadata(const PPARTITION_INFO partition_info,
+                                           PSAVE_METADATA metadata,
+                                           const char* filename,
+                                           unsigned char* buffer,
+                                           unsigned int size,
+                                           unsigned int* bytes_read)
+{
+    unsigned char* save_start = NULL;
+    SAT_START_BLOCK_HEADER save_header = {0};
+    SLINGA_ERROR result = 0;
+
+    result = find_save(filename,
+                       partition_info,
+                       &save_start);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = read_header(save_start, &save_header, partition_info->skip_bytes);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(buffer)
+    {
+        const unsigned short* blocks = NULL;
+        unsigned int num_blocks = 0;
+        unsigned int data_offset = 0;
+
+        // read the save size
+        if(save_header.data_size < size)
+        {
+            // buffer isn't big enough to hold the save
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        // the chain cache skips parsing the SAT table on repeat reads
+        result = get_save_chain(partition_info,
+                                save_start,
+                                &blocks,
+                                &num_blocks,
+                                &data_offset);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = read_chain_bytes(partition_info,
+                                  blocks,
+                                  num_blocks,
+                                  data_offset,
+                                  buffer,
+                                  size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(bytes_read)
+        {
+            *bytes_read = size;
+        }
+    }
+
+    if(metadata)
+    {
+        result = copy_metadata(metadata, save_start, partition_info);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Walk the partition, finding all saves and metadata
+ *
+ * @param[in] partition_buf Start of the save partition
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[in] start_block Block to start scanning from. Blocks before the first save block are skipped
+ * @param[out] saves Filled out SAVE_METADATA array on success
+ * @param[in] num_sizes size in elements of saves array
+ * @param[out] saves_available Number of saves found on device on success
+ * @param[out] used_blocks Number of used blocks on the partition on success
+ * @param[out] next_block If not NULL, stop when saves is full instead of failing and return the block to resume from. SLINGA_LIST_END if the scan finished
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR walk_partition(const PPARTITION_INFO partition_info,
+                                   unsigned int start_block,
+                                   PSAVE_METADATA saves,
+                                   unsigned int num_saves,
+                                   unsigned int* saves_available,
+                                   unsigned int* used_blocks,
+                                   unsigned int* next_block)
+{
+    SAT_START_BLOCK_HEADER metadata = {0};
+    const unsigned char* current_block = NULL;
+    unsigned int saves_found = 0;
+    unsigned int blocks_found = 0;
+    unsigned int save_blocks = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!partition_info)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(partition_info->block_size > partition_info->partition_size || (partition_info->partition_size % partition_info->block_size) != 0)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(next_block)
+    {
+        *next_block = SLINGA_LIST_END;
+    }
+
+    // the first two blocks are not used for saves
+    if(start_block < 2)
+    {
+        start_block = 2;
+    }
+
+    if(start_block > partition_info->partition_size / partition_info->block_size)
+    {
+        start_block = partition_info->partition_size / partition_info->block_size;
+    }
+
+    // loop through all blocks onthe parititon
+    for(unsigned int i = (start_block * partition_info->block_size); i < partition_info->partition_size; i += partition_info->block_size)
+    {
+        current_block = partition_info->partition_buf + i;
+
+        // validate range
+        if(current_block < partition_info->partition_buf || current_block >= partition_info->partition_buf + partition_info->partition_size)
+        {
+            return SLINGA_SAT_INVALID_PARTITION;
+        }
+
+        result = read_header(current_block, &metadata, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        // every save starts with a tag
+        if(metadata.tag == SAT_START_BLOCK_TAG)
+        {
+            PSAT_RESERVATION reservation = NULL;
+
+            result = calc_num_blocks(metadata.data_size, partition_info->block_size, partition_info->skip_bytes, &save_blocks);
+            if(result != SLINGA_SUCCESS)
+            {
+                return SLINGA_SAT_INVALID_PARTITION;
+            }
+
+            // a reserved save keeps every block it claimed, whatever was last written to it
+            reservation = find_reservation(partition_info, metadata.savename);
+            if(reservation && reservation->num_blocks > save_blocks)
+            {
+                save_blocks = reservation->num_blocks;
+            }
+
+            blocks_found += save_blocks;
+
+            if(saves)
+            {
+                // check if we are finished looking for saves
+                if(saves_found >= num_saves)
+                {
+                    if(next_block)
+                    {
+                        // page is full, resume from this save next time
+                        *next_block = i / partition_info->block_size;
+                        break;
+                    }
+
+                    // no more room in our saves array
+                    return SLINGA_BUFFER_TOO_SMALL;
+                }
+
+                // copy off the metadata
+                result = copy_metadata(&saves[saves_found], current_block, partition_info);
+                if(result)
+                {
+                    return result;
+                }
+            }
+
+            saves_found++;
+        }
+    }
+
+    if(saves_available)
+    {
+        *saves_available = saves_found;
+    }
+
+    if(used_blocks)
+    {
+        *used_blocks = blocks_found;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Walk the partition, finding all saves and metadata
+ *
+ * @param[out] bitmap On success the bitmap bits will be set to 1 for each block that is part of the save
+ * @param[in] bitmap_size Size of bitmap in bytes *
+ * @param[in] partition_buf Start of the save partition
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR walk_partition_bitmap(unsigned char* bitmap,
+                                          unsigned int bitmap_size,
+                                          const PPARTITION_INFO partition_info)
+{
+    unsigned int tag = 0;
+    const unsigned char* current_block = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!bitmap || !bitmap_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(!partition_info)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(partition_info->block_size > partition_info->partition_size || (partition_info->partition_size % partition_info->block_size) != 0)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // don't write to the first two blocks
+    // add the start block to our bitmap
+    result = set_bitmap(0, bitmap, bitmap_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = set_bitmap(1, bitmap, bitmap_size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // loop through all blocks onthe parititon
     // the first two blocks are not used for saves
     for(unsigned int i = (2 * partition_info->block_size); i < partition_info->partition_size; i += partition_info->block_size)
     {
-        const unsigned char* current_block = (partition_info->partition_buf + i);
+        current_block = partition_info->partition_buf + i;
 
         // validate range
         if(current_block < partition_info->partition_buf || current_block >= partition_info->partition_buf + partition_info->partition_size)
         {
-            return SLINGA_INVALID_PARAMETER;
+            return SLINGA_SAT_INVALID_PARTITION;
         }
 
-        result = read_from_partition((unsigned char*)&metadata, current_block, 0, sizeof(SAT_START_BLOCK_HEADER), partition_info->skip_bytes);
+        result = read_tag(current_block, &tag, partition_info->skip_bytes);
         if(result != SLINGA_SUCCESS)
         {
             return result;
         }
 
         // every save starts with a tag
-        if(metadata.tag == SAT_START_BLOCK_TAG)
+        if(tag == SAT_START_BLOCK_TAG)
         {
-            // check if this is our save
-            result = strncmp(filename, metadata.savename, SAT_MAX_SAVE_NAME);
-            if(result != 0)
+            const unsigned short* blocks = NULL;
+            unsigned int num_blocks = 0;
+            unsigned int data_offset = 0;
+
+            // cached chains don't have to be parsed again
+            result = get_save_chain(partition_info,
+                                    current_block,
+                                    &blocks,
+                                    &num_blocks,
+                                    &data_offset);
+            if(result == SLINGA_SAT_TOO_MANY_BLOCKS)
             {
-                // not our save
+                // longer than any save we write, stream the table to mark it busy
+                result = read_chain(partition_info,
+                                    current_block,
+                                    NULL,
+                                    0,
+                                    bitmap,
+                                    bitmap_size,
+                                    &num_blocks,
+                                    &data_offset);
+                if(result != SLINGA_SUCCESS)
+                {
+                    return result;
+                }
+
                 continue;
             }
 
-            *save_start = (unsigned char*)current_block;
-            return SLINGA_SUCCESS;
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+
+            for(unsigned int j = 0; j < num_blocks; j++)
+            {
+                result = set_bitmap(blocks[j], bitmap, bitmap_size);
+                if(result != SLINGA_SUCCESS)
+                {
+                    return result;
+                }
+            }
         }
     }
 
-    return SLINGA_NOT_FOUND;
+    return SLINGA_SUCCESS;
 }
 
-/**
- * @brief Read save and metadata on the SAT parittion
+//
+// SAT table
+//
 
- * @param[in] filename Save to query
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] save_start Pointer to start of save on success
+/**
+ * @brief Read the SAT table of a save into an ordered vector of blocks
+ *
+ * The table lists the blocks of the save in order after the start block.
+ * Every block holding part of the table is listed before the table reaches
+ * it, so the vector is filled as the table is read.
+ *
+ * Without a vector the table is streamed instead: the block holding the next
+ * part of the table is found by reading the entry that lists it again, so
+ * chains of any length can be walked.
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] save_start Pointer to the start of a save on the partition
+ * @param[out] blocks On success, the start block followed by the SAT table entries. NULL to stream the table
+ * @param[in] max_blocks Size in elements of blocks
+ * @param[out] bitmap If not NULL, the bit of every block of the save is set
+ * @param[in] bitmap_size Size of bitmap in bytes
+ * @param[out] num_blocks Number of blocks in the chain on success
+ * @param[out] data_offset Offset of the first data byte in the chain on success
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR read_save_and_metadata(const PPARTITION_INFO partition_info,
-                                           PSAVE_METADATA metadata,
-                                           const char* filename,
-                                           unsigned char* buffer,
-                                           unsigned int size,
-                                           unsigned int* bytes_read)
+static SLINGA_ERROR read_chain(const PPARTITION_INFO partition_info,
+                               const unsigned char* save_start,
+                               unsigned short* blocks,
+                               unsigned int max_blocks,
+                               unsigned char* bitmap,
+                               unsigned int bitmap_size,
+                               unsigned int* num_blocks,
+                               unsigned int* data_offset)
 {
-    unsigned char* save_start = NULL;
     SAT_START_BLOCK_HEADER save_header = {0};
+    unsigned char entries[SAT_READ_ENTRIES * sizeof(unsigned short)] = {0};
+    unsigned char* block = NULL;
+    unsigned int block_chain_index = 0;
+    unsigned int usable_size = 0;
+    unsigned int total_blocks = 0;
+    unsigned int start_block = 0;
+    unsigned int count = 0;
+    unsigned int offset = 0;
     SLINGA_ERROR result = 0;
 
-    result = find_save(filename,
-                       partition_info,
-                       &save_start);
+    if(!partition_info || !save_start || (blocks && !max_blocks) || !num_blocks || !data_offset)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if((partition_info->partition_size % partition_info->block_size) != 0)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = get_usable_block_size(partition_info, &usable_size);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    result = read_from_partition((unsigned char*)&save_header, save_start, 0, sizeof(SAT_START_BLOCK_HEADER), partition_info->skip_bytes);
+    // copy the data locally to avoid having to deal with skip_bytes
+    result = read_header(save_start, &save_header, partition_info->skip_bytes);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    if(buffer)
+    // first block must have the start tag
+    if(save_header.tag != SAT_START_BLOCK_TAG)
     {
-        unsigned int start_block = 0;
-        unsigned int start_data_block = 0;
-        unsigned int save_size = 0;
-        unsigned int bitmap_size = 0;
+        return SLINGA_SAT_INVALID_TAG;
+    }
 
-        // read the save size
-        save_size = save_header.data_size;
-        if(save_size < size)
-        {
-            // buffer isn't big enough to hold the save
-            return SLINGA_BUFFER_TOO_SMALL;
-        }
+    result = convert_address_to_block_index(save_start, partition_info, &start_block);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
 
-        // calculate how how much of the bitmap we actually need
-        result = get_bitmap_size(partition_info, sizeof(g_SAT_bitmap), &bitmap_size);
-        if(result != SLINGA_SUCCESS)
-        {
-            return result;
-        }
+    total_blocks = partition_info->partition_size / partition_info->block_size;
 
-        // zero out the bitmap to begin
-        memset(g_SAT_bitmap, 0, bitmap_size);
+    // a streamed chain can't be longer than the partition
+    if(!blocks)
+    {
+        max_blocks = total_blocks;
+    }
+    else
+    {
+        blocks[0] = (unsigned short)start_block;
+    }
 
-        result = read_sat_table(partition_info,
-                                save_start,
-                                g_SAT_bitmap,
-                                bitmap_size,
-                                &start_block,
-                                &start_data_block);
+    if(bitmap)
+    {
+        result = set_bitmap(start_block, bitmap, bitmap_size);
         if(result != SLINGA_SUCCESS)
         {
             return result;
         }
-
-        result = read_save_from_sat_table(buffer,
-                                          size,
-                                          bytes_read,
-                                          start_block,
-                                          start_data_block,
-                                          g_SAT_bitmap,
-                                          bitmap_size,
-                                          partition_info);
-        if(result != 0)
-        {
-            return result;
-        }
     }
 
-    if(metadata)
+    count = 1;
+
+    // the table starts right after the header
+    offset = sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE;
+    block = (unsigned char*)save_start;
+
+    while(1)
     {
-        result = copy_metadata(metadata, save_start, partition_info->skip_bytes);
-        if(result != SLINGA_SUCCESS)
+        unsigned int chain_index = offset / usable_size;
+        unsigned int block_offset = offset % usable_size;
+        unsigned int num_entries = 0;
+
+        if(chain_index >= count)
         {
-            return result;
+            // the table runs past the blocks it lists
+            return SLINGA_SAT_INVALID_PARTITION;
         }
-    }
 
-    return SLINGA_SUCCESS;
-}
+        if(chain_index != block_chain_index)
+        {
+            unsigned int block_index = 0;
+            unsigned int tag = 0;
 
-/**
- * @brief Walk the partition, finding all saves and metadata
- *
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] saves Filled out SAVE_METADATA array on success
- * @param[in] num_sizes size in elements of saves array
- * @param[out] saves_available Number of saves found on device on success
- * @param[out] used_blocks Number of used blocks on the partition on success
- *
- * @return SLINGA_SUCCESS on success
- */
-static SLINGA_ERROR walk_partition(const PPARTITION_INFO partition_info,
-                                   PSAVE_METADATA saves,
-                                   unsigned int num_saves,
-                                   unsigned int* saves_available,
-                                   unsigned int* used_blocks)
-{
-    SAT_START_BLOCK_HEADER metadata = {0};
-    const unsigned char* current_block = NULL;
-    unsigned int saves_found = 0;
-    unsigned int blocks_found = 0;
-    unsigned int save_blocks = 0;
-    SLINGA_ERROR result = 0;
+            if(blocks)
+            {
+                block_index = blocks[chain_index];
+            }
+            else
+            {
+                result = find_chain_block(partition_info, save_start, usable_size, chain_index, &block_index);
+                if(result != SLINGA_SUCCESS)
+                {
+                    return result;
+                }
+            }
 
-    if(!partition_info)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+            result = convert_block_index_to_address(block_index, partition_info, &block);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
 
-    if(partition_info->block_size > partition_info->partition_size || (partition_info->partition_size % partition_info->block_size) != 0)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+            block_chain_index = chain_index;
 
-    // loop through all blocks onthe parititon
-    // the first two blocks are not used for saves
-    for(unsigned int i = (2 * partition_info->block_size); i < partition_info->partition_size; i += partition_info->block_size)
-    {
-        current_block = partition_info->partition_buf + i;
+            // other blocks must have the continuation tag
+            result = read_tag(block, &tag, partition_info->skip_bytes);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
 
-        // validate range
-        if(current_block < partition_info->partition_buf || current_block >= partition_info->partition_buf + partition_info->partition_size)
-        {
-            return SLINGA_SAT_INVALID_PARTITION;
+            if(tag != SAT_CONTINUE_BLOCK_TAG)
+            {
+                return SLINGA_SAT_INVALID_TAG;
+            }
         }
 
-        result = read_from_partition((unsigned char*)&metadata, current_block, 0, sizeof(SAT_START_BLOCK_HEADER), partition_info->skip_bytes);
+        // read as many entries as are left in this block, a few at a time
+        num_entries = LIBSLINGA_MIN((usable_size - block_offset) / sizeof(unsigned short), SAT_READ_ENTRIES);
+
+        result = read_from_partition(entries, block, SAT_TAG_SIZE + block_offset, num_entries * sizeof(unsigned short), partition_info->skip_bytes);
         if(result != SLINGA_SUCCESS)
         {
             return result;
         }
 
-        // every save starts with a tag
-        if(metadata.tag == SAT_START_BLOCK_TAG)
+        for(unsigned int i = 0; i < num_entries; i++)
         {
-            result = calc_num_blocks(metadata.data_size, partition_info->block_size, partition_info->skip_bytes, &save_blocks);
-            if(result != SLINGA_SUCCESS)
-            {
-                return SLINGA_SAT_INVALID_PARTITION;
-            }
+            unsigned short entry = read_be16(&entries[i * sizeof(unsigned short)]);
 
-            blocks_found += save_blocks;
+            offset += sizeof(unsigned short);
 
-            if(saves)
+            if(entry == 0)
             {
-                // check if we are finished looking for saves
-                if(saves_found >= num_saves)
+                // 0x0000 terminates the table, data follows
+                if(count * usable_size < offset + save_header.data_size)
                 {
-                    // no more room in our saves array
-                    return SLINGA_BUFFER_TOO_SMALL;
-                    break;
+                    // not enough blocks for the save data
+                    return SLINGA_SAT_INVALID_SIZE;
                 }
 
-                // copy off the metadata
-                result = copy_metadata(&saves[saves_found], current_block, partition_info->skip_bytes);
-                if(result)
+                *num_blocks = count;
+                *data_offset = offset;
+                return SLINGA_SUCCESS;
+            }
+
+            // the first two blocks are not used for saves
+            if(entry < 2 || entry >= total_blocks)
+            {
+                return SLINGA_SAT_SAVE_OUT_OF_RANGE;
+            }
+
+            if(count >= max_blocks)
+            {
+                return SLINGA_SAT_TOO_MANY_BLOCKS;
+            }
+
+            if(blocks)
+            {
+                blocks[count] = entry;
+            }
+
+            if(bitmap)
+            {
+                result = set_bitmap(entry, bitmap, bitmap_size);
+                if(result != SLINGA_SUCCESS)
                 {
                     return result;
                 }
             }
 
-            saves_found++;
+            count++;
         }
     }
-
-    if(saves_available)
-    {
-        *saves_available = saves_found;
-    }
-
-    if(used_blocks)
-    {
-        *used_blocks = blocks_found;
-    }
-
-    return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Walk the partition, finding all saves and metadata
+ * @brief Find a block of a save's chain by reading the SAT table entry that lists it
  *
- * @param[out] bitmap On success the bitmap bits will be set to 1 for each block that is part of the save
- * @param[in] bitmap_size Size of bitmap in bytes *
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * The entry is in an earlier block of the chain, which is found the same way.
+ * Every table block holds at least a dozen entries so this only recurses a
+ * few times.
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] save_start Pointer to the start of the save on the partition
+ * @param[in] usable_size Bytes per block, not counting the tag
+ * @param[in] chain_index Index of the block in the chain. 0 is the start block
+ * @param[out] block_index Block index on success
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR walk_partition_bitmap(unsigned char* bitmap,
-                                          unsigned int bitmap_size,
-                                          const PPARTITION_INFO partition_info)
+static SLINGA_ERROR find_chain_block(const PPARTITION_INFO partition_info,
+                                     const unsigned char* save_start,
+                                     unsigned int usable_size,
+                                     unsigned int chain_index,
+                                     unsigned int* block_index)
 {
-    unsigned int tag = 0;
-    const unsigned char* current_block = NULL;
+    unsigned char entry[sizeof(unsigned short)] = {0};
+    unsigned char* block = NULL;
+    unsigned int entry_offset = 0;
+    unsigned int entry_block = 0;
     SLINGA_ERROR result = 0;
 
-    if(!bitmap || !bitmap_size)
+    if(chain_index == 0)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return convert_address_to_block_index(save_start, partition_info, block_index);
+    }
+
+    // chain block i is listed by table entry i - 1
+    entry_offset = sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE + (chain_index - 1) * sizeof(unsigned short);
+
+    result = find_chain_block(partition_info, save_start, usable_size, entry_offset / usable_size, &entry_block);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = convert_block_index_to_address(entry_block, partition_info, &block);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = read_from_partition(entry, block, SAT_TAG_SIZE + (entry_offset % usable_size), sizeof(entry), partition_info->skip_bytes);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
     }
 
-    if(!partition_info)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+    *block_index = read_be16(entry);
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Copy bytes out of a save, following its chain
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] blocks Chain of the save
+ * @param[in] num_blocks Number of blocks in the chain
+ * @param[in] offset Offset in the chain to start reading at. Tags aren't counted
+ * @param[out] buffer Bytes read on success
+ * @param[in] size Number of bytes to read
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR read_chain_bytes(const PPARTITION_INFO partition_info,
+                                     const unsigned short* blocks,
+                                     unsigned int num_blocks,
+                                     unsigned int offset,
+                                     unsigned char* buffer,
+                                     unsigned int size)
+{
+    unsigned int usable_size = 0;
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
 
-    if(partition_info->block_size > partition_info->partition_size || (partition_info->partition_size % partition_info->block_size) != 0)
+    if(!partition_info || !blocks || !buffer)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    // don't write to the first two blocks
-    // add the start block to our bitmap
-    result = set_bitmap(0, bitmap, bitmap_size);
+    result = get_usable_block_size(partition_info, &usable_size);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    result = set_bitmap(1, bitmap, bitmap_size);
-    if(result != SLINGA_SUCCESS)
+    if(offset + size > num_blocks * usable_size)
     {
-        return result;
+        return SLINGA_SAT_INVALID_READ_SIZE;
     }
 
-    // loop through all blocks onthe parititon
-    // the first two blocks are not used for saves
-    for(unsigned int i = (2 * partition_info->block_size); i < partition_info->partition_size; i += partition_info->block_size)
+    while(bytes_read < size)
     {
-        current_block = partition_info->partition_buf + i;
+        unsigned int block_offset = (offset + bytes_read) % usable_size;
+        unsigned int bytes_to_copy = LIBSLINGA_MIN(usable_size - block_offset, size - bytes_read);
+        unsigned char* block = NULL;
 
-        // validate range
-        if(current_block < partition_info->partition_buf || current_block >= partition_info->partition_buf + partition_info->partition_size)
+        result = convert_block_index_to_address(blocks[(offset + bytes_read) / usable_size], partition_info, &block);
+        if(result != SLINGA_SUCCESS)
         {
-            return SLINGA_SAT_INVALID_PARTITION;
+            return result;
         }
 
-        result = read_from_partition((unsigned char*)&tag, current_block, 0, SAT_TAG_SIZE, partition_info->skip_bytes);
+        result = read_from_partition(buffer + bytes_read, block, SAT_TAG_SIZE + block_offset, bytes_to_copy, partition_info->skip_bytes);
         if(result != SLINGA_SUCCESS)
         {
             return result;
         }
 
-        // every save starts with a tag
-        if(tag == SAT_START_BLOCK_TAG)
-        {
-            unsigned int start_block = 0;
-            unsigned int start_data_block = 0;
-
-            result = read_sat_table(partition_info,
-                                    current_block,
-                                    bitmap,
-                                    bitmap_size,
-                                    &start_block,
-                                    &start_data_block);
-            if(result != SLINGA_SUCCESS)
-            {
-                return result;
-            }
-        }
+        bytes_read += bytes_to_copy;
     }
 
     return SLINGA_SUCCESS;
 }
 
-//
-// SAT table
-//
-
 /**
- * @brief Read the SAT table from the specified save
+ * @brief Bytes of a block available to the save, not counting the tag
  *
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[in] save_start Pointer to the start of a save on the parit
- * @param[out] bitmap On success the bitmap bits will be set to 1 for each block that is part of the save
- * @param[in] bitmap_size Size of bitmap in bytes *
- * @param[out] start_block First block of the save on success
- * @param[out] start_data_block First block containing save data (as opposed to just metadata). Can be same or different than start_block
+ * @param[in] partition_info Save partition
+ * @param[out] usable_size Usable bytes per block on success
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR read_sat_table(const PPARTITION_INFO partition_info,
-                                   const unsigned char* save_start,
-                                   unsigned char* bitmap,
-                                   unsigned int bitmap_size,
-                                   unsigned int* start_block,
-                                   unsigned int* start_data_block)
-{
-    unsigned int num_sat_blocks = 0;
-    unsigned int written_sat_entries = 0;
-    unsigned int cur_sat_block = 0;
-    SAT_START_BLOCK_HEADER save_header = {0};
-    int result = 0;
-
-    if(!partition_info || !save_start || !bitmap || !bitmap_size || !start_block || !start_data_block)
+static SLINGA_ERROR get_usable_block_size(const PPARTITION_INFO partition_info, unsigned int* usable_size)
+{
+    if(!partition_info || !usable_size)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
     // block size must be 64-byte aligned
-    if((partition_info->block_size % MIN_BLOCK_SIZE) != 0)
+    if(!partition_info->block_size || (partition_info->block_size % MIN_BLOCK_SIZE) != 0)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    if((partition_info->partition_size % partition_info->block_size) != 0)
+    if(partition_info->skip_bytes == 0)
+    {
+        // all bytes are valid, just subtract off the tag size
+        *usable_size = partition_info->block_size - SAT_TAG_SIZE;
+    }
+    else if(partition_info->skip_bytes == 1)
+    {
+        // every other byte is valid
+        *usable_size = (partition_info->block_size / 2) - SAT_TAG_SIZE;
+    }
+    else
     {
+        // invalid skip_bytes value
         return SLINGA_INVALID_PARAMETER;
     }
 
-    // copy the data locally to avoid having to deal with skip_bytes
-    result = read_from_partition((unsigned char*)&save_header, save_start, 0, sizeof(SAT_START_BLOCK_HEADER), partition_info->skip_bytes);
+    return SLINGA_SUCCESS;
+}
+
+//
+// Write saves
+//
+
+/**
+ * @brief Allocate the blocks for a new save and write it.
+ * The chain is left in g_SAT_Chain_Scratch
+ *
+ * @param[in] metadata Metadata (comment, date, etc) to write with the save
+ * @param[in] buffer Save data, NULL to zero it
+ * @param[in] size size of the save data in bytes
+ * @param[in] partition_info Save partition
+ * @param[out] num_blocks Number of blocks in the chain on success
+ * @param[out] data_offset Offset in the chain of the first data byte on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR alloc_save(const PSAVE_METADATA metadata,
+                               const unsigned char* buffer,
+                               unsigned int size,
+                               const PPARTITION_INFO partition_info,
+                               unsigned int* num_blocks,
+                               unsigned int* data_offset)
+{
+    SAT_START_BLOCK_HEADER header = {0};
+    unsigned int bitmap_size = 0;
+    unsigned int blocks_needed = 0;
+    unsigned int free_blocks = 0;
+    SLINGA_ERROR result = 0;
+
+    // calculate how many blocks are needed for the save
+    result = calc_num_blocks(size, partition_info->block_size, partition_info->skip_bytes, &blocks_needed);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    result = calc_num_blocks(save_header.data_size, partition_info->block_size, partition_info->skip_bytes, &num_sat_blocks);
+    if(blocks_needed > SAT_MAX_CHAIN_BLOCKS)
+    {
+        return SLINGA_SAT_TOO_MANY_BLOCKS;
+    }
+
+    // calculate how how much of the bitmap we actually need
+    result = get_bitmap_size(partition_info, sizeof(g_SAT_bitmap), &bitmap_size);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // sanity check
-    if(num_sat_blocks > bitmap_size * 8)
+    memset(g_SAT_bitmap, 0, bitmap_size);
+
+    // record all of the busy blocks on the partition
+    result = walk_partition_bitmap(g_SAT_bitmap,
+                                   bitmap_size,
+                                   partition_info);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_SAT_SAVE_OUT_OF_RANGE;
+        return result;
     }
 
-    result = convert_address_to_block_index(save_start, partition_info, start_block);
+    // flip the bitmap so free blocks are set to 1
+    result = invert_bitmap(g_SAT_bitmap, bitmap_size);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // add the start block to our bitmap
-    result = set_bitmap(*start_block, bitmap, bitmap_size);
+    // count the free blocks
+    result = count_bitmap(g_SAT_bitmap, bitmap_size, &free_blocks);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    //
-    // set bits in the bitmap
-    // read the next bit in the bitmap
-    // if it's 1
-    // - check if it has sat entries
-    // - if it does, add them the bitmap
-    // - if it doesn't, we are done
-    //
+    // make sure we have enough free blocks
+    if(free_blocks < blocks_needed)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
 
-    //
-    // special cases
-    //
-    //- 1st entry start_block
-    // - skip past metadata
-    // first data entry - first_data
-    // - skip past block entries and 0x00 00 terminator then start reading data
-    // last block
-    // - not necessarily full
-    written_sat_entries = 1;
-    cur_sat_block = *start_block;
-
-    // loop through the blocks while we read the SAT table
-    // this is tricky because we are writing to the satBlocks array while parsing it
-    do
+    result = alloc_chain(g_SAT_bitmap, bitmap_size, blocks_needed, g_SAT_Chain_Scratch);
+    if(result != SLINGA_SUCCESS)
     {
-        // we calculated we have num_sat_blocks
-        // sanity check we aren't beyound that
-        if(written_sat_entries > num_sat_blocks)
-        {
-            return SLINGA_SAT_TOO_MANY_BLOCKS;
-        }
+        return result;
+    }
 
-        // read SAT table entries from this block
-        result = read_sat_table_from_block(cur_sat_block, bitmap, bitmap_size, partition_info, *start_block, start_data_block, &written_sat_entries);
-        if(result == SLINGA_SUCCESS && result != SLINGA_MORE_DATA_AVAILABLE)
-        {
-            return result;
-        }
+    result = metadata_to_header(metadata, &header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+    header.data_size = size;
 
-        result = get_next_block_bitmap(cur_sat_block, bitmap, bitmap_size, &cur_sat_block);
-        if(result == SLINGA_NOT_FOUND)
-        {
-            // no more bits set
-            break;
-        }
-        else if(result != SLINGA_SUCCESS)
-        {
-            // error
-            return result;
-        }
+    // header, block indexes array and data
+    result = write_blocks(partition_info,
+                          &header,
+                          g_SAT_Chain_Scratch,
+                          blocks_needed,
+                          buffer,
+                          size,
+                          data_offset);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
 
-    }while(1);
+    *num_blocks = blocks_needed;
+
+    return SLINGA_SUCCESS;
+}
 
-    unsigned int bitmap_count = 0;
+/**
+ * @brief Pick the blocks for a new save
+ *
+ * @param[in] bitmap Bitmap of free blocks
+ * @param[in] bitmap_size Size of bitmap in bytes
+ * @param[in] num_blocks Number of blocks the save needs
+ * @param[out] blocks On success, the lowest num_blocks free blocks in ascending order
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR alloc_chain(const unsigned char* bitmap,
+                                unsigned int bitmap_size,
+                                unsigned int num_blocks,
+                                unsigned short* blocks)
+{
+    unsigned int count = 0;
 
-    result = count_bitmap(bitmap, bitmap_size, &bitmap_count);
-    if(result != SLINGA_SUCCESS)
+    if(!bitmap || !bitmap_size || !num_blocks || !blocks)
     {
-        return result;;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    if(bitmap_count != num_sat_blocks)
+    for(unsigned int i = 0; i < bitmap_size * 8 && count < num_blocks; i++)
     {
-        return SLINGA_SAT_INVALID_PARTITION;
+        if(bitmap[i / 8] & (1 << (i % 8)))
+        {
+            blocks[count] = (unsigned short)i;
+            count++;
+        }
+    }
+
+    if(count != num_blocks)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
     }
-    // success
+
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Read the save from the specified sat_table
+ * @brief Write a whole save, header, SAT table and data, following its chain.
+ * Each block is assembled in g_SAT_Write_Block and written to the partition
+ * once, in chain order
  *
- * @param[out] buffer Save data read into buffer on success
- * @param[in] size Size of buffer in bytes
- * @param[out] bytes_read Number of bytes read on success
- * @param[in] start_block First block of the save on success
- * @param[in] start_data_block First block containing save data (as opposed to just metadata). Can be same or different than start_block
- * @param[in] bitmap On success the bitmap bits will be set to 1 for each block that is part of the save
- * @param[in] bitmap_size Size of bitmap in bytes *
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[in] partition_info Save partition
+ * @param[in] header Save header in host byte order. data_size is the size of the data area
+ * @param[in] blocks Chain of the save, starting with the block holding the header
+ * @param[in] num_blocks Number of blocks in the chain
+ * @param[in] buffer Save data, NULL to zero the data area
+ * @param[in] size Bytes of buffer to write. The rest of the data area is zeroed
+ * @param[out] data_offset Optional, offset in the chain of the first data byte on success
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR read_save_from_sat_table(unsigned char* buffer,
-                                             unsigned int size,
-                                             unsigned int* bytes_read,
-                                             unsigned int start_block,
-                                             unsigned int start_data_block,
-                                             const unsigned char* bitmap,
-                                             unsigned int bitmap_size,
-                                             const PPARTITION_INFO partition_info)
+static SLINGA_ERROR write_blocks(const PPARTITION_INFO partition_info,
+                                 const PSAT_START_BLOCK_HEADER header,
+                                 const unsigned short* blocks,
+                                 unsigned int num_blocks,
+                                 const unsigned char* buffer,
+                                 unsigned int size,
+                                 unsigned int* data_offset)
 {
-
-    unsigned int cur_sat_block = 0;
-    unsigned char* block = NULL;
-    unsigned int bytes_written = 0;
-    unsigned int block_data_size = 0;
-    unsigned int bytes_to_copy = 0;
+    SAT_START_BLOCK_HEADER stored = {0};
+    unsigned char* payload = g_SAT_Write_Block + SAT_TAG_SIZE;
+    unsigned int header_size = sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE;
+    unsigned int usable_size = 0;
+    unsigned int table_end = 0;
     SLINGA_ERROR result = 0;
 
-    if(!buffer || !size || !start_block || !start_data_block || !bitmap || !bitmap_size || !partition_info)
+    if(!partition_info || !header || !blocks || !num_blocks)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    if(partition_info->skip_bytes == 0)
+    result = get_usable_block_size(partition_info, &usable_size);
+    if(result != SLINGA_SUCCESS)
     {
-        // all bytes are valid, just subtract off the tag size
-        block_data_size = partition_info->block_size - SAT_TAG_SIZE;
+        return result;
     }
-    else if(partition_info->skip_bytes == 1)
+
+    if(usable_size + SAT_TAG_SIZE > sizeof(g_SAT_Write_Block))
     {
-        // every other byte is valid
-        block_data_size = (partition_info->block_size/2) - SAT_TAG_SIZE;
+        return SLINGA_INVALID_PARAMETER;
     }
-    else
+
+    // the table lists every block but the first, then the 0x0000 terminator
+    table_end = header_size + (num_blocks * sizeof(unsigned short));
+
+    if(size > header->data_size || table_end + header->data_size > num_blocks * usable_size)
     {
-        // invalid skip_bytes value
-        return SLINGA_INVALID_PARAMETER;
+        return SLINGA_SAT_INVALID_SIZE;
     }
 
-    // we want to start reading at the first block that has save data
-    cur_sat_block = start_data_block;
+    stored = *header;
+    header_to_partition(&stored);
 
-    // loop throught the bitmap until we are out of blocks
-    while(1)
+    for(unsigned int i = 0; i < num_blocks; i++)
     {
-        result = convert_block_index_to_address(cur_sat_block, partition_info, &block);
+        unsigned int block_start = i * usable_size;
+        unsigned int first_entry = 0;
+        unsigned char* block = NULL;
+
+        result = convert_block_index_to_address(blocks[i], partition_info, &block);
         if(result != SLINGA_SUCCESS)
         {
             return result;
         }
 
-        // validate we are still in range
-        if(block < partition_info->partition_buf || block >= partition_info->partition_buf + partition_info->partition_size)
+        // the start block carries the start tag, continuation tags are 0x00000000
+        if(i == 0)
         {
-            return SLINGA_SAT_INVALID_PARTITION;
+            memcpy(g_SAT_Write_Block, &stored.tag, SAT_TAG_SIZE);
         }
+        else
+        {
+            memset(g_SAT_Write_Block, 0, SAT_TAG_SIZE);
+        }
+
+        memset(payload, 0, usable_size);
 
-        // no flags means we are just a data block (no metadata, no SAT entries)
-        if(cur_sat_block != start_block && cur_sat_block != start_data_block)
+        copy_region(payload, block_start, usable_size, 0, (const unsigned char*)&stored + SAT_TAG_SIZE, header_size);
+
+        // entries are 2-byte aligned and so are blocks, an entry never straddles two blocks
+        first_entry = (block_start > header_size) ? (block_start - header_size) / sizeof(unsigned short) : 0;
+
+        for(unsigned int j = first_entry + 1; j < num_blocks; j++)
         {
-            // check if we are the very last block and we aren't full
-            if(size - bytes_written < block_data_size)
-            {
-                // last block isn't full, copy less data
-                bytes_to_copy = size - bytes_written;
-            }
-            else
+            unsigned int entry_offset = header_size + ((j - 1) * sizeof(unsigned short));
+
+            if(entry_offset >= block_start + usable_size)
             {
-                bytes_to_copy = block_data_size;
+                break;
             }
 
-            // copy the save bytes
-            result = read_from_partition(buffer + bytes_written, block, SAT_TAG_SIZE, bytes_to_copy, partition_info->skip_bytes);
-            if(result != SLINGA_SUCCESS)
+            if(entry_offset >= block_start)
             {
-                return result;
+                write_be16(payload + (entry_offset - block_start), blocks[j]);
             }
-            bytes_written += bytes_to_copy;
         }
 
-        // SAT table end means this block contains the last of the SAT blocks. It is possible there is save data here
-        else if(cur_sat_block == start_data_block)
+        if(buffer)
         {
-            unsigned int offset = 0;
+            copy_region(payload, block_start, usable_size, table_end, buffer, size);
+        }
 
-            // end of the SAT array, data can follow
-            bytes_to_copy = block_data_size;
+        result = write_to_partition(block, 0, g_SAT_Write_Block, SAT_TAG_SIZE + usable_size, partition_info->skip_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
 
-            // is this the start block?
-            if(cur_sat_block == start_block)
-            {
-                // skip over the header data
-                offset += sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE;
-            }
+    if(data_offset)
+    {
+        *data_offset = table_end;
+    }
 
-            // This is a SAT table block, parse until the 0x0000 and then start reading save bytes
-            // skip over all SAT entries including the terminating 0x0000
-            for(unsigned int i = offset; i < block_data_size; i += sizeof(unsigned short))
-            {
-                unsigned short index = 0;
+    return SLINGA_SUCCESS;
+}
 
-                result = read_from_partition((unsigned char*)&index, block, i + SAT_TAG_SIZE, sizeof(unsigned short), partition_info->skip_bytes);
-                if(result != SLINGA_SUCCESS)
-                {
-                    return result;
-                }
+/**
+ * @brief Copy the part of a region of the chain that falls in one block
+ *
+ * @param[out] dst Valid bytes of the block after the tag
+ * @param[in] dst_start Offset in the chain of dst
+ * @param[in] dst_size Size of dst in bytes
+ * @param[in] region_start Offset in the chain of src
+ * @param[in] src Bytes of the region
+ * @param[in] src_size Size of src in bytes
+ */
+static void copy_region(unsigned char* dst, unsigned int dst_start, unsigned int dst_size, unsigned int region_start, const unsigned char* src, unsigned int src_size)
+{
+    unsigned int start = (dst_start > region_start) ? dst_start : region_start;
+    unsigned int end = LIBSLINGA_MIN(dst_start + dst_size, region_start + src_size);
 
-                if(index == 0)
-                {
-                    // found the 0s
-                    offset = i + sizeof(unsigned short);
-                    break;
-                }
-            }
+    if(start < end)
+    {
+        memcpy(dst + (start - dst_start), src + (start - region_start), end - start);
+    }
+}
+
+//
+// SAT Bitmap
+//
+
+/**
+ * @brief Give a partition size and block size, compute how big of a bitmap is required
+ *
+ * @param[in] partition_size Size in bytes of the save partition
+ * @param[in] block_size How big the blocks are on the partition
+ * @param[in] max_bitmap_size Maximum size of bitmap. Errors if computed bitmap_size is too big
+ * @param[out] bitmap_size On success, size in bytes of the bitmap
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR get_bitmap_size(const PPARTITION_INFO partition_info, unsigned int max_bitmap_size, unsigned int* bitmap_size)
+{
+    if(!partition_info || !max_bitmap_size || !bitmap_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if((partition_info->block_size % 8) != 0)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if((partition_info->partition_size % partition_info->block_size) != 0)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
 
-            // handle edge case of end 0x0000 being last block
-            if(offset == block_data_size)
-            {
+    *bitmap_size = (partition_info->partition_size / partition_info->block_size) / 8;
 
-                 // TODO: add additional safety checks
-                result = get_next_block_bitmap(cur_sat_block, bitmap, bitmap_size, &cur_sat_block);
-                if(result == SLINGA_NOT_FOUND)
-                {
-                    // there are no more bits in the bitmap to check
-                    break;
-                }
+    return SLINGA_SUCCESS;
+}
 
-                result = convert_block_index_to_address(cur_sat_block, partition_info, &block);
-                if(result != SLINGA_SUCCESS)
-                {
-                    return result;
-                }
+/**
+ * @brief Sets the bit corresponding to block_index in the bitmap
+ *
+ * @param[in] block_index Block index
+ * @param[in] bitmap Bitmap representing SAT blocks
+ * @param[in] bitmap_size Size in bytes of the bitmap
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR set_bitmap(unsigned int block_index, unsigned char* bitmap, unsigned int bitmap_size)
+{
+    int byte_index = 0;
+    int bit_index = 0;
 
-                offset = 0;
-            }
+    if(!bitmap || !bitmap_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
 
-            bytes_to_copy -= offset;
+    if(block_index/8 >= bitmap_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
 
-            // check if we are the last very last block and we aren't full
-            if(size - bytes_written < block_data_size - offset)
-            {
-                // last block isn't full, copy less data
-                bytes_to_copy = size - bytes_written;
-            }
+    byte_index = block_index / 8;
+    bit_index = block_index % 8;
 
-            // at maximum we can only copy blockDataSize at once
-            if(bytes_to_copy > block_data_size)
-            {
-                return SLINGA_SAT_INVALID_SIZE;
-            }
+    // set a single bit in the bitmap
+    bitmap[byte_index] = bitmap[byte_index] | 1 << bit_index;
 
-            // another sanity check
-            if(bytes_written + bytes_to_copy > size)
-            {
-                return SLINGA_SAT_INVALID_SIZE;
-            }
+    return SLINGA_SUCCESS;
+}
 
-            result = read_from_partition(buffer + bytes_written, block, offset + SAT_TAG_SIZE, bytes_to_copy, partition_info->skip_bytes);
-            if(result != SLINGA_SUCCESS)
-            {
-                return result;
-            }
-            bytes_written += bytes_to_copy;
-        }
+/**
+ * @brief Counts the number of set bits in the bitmap
+ *
+ * @param[in] bitmap Bitmap representing SAT blocks
+ * @param[in] bitmap_size Size in bytes of the bitmap
+ * @param[out] total On success, number of bits set to 1 in the bitmap
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR count_bitmap(const unsigned char* bitmap, unsigned int bitmap_size, unsigned int* total)
+{
+    unsigned int count = 0;
 
-        // TODO: add additional safety checks
-        result = get_next_block_bitmap(cur_sat_block, bitmap, bitmap_size, &cur_sat_block);
-        if(result == SLINGA_NOT_FOUND)
-        {
-            // there are no more bits in the bitmap to check
-            break;
-        }
-        else if(result != SLINGA_SUCCESS)
-        {
-            // error
-            return result;
-        }
-    }
+    const uint8_t NIBBLE_LOOKUP_TABLE[16] =
+    {
+        0, 1, 1, 2, 1, 2, 2, 3,
+        1, 2, 2, 3, 2, 3, 3, 4
+    };
 
-    if(bytes_read)
+    if(!bitmap || !bitmap_size)
     {
-        *bytes_read = bytes_written;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    if(bytes_written == size)
+    for(unsigned int i = 0; i < bitmap_size; i++)
     {
-        return SLINGA_SUCCESS;
+        unsigned char byte = bitmap[i];
+        count += NIBBLE_LOOKUP_TABLE[byte & 0x0F] + NIBBLE_LOOKUP_TABLE[byte >> 4];
     }
 
-    return SLINGA_SAT_INVALID_READ_SIZE;
+    *total = count;
+
+    return SLINGA_SUCCESS;
 }
 
+
 /**
- * @brief Read the SAT table from specified block
+ * @brief Flips all 0s to 1s and 1s to 0s in the bitmap
  *
- * @param[in] block_index Specified block to read the SAT table from
- * @param[out] bitmap On success the bitmap bits will be set to 1 for each block referenced in this block
- * @param[in] bitmap_size Size of bitmap in bytes
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[in] start_block First block of the save
- * @param[out] start_data_block First block containing save data (as opposed to just metadata). Can be same or different than start_block. Set if found
- * @param[out] written_sat_entries Count of entries written into bitmap. Used to sanity check.
+ * @param[in] bitmap Bitmap representing SAT blocks
+ * @param[in] bitmap_size Size in bytes of the bitmap
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR read_sat_table_from_block(unsigned int block_index,
-                                            unsigned char* bitmap,
-                                            unsigned int bitmap_size,
-                                            const PPARTITION_INFO partition_info,
-                                            unsigned int start_block,
-                                            unsigned int* start_data_block,
-                                            unsigned int* written_sat_entries)
-{
-    unsigned int start_byte = 0;
-    SAT_START_BLOCK_HEADER save_start = {0};
-    unsigned char* save_start_block = NULL;
-    SLINGA_ERROR result = 0;
-    unsigned int adjusted_block_size = 0;
-
-    if(!block_index || !bitmap || !bitmap_size || !partition_info || !start_block || !start_data_block || !written_sat_entries)
+static SLINGA_ERROR invert_bitmap(unsigned char* bitmap, unsigned int bitmap_size)
+{
+    if(!bitmap || !bitmap_size)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    // block size must be 64-byte aligned
-    if((partition_info->block_size % MIN_BLOCK_SIZE) != 0)
+    for(unsigned int i = 0; i < bitmap_size; i++)
     {
-        return SLINGA_INVALID_PARAMETER;
+        bitmap[i] = ~bitmap[i];
     }
 
-    if((partition_info->partition_size % partition_info->block_size) != 0)
+    return SLINGA_SUCCESS;
+}
+
+//
+// Save chain cache
+//
+
+/**
+ * @brief Get the chain of a save, from the chain cache if possible
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] save_start Pointer to the start of a save on the partition
+ * @param[out] blocks On success, the chain. Only valid until the next call
+ * @param[out] num_blocks Number of blocks in the chain on success
+ * @param[out] data_offset Offset of the first data byte in the chain on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR get_save_chain(const PPARTITION_INFO partition_info,
+                                   const unsigned char* save_start,
+                                   const unsigned short** blocks,
+                                   unsigned int* num_blocks,
+                                   unsigned int* data_offset)
+{
+    SAT_START_BLOCK_HEADER header = {0};
+    unsigned int block_index = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!partition_info || !save_start || !blocks || !num_blocks || !data_offset)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    result = convert_block_index_to_address(block_index, partition_info, &save_start_block);
+    result = convert_address_to_block_index(save_start, partition_info, &block_index);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // validate we are still in range
-    if(save_start_block < partition_info->partition_buf || save_start_block >= partition_info->partition_buf + partition_info->partition_size)
-    {
-        return SLINGA_SAT_INVALID_PARTITION;
-    }
-
-    // copy the data locally to avoid having to deal with skip_bytes
-    result = read_from_partition((unsigned char*)&save_start, save_start_block, 0, sizeof(SAT_START_BLOCK_HEADER), partition_info->skip_bytes);
+    // the header is all that has to be read to know if the cached chain is still good
+    result = read_header(save_start, &header, partition_info->skip_bytes);
     if(result != SLINGA_SUCCESS)
     {
         return result;
     }
 
-    // first entry
-    if(block_index == start_block)
+    for(unsigned int i = 0; i < SAT_CHAIN_CACHE_ENTRIES; i++)
     {
-        // first block must have the start tag
-        if(save_start.tag != SAT_START_BLOCK_TAG)
+        PSAT_CHAIN chain = &g_SAT_Chains[i];
+
+        if(chain->partition_buf != partition_info->partition_buf || chain->start_block != block_index)
         {
-            return SLINGA_SAT_INVALID_TAG;
+            continue;
         }
 
-        // where the block's data starts
-        // first block has the PSAT_START_BLOCK_HEADER
-        start_byte = sizeof(SAT_START_BLOCK_HEADER);
-    }
-    else
-    {
-        // other blocks must not have the continuation tag
-        if(save_start.tag != SAT_CONTINUE_BLOCK_TAG)
+        // the BIOS can rewrite a save into other blocks with the same header
+        if(memcmp(&chain->header, &header, sizeof(SAT_START_BLOCK_HEADER)) != 0 ||
+           check_save_chain(partition_info, save_start, &g_SAT_Chain_Blocks[chain->first], chain->num_blocks) != SLINGA_SUCCESS)
         {
-            return SLINGA_SAT_INVALID_TAG;
+            // the save was replaced behind our back
+            chain->partition_buf = NULL;
+            break;
         }
 
-        // where the block's data starts
-        // continuation block's only have a 4-byte tag field
-        start_byte = SAT_TAG_SIZE;
-    }
+        *blocks = &g_SAT_Chain_Blocks[chain->first];
+        *num_blocks = chain->num_blocks;
+        *data_offset = chain->data_offset;
 
-    // loop through the block, recording SAT table entries until you find the
-    // 0x0000 terminator or reach the end of the block
+        return SLINGA_SUCCESS;
+    }
 
-    if(partition_info->skip_bytes == 1)
+    // not cached, parse the SAT table
+    result = read_chain(partition_info,
+                        save_start,
+                        g_SAT_Chain_Scratch,
+                        SAT_MAX_CHAIN_BLOCKS,
+                        NULL,
+                        0,
+                        num_blocks,
+                        data_offset);
+    if(result != SLINGA_SUCCESS)
     {
-        // every other byte is valid
-        adjusted_block_size = partition_info->block_size/2;
+        return result;
     }
-    else
+
+    // failing to cache isn't an error
+    add_save_chain(partition_info, &header, g_SAT_Chain_Scratch, *num_blocks, *data_offset);
+
+    *blocks = g_SAT_Chain_Scratch;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Compare a remembered chain against the SAT table entries in the start block
+ *
+ * Only the start block is read, the rest of the table lives in the blocks
+ * it lists.
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] save_start Pointer to the start of the save on the partition
+ * @param[in] blocks Cached or reserved chain of the save
+ * @param[in] num_blocks Number of blocks in the chain
+ *
+ * @return SLINGA_SUCCESS if the entries match, SLINGA_SAT_INVALID_PARTITION if they don't
+ */
+static SLINGA_ERROR check_save_chain(const PPARTITION_INFO partition_info,
+                                     const unsigned char* save_start,
+                                     const unsigned short* blocks,
+                                     unsigned int num_blocks)
+{
+    unsigned char entries[SAT_READ_ENTRIES * sizeof(unsigned short)] = {0};
+    unsigned int usable_size = 0;
+    unsigned int offset = 0;
+    unsigned int index = 1;
+    SLINGA_ERROR result = 0;
+
+    result = get_usable_block_size(partition_info, &usable_size);
+    if(result != SLINGA_SUCCESS)
     {
-        adjusted_block_size = partition_info->block_size;
+        return result;
     }
 
-    // look throught the block recording all the block indexes
-    // we terminate if:
-    // - we reach the end of the block
-    // - we encounter a 0x0000
-    for(; start_byte < adjusted_block_size; start_byte += sizeof(unsigned short))
+    // the table starts right after the header
+    offset = sizeof(SAT_START_BLOCK_HEADER) - SAT_TAG_SIZE;
+
+    while(offset + sizeof(unsigned short) <= usable_size)
     {
-        unsigned short index = 0;
+        unsigned int num_entries = LIBSLINGA_MIN((usable_size - offset) / sizeof(unsigned short), SAT_READ_ENTRIES);
 
-        // copy the data locally to avoid having to deal with skip_bytes
-        result = read_from_partition((unsigned char*)&index, save_start_block, start_byte, sizeof(unsigned short), partition_info->skip_bytes);
+        result = read_from_partition(entries, save_start, SAT_TAG_SIZE + offset, num_entries * sizeof(unsigned short), partition_info->skip_bytes);
         if(result != SLINGA_SUCCESS)
         {
             return result;
         }
 
-        if(index == 0)
+        for(unsigned int i = 0; i < num_entries; i++)
         {
-            // we are at the end index
-            *start_data_block = block_index;
-            return SLINGA_SUCCESS;
-        }
+            unsigned short entry = read_be16(&entries[i * sizeof(unsigned short)]);
 
-        if(index <= block_index)
-        {
-            // I'm relying on the fact that these saves block are in order!
-            // otherwise the bitmap technique will not work
-            return SLINGA_SAT_BLOCKS_OUT_OF_ORDER;
-        }
+            // past the last block the table must be terminated
+            if(entry != (index < num_blocks ? blocks[index] : 0))
+            {
+                return SLINGA_SAT_INVALID_PARTITION;
+            }
 
-        // found a table entry, record it
-        result = set_bitmap(index, bitmap, bitmap_size);
-        if(result != SLINGA_SUCCESS)
-        {
-            return result;
+            if(entry == 0)
+            {
+                return SLINGA_SUCCESS;
+            }
+
+            index++;
         }
 
-        *written_sat_entries += 1;
+        offset += num_entries * sizeof(unsigned short);
     }
 
-    // didn't find end val, continue checking
-    return SLINGA_MORE_DATA_AVAILABLE;
+    return SLINGA_SUCCESS;
 }
 
-//
-// Write saves
-//
-
 /**
- * @brief Write the SAT_START_BLOCK_HEADER for the specified save
+ * @brief Remember the chain of a save that was just parsed
  *
- * @param[in] save_start_block Index corresponding to the first block of the save
- * @param[in] filename Save name
- * @param[in] size Size in bytes of the save data
- * @param[in] metadata Save metadata
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
+ * @param[in] partition_info Save partition
+ * @param[in] header Header of the save
+ * @param[in] blocks Chain of the save
+ * @param[in] num_blocks Number of blocks in the chain
+ * @param[in] data_offset Offset of the first data byte in the chain
  *
- * @return SLINGA_SUCCESS on success
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if the chain is too long to cache
  */
-static SLINGA_ERROR write_header(unsigned int save_start_block,
-                                 const char* filename,
-                                 unsigned int size,
-                                 const PSAVE_METADATA metadata,
-                                 const PPARTITION_INFO partition_info)
+static SLINGA_ERROR add_save_chain(const PPARTITION_INFO partition_info,
+                                   const PSAT_START_BLOCK_HEADER header,
+                                   const unsigned short* blocks,
+                                   unsigned int num_blocks,
+                                   unsigned int data_offset)
 {
-    SAT_START_BLOCK_HEADER header = {0};
-    unsigned char* save_start = NULL;
-    SLINGA_ERROR result = 0;
+    PSAT_CHAIN chain = NULL;
 
-    if(!filename || !size || !metadata)
+    if(!num_blocks || num_blocks > SAT_CHAIN_POOL_BLOCKS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return SLINGA_BUFFER_TOO_SMALL;
     }
 
-    if(!partition_info)
+    if(g_SAT_Chain_Blocks_Used + num_blocks > SAT_CHAIN_POOL_BLOCKS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        // out of room, start over
+        memset(g_SAT_Chains, 0, sizeof(g_SAT_Chains));
+        g_SAT_Chain_Blocks_Used = 0;
+        g_SAT_Chain_Next = 0;
     }
 
-    // set up the save header
-    result = metadata_to_header(metadata, &header);
-    if(result != SLINGA_SUCCESS)
-    {
-        return result;
-    }
-    header.data_size = size;
+    chain = &g_SAT_Chains[g_SAT_Chain_Next];
+    g_SAT_Chain_Next = (g_SAT_Chain_Next + 1) % SAT_CHAIN_CACHE_ENTRIES;
 
-    // convert the block index to an address
-    result = convert_block_index_to_address(save_start_block,
-                                            partition_info,
-                                            &save_start);
-    if(result != SLINGA_SUCCESS)
-    {
-        return result;
-    }
+    chain->partition_buf = partition_info->partition_buf;
+    chain->start_block = blocks[0];
+    chain->data_offset = data_offset;
+    memcpy(&chain->header, header, sizeof(SAT_START_BLOCK_HEADER));
+    chain->first = (unsigned short)g_SAT_Chain_Blocks_Used;
+    chain->num_blocks = (unsigned short)num_blocks;
 
-    // write the header
-    result = write_to_partition(save_start, 0, (const unsigned char*)&header, sizeof(header), partition_info->skip_bytes);
-    if(result != SLINGA_SUCCESS)
-    {
-        return result;
-    }
+    memcpy(&g_SAT_Chain_Blocks[g_SAT_Chain_Blocks_Used], blocks, num_blocks * sizeof(unsigned short));
+    g_SAT_Chain_Blocks_Used += num_blocks;
 
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Write the variable array of block indexes after the SAT_START_BLOCK_HEADER for the specified save
+ * @brief Forget the chain of a save before it is overwritten or deleted
  *
- * @param[in] save_start_block Index corresponding to the first block of the save
- * @param[in] num_blocks number of blocks for the save
- * @param[in] bitmap Bitmap of free blocks that will be used by this save
- * @param[in] bitmap_size Size of bitmap in bytes
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
- * @param[out] save_data_start_block On success, the index of the 1st block with save data (after header and block index array)
- * @param[out] save_data_start_offset On success, the byte offset within save_data_start_block of the first byte of data
- * @return SLINGA_SUCCESS on success
+ * @param[in] partition_info Save partition
+ * @param[in] save_start Pointer to the start of the save. NULL to forget every save on the partition
  */
-static SLINGA_ERROR write_block_indexes(unsigned int save_start_block,
-                                        unsigned int num_blocks,
-                                        const unsigned char* bitmap,
-                                        unsigned int bitmap_size,
-                                        const PPARTITION_INFO partition_info,
-                                        unsigned int* save_data_start_block,
-                                        unsigned int* save_data_start_offset)
-{
-    unsigned int cur_block_index = 0;
-    unsigned int highest_index_written = 0;
-    unsigned int indexes_written = 0;
-    unsigned char* cur_block_address = NULL;
-    unsigned int offset = 0;
-    unsigned int adjusted_block_size = 0;
-    SLINGA_ERROR result = 0;
+static void drop_save_chain(const PPARTITION_INFO partition_info, const unsigned char* save_start)
+{
+    unsigned int block_index = 0;
 
-    if(!bitmap || !bitmap_size)
+    if(save_start && convert_address_to_block_index(save_start, partition_info, &block_index) != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return;
     }
 
-    if(!partition_info)
+    for(unsigned int i = 0; i < SAT_CHAIN_CACHE_ENTRIES; i++)
     {
-        return SLINGA_INVALID_PARAMETER;
+        if(g_SAT_Chains[i].partition_buf == partition_info->partition_buf && (!save_start || g_SAT_Chains[i].start_block == block_index))
+        {
+            g_SAT_Chains[i].partition_buf = NULL;
+        }
     }
+}
 
-    if(!save_data_start_block || !save_data_start_offset)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+//
+// Reservations
+//
+
+/**
+ * @brief Write a save into the blocks reserved for it by sat_reserve()
+ *
+ * The blocks stay reserved, so every write of up to max_size bytes takes
+ * this path until the save is deleted or changed behind our back.
+ *
+ * @param[in] flags OVERWRITE_EXISTING_SAVE to replace what an earlier write stored
+ * @param[in] filename Save to write
+ * @param[in] metadata Metadata (comment, date, etc) to write with the save
+ * @param[in] buffer Save data
+ * @param[in] size size of the save data in bytes
+ * @param[in] partition_info Save partition
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if the save has to be written the normal way
+ */
+static SLINGA_ERROR write_reserved(FLAGS flags,
+                                   const char* filename,
+                                   const PSAVE_METADATA metadata,
+                                   const unsigned char* buffer,
+                                   unsigned int size,
+                                   const PPARTITION_INFO partition_info)
+{
+    SAT_START_BLOCK_HEADER header = {0};
+    PSAT_RESERVATION reservation = NULL;
+    const unsigned short* blocks = NULL;
+    unsigned char* save_start = NULL;
+    SLINGA_ERROR result = 0;
 
-    // minimum save size is one block
-    if(!num_blocks)
+    reservation = find_reservation(partition_info, filename);
+    if(!reservation)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return SLINGA_NOT_FOUND;
     }
 
-    if(partition_info->skip_bytes == 1)
+    blocks = &g_SAT_Reserved_Blocks[reservation->first];
+
+    result = convert_block_index_to_address(blocks[0], partition_info, &save_start);
+    if(result != SLINGA_SUCCESS)
     {
-        // if skip_bytes, only have the block size is valid
-        adjusted_block_size = partition_info->block_size / 2;
+        return result;
     }
-    else
+
+    result = read_header(save_start, &header, partition_info->skip_bytes);
+    if(result != SLINGA_SUCCESS)
     {
-        adjusted_block_size = partition_info->block_size;
+        return result;
     }
 
-    cur_block_index = save_start_block;
-    highest_index_written = save_start_block;
-    offset = sizeof(SAT_START_BLOCK_HEADER); // in case only one block
-
-    while(indexes_written < num_blocks)
+    // the BIOS can rewrite the save into other blocks with the same header
+    if(header.tag != SAT_START_BLOCK_TAG ||
+       strncmp(filename, header.savename, SAT_MAX_SAVE_NAME) != 0 ||
+       header.data_size > reservation->max_size ||
+       check_save_chain(partition_info, save_start, blocks, reservation->num_blocks) != SLINGA_SUCCESS)
     {
-        offset = 0;
-
-        result = convert_block_index_to_address(cur_block_index, partition_info, &cur_block_address);
-        if(result != SLINGA_SUCCESS)
-        {
-            return result;
-        }
-
-        if(cur_block_index == save_start_block)
-        {
-            // first block: start after the header
-            offset = sizeof(SAT_START_BLOCK_HEADER);
-        }
-        else
-        {
-            // not the start block, start after the tag
-            offset = SAT_TAG_SIZE;
+        // the save changed behind our back
+        release_reservation(partition_info, filename);
+        return SLINGA_NOT_FOUND;
+    }
 
-            // continuation tags are 0x00000000
-            result = memset_partition(cur_block_address, 0, 0, SAT_TAG_SIZE, partition_info->skip_bytes);
-            if(result != SLINGA_SUCCESS)
-            {
-                return result;
-            }
-        }
+    if(reservation->written && (flags & OVERWRITE_EXISTING_SAVE) == 0)
+    {
+        // same as any other save that already exists
+        return SLINGA_FILE_EXISTS;
+    }
 
-        for(; offset < adjusted_block_size; offset += sizeof(unsigned short))
-        {
-            unsigned short index = 0;
-            unsigned int next_sat_block = 0;
+    if(size > reservation->max_size)
+    {
+        // the data outgrew the reservation
+        release_reservation(partition_info, filename);
+        return SLINGA_NOT_FOUND;
+    }
 
-            indexes_written++;
+    result = metadata_to_header(metadata, &header);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+    header.data_size = size;
 
-            if(indexes_written == num_blocks)
-            {
-                // this is the last block, write 0x0000 as the terminating index
-                index = 0;
-            }
-            else
-            {
-                // not the last block
-                // get the index of the next block to write
-                result = get_next_block_bitmap(highest_index_written, bitmap, bitmap_size, &next_sat_block);
-                if(result != SLINGA_SUCCESS)
-                {
-                    return result;
-                }
+    // same blocks, but the header is rewritten
+    drop_save_chain(partition_info, save_start);
 
-                index = (unsigned short)(next_sat_block);
-                highest_index_written = index;
-            }
+    // what's left of the previous data is zeroed
+    result = write_blocks(partition_info,
+                          &header,
+                          blocks,
+                          reservation->num_blocks,
+                          buffer,
+                          size,
+                          NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
 
-            // we have the index, write it
-            result = write_to_partition(cur_block_address, offset, (unsigned char*)&index, sizeof(unsigned short), partition_info->skip_bytes);
-            if(result != SLINGA_SUCCESS)
-            {
-                return result;
-            }
+    reservation->written = 1;
 
-            // check if we have more blocks to write
-            if(indexes_written >= num_blocks)
-            {
-                // TODO: increment offset here
-                offset += sizeof(unsigned short);
-                break;
-            }
-        }
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Check there is room to remember another reservation
+ *
+ * @param[in] num_blocks Blocks in the chain of the save to reserve
+ *
+ * @return SLINGA_SUCCESS if add_reservation() won't run out of room
+ */
+static SLINGA_ERROR can_reserve(unsigned int num_blocks)
+{
+    if(num_blocks > SAT_RESERVED_POOL_BLOCKS - g_SAT_Reserved_Blocks_Used)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
 
-        // check if we have more blocks to write
-        if(indexes_written < num_blocks)
+    for(unsigned int i = 0; i < SAT_MAX_RESERVATIONS; i++)
+    {
+        if(!g_SAT_Reservations[i].partition_buf)
         {
-            // get the next block to write to
-            result = get_next_block_bitmap(cur_block_index, bitmap, bitmap_size, &cur_block_index);
-            if(result != SLINGA_SUCCESS)
-            {
-                return result;
-            }
+            return SLINGA_SUCCESS;
         }
     }
 
-    // edge case of us filling up the current block in the loop
-    if(offset == adjusted_block_size)
+    return SLINGA_BUFFER_TOO_SMALL;
+}
+
+/**
+ * @brief Look up the reservation of a save
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] savename Save name, need not be NULL terminated past SAT_MAX_SAVE_NAME
+ *
+ * @return The reservation, NULL if the save isn't reserved
+ */
+static PSAT_RESERVATION find_reservation(const PPARTITION_INFO partition_info, const char* savename)
+{
+    for(unsigned int i = 0; i < SAT_MAX_RESERVATIONS; i++)
     {
-        // get the next block to write to
-        result = get_next_block_bitmap(cur_block_index, bitmap, bitmap_size, &cur_block_index);
-        if(result != SLINGA_SUCCESS)
+        if(g_SAT_Reservations[i].partition_buf == partition_info->partition_buf &&
+           strncmp(savename, g_SAT_Reservations[i].savename, SAT_MAX_SAVE_NAME) == 0)
         {
-            return result;
+            return &g_SAT_Reservations[i];
         }
-        offset = SAT_TAG_SIZE;
     }
 
-    *save_data_start_block = cur_block_index;
-    *save_data_start_offset = offset;
-
-    return SLINGA_SUCCESS;
+    return NULL;
 }
 
 /**
- * @brief Write the save data for the specified save
+ * @brief Remember the chain of a reserved save
  *
- * @param[in] save_data_start_block Index of the 1st block with save data (after header and block index array)
- * @param[in] save_data_start_offset Byte offset within save_data_start_block of the first byte of data
- * @param[in] data save data to write
- * @param[in] size size in bytes of data
- * @param[in] bitmap Bitmap of free blocks that will be used by this save
- * @param[in] bitmap_size Size of bitmap in bytes
- * @param[in] partition_buf Start of the save partition
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
-
- * @return SLINGA_SUCCESS on success
+ * @param[in] partition_info Save partition
+ * @param[in] filename Reserved save
+ * @param[in] blocks Chain of the save
+ * @param[in] num_blocks Number of blocks in the chain
+ * @param[in] data_offset Offset of the first data byte in the chain
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if there are too many reservations
  */
-static SLINGA_ERROR write_data(unsigned int save_data_start_block,
-                               unsigned int save_data_start_offset,
-                               const unsigned char* data,
-                               unsigned int size,
-                               const unsigned char* bitmap,
-                               unsigned int bitmap_size,
-                               const PPARTITION_INFO partition_info)
+static SLINGA_ERROR add_reservation(const PPARTITION_INFO partition_info,
+                                    const char* filename,
+                                    const unsigned short* blocks,
+                                    unsigned int num_blocks,
+                                    unsigned int data_offset)
 {
-    unsigned int cur_block_index = 0;
-    unsigned int bytes_written = 0;
-    unsigned char* cur_block_address = NULL;
-    unsigned int offset = 0;
-    unsigned int bytes_left = 0;
-    unsigned int adjusted_block_size = 0;
+    PSAT_RESERVATION reservation = NULL;
+    unsigned int usable_size = 0;
     SLINGA_ERROR result = 0;
 
-    // save start block
-    // current_index_block - current block that we are writing the array to
-    // current_index
-    // return current_index_block when finished so we know where to write data to
-
-    if(!bitmap || !bitmap_size)
+    result = can_reserve(num_blocks);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return result;
     }
 
-    if(!partition_info->partition_buf || !partition_info->partition_size || !partition_info->block_size)
+    result = get_usable_block_size(partition_info, &usable_size);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return result;
     }
 
-    if(!data || !size)
+    for(unsigned int i = 0; i < SAT_MAX_RESERVATIONS; i++)
     {
-        return SLINGA_INVALID_PARAMETER;
+        if(!g_SAT_Reservations[i].partition_buf)
+        {
+            reservation = &g_SAT_Reservations[i];
+            break;
+        }
     }
 
-    if(partition_info->skip_bytes == 1)
-    {
-        // if skip_bytes, only have the block size is valid
-        adjusted_block_size = partition_info->block_size / 2;
-    }
-    else
-    {
-        adjusted_block_size = partition_info->block_size;
-    }
+    reservation->partition_buf = partition_info->partition_buf;
+    memset(reservation->savename, 0, sizeof(reservation->savename));
+    strncpy(reservation->savename, filename, SAT_MAX_SAVE_NAME);
+    reservation->max_size = (num_blocks * usable_size) - data_offset;
+    reservation->written = 0;
+    reservation->data_offset = data_offset;
+    reservation->first = (unsigned short)g_SAT_Reserved_Blocks_Used;
+    reservation->num_blocks = (unsigned short)num_blocks;
 
-    cur_block_index = save_data_start_block;
+    memcpy(&g_SAT_Reserved_Blocks[g_SAT_Reserved_Blocks_Used], blocks, num_blocks * sizeof(unsigned short));
+    g_SAT_Reserved_Blocks_Used += num_blocks;
+
+    return SLINGA_SUCCESS;
+}
 
-    while(bytes_written < size)
+/**
+ * @brief Forget a reservation. The save itself is left alone
+ *
+ * @param[in] partition_info Save partition
+ * @param[in] filename Reserved save, NULL for every reservation on the partition
+ */
+static void release_reservation(const PPARTITION_INFO partition_info, const char* filename)
+{
+    for(unsigned int i = 0; i < SAT_MAX_RESERVATIONS; i++)
     {
-        unsigned int bytes_to_write = 0;
-        offset = 0;
+        PSAT_RESERVATION reservation = &g_SAT_Reservations[i];
+        unsigned int end = 0;
 
-        result = convert_block_index_to_address(cur_block_index,partition_info, &cur_block_address);
-        if(result != SLINGA_SUCCESS)
+        if(reservation->partition_buf != partition_info->partition_buf)
         {
-            return result;
+            continue;
         }
 
-        // check if we are the first data block
-        if(cur_block_index == save_data_start_block)
-        {
-            offset = save_data_start_offset;
-        }
-        else
+        if(filename && strncmp(filename, reservation->savename, SAT_MAX_SAVE_NAME) != 0)
         {
-            // not the save_data_start_block, start after the tag
-            offset = SAT_TAG_SIZE;
+            continue;
         }
 
-        bytes_left = size - bytes_written;
-        bytes_to_write = LIBSLINGA_MIN(adjusted_block_size - offset, bytes_left);
-
-        result = write_to_partition(cur_block_address, offset, data + bytes_written, bytes_to_write, partition_info->skip_bytes);
-        if(result != SLINGA_SUCCESS)
-        {
-            return result;
-        }
-        bytes_written += bytes_to_write;
+        // close the gap in the pool
+        end = reservation->first + reservation->num_blocks;
+        memmove(&g_SAT_Reserved_Blocks[reservation->first],
+                &g_SAT_Reserved_Blocks[end],
+                (g_SAT_Reserved_Blocks_Used - end) * sizeof(unsigned short));
+        g_SAT_Reserved_Blocks_Used -= reservation->num_blocks;
 
-        // check if we have more blocks to write
-        if(bytes_written <= size)
+        for(unsigned int j = 0; j < SAT_MAX_RESERVATIONS; j++)
         {
-            // get the next block to write to
-            result = get_next_block_bitmap(cur_block_index, bitmap, bitmap_size, &cur_block_index);
-            if(result != SLINGA_SUCCESS)
+            if(g_SAT_Reservations[j].partition_buf && g_SAT_Reservations[j].first > reservation->first)
             {
-                return result;
+                g_SAT_Reservations[j].first -= reservation->num_blocks;
             }
         }
-    }
 
-    return SLINGA_SUCCESS;
+        memset(reservation, 0, sizeof(SAT_RESERVATION));
+    }
 }
 
 //
-// SAT Bitmap
+// Byte order
 //
 
 /**
- * @brief Give a partition size and block size, compute how big of a bitmap is required
+ * @brief Read a save header and convert its fields to host byte order
  *
- * @param[in] partition_size Size in bytes of the save partition
- * @param[in] block_size How big the blocks are on the partition
- * @param[in] max_bitmap_size Maximum size of bitmap. Errors if computed bitmap_size is too big
- * @param[out] bitmap_size On success, size in bytes of the bitmap
+ * @param[in] save_start Start block of the save
+ * @param[out] header Header on success
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR get_bitmap_size(const PPARTITION_INFO partition_info, unsigned int max_bitmap_size, unsigned int* bitmap_size)
+static SLINGA_ERROR read_header(const unsigned char* save_start, PSAT_START_BLOCK_HEADER header, unsigned int skip_bytes)
 {
-    if(!partition_info || !max_bitmap_size || !bitmap_size)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
-
-    if((partition_info->block_size % 8) != 0)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+    SLINGA_ERROR result = 0;
 
-    if((partition_info->partition_size % partition_info->block_size) != 0)
+    result = read_from_partition((unsigned char*)header, save_start, 0, sizeof(SAT_START_BLOCK_HEADER), skip_bytes);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return result;
     }
 
-    *bitmap_size = (partition_info->partition_size / partition_info->block_size) / 8;
+    header_to_host(header);
 
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Sets the bit corresponding to block_index in the bitmap
+ * @brief Read the tag of a block in host byte order
  *
- * @param[in] block_index Block index
- * @param[in] bitmap Bitmap representing SAT blocks
- * @param[in] bitmap_size Size in bytes of the bitmap
+ * @param[in] block Block to read
+ * @param[out] tag Tag on success
+ * @param[in] skip_bytes How many bytes to skip between valid bytes. This is used by internal\cartridge only.
  *
  * @return SLINGA_SUCCESS on success
  */
-static SLINGA_ERROR set_bitmap(unsigned int block_index, unsigned char* bitmap, unsigned int bitmap_size)
+static SLINGA_ERROR read_tag(const unsigned char* block, unsigned int* tag, unsigned int skip_bytes)
 {
-    int byte_index = 0;
-    int bit_index = 0;
+    unsigned char bytes[SAT_TAG_SIZE] = {0};
+    SLINGA_ERROR result = 0;
 
-    if(!bitmap || !bitmap_size)
+    if(!tag)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    if(block_index/8 >= bitmap_size)
+    result = read_from_partition(bytes, block, 0, SAT_TAG_SIZE, skip_bytes);
+    if(result != SLINGA_SUCCESS)
     {
-        return SLINGA_INVALID_PARAMETER;
+        return result;
     }
 
-    byte_index = block_index / 8;
-    bit_index = block_index % 8;
-
-    // set a single bit in the bitmap
-    bitmap[byte_index] = bitmap[byte_index] | 1 << bit_index;
+    *tag = read_be32(bytes);
 
     return SLINGA_SUCCESS;
 }
 
 /**
- * @brief Get's the next block in the SAT bitmap. Bit must be set to 1
+ * @brief Convert the multi-byte fields of a header read from the partition to host byte order
  *
- * @param[in] block_index Block index
- * @param[in] bitmap Bitmap representing SAT blocks
- * @param[in] bitmap_size Size in bytes of the bitmap
- * @param[out] next_block_index Next block index of a block on success.
+ * @param[in,out] header Header to convert
+ */
+static void header_to_host(PSAT_START_BLOCK_HEADER header)
+{
+    header->tag = read_be32((const unsigned char*)&header->tag);
+    header->timestamp = read_be32((const unsigned char*)&header->timestamp);
+    header->data_size = read_be32((const unsigned char*)&header->data_size);
+}
+
+/**
+ * @brief Convert the multi-byte fields of a header to partition byte order before it is written
  *
- * @return SLINGA_SUCCESS on success
+ * @param[in,out] header Header to convert
  */
-static SLINGA_ERROR get_next_block_bitmap(unsigned int block_index, const unsigned char* bitmap, unsigned int bitmap_size, unsigned int* next_block_index)
+static void header_to_partition(PSAT_START_BLOCK_HEADER header)
 {
-    int byte_index = 0;
-    int bit_index = 0;
+    unsigned int tag = header->tag;
+    unsigned int timestamp = header->timestamp;
+    unsigned int data_size = header->data_size;
 
-    if(!bitmap || !bitmap_size || !next_block_index)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+    write_be32((unsigned char*)&header->tag, tag);
+    write_be32((unsigned char*)&header->timestamp, timestamp);
+    write_be32((unsigned char*)&header->data_size, data_size);
+}
 
-    for(unsigned int i = block_index + 1; i < bitmap_size * 8; i++)
-    {
-        byte_index = i / 8;
-        bit_index = i % 8;
+/**
+ * @brief Convert the multi-byte fields of a snapshot header to host byte order after it is read
+ *
+ * @param[in,out] header Header to convert
+ */
+static void snapshot_header_to_host(PSAT_SNAPSHOT_HEADER header)
+{
+    header->block_size = read_be32((const unsigned char*)&header->block_size);
+    header->num_blocks = read_be32((const unsigned char*)&header->num_blocks);
+    header->used_blocks = read_be32((const unsigned char*)&header->used_blocks);
+}
 
-        if((bitmap[byte_index] & (1 << bit_index)) != 0)
-        {
-            // found the next set bit
-            *next_block_index = i;
-            return SLINGA_SUCCESS;
-        }
-    }
+/**
+ * @brief Convert the multi-byte fields of a snapshot header to big-endian before it is stored
+ *
+ * @param[in,out] header Header to convert
+ */
+static void snapshot_header_to_be(PSAT_SNAPSHOT_HEADER header)
+{
+    unsigned int block_size = header->block_size;
+    unsigned int num_blocks = header->num_blocks;
+    unsigned int used_blocks = header->used_blocks;
 
-    // we didn't find another block!
-    return SLINGA_NOT_FOUND;
+    write_be32((unsigned char*)&header->block_size, block_size);
+    write_be32((unsigned char*)&header->num_blocks, num_blocks);
+    write_be32((unsigned char*)&header->used_blocks, used_blocks);
 }
 
 /**
- * @brief Counts the number of set bits in the bitmap
+ * @brief Convert the multi-byte fields of a diff header to host byte order after it is read
  *
- * @param[in] bitmap Bitmap representing SAT blocks
- * @param[in] bitmap_size Size in bytes of the bitmap
- * @param[out] total On success, number of bits set to 1 in the bitmap
+ * @param[in,out] header Header to convert
+ */
+static void diff_header_to_host(PSAT_DIFF_HEADER header)
+{
+    header->block_size = read_be32((const unsigned char*)&header->block_size);
+    header->num_blocks = read_be32((const unsigned char*)&header->num_blocks);
+    header->changed_blocks = read_be32((const unsigned char*)&header->changed_blocks);
+    header->base_size = read_be32((const unsigned char*)&header->base_size);
+    header->base_hash = read_be32((const unsigned char*)&header->base_hash);
+}
+
+/**
+ * @brief Convert the multi-byte fields of a diff header to big-endian before it is stored
  *
- * @return SLINGA_SUCCESS on success
+ * @param[in,out] header Header to convert
  */
-static SLINGA_ERROR count_bitmap(const unsigned char* bitmap, unsigned int bitmap_size, unsigned int* total)
+static void diff_header_to_be(PSAT_DIFF_HEADER header)
 {
-    unsigned int count = 0;
+    unsigned int block_size = header->block_size;
+    unsigned int num_blocks = header->num_blocks;
+    unsigned int changed_blocks = header->changed_blocks;
+    unsigned int base_size = header->base_size;
+    unsigned int base_hash = header->base_hash;
+
+    write_be32((unsigned char*)&header->block_size, block_size);
+    write_be32((unsigned char*)&header->num_blocks, num_blocks);
+    write_be32((unsigned char*)&header->changed_blocks, changed_blocks);
+    write_be32((unsigned char*)&header->base_size, base_size);
+    write_be32((unsigned char*)&header->base_hash, base_hash);
+}
 
-    const uint8_t NIBBLE_LOOKUP_TABLE[16] =
-    {
-        0, 1, 1, 2, 1, 2, 2, 3,
-        1, 2, 2, 3, 2, 3, 3, 4
-    };
+#ifdef SAT_BYTEWISE_BYTE_ORDER
 
-    if(!bitmap || !bitmap_size)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+static unsigned short read_be16(const unsigned char* src)
+{
+    return (unsigned short)((src[0] << 8) | src[1]);
+}
 
-    for(unsigned int i = 0; i < bitmap_size; i++)
-    {
-        unsigned char byte = bitmap[i];
-        count += NIBBLE_LOOKUP_TABLE[byte & 0x0F] + NIBBLE_LOOKUP_TABLE[byte >> 4];
-    }
+static unsigned int read_be32(const unsigned char* src)
+{
+    return ((unsigned int)src[0] << 24) | ((unsigned int)src[1] << 16) | ((unsigned int)src[2] << 8) | src[3];
+}
 
-    *total = count;
+static void write_be16(unsigned char* dst, unsigned short val)
+{
+    dst[0] = (unsigned char)(val >> 8);
+    dst[1] = (unsigned char)val;
+}
 
-    return SLINGA_SUCCESS;
+static void write_be32(unsigned char* dst, unsigned int val)
+{
+    dst[0] = (unsigned char)(val >> 24);
+    dst[1] = (unsigned char)(val >> 16);
+    dst[2] = (unsigned char)(val >> 8);
+    dst[3] = (unsigned char)val;
 }
 
+#else
 
-/**
- * @brief Flips all 0s to 1s and 1s to 0s in the bitmap
- *
- * @param[in] bitmap Bitmap representing SAT blocks
- * @param[in] bitmap_size Size in bytes of the bitmap
- *
- * @return SLINGA_SUCCESS on success
- */
-static SLINGA_ERROR invert_bitmap(unsigned char* bitmap, unsigned int bitmap_size)
+static unsigned short read_be16(const unsigned char* src)
 {
-    if(!bitmap || !bitmap_size)
-    {
-        return SLINGA_INVALID_PARAMETER;
-    }
+    unsigned short val = 0;
 
-    for(unsigned int i = 0; i < bitmap_size; i++)
-    {
-        bitmap[i] = ~bitmap[i];
-    }
+    memcpy(&val, src, sizeof(val));
 
-    return SLINGA_SUCCESS;
+    return SAT_HOST_TO_BE16(val);
+}
+
+static unsigned int read_be32(const unsigned char* src)
+{
+    unsigned int val = 0;
+
+    memcpy(&val, src, sizeof(val));
+
+    return SAT_HOST_TO_BE32(val);
+}
+
+static void write_be16(unsigned char* dst, unsigned short val)
+{
+    val = SAT_HOST_TO_BE16(val);
+
+    memcpy(dst, &val, sizeof(val));
+}
+
+static void write_be32(unsigned char* dst, unsigned int val)
+{
+    val = SAT_HOST_TO_BE32(val);
+
+    memcpy(dst, &val, sizeof(val));
 }
 
+#endif
+
 //
 // Skip Bytes
 //
@@ -23,7 +23,8 @@
 
 #define SAT_TAG_SIZE sizeof(((SAT_START_BLOCK_HEADER *)0)->tag)
 
-// struct at the beginning of a save block
+// struct at the beginning of a save block. tag, timestamp and data_size are
+// big-endian on the partition, sat.c converts them as the header is read and written
 #pragma pack(1)
 typedef struct _SAT_START_BLOCK_HEADER
 {
@@ -37,21 +38,119 @@ typedef struct _SAT_START_BLOCK_HEADER
 #pragma pack()
 
 #define MIN_BLOCK_SIZE (64)
+#define SAT_MAX_BLOCK_SIZE (0x400) // 32 Mb Cartridge
 #define INTERNAL_MAX_BLOCKS (512)
 #define CARTRIDGE_MAX_BLOCKS (4096) // 32 Mb Cartridge
 #define ACTION_REPLAY_MAX_BLOCKS (8192)
 #define SAT_MAX_BITMAP (ACTION_REPLAY_MAX_BLOCKS / 8) // Each bit represents a block
 
+//
+// Save chains
+// A save's blocks are kept as an ordered vector of block indexes: the start
+// block followed by the SAT table entries in table order. Byte i of the save
+// (header, table, then data) is in blocks[i / usable] where usable is the
+// block size minus the tag, so no partition sized bitmap is needed to follow a save.
+//
+// The longest chain is a MAX_SAVE_SIZE save on 64 byte blocks without skip
+// bytes (Action Replay): each block holds 60 bytes, 2 of them its table entry.
+#define SAT_MAX_CHAIN_BLOCKS    ((MAX_SAVE_SIZE + sizeof(SAT_START_BLOCK_HEADER)) / (MIN_BLOCK_SIZE - SAT_TAG_SIZE - sizeof(unsigned short)) + 1)
+#define SAT_CHAIN_CACHE_ENTRIES (8)     // saves whose chains are remembered
+#define SAT_CHAIN_POOL_BLOCKS   (1024)  // block indexes shared by all cached chains
+#define SAT_READ_ENTRIES        (32)    // SAT table entries read from the partition at a time
+
+/** @brief Resolved block chain of one save */
+typedef struct _SAT_CHAIN
+{
+    const unsigned char* partition_buf; // partition the save is on, NULL if the entry is free
+    unsigned int start_block;           // block holding the save header
+    unsigned int data_offset;           // offset of the first data byte in the chain, after the header and SAT table
+    SAT_START_BLOCK_HEADER header;      // header when the chain was parsed. A different header means the save changed
+    unsigned short first;               // index of the first block in g_SAT_Chain_Blocks
+    unsigned short num_blocks;          // blocks in the chain, including start_block
+}SAT_CHAIN, *PSAT_CHAIN;
+
+//
+// Reservations
+// A reserved save keeps its chain here so writing it needs no allocation.
+//
+#define SAT_MAX_RESERVATIONS        (4)     // saves that can be reserved at once
+#define SAT_RESERVED_POOL_BLOCKS    (1024)  // block indexes shared by all reserved chains
+
+/** @brief Pre-allocated chain of one save */
+typedef struct _SAT_RESERVATION
+{
+    const unsigned char* partition_buf;     // partition the save is on, NULL if the entry is free
+    char savename[SAT_MAX_SAVE_NAME + 1];   // reserved save
+    unsigned int max_size;                  // data the chain holds, writes up to this size take the fast path
+    unsigned int data_offset;               // offset of the first data byte in the chain
+    unsigned short first;                   // index of the first block in g_SAT_Reserved_Blocks
+    unsigned short num_blocks;              // blocks in the chain, including the start block
+    unsigned char written;                  // 1 once a save was written into it, later writes need OVERWRITE_EXISTING_SAVE
+}SAT_RESERVATION, *PSAT_RESERVATION;
+
+//
+// Snapshots
+// A raw copy of a partition: this header, the used block bitmap, then the
+// valid bytes of each used block in block order. Free blocks aren't stored.
+// Multi-byte fields are big-endian, like the SAT, whatever machine took it.
+//
+#define SAT_SNAPSHOT_MAGIC      "SLSN"
+#define SAT_SNAPSHOT_VERSION    (1)
+
+#pragma pack(1)
+typedef struct _SAT_SNAPSHOT_HEADER
+{
+    char magic[4];                  // SAT_SNAPSHOT_MAGIC, not NULL terminated
+    unsigned char version;          // SAT_SNAPSHOT_VERSION
+    unsigned char reserved[3];
+    unsigned int block_size;        // bytes stored per used block, skip bytes already removed
+    unsigned int num_blocks;        // blocks covered by the bitmap
+    unsigned int used_blocks;       // blocks stored after the bitmap
+}SAT_SNAPSHOT_HEADER, *PSAT_SNAPSHOT_HEADER;
+#pragma pack()
+
+//
+// Differential snapshots
+// The blocks that changed since a base snapshot: this header, the used block
+// bitmap, a bitmap of the changed blocks, then the valid bytes of each
+// changed block in block order. Restoring needs the base snapshot too.
+// Multi-byte fields are big-endian, like the snapshot header.
+//
+#define SAT_DIFF_MAGIC          "SLDF"
+
+#pragma pack(1)
+typedef struct _SAT_DIFF_HEADER
+{
+    char magic[4];                  // SAT_DIFF_MAGIC, not NULL terminated
+    unsigned char version;          // SAT_SNAPSHOT_VERSION
+    unsigned char reserved[3];
+    unsigned int block_size;        // bytes stored per changed block, skip bytes already removed
+    unsigned int num_blocks;        // blocks covered by each bitmap
+    unsigned int changed_blocks;    // blocks stored after the bitmaps
+    unsigned int base_size;         // size of the base snapshot in bytes
+    unsigned int base_hash;         // hash of the base snapshot
+}SAT_DIFF_HEADER, *PSAT_DIFF_HEADER;
+#pragma pack()
+
 #define BACKUP_RAM_FORMAT_STR "BackUpRam Format"
 #define BACKUP_RAM_FORMAT_STR_LEN 16
 
 SLINGA_ERROR sat_get_used_blocks(const PPARTITION_INFO partition_info, unsigned int* used_blocks);
 
+SLINGA_ERROR sat_calc_blocks(const PPARTITION_INFO partition_info, unsigned int size, unsigned int* num_blocks);
+
 SLINGA_ERROR sat_list_saves(const PPARTITION_INFO partition_info,
                             PSAVE_METADATA saves,
                             unsigned int num_saves,
                             unsigned int* saves_available);
 
+SLINGA_ERROR sat_list_page(const PPARTITION_INFO partition_info,
+                           unsigned int cursor,
+                           PSAVE_METADATA saves,
+                           unsigned int num_saves,
+                           unsigned int* saves_found,
+                           unsigned int* next_cursor);
+
 SLINGA_ERROR sat_query_file(const char* filename,
                             const PPARTITION_INFO partition_info,
                             PSAVE_METADATA metadata);
@@ -62,6 +161,13 @@ SLINGA_ERROR sat_read(const char* filename,
                       unsigned int* bytes_read,
                       const PPARTITION_INFO partition_info);
 
+SLINGA_ERROR sat_query_chain(const char* filename,
+                             const PPARTITION_INFO partition_info,
+                             unsigned short* blocks,
+                             unsigned int max_blocks,
+                             unsigned int* num_blocks,
+                             unsigned int* data_offset);
+
 SLINGA_ERROR sat_write(FLAGS flags,
                        const char* filename,
                        const PSAVE_METADATA save_metadata,
@@ -69,6 +175,11 @@ SLINGA_ERROR sat_write(FLAGS flags,
                        unsigned int size,
                        const PPARTITION_INFO partition_info);
 
+SLINGA_ERROR sat_reserve(FLAGS flags,
+                         const char* filename,
+                         unsigned int max_size,
+                         const PPARTITION_INFO partition_info);
+
 SLINGA_ERROR sat_delete(const char* filename,
                         FLAGS flags,
                         const PPARTITION_INFO partition_info);
@@ -76,3 +187,27 @@ SLINGA_ERROR sat_delete(const char* filename,
 SLINGA_ERROR sat_check_formatted(const PPARTITION_INFO partition_info);
 
 SLINGA_ERROR sat_format(const PPARTITION_INFO partition_info);
+
+SLINGA_ERROR sat_snapshot(const PPARTITION_INFO partition_info,
+                          unsigned char* buffer,
+                          unsigned int size,
+                          unsigned int* snapshot_size);
+
+SLINGA_ERROR sat_restore(const PPARTITION_INFO partition_info,
+                         const unsigned char* buffer,
+                         unsigned int size);
+
+SLINGA_ERROR sat_snapshot_diff(const PPARTITION_INFO partition_info,
+                               const unsigned char* base,
+                               unsigned int base_size,
+                               unsigned char* buffer,
+                               unsigned int size,
+                               unsigned int* diff_size);
+
+SLINGA_ERROR sat_restore_diff(const PPARTITION_INFO partition_info,
+                              const unsigned char* base,
+                              unsigned int base_size,
+                              const unsigned char* diff,
+                              unsigned int diff_size);
+
+SLINGA_ERROR sat_release(const PPARTITION_INFO partition_info);
@@ -34,12 +34,19 @@ SLINGA_ERROR Saturn_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* de
     g_Saturn_Handler.is_readable = Saturn_IsReadable;
     g_Saturn_Handler.is_writeable = Saturn_IsWriteable;
     g_Saturn_Handler.stat = Saturn_Stat;
+    g_Saturn_Handler.calc_blocks = Saturn_CalcBlocks;
     g_Saturn_Handler.query_file = Saturn_QueryFile;
     g_Saturn_Handler.list = Saturn_List;
+    g_Saturn_Handler.list_page = Saturn_ListPage;
     g_Saturn_Handler.read = Saturn_Read;
     g_Saturn_Handler.write = Saturn_Write;
+    g_Saturn_Handler.reserve = Saturn_Reserve;
     g_Saturn_Handler.delete = Saturn_Delete;
     g_Saturn_Handler.format = Saturn_Format;
+    g_Saturn_Handler.snapshot = Saturn_Snapshot;
+    g_Saturn_Handler.restore = Saturn_Restore;
+    g_Saturn_Handler.snapshot_diff = Saturn_SnapshotDiff;
+    g_Saturn_Handler.restore_diff = Saturn_RestoreDiff;
 
     *device_handler = &g_Saturn_Handler;
 
@@ -218,6 +225,31 @@ SLINGA_ERROR Saturn_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
     return SLINGA_SUCCESS;
 }
 
+SLINGA_ERROR Saturn_CalcBlocks(DEVICE_TYPE device_type, unsigned int size, unsigned int* num_blocks)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_calc_blocks(&partition_info, size, num_blocks);
+}
+
 SLINGA_ERROR Saturn_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
 {
     PARTITION_INFO partition_info = {0};
@@ -294,6 +326,39 @@ SLINGA_ERROR Saturn_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA sa
     return SLINGA_SUCCESS;
 }
 
+SLINGA_ERROR Saturn_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // the cursor is the block to resume scanning from
+    return sat_list_page(&partition_info,
+                         cursor,
+                         page,
+                         page_len,
+                         saves_found,
+                         next_cursor);
+}
+
 SLINGA_ERROR Saturn_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
 {
     PARTITION_INFO partition_info = {0};
@@ -374,6 +439,31 @@ SLINGA_ERROR Saturn_Write(DEVICE_TYPE device_type, FLAGS flags, const char* file
     return SLINGA_SUCCESS;
 }
 
+SLINGA_ERROR Saturn_Reserve(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned int max_size)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_reserve(flags, filename, max_size, &partition_info);
+}
+
 SLINGA_ERROR Saturn_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
 {
     UNUSED(flags);
@@ -438,6 +528,106 @@ SLINGA_ERROR Saturn_Format(DEVICE_TYPE device_type)
     return SLINGA_SUCCESS;
 }
 
+SLINGA_ERROR Saturn_Snapshot(DEVICE_TYPE device_type, unsigned char* buffer, unsigned int size, unsigned int* snapshot_size)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_snapshot(&partition_info, buffer, size, snapshot_size);
+}
+
+SLINGA_ERROR Saturn_Restore(DEVICE_TYPE device_type, const unsigned char* buffer, unsigned int size)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_restore(&partition_info, buffer, size);
+}
+
+SLINGA_ERROR Saturn_SnapshotDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, unsigned char* buffer, unsigned int size, unsigned int* diff_size)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_snapshot_diff(&partition_info, base, base_size, buffer, size, diff_size);
+}
+
+SLINGA_ERROR Saturn_RestoreDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, const unsigned char* diff, unsigned int diff_size)
+{
+    PARTITION_INFO partition_info = {0};
+    SLINGA_ERROR result = 0;
+
+    if(device_type != DEVICE_INTERNAL && device_type != DEVICE_CARTRIDGE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    result = Saturn_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = get_partition_info(device_type, g_Cartridge_Type, &partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_restore_diff(&partition_info, base, base_size, diff, diff_size);
+}
+
 //
 // helper functions
 //
@@ -44,12 +44,19 @@ SLINGA_ERROR Saturn_IsReadable(DEVICE_TYPE type);
 SLINGA_ERROR Saturn_IsWriteable(DEVICE_TYPE type);
 
 SLINGA_ERROR Saturn_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+SLINGA_ERROR Saturn_CalcBlocks(DEVICE_TYPE device_type, unsigned int size, unsigned int* num_blocks);
 SLINGA_ERROR Saturn_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
 SLINGA_ERROR Saturn_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR Saturn_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
 
 SLINGA_ERROR Saturn_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
 SLINGA_ERROR Saturn_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Saturn_Reserve(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned int max_size);
 SLINGA_ERROR Saturn_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
 SLINGA_ERROR Saturn_Format(DEVICE_TYPE device_type);
+SLINGA_ERROR Saturn_Snapshot(DEVICE_TYPE device_type, unsigned char* buffer, unsigned int size, unsigned int* snapshot_size);
+SLINGA_ERROR Saturn_Restore(DEVICE_TYPE device_type, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Saturn_SnapshotDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, unsigned char* buffer, unsigned int size, unsigned int* diff_size);
+SLINGA_ERROR Saturn_RestoreDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, const unsigned char* diff, unsigned int diff_size);
 
 #endif
@@ -0,0 +1,947 @@
+/** @file serial.c
+ *
+ *  @author Slinga
+ *  @brief Serial link device
+ *  @bug Requires a SERIAL_PORT to be attached with Serial_SetPort().
+ */
+#include "serial.h"
+
+#ifdef INCLUDE_SERIAL
+
+DEVICE_HANDLER g_Serial_Handler = {0};
+
+/** @brief Port attached by Serial_SetPort(), NULL if none */
+PSERIAL_PORT g_Serial_Port = NULL;
+
+/** @brief Link to the host */
+SERIAL_LINK g_Serial_Link = {0};
+
+/** @brief Staging for .BUP headers */
+unsigned char g_Serial_Header[BUP_HEADER_SIZE] = {0};
+
+static SLINGA_ERROR begin_request(SERIAL_OP op, unsigned short count);
+static SLINGA_ERROR write_name(const char* filename);
+static SLINGA_ERROR read_result(SLINGA_ERROR* result);
+static SLINGA_ERROR read_header(PSAVE_METADATA metadata);
+static SLINGA_ERROR simple_request(SERIAL_OP op, const char* filename);
+static SLINGA_ERROR list_directory(unsigned int first, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* found, unsigned int* total);
+
+SLINGA_ERROR Serial_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!device_handler)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_Serial_Handler.init = Serial_Init;
+    g_Serial_Handler.fini = Serial_Fini;
+    g_Serial_Handler.get_device_name = Serial_GetDeviceName;
+    g_Serial_Handler.is_present = Serial_IsPresent;
+    g_Serial_Handler.is_readable = Serial_IsReadable;
+    g_Serial_Handler.is_writeable = Serial_IsWriteable;
+    g_Serial_Handler.stat = Serial_Stat;
+    g_Serial_Handler.query_file = Serial_QueryFile;
+    g_Serial_Handler.list = Serial_List;
+    g_Serial_Handler.list_page = Serial_ListPage;
+    g_Serial_Handler.read = Serial_Read;
+    g_Serial_Handler.write = Serial_Write;
+    g_Serial_Handler.delete = Serial_Delete;
+    g_Serial_Handler.format = Serial_Format;
+
+    *device_handler = &g_Serial_Handler;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Attach the port the host is connected to
+ *
+ * @param[in] port Port to use. Must remain valid until detached. NULL to detach
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Serial_SetPort(PSERIAL_PORT port)
+{
+    SLINGA_ERROR result = 0;
+
+    g_Context.isPresent[DEVICE_SERIAL] = 0;
+    g_Serial_Port = NULL;
+
+    if(!port)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    result = serial_link_init(&g_Serial_Link, port);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    g_Serial_Port = port;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Get the link counters
+ *
+ * @param[out] stats Counters since the port was attached or Serial_ResetStats()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Serial_GetStats(PSERIAL_LINK_STATS stats)
+{
+    if(!stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memcpy(stats, &g_Serial_Link.stats, sizeof(SERIAL_LINK_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Zero the link counters
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Serial_ResetStats(void)
+{
+    memset(&g_Serial_Link.stats, 0, sizeof(SERIAL_LINK_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Read several saves with a single request
+ *
+ * @param[in] flags Unused
+ * @param[in,out] entries filename, buffer and size in, metadata, bytes_read and result out
+ * @param[in] count Number of entries, at most SERIAL_MAX_BATCH
+ *
+ * @return SLINGA_SUCCESS if the request completed. Check each entry's result
+ */
+SLINGA_ERROR Serial_ReadBatch(FLAGS flags, PSERIAL_BATCH_ENTRY entries, unsigned int count)
+{
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    if(!entries || !count || count > SERIAL_MAX_BATCH)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // validate everything up front, we can't back out of a half sent request
+    for(unsigned int i = 0; i < count; i++)
+    {
+        char savename[MAX_SAVENAME + 1] = {0};
+
+        if(!entries[i].buffer || bup_get_savename(entries[i].filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+        {
+            return SLINGA_INVALID_PARAMETER;
+        }
+    }
+
+    result = begin_request(SERIAL_OP_READ, (unsigned short)count);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        result = write_name(entries[i].filename);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_write_u32(&g_Serial_Link, entries[i].size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = serial_link_end_message(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // the saves stream straight into the caller's buffers
+    for(unsigned int i = 0; i < count; i++)
+    {
+        PSERIAL_BATCH_ENTRY entry = &entries[i];
+
+        entry->bytes_read = 0;
+
+        result = read_result(&entry->result);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(entry->result != SLINGA_SUCCESS && entry->result != SLINGA_BUFFER_TOO_SMALL)
+        {
+            continue;
+        }
+
+        // even too small gets the header so the caller knows how much to allocate
+        result = read_header(&entry->metadata);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(entry->result != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        if(entry->metadata.data_size > entry->size)
+        {
+            // host ignored our max size
+            return SLINGA_SERIAL_PROTOCOL_ERROR;
+        }
+
+        result = serial_link_read(&g_Serial_Link, entry->buffer, entry->metadata.data_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        entry->bytes_read = entry->metadata.data_size;
+    }
+
+    return serial_link_end_read(&g_Serial_Link);
+}
+
+/**
+ * @brief Write several saves with a single request
+ *
+ * @param[in] flags OVERWRITE_EXISTING_SAVE to replace existing saves
+ * @param[in,out] entries filename, buffer, size and metadata in, result out
+ * @param[in] count Number of entries, at most SERIAL_MAX_BATCH
+ *
+ * @return SLINGA_SUCCESS if the request completed. Check each entry's result
+ */
+SLINGA_ERROR Serial_WriteBatch(FLAGS flags, PSERIAL_BATCH_ENTRY entries, unsigned int count)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!entries || !count || count > SERIAL_MAX_BATCH)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // validate everything up front, we can't back out of a half sent request
+    for(unsigned int i = 0; i < count; i++)
+    {
+        char savename[MAX_SAVENAME + 1] = {0};
+
+        if(!entries[i].buffer || !entries[i].size || entries[i].size > MAX_SAVE_SIZE)
+        {
+            return SLINGA_INVALID_PARAMETER;
+        }
+
+        if(bup_get_savename(entries[i].filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+        {
+            return SLINGA_INVALID_PARAMETER;
+        }
+    }
+
+    result = begin_request(SERIAL_OP_WRITE, (unsigned short)count);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        PSERIAL_BATCH_ENTRY entry = &entries[i];
+
+        result = bup_build_header(&entry->metadata, entry->size, g_Serial_Header, sizeof(g_Serial_Header));
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_write_u8(&g_Serial_Link, (unsigned char)flags);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = write_name(entry->filename);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_write(&g_Serial_Link, g_Serial_Header, sizeof(g_Serial_Header));
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_write(&g_Serial_Link, entry->buffer, entry->size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = serial_link_end_message(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        result = read_result(&entries[i].result);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return serial_link_end_read(&g_Serial_Link);
+}
+
+/**
+ * @brief Tell the host we are done. The port stays attached
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Serial_Close(void)
+{
+    return simple_request(SERIAL_OP_BYE, NULL);
+}
+
+SLINGA_ERROR Serial_Init(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_Fini(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_GetDeviceName(DEVICE_TYPE device_type, char** device_name)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!device_name)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    *device_name = "Serial Link";
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_IsPresent(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(g_Context.isPresent[device_type])
+    {
+        // we already know device is present
+        return SLINGA_SUCCESS;
+    }
+
+    // without a port there is no way to talk to the host
+    if(!g_Serial_Port)
+    {
+        return SLINGA_DEVICE_NOT_PRESENT;
+    }
+
+    g_Context.isPresent[device_type] = 1;
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_IsReadable(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_IsWriteable(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SERIAL)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
+{
+    SLINGA_ERROR host_result = 0;
+    unsigned int total_bytes = 0;
+    unsigned int free_bytes = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stat)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(stat, 0, sizeof(BACKUP_STAT));
+
+    result = begin_request(SERIAL_OP_STAT, 0);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_end_message(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = read_result(&host_result);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(host_result == SLINGA_SUCCESS)
+    {
+        result = serial_link_read_u32(&g_Serial_Link, &total_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_read_u32(&g_Serial_Link, &free_bytes);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = serial_link_end_read(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(host_result != SLINGA_SUCCESS)
+    {
+        return host_result;
+    }
+
+    //
+    // fill out stats
+    // hosts don't have blocks, report in BUP_BLOCK_SIZE units
+    //
+    stat->block_size = BUP_BLOCK_SIZE;
+    stat->total_blocks = total_bytes / BUP_BLOCK_SIZE;
+    stat->total_bytes = stat->total_blocks * BUP_BLOCK_SIZE;
+    stat->free_blocks = free_bytes / BUP_BLOCK_SIZE;
+    stat->free_bytes = stat->free_blocks * BUP_BLOCK_SIZE;
+
+    // smallest possible save is a header plus one block of data
+    stat->max_saves_possible = stat->free_bytes / (BUP_HEADER_SIZE + BUP_BLOCK_SIZE);
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    SLINGA_ERROR host_result = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!save || bup_get_savename(filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = begin_request(SERIAL_OP_QUERY, 1);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = write_name(filename);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_end_message(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = read_result(&host_result);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(host_result == SLINGA_SUCCESS)
+    {
+        result = read_header(save);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = serial_link_end_read(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return host_result;
+}
+
+SLINGA_ERROR Serial_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    unsigned int found = 0;
+    unsigned int total = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = list_directory(0, saves, saves ? num_saves : 0, &found, &total);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(saves && total > num_saves)
+    {
+        // no more room in our saves array
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    if(saves_found)
+    {
+        *saves_found = total;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    unsigned int found = 0;
+    unsigned int total = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // the cursor is the directory index to resume from
+    result = list_directory(cursor, page, page_len, &found, &total);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    *saves_found = found;
+    // an empty page ends the listing even if the directory shrank underneath us
+    *next_cursor = (found && cursor + found < total) ? cursor + found : SLINGA_LIST_END;
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    SERIAL_BATCH_ENTRY entry = {0};
+    SLINGA_ERROR result = 0;
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !buffer || !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    entry.filename = filename;
+    entry.buffer = buffer;
+    entry.size = size;
+
+    result = Serial_ReadBatch(flags, &entry, 1);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(entry.result != SLINGA_SUCCESS)
+    {
+        return entry.result;
+    }
+
+    if(bytes_read)
+    {
+        *bytes_read = entry.bytes_read;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Serial_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
+{
+    SERIAL_BATCH_ENTRY entry = {0};
+    SLINGA_ERROR result = 0;
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !save_metadata || !buffer || !size || size > MAX_SAVE_SIZE)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    entry.filename = filename;
+    entry.buffer = (unsigned char*)buffer;
+    entry.size = size;
+    memcpy(&entry.metadata, save_metadata, sizeof(SAVE_METADATA));
+
+    result = Serial_WriteBatch(flags, &entry, 1);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return entry.result;
+}
+
+SLINGA_ERROR Serial_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(bup_get_savename(filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    return simple_request(SERIAL_OP_DELETE, filename);
+}
+
+SLINGA_ERROR Serial_Format(DEVICE_TYPE device_type)
+{
+    SLINGA_ERROR result = 0;
+
+    result = Serial_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return simple_request(SERIAL_OP_FORMAT, NULL);
+}
+
+//
+// helper functions
+//
+
+static SLINGA_ERROR begin_request(SERIAL_OP op, unsigned short count)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!g_Serial_Port)
+    {
+        return SLINGA_SERIAL_NO_PORT;
+    }
+
+    result = serial_link_write_u8(&g_Serial_Link, (unsigned char)op);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_write_u16(&g_Serial_Link, count);
+}
+
+static SLINGA_ERROR write_name(const char* filename)
+{
+    char name[BUP_SAVENAME_LEN] = {0};
+    SLINGA_ERROR result = 0;
+
+    result = bup_get_savename(filename, name, sizeof(name));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_write(&g_Serial_Link, (const unsigned char*)name, sizeof(name));
+}
+
+static SLINGA_ERROR read_result(SLINGA_ERROR* result)
+{
+    unsigned short val = 0;
+    SLINGA_ERROR link_result = 0;
+
+    link_result = serial_link_read_u16(&g_Serial_Link, &val);
+    if(link_result != SLINGA_SUCCESS)
+    {
+        return link_result;
+    }
+
+    *result = (SLINGA_ERROR)val;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR read_header(PSAVE_METADATA metadata)
+{
+    SLINGA_ERROR result = 0;
+
+    result = serial_link_read(&g_Serial_Link, g_Serial_Header, sizeof(g_Serial_Header));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = bup_parse_header(g_Serial_Header, sizeof(g_Serial_Header), metadata);
+    if(result != SLINGA_SUCCESS)
+    {
+        // the host is supposed to filter out bad saves
+        return SLINGA_SERIAL_PROTOCOL_ERROR;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Send a request with at most one name and a single result in the response
+ *
+ * @param[in] op Request to send
+ * @param[in] filename Save the request is for. NULL if the request doesn't take a name
+ *
+ * @return The host's result on success
+ */
+static SLINGA_ERROR simple_request(SERIAL_OP op, const char* filename)
+{
+    SLINGA_ERROR host_result = 0;
+    SLINGA_ERROR result = 0;
+
+    result = begin_request(op, filename ? 1 : 0);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(filename)
+    {
+        result = write_name(filename);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    result = serial_link_end_message(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = read_result(&host_result);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_end_read(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return host_result;
+}
+
+/**
+ * @brief Request saves first to first + num_saves - 1 of the directory
+ *
+ * The host only sends the requested range, so a page costs one round trip
+ * and only its own entries on the wire.
+ *
+ * @param[in] first Directory index of the first save to return
+ * @param[out] saves Saves returned. Can be NULL if num_saves is 0
+ * @param[in] num_saves Size in elements of saves
+ * @param[out] found Number of saves written to saves
+ * @param[out] total Number of saves in the directory
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR list_directory(unsigned int first, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* found, unsigned int* total)
+{
+    SLINGA_ERROR host_result = 0;
+    unsigned short directory_size = 0;
+    unsigned short count = 0;
+    SLINGA_ERROR result = 0;
+
+    *found = 0;
+
+    result = begin_request(SERIAL_OP_LIST, (unsigned short)LIBSLINGA_MIN(num_saves, 0xFFFF));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_write_u32(&g_Serial_Link, first);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_end_message(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = read_result(&host_result);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(host_result == SLINGA_SUCCESS)
+    {
+        result = serial_link_read_u16(&g_Serial_Link, &directory_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_read_u16(&g_Serial_Link, &count);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(count > num_saves)
+        {
+            // the host sent more than we asked for
+            return SLINGA_SERIAL_PROTOCOL_ERROR;
+        }
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        char name[BUP_SAVENAME_LEN + 1] = {0};
+        SAVE_METADATA metadata = {0};
+
+        result = serial_link_read(&g_Serial_Link, (unsigned char*)name, BUP_SAVENAME_LEN);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = read_header(&metadata);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        // the file name on the host wins over the name in the header
+        strcpy(metadata.filename, name);
+        strcat(metadata.filename, BUP_EXTENSION);
+
+        memcpy(&saves[*found], &metadata, sizeof(SAVE_METADATA));
+        (*found)++;
+    }
+
+    result = serial_link_end_read(&g_Serial_Link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(host_result != SLINGA_SUCCESS)
+    {
+        return host_result;
+    }
+
+    *total = directory_size;
+
+    return SLINGA_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,103 @@
+/** @file serial.h
+ *
+ *  @author Slinga
+ *  @brief Serial link device prototypes and constants
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#ifdef INCLUDE_SERIAL
+
+#include "../../libslinga.h"
+#include "../bup/bup.h"
+#include "serial_link.h"
+
+//
+// DEVICE_SERIAL talks to a host (PC, another Saturn, etc) that stores saves
+// as .BUP files. The Saturn sends a request message and the host answers with
+// a single response message. All integers are big-endian. Names are save
+// names (no .BUP) padded with NULLs to BUP_SAVENAME_LEN bytes.
+//
+// Request:  op (1), count (2), then per op:
+// STAT:     -
+//           response: result (2), total bytes (4), free bytes (4)
+// LIST:     first (4). count is the most saves to return, starting at
+//           directory index first
+//           response: result (2), total (2), returned (2),
+//                     returned * [name, .BUP header]
+// QUERY:    count * [name]
+//           response: count * [result (2), .BUP header if result is SLINGA_SUCCESS]
+// READ:     count * [name, max data size (4)]
+//           response: count * [result (2), .BUP header if result is SLINGA_SUCCESS
+//                     or SLINGA_BUFFER_TOO_SMALL, data if result is SLINGA_SUCCESS]
+// WRITE:    count * [FLAGS (1), name, .BUP header, data]
+//           response: count * [result (2)]
+// DELETE:   count * [name]
+//           response: count * [result (2)]
+// FORMAT:   -
+//           response: result (2)
+// BYE:      -
+//           response: result (2). The host stops serving
+//
+// Batching is what makes the link usable. One request costs a round trip
+// regardless of how many saves it carries, and the link streams the saves in
+// a single window so the whole device can be dumped or restored in one
+// request.
+//
+
+#define SERIAL_MAX_BATCH    MAX_SAVES ///< @brief Maximum saves in one READ\WRITE\QUERY\DELETE request
+
+/** @brief Request opcodes */
+typedef enum
+{
+    SERIAL_OP_STAT = 1,
+    SERIAL_OP_LIST = 2,
+    SERIAL_OP_QUERY = 3,
+    SERIAL_OP_READ = 4,
+    SERIAL_OP_WRITE = 5,
+    SERIAL_OP_DELETE = 6,
+    SERIAL_OP_FORMAT = 7,
+    SERIAL_OP_BYE = 8,
+} SERIAL_OP;
+
+/** @brief One save in a Serial_ReadBatch() or Serial_WriteBatch() */
+typedef struct _SERIAL_BATCH_ENTRY
+{
+    const char* filename;       ///< @brief Save to read\write. Either "SAVENAME" or "SAVENAME.BUP"
+    unsigned char* buffer;      ///< @brief Read destination or write source
+    unsigned int size;          ///< @brief Size of buffer for reads, size of the save data for writes
+    SAVE_METADATA metadata;     ///< @brief Filled out by reads, must be filled out for writes
+    unsigned int bytes_read;    ///< @brief Filled out by reads
+    SLINGA_ERROR result;        ///< @brief Result for this save
+} SERIAL_BATCH_ENTRY, *PSERIAL_BATCH_ENTRY;
+
+SLINGA_ERROR Serial_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler);
+
+SLINGA_ERROR Serial_SetPort(PSERIAL_PORT port);
+SLINGA_ERROR Serial_GetStats(PSERIAL_LINK_STATS stats);
+SLINGA_ERROR Serial_ResetStats(void);
+SLINGA_ERROR Serial_ReadBatch(FLAGS flags, PSERIAL_BATCH_ENTRY entries, unsigned int count);
+SLINGA_ERROR Serial_WriteBatch(FLAGS flags, PSERIAL_BATCH_ENTRY entries, unsigned int count);
+SLINGA_ERROR Serial_Close(void);
+
+SLINGA_ERROR Serial_Init(DEVICE_TYPE device_type);
+SLINGA_ERROR Serial_Fini(DEVICE_TYPE device_type);
+
+SLINGA_ERROR Serial_GetDeviceName(DEVICE_TYPE device_type, char** device_name);
+SLINGA_ERROR Serial_IsPresent(DEVICE_TYPE device_type);
+SLINGA_ERROR Serial_IsReadable(DEVICE_TYPE device_type);
+SLINGA_ERROR Serial_IsWriteable(DEVICE_TYPE device_type);
+
+SLINGA_ERROR Serial_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+SLINGA_ERROR Serial_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
+SLINGA_ERROR Serial_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR Serial_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
+SLINGA_ERROR Serial_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+SLINGA_ERROR Serial_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Serial_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
+SLINGA_ERROR Serial_Format(DEVICE_TYPE device_type);
+
+#endif
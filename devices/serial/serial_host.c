@@ -0,0 +1,851 @@
+/** @file serial_host.c
+ *
+ *  @author Slinga
+ *  @brief Host side of the serial link, serves a directory of .BUP files
+ *  @bug Host only, requires POSIX.
+ */
+#include "serial_host.h"
+
+#if defined(INCLUDE_SERIAL_HOST) && defined(INCLUDE_SERIAL)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#define HOST_CHUNK_SIZE 4096 ///< @brief Bytes moved between the link and a file at a time
+
+// port callbacks
+static SLINGA_ERROR fd_send(void* context, const unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR fd_receive(void* context, unsigned char* buffer, unsigned int size, unsigned int timeout_ms, unsigned int* bytes_received);
+
+// request handlers
+static SLINGA_ERROR host_stat(PSERIAL_HOST host);
+static SLINGA_ERROR host_list(PSERIAL_HOST host, unsigned short count);
+static SLINGA_ERROR host_query(PSERIAL_HOST host, unsigned short count);
+static SLINGA_ERROR host_read(PSERIAL_HOST host, unsigned short count);
+static SLINGA_ERROR host_write(PSERIAL_HOST host, unsigned short count);
+static SLINGA_ERROR host_delete(PSERIAL_HOST host, unsigned short count);
+static SLINGA_ERROR host_format(PSERIAL_HOST host);
+
+static SLINGA_ERROR read_names(PSERIAL_HOST host, unsigned short count, unsigned int with_size, char (**names)[BUP_SAVENAME_LEN], unsigned int** sizes);
+static SLINGA_ERROR send_results(PSERIAL_HOST host, const SLINGA_ERROR* results, unsigned short count);
+static SLINGA_ERROR get_save_path(const PSERIAL_HOST host, const char* name, char* path, unsigned int path_size);
+static SLINGA_ERROR read_save_header(const char* path, unsigned char* header, PSAVE_METADATA metadata);
+static int filter_bup(const struct dirent* entry);
+
+/**
+ * @brief Fill out a SERIAL_PORT that reads and writes a file descriptor
+ *
+ * @param[out] fd_port Port state. Must remain valid while the port is used
+ * @param[in] fd Descriptor (socket, pty, tty) to use
+ * @param[out] port Port to pass to Serial_SetPort() or Serial_Host_Init()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Serial_Host_InitFdPort(PSERIAL_FD_PORT fd_port, int fd, PSERIAL_PORT port)
+{
+    if(!fd_port || fd < 0 || !port)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    fd_port->fd = fd;
+
+    memset(port, 0, sizeof(SERIAL_PORT));
+    port->context = fd_port;
+    port->send = fd_send;
+    port->receive = fd_receive;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Initialize the host stand-in
+ *
+ * @param[out] host Host state
+ * @param[in] root Host directory. Saves live in root/SATSAVES
+ * @param[in] port Port the Saturn is connected to
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Serial_Host_Init(PSERIAL_HOST host, const char* root, PSERIAL_PORT port)
+{
+    if(!host || !root || strlen(root) >= sizeof(host->root))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(host, 0, sizeof(SERIAL_HOST));
+    strcpy(host->root, root);
+
+    return serial_link_init(&host->link, port);
+}
+
+/**
+ * @brief Answer requests until the Saturn sends SERIAL_OP_BYE
+ *
+ * @param[in] host Host state
+ *
+ * @return SLINGA_SUCCESS after a BYE, otherwise the link error that stopped us
+ */
+SLINGA_ERROR Serial_Host_Serve(PSERIAL_HOST host)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!host)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(1)
+    {
+        unsigned char op = 0;
+        unsigned short count = 0;
+
+        result = serial_link_wait_message(&host->link);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_read_u8(&host->link, &op);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = serial_link_read_u16(&host->link, &count);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        switch(op)
+        {
+            case SERIAL_OP_STAT:
+                result = host_stat(host);
+                break;
+            case SERIAL_OP_LIST:
+                result = host_list(host, count);
+                break;
+            case SERIAL_OP_QUERY:
+                result = host_query(host, count);
+                break;
+            case SERIAL_OP_READ:
+                result = host_read(host, count);
+                break;
+            case SERIAL_OP_WRITE:
+                result = host_write(host, count);
+                break;
+            case SERIAL_OP_DELETE:
+                result = host_delete(host, count);
+                break;
+            case SERIAL_OP_FORMAT:
+                result = host_format(host);
+                break;
+            case SERIAL_OP_BYE:
+                result = serial_link_end_read(&host->link);
+                if(result == SLINGA_SUCCESS)
+                {
+                    result = serial_link_write_u16(&host->link, SLINGA_SUCCESS);
+                }
+                if(result == SLINGA_SUCCESS)
+                {
+                    result = serial_link_end_message(&host->link);
+                }
+                if(result == SLINGA_SUCCESS)
+                {
+                    // give the Saturn a chance to ack before we go away. Best
+                    // effort, it may have already hung up once it had the response
+                    serial_link_flush(&host->link);
+                }
+                return result;
+            default:
+                result = serial_link_end_read(&host->link);
+                if(result == SLINGA_SUCCESS)
+                {
+                    result = serial_link_write_u16(&host->link, SLINGA_NOT_SUPPORTED);
+                }
+                if(result == SLINGA_SUCCESS)
+                {
+                    result = serial_link_end_message(&host->link);
+                }
+                break;
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+}
+
+//
+// port callbacks
+//
+
+static SLINGA_ERROR fd_send(void* context, const unsigned char* buffer, unsigned int size)
+{
+    PSERIAL_FD_PORT fd_port = (PSERIAL_FD_PORT)context;
+
+    while(size)
+    {
+        ssize_t written = write(fd_port->fd, buffer, size);
+
+        if(written < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            return SLINGA_SERIAL_PORT_ERROR;
+        }
+
+        buffer += written;
+        size -= (unsigned int)written;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR fd_receive(void* context, unsigned char* buffer, unsigned int size, unsigned int timeout_ms, unsigned int* bytes_received)
+{
+    PSERIAL_FD_PORT fd_port = (PSERIAL_FD_PORT)context;
+    struct pollfd pfd = {0};
+    ssize_t received = 0;
+    int ready = 0;
+
+    *bytes_received = 0;
+
+    pfd.fd = fd_port->fd;
+    pfd.events = POLLIN;
+
+    do
+    {
+        ready = poll(&pfd, 1, (int)timeout_ms);
+    } while(ready < 0 && errno == EINTR);
+
+    if(ready < 0)
+    {
+        return SLINGA_SERIAL_PORT_ERROR;
+    }
+
+    if(ready == 0)
+    {
+        // timed out
+        return SLINGA_SUCCESS;
+    }
+
+    received = read(fd_port->fd, buffer, size);
+    if(received <= 0)
+    {
+        // error or the other end hung up
+        return SLINGA_SERIAL_PORT_ERROR;
+    }
+
+    *bytes_received = (unsigned int)received;
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// request handlers
+//
+
+static SLINGA_ERROR host_stat(PSERIAL_HOST host)
+{
+    struct statvfs fs = {0};
+    unsigned long long total = 0;
+    unsigned long long avail = 0;
+    SLINGA_ERROR result = 0;
+
+    result = serial_link_end_read(&host->link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(statvfs(host->root, &fs) != 0)
+    {
+        result = serial_link_write_u16(&host->link, SLINGA_DEVICE_NOT_PRESENT);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        return serial_link_end_message(&host->link);
+    }
+
+    total = (unsigned long long)fs.f_blocks * fs.f_frsize;
+    avail = (unsigned long long)fs.f_bavail * fs.f_frsize;
+
+    result = serial_link_write_u16(&host->link, SLINGA_SUCCESS);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // host disks are bigger than 4GB, clamp
+    result = serial_link_write_u32(&host->link, (unsigned int)LIBSLINGA_MIN(total, 0xFFFFFFFFULL));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_write_u32(&host->link, (unsigned int)LIBSLINGA_MIN(avail, 0xFFFFFFFFULL));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_end_message(&host->link);
+}
+
+static SLINGA_ERROR host_list(PSERIAL_HOST host, unsigned short count)
+{
+    char dir_path[512] = {0};
+    struct dirent** names = NULL;
+    unsigned char (*headers)[BUP_HEADER_SIZE] = NULL;
+    char (*savenames)[BUP_SAVENAME_LEN] = NULL;
+    char savename[BUP_SAVENAME_LEN] = {0};
+    unsigned char header[BUP_HEADER_SIZE] = {0};
+    unsigned int first = 0;
+    unsigned int total = 0;
+    unsigned int returned = 0;
+    int num_names = 0;
+    SLINGA_ERROR result = 0;
+
+    result = serial_link_read_u32(&host->link, &first);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = serial_link_end_read(&host->link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", host->root, SAVES_DIRECTORY);
+
+    // a missing SATSAVES directory is just an empty device
+    num_names = scandir(dir_path, &names, filter_bup, alphasort);
+    if(num_names < 0)
+    {
+        num_names = 0;
+    }
+
+    // only the requested page is kept
+    headers = calloc(count ? count : 1, BUP_HEADER_SIZE);
+    savenames = calloc(count ? count : 1, BUP_SAVENAME_LEN);
+
+    // the total goes first, so every save is validated before sending anything
+    for(int i = 0; i < num_names; i++)
+    {
+        char path[1024] = {0};
+        SAVE_METADATA metadata = {0};
+
+        if(headers && savenames && total < 0xFFFF &&
+           bup_get_savename(names[i]->d_name, savename, BUP_SAVENAME_LEN) == SLINGA_SUCCESS &&
+           get_save_path(host, savename, path, sizeof(path)) == SLINGA_SUCCESS &&
+           read_save_header(path, header, &metadata) == SLINGA_SUCCESS)
+        {
+            if(total >= first && returned < count)
+            {
+                memcpy(savenames[returned], savename, BUP_SAVENAME_LEN);
+                memcpy(headers[returned], header, BUP_HEADER_SIZE);
+                returned++;
+            }
+
+            total++;
+        }
+
+        free(names[i]);
+    }
+
+    free(names);
+
+    result = serial_link_write_u16(&host->link, (headers && savenames) ? SLINGA_SUCCESS : SLINGA_NOT_ENOUGH_SPACE);
+
+    if(result == SLINGA_SUCCESS && headers && savenames)
+    {
+        result = serial_link_write_u16(&host->link, (unsigned short)total);
+        if(result == SLINGA_SUCCESS)
+        {
+            result = serial_link_write_u16(&host->link, (unsigned short)returned);
+        }
+
+        for(unsigned int i = 0; i < returned && result == SLINGA_SUCCESS; i++)
+        {
+            result = serial_link_write(&host->link, (const unsigned char*)savenames[i], BUP_SAVENAME_LEN);
+            if(result == SLINGA_SUCCESS)
+            {
+                result = serial_link_write(&host->link, headers[i], BUP_HEADER_SIZE);
+            }
+        }
+    }
+
+    free(headers);
+    free(savenames);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_end_message(&host->link);
+}
+
+static SLINGA_ERROR host_query(PSERIAL_HOST host, unsigned short count)
+{
+    char (*names)[BUP_SAVENAME_LEN] = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = read_names(host, count, 0, &names, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < count && result == SLINGA_SUCCESS; i++)
+    {
+        unsigned char header[BUP_HEADER_SIZE] = {0};
+        SAVE_METADATA metadata = {0};
+        char path[1024] = {0};
+        SLINGA_ERROR save_result = 0;
+
+        save_result = get_save_path(host, names[i], path, sizeof(path));
+        if(save_result == SLINGA_SUCCESS)
+        {
+            save_result = read_save_header(path, header, &metadata);
+        }
+
+        result = serial_link_write_u16(&host->link, (unsigned short)save_result);
+        if(result == SLINGA_SUCCESS && save_result == SLINGA_SUCCESS)
+        {
+            result = serial_link_write(&host->link, header, BUP_HEADER_SIZE);
+        }
+    }
+
+    free(names);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_end_message(&host->link);
+}
+
+static SLINGA_ERROR host_read(PSERIAL_HOST host, unsigned short count)
+{
+    char (*names)[BUP_SAVENAME_LEN] = NULL;
+    unsigned int* sizes = NULL;
+    unsigned char* chunk = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = read_names(host, count, 1, &names, &sizes);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    chunk = malloc(HOST_CHUNK_SIZE);
+
+    for(unsigned int i = 0; i < count && result == SLINGA_SUCCESS; i++)
+    {
+        unsigned char header[BUP_HEADER_SIZE] = {0};
+        SAVE_METADATA metadata = {0};
+        char path[1024] = {0};
+        SLINGA_ERROR save_result = 0;
+        FILE* fp = NULL;
+
+        save_result = chunk ? get_save_path(host, names[i], path, sizeof(path)) : SLINGA_NOT_ENOUGH_SPACE;
+        if(save_result == SLINGA_SUCCESS)
+        {
+            save_result = read_save_header(path, header, &metadata);
+        }
+
+        if(save_result == SLINGA_SUCCESS && metadata.data_size > sizes[i])
+        {
+            save_result = SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        if(save_result == SLINGA_SUCCESS)
+        {
+            fp = fopen(path, "rb");
+            if(!fp || fseek(fp, BUP_HEADER_SIZE, SEEK_SET) != 0)
+            {
+                save_result = SLINGA_NOT_FOUND;
+            }
+        }
+
+        result = serial_link_write_u16(&host->link, (unsigned short)save_result);
+        if(result == SLINGA_SUCCESS && (save_result == SLINGA_SUCCESS || save_result == SLINGA_BUFFER_TOO_SMALL))
+        {
+            result = serial_link_write(&host->link, header, BUP_HEADER_SIZE);
+        }
+
+        if(save_result == SLINGA_SUCCESS)
+        {
+            // stream the data, a short file is padded with zeros to keep the response in sync
+            for(unsigned int offset = 0; offset < metadata.data_size && result == SLINGA_SUCCESS; offset += HOST_CHUNK_SIZE)
+            {
+                unsigned int chunk_size = LIBSLINGA_MIN(HOST_CHUNK_SIZE, metadata.data_size - offset);
+                unsigned int bytes_read = 0;
+
+                bytes_read = (unsigned int)fread(chunk, 1, chunk_size, fp);
+                memset(chunk + bytes_read, 0, chunk_size - bytes_read);
+
+                result = serial_link_write(&host->link, chunk, chunk_size);
+            }
+        }
+
+        if(fp)
+        {
+            fclose(fp);
+        }
+    }
+
+    free(chunk);
+    free(names);
+    free(sizes);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_end_message(&host->link);
+}
+
+static SLINGA_ERROR host_write(PSERIAL_HOST host, unsigned short count)
+{
+    SLINGA_ERROR* results = NULL;
+    unsigned char* chunk = NULL;
+    char dir_path[512] = {0};
+    SLINGA_ERROR result = 0;
+
+    results = calloc(count ? count : 1, sizeof(SLINGA_ERROR));
+    chunk = malloc(HOST_CHUNK_SIZE);
+    if(!results || !chunk)
+    {
+        free(results);
+        free(chunk);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", host->root, SAVES_DIRECTORY);
+    mkdir(dir_path, 0755);
+
+    // each save is written as it streams in, results go back at the end
+    for(unsigned int i = 0; i < count && result == SLINGA_SUCCESS; i++)
+    {
+        unsigned char header[BUP_HEADER_SIZE] = {0};
+        char name[BUP_SAVENAME_LEN + 1] = {0};
+        SAVE_METADATA metadata = {0};
+        char path[1024] = {0};
+        unsigned char flags = 0;
+        struct stat st = {0};
+        FILE* fp = NULL;
+
+        result = serial_link_read_u8(&host->link, &flags);
+        if(result == SLINGA_SUCCESS)
+        {
+            result = serial_link_read(&host->link, (unsigned char*)name, BUP_SAVENAME_LEN);
+        }
+        if(result == SLINGA_SUCCESS)
+        {
+            result = serial_link_read(&host->link, header, BUP_HEADER_SIZE);
+        }
+        if(result == SLINGA_SUCCESS && bup_parse_header(header, BUP_HEADER_SIZE, &metadata) != SLINGA_SUCCESS)
+        {
+            // without the data size we lose track of the request
+            result = SLINGA_SERIAL_PROTOCOL_ERROR;
+        }
+        if(result != SLINGA_SUCCESS)
+        {
+            break;
+        }
+
+        results[i] = get_save_path(host, name, path, sizeof(path));
+
+        if(results[i] == SLINGA_SUCCESS && !(flags & OVERWRITE_EXISTING_SAVE) && stat(path, &st) == 0)
+        {
+            results[i] = SLINGA_FILE_EXISTS;
+        }
+
+        if(results[i] == SLINGA_SUCCESS)
+        {
+            fp = fopen(path, "wb");
+            if(!fp || fwrite(header, 1, BUP_HEADER_SIZE, fp) != BUP_HEADER_SIZE)
+            {
+                results[i] = SLINGA_NOT_ENOUGH_SPACE;
+            }
+        }
+
+        // the data has to be read off the link even if we can't store it
+        for(unsigned int offset = 0; offset < metadata.data_size && result == SLINGA_SUCCESS; offset += HOST_CHUNK_SIZE)
+        {
+            unsigned int chunk_size = LIBSLINGA_MIN(HOST_CHUNK_SIZE, metadata.data_size - offset);
+
+            result = serial_link_read(&host->link, chunk, chunk_size);
+            if(result == SLINGA_SUCCESS && results[i] == SLINGA_SUCCESS && fwrite(chunk, 1, chunk_size, fp) != chunk_size)
+            {
+                results[i] = SLINGA_NOT_ENOUGH_SPACE;
+            }
+        }
+
+        if(fp)
+        {
+            if(fclose(fp) != 0 && results[i] == SLINGA_SUCCESS)
+            {
+                results[i] = SLINGA_NOT_ENOUGH_SPACE;
+            }
+
+            if(results[i] != SLINGA_SUCCESS)
+            {
+                // don't leave half written saves behind
+                remove(path);
+            }
+        }
+    }
+
+    free(chunk);
+
+    if(result == SLINGA_SUCCESS)
+    {
+        result = serial_link_end_read(&host->link);
+    }
+
+    if(result == SLINGA_SUCCESS)
+    {
+        result = send_results(host, results, count);
+    }
+
+    free(results);
+
+    return result;
+}
+
+static SLINGA_ERROR host_delete(PSERIAL_HOST host, unsigned short count)
+{
+    char (*names)[BUP_SAVENAME_LEN] = NULL;
+    SLINGA_ERROR* results = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = read_names(host, count, 0, &names, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    results = calloc(count ? count : 1, sizeof(SLINGA_ERROR));
+    if(!results)
+    {
+        free(names);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        char path[1024] = {0};
+
+        results[i] = get_save_path(host, names[i], path, sizeof(path));
+        if(results[i] == SLINGA_SUCCESS && remove(path) != 0)
+        {
+            results[i] = (errno == ENOENT) ? SLINGA_NOT_FOUND : SLINGA_INVALID_PARAMETER;
+        }
+    }
+
+    result = send_results(host, results, count);
+
+    free(results);
+    free(names);
+
+    return result;
+}
+
+static SLINGA_ERROR host_format(PSERIAL_HOST host)
+{
+    char dir_path[512] = {0};
+    struct dirent** names = NULL;
+    int num_names = 0;
+    SLINGA_ERROR format_result = SLINGA_SUCCESS;
+    SLINGA_ERROR result = 0;
+
+    result = serial_link_end_read(&host->link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    snprintf(dir_path, sizeof(dir_path), "%s/%s", host->root, SAVES_DIRECTORY);
+
+    // only .BUP files are ours to delete
+    num_names = scandir(dir_path, &names, filter_bup, alphasort);
+    for(int i = 0; i < num_names; i++)
+    {
+        char path[1024] = {0};
+
+        snprintf(path, sizeof(path), "%s/%s", dir_path, names[i]->d_name);
+        if(remove(path) != 0)
+        {
+            format_result = SLINGA_INVALID_PARAMETER;
+        }
+
+        free(names[i]);
+    }
+
+    if(num_names >= 0)
+    {
+        free(names);
+    }
+
+    result = serial_link_write_u16(&host->link, (unsigned short)format_result);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return serial_link_end_message(&host->link);
+}
+
+//
+// helper functions
+//
+
+/**
+ * @brief Read the rest of a request made of names (and optionally max sizes)
+ *
+ * @param[out] names count names on success, caller frees
+ * @param[out] sizes count sizes on success if with_size, caller frees
+ */
+static SLINGA_ERROR read_names(PSERIAL_HOST host, unsigned short count, unsigned int with_size, char (**names)[BUP_SAVENAME_LEN], unsigned int** sizes)
+{
+    SLINGA_ERROR result = 0;
+
+    *names = calloc(count ? count : 1, BUP_SAVENAME_LEN);
+    if(sizes)
+    {
+        *sizes = calloc(count ? count : 1, sizeof(unsigned int));
+    }
+
+    if(!*names || (sizes && !*sizes))
+    {
+        free(*names);
+        if(sizes)
+        {
+            free(*sizes);
+        }
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    for(unsigned int i = 0; i < count && result == SLINGA_SUCCESS; i++)
+    {
+        result = serial_link_read(&host->link, (unsigned char*)(*names)[i], BUP_SAVENAME_LEN);
+        if(result == SLINGA_SUCCESS && with_size)
+        {
+            result = serial_link_read_u32(&host->link, &(*sizes)[i]);
+        }
+
+        // names are NULL padded, make sure they are terminated
+        (*names)[i][BUP_SAVENAME_LEN - 1] = '\0';
+    }
+
+    if(result == SLINGA_SUCCESS)
+    {
+        result = serial_link_end_read(&host->link);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        free(*names);
+        if(sizes)
+        {
+            free(*sizes);
+        }
+    }
+
+    return result;
+}
+
+static SLINGA_ERROR send_results(PSERIAL_HOST host, const SLINGA_ERROR* results, unsigned short count)
+{
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        result = serial_link_write_u16(&host->link, (unsigned short)results[i]);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return serial_link_end_message(&host->link);
+}
+
+static SLINGA_ERROR get_save_path(const PSERIAL_HOST host, const char* name, char* path, unsigned int path_size)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    SLINGA_ERROR result = 0;
+    int len = 0;
+
+    // names come off the wire, don't let them escape SATSAVES
+    if(strchr(name, '/') || strchr(name, '\\') || strstr(name, ".."))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = bup_get_savename(name, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    len = snprintf(path, path_size, "%s/%s/%s" BUP_EXTENSION, host->root, SAVES_DIRECTORY, savename);
+    if(len < 0 || (unsigned int)len >= path_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR read_save_header(const char* path, unsigned char* header, PSAVE_METADATA metadata)
+{
+    FILE* fp = NULL;
+    size_t bytes_read = 0;
+
+    fp = fopen(path, "rb");
+    if(!fp)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    bytes_read = fread(header, 1, BUP_HEADER_SIZE, fp);
+    fclose(fp);
+
+    if(bytes_read != BUP_HEADER_SIZE)
+    {
+        return SLINGA_BUP_INVALID_HEADER;
+    }
+
+    return bup_parse_header(header, BUP_HEADER_SIZE, metadata);
+}
+
+static int filter_bup(const struct dirent* entry)
+{
+    // skip hidden files and anything that isn't a save
+    return entry->d_name[0] != '.' && bup_is_bup_filename(entry->d_name) == SLINGA_SUCCESS;
+}
+
+#endif
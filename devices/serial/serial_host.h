@@ -0,0 +1,40 @@
+/** @file serial_host.h
+ *
+ *  @author Slinga
+ *  @brief Host side of the serial link, serves a directory of .BUP files
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#if defined(INCLUDE_SERIAL_HOST) && defined(INCLUDE_SERIAL)
+
+#include "serial.h"
+
+//
+// The host stand-in answers DEVICE_SERIAL requests from a directory on the
+// host (root/SATSAVES/*.BUP). It runs the same link code as the Saturn, so
+// pointing the Saturn side and the host side at the two ends of a socketpair
+// or pty exercises the whole protocol without hardware.
+//
+
+/** @brief SERIAL_PORT backed by a file descriptor (socket, pty, tty) */
+typedef struct _SERIAL_FD_PORT
+{
+    int fd;     ///< @brief Descriptor to read and write
+} SERIAL_FD_PORT, *PSERIAL_FD_PORT;
+
+/** @brief Host stand-in state. Treat as opaque */
+typedef struct _SERIAL_HOST
+{
+    char root[256];     ///< @brief Host directory holding SATSAVES
+    SERIAL_LINK link;   ///< @brief Link to the Saturn
+} SERIAL_HOST, *PSERIAL_HOST;
+
+SLINGA_ERROR Serial_Host_InitFdPort(PSERIAL_FD_PORT fd_port, int fd, PSERIAL_PORT port);
+SLINGA_ERROR Serial_Host_Init(PSERIAL_HOST host, const char* root, PSERIAL_PORT port);
+SLINGA_ERROR Serial_Host_Serve(PSERIAL_HOST host);
+
+#endif
@@ -0,0 +1,815 @@
+/** @file serial_link.c
+ *
+ *  @author Slinga
+ *  @brief Reliable, compressed message stream over a serial port
+ *  @bug No known bugs.
+ */
+#include "serial_link.h"
+#include "../rle/rle01.h"
+
+#ifdef INCLUDE_SERIAL
+
+#define SEQUENCE_AHEAD_MAX 128 ///< @brief Sequence numbers less than this ahead of expected are new frames, the rest are old
+
+/** @brief CRC-16/CCITT (poly 0x1021) lookup, one nibble at a time to keep the table small */
+static const unsigned short CRC16_NIBBLE_TABLE[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+static unsigned short calc_crc16(const unsigned char* buffer, unsigned int size);
+
+// port helpers
+static SLINGA_ERROR port_send(PSERIAL_LINK link, const unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR port_receive(PSERIAL_LINK link, unsigned char* buffer, unsigned int size);
+
+// frame helpers
+static unsigned int finish_frame(unsigned char* frame, SERIAL_FRAME_TYPE type, unsigned char sequence, unsigned char ack, unsigned char flags, unsigned int payload_size);
+static SLINGA_ERROR send_data_frame(PSERIAL_LINK link, unsigned char flags);
+static SLINGA_ERROR send_control_frame(PSERIAL_LINK link, SERIAL_FRAME_TYPE type);
+static SLINGA_ERROR resend_frames(PSERIAL_LINK link);
+static SLINGA_ERROR receive_frame(PSERIAL_LINK link);
+static SLINGA_ERROR accept_data_frame(PSERIAL_LINK link, const unsigned char* frame, unsigned int payload_size);
+static void process_ack(PSERIAL_LINK link, unsigned char ack);
+
+// waiting on the peer
+static SLINGA_ERROR wait_for_window(PSERIAL_LINK link);
+static SLINGA_ERROR wait_for_data(PSERIAL_LINK link, unsigned int max_retries);
+static SLINGA_ERROR handle_timeout(PSERIAL_LINK link, unsigned int* retries, unsigned int max_retries);
+
+/**
+ * @brief Initialize a link
+ *
+ * Both ends of the link must be initialized before either sends.
+ *
+ * @param[out] link Link state
+ * @param[in] port Port to run the link over. Must remain valid while the link is used
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR serial_link_init(PSERIAL_LINK link, PSERIAL_PORT port)
+{
+    if(!link || !port || !port->send || !port->receive)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(link, 0, sizeof(SERIAL_LINK));
+    link->port = port;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Append bytes to the message being sent
+ *
+ * Full frames go out as soon as they fill up, so only the window limits how
+ * far ahead of the peer we get.
+ *
+ * @param[in] link Link
+ * @param[in] buffer Bytes to send
+ * @param[in] size Size of buffer in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR serial_link_write(PSERIAL_LINK link, const unsigned char* buffer, unsigned int size)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!link || (!buffer && size))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(size)
+    {
+        unsigned int copy_size = LIBSLINGA_MIN(size, SERIAL_MAX_PAYLOAD - link->tx_fill);
+
+        memcpy(link->tx_message + link->tx_fill, buffer, copy_size);
+        link->tx_fill += copy_size;
+        link->stats.payload_bytes += copy_size;
+        buffer += copy_size;
+        size -= copy_size;
+
+        if(link->tx_fill == SERIAL_MAX_PAYLOAD)
+        {
+            result = send_data_frame(link, 0);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR serial_link_write_u8(PSERIAL_LINK link, unsigned char val)
+{
+    return serial_link_write(link, &val, sizeof(val));
+}
+
+SLINGA_ERROR serial_link_write_u16(PSERIAL_LINK link, unsigned short val)
+{
+    unsigned char buffer[2] = {0};
+
+    buffer[0] = (unsigned char)(val >> 8);
+    buffer[1] = (unsigned char)val;
+
+    return serial_link_write(link, buffer, sizeof(buffer));
+}
+
+SLINGA_ERROR serial_link_write_u32(PSERIAL_LINK link, unsigned int val)
+{
+    unsigned char buffer[4] = {0};
+
+    buffer[0] = (unsigned char)(val >> 24);
+    buffer[1] = (unsigned char)(val >> 16);
+    buffer[2] = (unsigned char)(val >> 8);
+    buffer[3] = (unsigned char)val;
+
+    return serial_link_write(link, buffer, sizeof(buffer));
+}
+
+/**
+ * @brief Send whatever is left of the message and mark it finished
+ *
+ * Doesn't wait for the peer to ack. The response to the message is the ack.
+ *
+ * @param[in] link Link
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR serial_link_end_message(PSERIAL_LINK link)
+{
+    if(!link)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    return send_data_frame(link, SERIAL_FLAG_END);
+}
+
+/**
+ * @brief Wait until the peer acked every frame we sent
+ *
+ * @param[in] link Link
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR serial_link_flush(PSERIAL_LINK link)
+{
+    unsigned int retries = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!link)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(link->tx_base != link->tx_next)
+    {
+        result = receive_frame(link);
+        if(result == SLINGA_SERIAL_TIMEOUT)
+        {
+            result = handle_timeout(link, &retries, SERIAL_MAX_RETRIES);
+        }
+        else if(result == SLINGA_SUCCESS)
+        {
+            retries = 0;
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Wait, without giving up, for the peer to start a message
+ *
+ * Used by the side that serves requests. Unacked frames are still resent, and
+ * still time out.
+ *
+ * @param[in] link Link
+ *
+ * @return SLINGA_SUCCESS once the first frame of a message arrived
+ */
+SLINGA_ERROR serial_link_wait_message(PSERIAL_LINK link)
+{
+    if(!link)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    return wait_for_data(link, 0);
+}
+
+/**
+ * @brief Read bytes from the message being received
+ *
+ * @param[in] link Link
+ * @param[out] buffer Received bytes on success
+ * @param[in] size Bytes to read
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_SERIAL_PROTOCOL_ERROR if the message is shorter than size
+ */
+SLINGA_ERROR serial_link_read(PSERIAL_LINK link, unsigned char* buffer, unsigned int size)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!link || (!buffer && size))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(size)
+    {
+        unsigned int copy_size = 0;
+
+        if(link->rx_ready && link->rx_pos == link->rx_size)
+        {
+            if(link->rx_end)
+            {
+                // caller expected more than the peer sent
+                return SLINGA_SERIAL_PROTOCOL_ERROR;
+            }
+
+            // done with this frame
+            link->rx_ready = 0;
+        }
+
+        if(!link->rx_ready)
+        {
+            result = wait_for_data(link, SERIAL_MAX_RETRIES);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+        }
+
+        copy_size = LIBSLINGA_MIN(size, link->rx_size - link->rx_pos);
+
+        memcpy(buffer, link->rx_payload + link->rx_pos, copy_size);
+        link->rx_pos += copy_size;
+        buffer += copy_size;
+        size -= copy_size;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR serial_link_read_u8(PSERIAL_LINK link, unsigned char* val)
+{
+    return serial_link_read(link, val, sizeof(*val));
+}
+
+SLINGA_ERROR serial_link_read_u16(PSERIAL_LINK link, unsigned short* val)
+{
+    unsigned char buffer[2] = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!val)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = serial_link_read(link, buffer, sizeof(buffer));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    *val = (unsigned short)((buffer[0] << 8) | buffer[1]);
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR serial_link_read_u32(PSERIAL_LINK link, unsigned int* val)
+{
+    unsigned char buffer[4] = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!val)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = serial_link_read(link, buffer, sizeof(buffer));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    *val = ((unsigned int)buffer[0] << 24) | ((unsigned int)buffer[1] << 16) | ((unsigned int)buffer[2] << 8) | buffer[3];
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Read and throw away bytes from the message being received
+ *
+ * @param[in] link Link
+ * @param[in] size Bytes to skip
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR serial_link_skip(PSERIAL_LINK link, unsigned int size)
+{
+    unsigned char buffer[64] = {0};
+    SLINGA_ERROR result = 0;
+
+    while(size)
+    {
+        unsigned int skip_size = LIBSLINGA_MIN(size, sizeof(buffer));
+
+        result = serial_link_read(link, buffer, skip_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        size -= skip_size;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Finish the message being received, dropping anything not read
+ *
+ * @param[in] link Link
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR serial_link_end_read(PSERIAL_LINK link)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!link)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    while(1)
+    {
+        if(!link->rx_ready)
+        {
+            result = wait_for_data(link, SERIAL_MAX_RETRIES);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+        }
+
+        link->rx_ready = 0;
+
+        if(link->rx_end)
+        {
+            link->rx_end = 0;
+            return SLINGA_SUCCESS;
+        }
+    }
+}
+
+//
+// helper functions
+//
+
+static unsigned short calc_crc16(const unsigned char* buffer, unsigned int size)
+{
+    unsigned short crc = 0xFFFF;
+
+    for(unsigned int i = 0; i < size; i++)
+    {
+        crc = (unsigned short)((crc << 4) ^ CRC16_NIBBLE_TABLE[(crc >> 12) ^ (buffer[i] >> 4)]);
+        crc = (unsigned short)((crc << 4) ^ CRC16_NIBBLE_TABLE[(crc >> 12) ^ (buffer[i] & 0x0F)]);
+    }
+
+    return crc;
+}
+
+static SLINGA_ERROR port_send(PSERIAL_LINK link, const unsigned char* buffer, unsigned int size)
+{
+    SLINGA_ERROR result = 0;
+
+    result = link->port->send(link->port->context, buffer, size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return SLINGA_SERIAL_PORT_ERROR;
+    }
+
+    link->stats.wire_bytes += size;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Read exactly size bytes from the port
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_SERIAL_TIMEOUT if the port went quiet
+ */
+static SLINGA_ERROR port_receive(PSERIAL_LINK link, unsigned char* buffer, unsigned int size)
+{
+    SLINGA_ERROR result = 0;
+
+    while(size)
+    {
+        unsigned int copy_size = 0;
+
+        if(link->rx_bytes_pos == link->rx_bytes_size)
+        {
+            unsigned int bytes_received = 0;
+
+            link->rx_bytes_pos = 0;
+            link->rx_bytes_size = 0;
+
+            result = link->port->receive(link->port->context, link->rx_bytes, sizeof(link->rx_bytes), SERIAL_TIMEOUT_MS, &bytes_received);
+            if(result != SLINGA_SUCCESS || bytes_received > sizeof(link->rx_bytes))
+            {
+                return SLINGA_SERIAL_PORT_ERROR;
+            }
+
+            if(!bytes_received)
+            {
+                link->stats.timeouts++;
+                return SLINGA_SERIAL_TIMEOUT;
+            }
+
+            link->rx_bytes_size = bytes_received;
+        }
+
+        copy_size = LIBSLINGA_MIN(size, link->rx_bytes_size - link->rx_bytes_pos);
+
+        memcpy(buffer, link->rx_bytes + link->rx_bytes_pos, copy_size);
+        link->rx_bytes_pos += copy_size;
+        buffer += copy_size;
+        size -= copy_size;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Fill out the frame header and CRC around a payload already in place
+ *
+ * @return Size of the frame in bytes
+ */
+static unsigned int finish_frame(unsigned char* frame, SERIAL_FRAME_TYPE type, unsigned char sequence, unsigned char ack, unsigned char flags, unsigned int payload_size)
+{
+    unsigned short crc = 0;
+
+    frame[0] = SERIAL_SYNC_1;
+    frame[1] = SERIAL_SYNC_2;
+    frame[2] = (unsigned char)type;
+    frame[3] = sequence;
+    frame[4] = ack;
+    frame[5] = flags;
+    frame[6] = (unsigned char)(payload_size >> 8);
+    frame[7] = (unsigned char)payload_size;
+
+    // sync bytes aren't covered
+    crc = calc_crc16(frame + 2, SERIAL_FRAME_HEADER_SIZE - 2 + payload_size);
+
+    frame[SERIAL_FRAME_HEADER_SIZE + payload_size] = (unsigned char)(crc >> 8);
+    frame[SERIAL_FRAME_HEADER_SIZE + payload_size + 1] = (unsigned char)crc;
+
+    return SERIAL_FRAME_HEADER_SIZE + payload_size + SERIAL_FRAME_CRC_SIZE;
+}
+
+/**
+ * @brief Turn tx_message into a data frame, keep it for resends and send it
+ */
+static SLINGA_ERROR send_data_frame(PSERIAL_LINK link, unsigned char flags)
+{
+    unsigned int slot = 0;
+    unsigned char* frame = NULL;
+    unsigned char* payload = NULL;
+    unsigned int payload_size = 0;
+    SLINGA_ERROR result = 0;
+
+    result = wait_for_window(link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    slot = link->tx_next % SERIAL_WINDOW;
+    frame = link->tx_frames[slot];
+    payload = frame + SERIAL_FRAME_HEADER_SIZE;
+
+    // compressed payload is the key byte plus the RLE01 data, only worth it if that's smaller
+    if(link->tx_fill > 2)
+    {
+        unsigned char rle_key = 0;
+        unsigned int compressed_size = 0;
+
+        rle01_find_key(link->tx_message, link->tx_fill, &rle_key);
+
+        result = rle01_compress(rle_key, link->tx_message, link->tx_fill, payload + 1, link->tx_fill - 2, &compressed_size);
+        if(result == SLINGA_SUCCESS)
+        {
+            payload[0] = rle_key;
+            payload_size = compressed_size + 1;
+            flags |= SERIAL_FLAG_COMPRESSED;
+        }
+    }
+
+    if(!(flags & SERIAL_FLAG_COMPRESSED))
+    {
+        memcpy(payload, link->tx_message, link->tx_fill);
+        payload_size = link->tx_fill;
+    }
+
+    link->tx_sizes[slot] = (unsigned short)finish_frame(frame, SERIAL_FRAME_DATA, link->tx_next, link->rx_expected, flags, payload_size);
+    link->tx_next++;
+    link->tx_fill = 0;
+    link->stats.frames_sent++;
+
+    return port_send(link, frame, link->tx_sizes[slot]);
+}
+
+static SLINGA_ERROR send_control_frame(PSERIAL_LINK link, SERIAL_FRAME_TYPE type)
+{
+    unsigned char frame[SERIAL_FRAME_HEADER_SIZE + SERIAL_FRAME_CRC_SIZE] = {0};
+    unsigned int size = 0;
+
+    size = finish_frame(frame, type, link->tx_next, link->rx_expected, 0, 0);
+
+    return port_send(link, frame, size);
+}
+
+/**
+ * @brief Go back N, send every unacked frame again
+ */
+static SLINGA_ERROR resend_frames(PSERIAL_LINK link)
+{
+    SLINGA_ERROR result = 0;
+
+    for(unsigned char sequence = link->tx_base; sequence != link->tx_next; sequence++)
+    {
+        unsigned int slot = sequence % SERIAL_WINDOW;
+        unsigned char* frame = link->tx_frames[slot];
+        unsigned int payload_size = (frame[6] << 8) | frame[7];
+
+        // the piggybacked ack may be stale, refresh it
+        finish_frame(frame, SERIAL_FRAME_DATA, sequence, link->rx_expected, frame[5], payload_size);
+
+        result = port_send(link, frame, link->tx_sizes[slot]);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        link->stats.resends++;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Receive and process a single frame
+ *
+ * @return SLINGA_SUCCESS if a frame was received, even if it was dropped. SLINGA_SERIAL_TIMEOUT if nothing arrived
+ */
+static SLINGA_ERROR receive_frame(PSERIAL_LINK link)
+{
+    unsigned char* frame = link->rx_frame;
+    unsigned int payload_size = 0;
+    unsigned short crc = 0;
+    SLINGA_ERROR result = 0;
+
+    // hunt for the sync bytes
+    frame[1] = 0;
+    do
+    {
+        frame[0] = frame[1];
+
+        result = port_receive(link, &frame[1], 1);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    } while(frame[0] != SERIAL_SYNC_1 || frame[1] != SERIAL_SYNC_2);
+
+    result = port_receive(link, frame + 2, SERIAL_FRAME_HEADER_SIZE - 2);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    payload_size = (frame[6] << 8) | frame[7];
+    if(payload_size > SERIAL_MAX_PAYLOAD)
+    {
+        // corrupt length, NAK it and resync on the next frame
+        link->stats.crc_errors++;
+        goto bad_frame;
+    }
+
+    result = port_receive(link, frame + SERIAL_FRAME_HEADER_SIZE, payload_size + SERIAL_FRAME_CRC_SIZE);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    crc = (unsigned short)((frame[SERIAL_FRAME_HEADER_SIZE + payload_size] << 8) | frame[SERIAL_FRAME_HEADER_SIZE + payload_size + 1]);
+    if(crc != calc_crc16(frame + 2, SERIAL_FRAME_HEADER_SIZE - 2 + payload_size))
+    {
+        link->stats.crc_errors++;
+        goto bad_frame;
+    }
+
+    // every frame type carries an ack
+    process_ack(link, frame[4]);
+
+    switch(frame[2])
+    {
+        case SERIAL_FRAME_DATA:
+            return accept_data_frame(link, frame, payload_size);
+
+        case SERIAL_FRAME_NAK:
+            return resend_frames(link);
+
+        default:
+            return SLINGA_SUCCESS;
+    }
+
+bad_frame:
+
+    if(!link->rx_nak_sent)
+    {
+        link->rx_nak_sent = 1;
+        return send_control_frame(link, SERIAL_FRAME_NAK);
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR accept_data_frame(PSERIAL_LINK link, const unsigned char* frame, unsigned int payload_size)
+{
+    unsigned char sequence = frame[3];
+    unsigned char flags = frame[5];
+    const unsigned char* payload = frame + SERIAL_FRAME_HEADER_SIZE;
+    SLINGA_ERROR result = 0;
+
+    if(sequence != link->rx_expected)
+    {
+        if((unsigned char)(sequence - link->rx_expected) < SEQUENCE_AHEAD_MAX)
+        {
+            // we missed a frame, ask for a resend once per gap
+            if(!link->rx_nak_sent)
+            {
+                link->rx_nak_sent = 1;
+                return send_control_frame(link, SERIAL_FRAME_NAK);
+            }
+
+            return SLINGA_SUCCESS;
+        }
+
+        // a resend of a frame we already have, our ack must have been lost
+        return send_control_frame(link, SERIAL_FRAME_ACK);
+    }
+
+    if(link->rx_ready)
+    {
+        // no room until the caller reads the last frame, the peer will resend
+        return SLINGA_SUCCESS;
+    }
+
+    if(flags & SERIAL_FLAG_COMPRESSED)
+    {
+        if(!payload_size)
+        {
+            return SLINGA_SERIAL_PROTOCOL_ERROR;
+        }
+
+        result = rle01_decompress(payload[0], payload + 1, payload_size - 1, link->rx_payload, sizeof(link->rx_payload), &link->rx_size);
+        if(result != SLINGA_SUCCESS)
+        {
+            // the CRC matched so the peer sent this, it's not line noise
+            return SLINGA_SERIAL_PROTOCOL_ERROR;
+        }
+    }
+    else
+    {
+        memcpy(link->rx_payload, payload, payload_size);
+        link->rx_size = payload_size;
+    }
+
+    link->rx_pos = 0;
+    link->rx_ready = 1;
+    link->rx_end = (flags & SERIAL_FLAG_END) ? 1 : 0;
+    link->rx_expected++;
+    link->rx_nak_sent = 0;
+    link->stats.frames_received++;
+
+    // ack often enough that the sender's window never closes
+    if(link->rx_end || (link->rx_expected % (SERIAL_WINDOW / 2)) == 0)
+    {
+        return send_control_frame(link, SERIAL_FRAME_ACK);
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static void process_ack(PSERIAL_LINK link, unsigned char ack)
+{
+    // ignore acks outside of the frames in flight
+    if((unsigned char)(ack - link->tx_base) <= (unsigned char)(link->tx_next - link->tx_base))
+    {
+        link->tx_base = ack;
+    }
+}
+
+static SLINGA_ERROR wait_for_window(PSERIAL_LINK link)
+{
+    unsigned int retries = 0;
+    SLINGA_ERROR result = 0;
+
+    while((unsigned char)(link->tx_next - link->tx_base) >= SERIAL_WINDOW)
+    {
+        result = receive_frame(link);
+        if(result == SLINGA_SERIAL_TIMEOUT)
+        {
+            result = handle_timeout(link, &retries, SERIAL_MAX_RETRIES);
+        }
+        else if(result == SLINGA_SUCCESS)
+        {
+            retries = 0;
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Wait for a data frame to be accepted into rx_payload
+ *
+ * @param[in] max_retries Give up after this many timeouts in a row. 0 to wait forever while nothing is unacked
+ */
+static SLINGA_ERROR wait_for_data(PSERIAL_LINK link, unsigned int max_retries)
+{
+    unsigned int retries = 0;
+    SLINGA_ERROR result = 0;
+
+    while(!link->rx_ready)
+    {
+        result = receive_frame(link);
+        if(result == SLINGA_SERIAL_TIMEOUT)
+        {
+            if(!max_retries && link->tx_base == link->tx_next)
+            {
+                // idle, nothing to resend
+                continue;
+            }
+
+            result = handle_timeout(link, &retries, max_retries ? max_retries : SERIAL_MAX_RETRIES);
+        }
+        else if(result == SLINGA_SUCCESS)
+        {
+            retries = 0;
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief The port went quiet. Nudge the peer by resending and NAKing
+ */
+static SLINGA_ERROR handle_timeout(PSERIAL_LINK link, unsigned int* retries, unsigned int max_retries)
+{
+    SLINGA_ERROR result = 0;
+
+    (*retries)++;
+    if(*retries > max_retries)
+    {
+        return SLINGA_SERIAL_TIMEOUT;
+    }
+
+    // either our frames or the peer's ack got lost
+    result = resend_frames(link);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // or the peer's frames got lost
+    return send_control_frame(link, SERIAL_FRAME_NAK);
+}
+
+#endif
@@ -0,0 +1,143 @@
+/** @file serial_link.h
+ *
+ *  @author Slinga
+ *  @brief Reliable, compressed message stream over a serial port
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#ifdef INCLUDE_SERIAL
+
+#include "../../libslinga.h"
+
+//
+// The serial link turns an unreliable byte stream into reliable messages. The
+// same code runs on the Saturn and on the host stand-in.
+//
+// Messages are split into frames of up to SERIAL_MAX_PAYLOAD bytes:
+// 0x00 sync (0x5A 0xA5)
+// 0x02 type (SERIAL_FRAME_DATA, SERIAL_FRAME_ACK, SERIAL_FRAME_NAK)
+// 0x03 sequence number
+// 0x04 ack, the next sequence number the sender expects to receive
+// 0x05 flags (SERIAL_FLAG_END, SERIAL_FLAG_COMPRESSED)
+// 0x06 payload length, big-endian
+// 0x08 payload
+// .... CRC-16/CCITT of type through payload, big-endian
+//
+// Frames are sent go-back-N with up to SERIAL_WINDOW frames in flight, so the
+// sender never stops to wait for an ack while the window has room. The
+// receiver acks every SERIAL_WINDOW / 2 frames and the last frame of each
+// message, and NAKs the first bad or missing frame so the sender can resend
+// without waiting for a timeout. Acks also ride along on data frames.
+//
+// Payloads are RLE01 compressed when that makes them smaller. Save data is
+// mostly runs of zeros and 0xFF, which RLE01 is good at.
+//
+
+#define SERIAL_SYNC_1               0x5A
+#define SERIAL_SYNC_2               0xA5
+#define SERIAL_WINDOW               8       ///< @brief Maximum unacked frames. Must be a power of 2 less than 128
+#define SERIAL_MAX_PAYLOAD          1024    ///< @brief Maximum message bytes per frame
+#define SERIAL_FRAME_HEADER_SIZE    8
+#define SERIAL_FRAME_CRC_SIZE       2
+#define SERIAL_MAX_FRAME            (SERIAL_FRAME_HEADER_SIZE + SERIAL_MAX_PAYLOAD + SERIAL_FRAME_CRC_SIZE)
+#define SERIAL_TIMEOUT_MS           500     ///< @brief Time to wait on the port before resending
+#define SERIAL_MAX_RETRIES          8       ///< @brief Consecutive timeouts before giving up
+#define SERIAL_RX_BUFFER_SIZE       256     ///< @brief Bytes pulled from the port at a time
+
+/** @brief Frame types */
+typedef enum
+{
+    SERIAL_FRAME_DATA = 1,      ///< @brief Part of a message
+    SERIAL_FRAME_ACK = 2,       ///< @brief Acknowledges every frame before ack
+    SERIAL_FRAME_NAK = 3,       ///< @brief Acknowledges every frame before ack and asks for the rest to be resent
+} SERIAL_FRAME_TYPE;
+
+/** @brief Frame flags */
+typedef enum
+{
+    SERIAL_FLAG_END = 1 << 0,           ///< @brief Last frame of a message
+    SERIAL_FLAG_COMPRESSED = 1 << 1,    ///< @brief Payload is the RLE01 key followed by RLE01 data
+} SERIAL_FRAME_FLAGS;
+
+/** @brief Byte stream the link runs over. Can be a real serial port, a socket, a pty, etc */
+typedef struct _SERIAL_PORT
+{
+    void* context;  ///< @brief Passed to send() and receive()
+
+    /**
+     * @brief Send all size bytes of buffer
+     * @return SLINGA_SUCCESS on success
+     */
+    SLINGA_ERROR (*send)(void* context, const unsigned char* buffer, unsigned int size);
+
+    /**
+     * @brief Receive up to size bytes, waiting at most timeout_ms for the first one
+     * @return SLINGA_SUCCESS on success. A timeout is a success with bytes_received set to 0
+     */
+    SLINGA_ERROR (*receive)(void* context, unsigned char* buffer, unsigned int size, unsigned int timeout_ms, unsigned int* bytes_received);
+} SERIAL_PORT, *PSERIAL_PORT;
+
+/** @brief Link counters */
+typedef struct _SERIAL_LINK_STATS
+{
+    unsigned int frames_sent;       ///< @brief Data frames sent, not counting resends
+    unsigned int frames_received;   ///< @brief Data frames accepted
+    unsigned int resends;           ///< @brief Data frames sent again
+    unsigned int crc_errors;        ///< @brief Frames dropped for a bad CRC or length
+    unsigned int timeouts;          ///< @brief Port waits that timed out
+    unsigned int payload_bytes;     ///< @brief Message bytes sent
+    unsigned int wire_bytes;        ///< @brief Bytes sent on the port, including framing, acks and resends
+} SERIAL_LINK_STATS, *PSERIAL_LINK_STATS;
+
+/** @brief Link state. Treat as opaque */
+typedef struct _SERIAL_LINK
+{
+    PSERIAL_PORT port;                                      ///< @brief Port the link runs over
+    SERIAL_LINK_STATS stats;                                ///< @brief Counters
+
+    // transmit
+    unsigned char tx_frames[SERIAL_WINDOW][SERIAL_MAX_FRAME]; ///< @brief Encoded frames kept until acked
+    unsigned short tx_sizes[SERIAL_WINDOW];                 ///< @brief Size of each encoded frame
+    unsigned char tx_base;                                  ///< @brief Oldest unacked sequence number
+    unsigned char tx_next;                                  ///< @brief Next sequence number to send
+    unsigned char tx_message[SERIAL_MAX_PAYLOAD];           ///< @brief Message bytes not yet framed
+    unsigned int tx_fill;                                   ///< @brief Bytes in tx_message
+
+    // receive
+    unsigned char rx_expected;                              ///< @brief Next sequence number we accept
+    unsigned char rx_nak_sent;                              ///< @brief 1 if we already NAKed the current gap
+    unsigned char rx_frame[SERIAL_MAX_FRAME];               ///< @brief Frame being received
+    unsigned char rx_payload[SERIAL_MAX_PAYLOAD];           ///< @brief Payload of the last accepted data frame
+    unsigned int rx_size;                                   ///< @brief Bytes in rx_payload
+    unsigned int rx_pos;                                    ///< @brief Bytes of rx_payload already read
+    unsigned char rx_ready;                                 ///< @brief 1 if rx_payload holds an accepted frame
+    unsigned char rx_end;                                   ///< @brief 1 if rx_payload is the last frame of a message
+    unsigned char rx_bytes[SERIAL_RX_BUFFER_SIZE];          ///< @brief Raw bytes pulled from the port
+    unsigned int rx_bytes_size;                             ///< @brief Bytes in rx_bytes
+    unsigned int rx_bytes_pos;                              ///< @brief Bytes of rx_bytes already parsed
+} SERIAL_LINK, *PSERIAL_LINK;
+
+SLINGA_ERROR serial_link_init(PSERIAL_LINK link, PSERIAL_PORT port);
+
+// sending a message
+SLINGA_ERROR serial_link_write(PSERIAL_LINK link, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR serial_link_write_u8(PSERIAL_LINK link, unsigned char val);
+SLINGA_ERROR serial_link_write_u16(PSERIAL_LINK link, unsigned short val);
+SLINGA_ERROR serial_link_write_u32(PSERIAL_LINK link, unsigned int val);
+SLINGA_ERROR serial_link_end_message(PSERIAL_LINK link);
+SLINGA_ERROR serial_link_flush(PSERIAL_LINK link);
+
+// receiving a message
+SLINGA_ERROR serial_link_wait_message(PSERIAL_LINK link);
+SLINGA_ERROR serial_link_read(PSERIAL_LINK link, unsigned char* buffer, unsigned int size);
+SLINGA_ERROR serial_link_read_u8(PSERIAL_LINK link, unsigned char* val);
+SLINGA_ERROR serial_link_read_u16(PSERIAL_LINK link, unsigned short* val);
+SLINGA_ERROR serial_link_read_u32(PSERIAL_LINK link, unsigned int* val);
+SLINGA_ERROR serial_link_skip(PSERIAL_LINK link, unsigned int size);
+SLINGA_ERROR serial_link_end_read(PSERIAL_LINK link);
+
+#endif
@@ -0,0 +1,1194 @@
+/** @file span.c
+ *
+ *  @author Slinga
+ *  @brief Virtual device spanning several backup devices
+ *  @bug Saves are limited to SPAN_MAX_SAVES across all members.
+ */
+#include "span.h"
+
+#ifdef INCLUDE_SPAN
+
+#include "../../libslinga/payload_cache.h"
+
+DEVICE_HANDLER g_Span_Handler = {0};
+
+/** @brief Member devices */
+SPAN_MEMBER g_Span_Members[SPAN_MAX_MEMBERS] = {{DEVICE_INTERNAL, 0}, {DEVICE_CARTRIDGE, 1}};
+unsigned int g_Span_Num_Members = 2;
+
+/** @brief Cached stat of each member */
+BACKUP_STAT g_Span_Member_Stat[SPAN_MAX_MEMBERS] = {0};
+unsigned char g_Span_Member_Stat_Valid[SPAN_MAX_MEMBERS] = {0};
+
+/** @brief Merged directory sorted by save name, g_Span_Owner holds the member index of each save */
+SAVE_METADATA g_Span_Saves[SPAN_MAX_SAVES] = {0};
+unsigned char g_Span_Owner[SPAN_MAX_SAVES] = {0};
+
+/** @brief Access clock of each save, 0 if not read or written since the directory was built */
+unsigned int g_Span_Last_Used[SPAN_MAX_SAVES] = {0};
+unsigned int g_Span_Clock = 0;
+unsigned int g_Span_Num_Saves = 0;
+unsigned char g_Span_Index_Valid = 0;
+
+/** @brief Saves hidden behind a same named save on an earlier member */
+unsigned int g_Span_Num_Hidden = 0;
+
+/** @brief One page of a member's listing while building the directory */
+SAVE_METADATA g_Span_Page[SLINGA_LIST_PAGE_LEN] = {0};
+
+/** @brief Tiering settings, disabled while g_Span_Tier_Buffer is NULL */
+unsigned char* g_Span_Tier_Buffer = NULL;
+unsigned int g_Span_Tier_Buffer_Size = 0;
+unsigned int g_Span_Tier_Max_Moves = 0;
+SPAN_TIER_STATS g_Span_Tier_Stats = {0};
+
+static SLINGA_ERROR load_index(void);
+static SLINGA_ERROR find_save(const char* savename, unsigned int* index);
+static SLINGA_ERROR insert_save(const PSAVE_METADATA metadata, unsigned int member, unsigned int* index);
+static void remove_save(unsigned int index);
+static SLINGA_ERROR refresh_save(unsigned int member, const char* savename);
+static SLINGA_ERROR get_member_stat(unsigned int member, PBACKUP_STAT* stat);
+static SLINGA_ERROR pick_member(unsigned int size, unsigned int excluded, unsigned int* member);
+static SLINGA_ERROR is_member_usable(unsigned int member);
+static SLINGA_ERROR find_primary(unsigned int* member);
+static void touch_save(unsigned int index);
+static SLINGA_ERROR write_tiered(FLAGS flags, const char* filename, const char* savename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size, unsigned int* member);
+static SLINGA_ERROR pick_victim(unsigned int member, const char* savename, unsigned int* index);
+static SLINGA_ERROR move_save(unsigned int index);
+
+SLINGA_ERROR Span_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!device_handler)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_Span_Handler.init = Span_Init;
+    g_Span_Handler.fini = Span_Fini;
+    g_Span_Handler.get_device_name = Span_GetDeviceName;
+    g_Span_Handler.is_present = Span_IsPresent;
+    g_Span_Handler.is_readable = Span_IsReadable;
+    g_Span_Handler.is_writeable = Span_IsWriteable;
+    g_Span_Handler.stat = Span_Stat;
+    g_Span_Handler.query_file = Span_QueryFile;
+    g_Span_Handler.list = Span_List;
+    g_Span_Handler.list_page = Span_ListPage;
+    g_Span_Handler.read = Span_Read;
+    g_Span_Handler.write = Span_Write;
+    g_Span_Handler.delete = Span_Delete;
+    g_Span_Handler.format = Span_Format;
+
+    *device_handler = &g_Span_Handler;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Choose the devices making up the span. Defaults to internal (latency 0) and cartridge (latency 1)
+ *
+ * @param[in] members Member devices. Order matters when two members hold the same save name
+ * @param[in] num_members Number of members, at most SPAN_MAX_MEMBERS
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Span_SetMembers(const SPAN_MEMBER* members, unsigned int num_members)
+{
+    if(!members || !num_members || num_members > SPAN_MAX_MEMBERS)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    for(unsigned int i = 0; i < num_members; i++)
+    {
+        if(members[i].device_type < 0 || members[i].device_type >= MAX_DEVICE_TYPE || members[i].device_type == DEVICE_SPAN)
+        {
+            return SLINGA_INVALID_DEVICE_TYPE;
+        }
+
+        for(unsigned int j = 0; j < i; j++)
+        {
+            if(members[i].device_type == members[j].device_type)
+            {
+                return SLINGA_INVALID_PARAMETER;
+            }
+        }
+    }
+
+    memcpy(g_Span_Members, members, num_members * sizeof(SPAN_MEMBER));
+    g_Span_Num_Members = num_members;
+
+    return Span_Invalidate();
+}
+
+/**
+ * @brief Drop the merged directory, every cached member stat and the span's cached saves
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Span_Invalidate(void)
+{
+    g_Span_Index_Valid = 0;
+    g_Span_Num_Saves = 0;
+    g_Span_Num_Hidden = 0;
+    memset(g_Span_Member_Stat_Valid, 0, sizeof(g_Span_Member_Stat_Valid));
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    // the members changed or were written behind our back
+    Slinga_InvalidatePayloadCache(DEVICE_SPAN);
+#endif
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Turn tiering on or off
+ *
+ * @param[in] buffer Scratch for moving saves, NULL to turn tiering off. Saves larger than buffer_size aren't moved
+ * @param[in] buffer_size Size of buffer in bytes
+ * @param[in] max_moves Most saves moved to make room for one write
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Span_SetTiering(unsigned char* buffer, unsigned int buffer_size, unsigned int max_moves)
+{
+    if(buffer && (!buffer_size || !max_moves))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_Span_Tier_Buffer = buffer;
+    g_Span_Tier_Buffer_Size = buffer ? buffer_size : 0;
+    g_Span_Tier_Max_Moves = buffer ? max_moves : 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Get the tiering counters
+ *
+ * @param[out] stats Counters since Slinga_Init()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Span_GetTierStats(PSPAN_TIER_STATS stats)
+{
+    if(!stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memcpy(stats, &g_Span_Tier_Stats, sizeof(SPAN_TIER_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_Init(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    memset(&g_Span_Tier_Stats, 0, sizeof(g_Span_Tier_Stats));
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_Fini(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return Span_Invalidate();
+}
+
+SLINGA_ERROR Span_GetDeviceName(DEVICE_TYPE device_type, char** device_name)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!device_name)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    *device_name = "Spanned Devices";
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_IsPresent(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    // not cached in g_Context, members come and go
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        if(Slinga_IsPresent(g_Span_Members[i].device_type) == SLINGA_SUCCESS)
+        {
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_DEVICE_NOT_PRESENT;
+}
+
+SLINGA_ERROR Span_IsReadable(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_IsWriteable(DEVICE_TYPE device_type)
+{
+    if(device_type != DEVICE_SPAN)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        if(is_member_usable(i) == SLINGA_SUCCESS)
+        {
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_SUPPORTED;
+}
+
+SLINGA_ERROR Span_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
+{
+    unsigned int max_saves = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stat)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    memset(stat, 0, sizeof(BACKUP_STAT));
+
+    //
+    // members use different block sizes, report bytes in BUP_BLOCK_SIZE units
+    //
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        PBACKUP_STAT member_stat = NULL;
+
+        if(get_member_stat(i, &member_stat) != SLINGA_SUCCESS)
+        {
+            // member not present
+            continue;
+        }
+
+        stat->total_bytes += member_stat->total_bytes;
+
+        // read-only members count towards capacity, not free space
+        if(is_member_usable(i) == SLINGA_SUCCESS)
+        {
+            stat->free_bytes += member_stat->free_bytes;
+            max_saves += member_stat->max_saves_possible;
+        }
+    }
+
+    stat->block_size = BUP_BLOCK_SIZE;
+    stat->total_blocks = stat->total_bytes / BUP_BLOCK_SIZE;
+    stat->free_blocks = stat->free_bytes / BUP_BLOCK_SIZE;
+    stat->max_saves_possible = LIBSLINGA_MIN(max_saves, SPAN_MAX_SAVES - g_Span_Num_Saves);
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !save)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = bup_get_savename(filename, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(savename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    memcpy(save, &g_Span_Saves[index], sizeof(SAVE_METADATA));
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(saves)
+    {
+        if(g_Span_Num_Saves > num_saves)
+        {
+            // no more room in our saves array
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        memcpy(saves, g_Span_Saves, g_Span_Num_Saves * sizeof(SAVE_METADATA));
+    }
+
+    if(saves_found)
+    {
+        *saves_found = g_Span_Num_Saves;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    unsigned int found = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(flags);
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // the cursor is the merged directory index to resume from
+    if(cursor < g_Span_Num_Saves)
+    {
+        found = LIBSLINGA_MIN(page_len, g_Span_Num_Saves - cursor);
+        memcpy(page, &g_Span_Saves[cursor], found * sizeof(SAVE_METADATA));
+    }
+
+    *saves_found = found;
+    *next_cursor = (cursor + found < g_Span_Num_Saves) ? cursor + found : SLINGA_LIST_END;
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !buffer || !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = bup_get_savename(filename, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(savename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    touch_save(index);
+
+    // every device accepts the bare save name
+    return Slinga_Read(g_Span_Members[g_Span_Owner[index]].device_type, flags, savename, buffer, size, bytes_read);
+}
+
+SLINGA_ERROR Span_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    unsigned int index = 0;
+    unsigned int member = 0;
+    unsigned int old_member = 0;
+    unsigned int excluded = 0;
+    unsigned char exists = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename || !save_metadata || !buffer || !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = bup_get_savename(filename, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(find_save(savename, &index) == SLINGA_SUCCESS)
+    {
+        if(!(flags & OVERWRITE_EXISTING_SAVE))
+        {
+            return SLINGA_FILE_EXISTS;
+        }
+
+        exists = 1;
+        old_member = g_Span_Owner[index];
+
+        // replace it where it is if it still fits. With tiering a save on a slower member is brought back instead
+        if(!g_Span_Tier_Buffer || find_primary(&member) != SLINGA_SUCCESS || member == old_member)
+        {
+            result = Slinga_Write(g_Span_Members[old_member].device_type, flags, filename, save_metadata, buffer, size);
+            g_Span_Member_Stat_Valid[old_member] = 0;
+
+            if(result == SLINGA_SUCCESS)
+            {
+                return refresh_save(old_member, savename);
+            }
+
+            if(result != SLINGA_NOT_ENOUGH_SPACE)
+            {
+                Span_Invalidate();
+                return result;
+            }
+
+            excluded |= 1 << old_member;
+        }
+    }
+
+    result = SLINGA_NOT_ENOUGH_SPACE;
+
+    if(g_Span_Tier_Buffer)
+    {
+        result = write_tiered(flags, filename, savename, save_metadata, buffer, size, &member);
+        if(result != SLINGA_SUCCESS && result != SLINGA_NOT_ENOUGH_SPACE)
+        {
+            Span_Invalidate();
+            return result;
+        }
+    }
+
+    //
+    // place the save on the best member, falling back to the next best if
+    // the free space estimate was off
+    //
+    while(result != SLINGA_SUCCESS)
+    {
+        result = pick_member(size, excluded, &member);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        result = Slinga_Write(g_Span_Members[member].device_type, flags, filename, save_metadata, buffer, size);
+        g_Span_Member_Stat_Valid[member] = 0;
+
+        if(result == SLINGA_SUCCESS)
+        {
+            break;
+        }
+
+        if(result != SLINGA_NOT_ENOUGH_SPACE)
+        {
+            Span_Invalidate();
+            return result;
+        }
+
+        excluded |= 1 << member;
+    }
+
+    if(exists && member != old_member)
+    {
+        // the save moved, drop the old copy so it doesn't shadow the new one
+        result = Slinga_Delete(g_Span_Members[old_member].device_type, 0, savename);
+        if(result != SLINGA_SUCCESS && result != SLINGA_NOT_FOUND)
+        {
+            Span_Invalidate();
+            return result;
+        }
+
+        remove_save(index);
+    }
+
+    return refresh_save(member, savename);
+}
+
+SLINGA_ERROR Span_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    unsigned int index = 0;
+    unsigned int member = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!filename)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = bup_get_savename(filename, savename, sizeof(savename));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = load_index();
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = find_save(savename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    member = g_Span_Owner[index];
+
+    result = Slinga_Delete(g_Span_Members[member].device_type, flags, savename);
+    g_Span_Member_Stat_Valid[member] = 0;
+    if(result != SLINGA_SUCCESS)
+    {
+        Span_Invalidate();
+        return result;
+    }
+
+    if(g_Span_Num_Hidden)
+    {
+        // a save with the same name on a later member may have been hidden, list again to reveal it
+        Span_Invalidate();
+        return SLINGA_SUCCESS;
+    }
+
+    remove_save(index);
+
+    return SLINGA_SUCCESS;
+}
+
+SLINGA_ERROR Span_Format(DEVICE_TYPE device_type)
+{
+    SLINGA_ERROR result = 0;
+
+    result = Span_IsPresent(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    Span_Invalidate();
+
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        if(is_member_usable(i) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        result = Slinga_Format(g_Span_Members[i].device_type);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// helper functions
+//
+
+/**
+ * @brief Build the merged directory by paging through every member
+ *
+ * Each member is listed a page at a time into g_Span_Page with
+ * Slinga_ListPage(). Every entry is looked up in the sorted g_Span_Saves
+ * and inserted at its place unless an earlier member already has the name,
+ * then it counts as hidden.
+ */
+static SLINGA_ERROR load_index(void)
+{
+    SLINGA_ERROR result = 0;
+
+    if(g_Span_Index_Valid)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    g_Span_Num_Saves = 0;
+    g_Span_Num_Hidden = 0;
+
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        unsigned int cursor = SLINGA_LIST_START;
+
+        if(Slinga_IsPresent(g_Span_Members[i].device_type) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        while(cursor != SLINGA_LIST_END)
+        {
+            unsigned int saves_found = 0;
+
+            result = Slinga_ListPage(g_Span_Members[i].device_type, 0, cursor, g_Span_Page, SLINGA_LIST_PAGE_LEN, &saves_found, &cursor);
+            if(result != SLINGA_SUCCESS)
+            {
+                g_Span_Num_Saves = 0;
+                return result;
+            }
+
+            for(unsigned int j = 0; j < saves_found; j++)
+            {
+                unsigned int index = 0;
+
+                if(find_save(g_Span_Page[j].savename, &index) == SLINGA_SUCCESS)
+                {
+                    // an earlier member has the same save name
+                    g_Span_Num_Hidden++;
+                    continue;
+                }
+
+                result = insert_save(&g_Span_Page[j], i, &index);
+                if(result != SLINGA_SUCCESS)
+                {
+                    g_Span_Num_Saves = 0;
+                    return result;
+                }
+            }
+        }
+    }
+
+    g_Span_Index_Valid = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Binary search the merged directory
+ *
+ * @param[in] savename Save name to look for
+ * @param[out] index Index of the save on success, insertion point otherwise
+ *
+ * @return SLINGA_SUCCESS if found, SLINGA_NOT_FOUND otherwise
+ */
+static SLINGA_ERROR find_save(const char* savename, unsigned int* index)
+{
+    unsigned int low = 0;
+    unsigned int high = g_Span_Num_Saves;
+
+    while(low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        int cmp = strncmp(g_Span_Saves[mid].savename, savename, MAX_SAVENAME);
+
+        if(cmp == 0)
+        {
+            *index = mid;
+            return SLINGA_SUCCESS;
+        }
+
+        if(cmp < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    *index = low;
+    return SLINGA_NOT_FOUND;
+}
+
+static SLINGA_ERROR insert_save(const PSAVE_METADATA metadata, unsigned int member, unsigned int* index)
+{
+    unsigned int position = 0;
+
+    if(find_save(metadata->savename, &position) == SLINGA_SUCCESS)
+    {
+        // replace in place
+        memcpy(&g_Span_Saves[position], metadata, sizeof(SAVE_METADATA));
+        g_Span_Owner[position] = (unsigned char)member;
+        *index = position;
+        return SLINGA_SUCCESS;
+    }
+
+    if(g_Span_Num_Saves >= SPAN_MAX_SAVES)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memmove(&g_Span_Saves[position + 1], &g_Span_Saves[position], (g_Span_Num_Saves - position) * sizeof(SAVE_METADATA));
+    memmove(&g_Span_Owner[position + 1], &g_Span_Owner[position], g_Span_Num_Saves - position);
+    memmove(&g_Span_Last_Used[position + 1], &g_Span_Last_Used[position], (g_Span_Num_Saves - position) * sizeof(unsigned int));
+
+    memcpy(&g_Span_Saves[position], metadata, sizeof(SAVE_METADATA));
+    g_Span_Owner[position] = (unsigned char)member;
+    g_Span_Last_Used[position] = 0;
+    g_Span_Num_Saves++;
+
+    *index = position;
+
+    return SLINGA_SUCCESS;
+}
+
+static void remove_save(unsigned int index)
+{
+    memmove(&g_Span_Saves[index], &g_Span_Saves[index + 1], (g_Span_Num_Saves - index - 1) * sizeof(SAVE_METADATA));
+    memmove(&g_Span_Owner[index], &g_Span_Owner[index + 1], g_Span_Num_Saves - index - 1);
+    memmove(&g_Span_Last_Used[index], &g_Span_Last_Used[index + 1], (g_Span_Num_Saves - index - 1) * sizeof(unsigned int));
+    g_Span_Num_Saves--;
+}
+
+/**
+ * @brief Update one directory entry from its member after a write
+ */
+static SLINGA_ERROR refresh_save(unsigned int member, const char* savename)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Slinga_QueryFile(g_Span_Members[member].device_type, 0, savename, &metadata);
+    if(result == SLINGA_SUCCESS)
+    {
+        result = insert_save(&metadata, member, &index);
+    }
+
+    if(result == SLINGA_SUCCESS)
+    {
+        touch_save(index);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        // the write went through, we just lost track of it
+        Span_Invalidate();
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR get_member_stat(unsigned int member, PBACKUP_STAT* stat)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!g_Span_Member_Stat_Valid[member])
+    {
+        result = Slinga_Stat(g_Span_Members[member].device_type, &g_Span_Member_Stat[member]);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        g_Span_Member_Stat_Valid[member] = 1;
+    }
+
+    *stat = &g_Span_Member_Stat[member];
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Pick the member a new save of size bytes goes to
+ *
+ * @param[in] size Save size in bytes
+ * @param[in] excluded Bitmask of members already tried
+ * @param[out] member Lowest latency member with room, most free space breaks ties
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_ENOUGH_SPACE if nothing fits
+ */
+static SLINGA_ERROR pick_member(unsigned int size, unsigned int excluded, unsigned int* member)
+{
+    PBACKUP_STAT best_stat = NULL;
+    unsigned int best = 0;
+
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        PBACKUP_STAT member_stat = NULL;
+
+        if(excluded & (1 << i))
+        {
+            continue;
+        }
+
+        if(is_member_usable(i) != SLINGA_SUCCESS || get_member_stat(i, &member_stat) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        if(member_stat->free_bytes < size)
+        {
+            continue;
+        }
+
+        if(best_stat)
+        {
+            if(g_Span_Members[i].latency > g_Span_Members[best].latency)
+            {
+                continue;
+            }
+
+            if(g_Span_Members[i].latency == g_Span_Members[best].latency && member_stat->free_bytes <= best_stat->free_bytes)
+            {
+                continue;
+            }
+        }
+
+        best = i;
+        best_stat = member_stat;
+    }
+
+    if(!best_stat)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    *member = best;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Check a member is present and can be written to
+ */
+static SLINGA_ERROR is_member_usable(unsigned int member)
+{
+    SLINGA_ERROR result = 0;
+
+    result = Slinga_IsPresent(g_Span_Members[member].device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return Slinga_IsWriteable(g_Span_Members[member].device_type);
+}
+
+
+/**
+ * @brief Find the member tiering keeps writes on
+ *
+ * @param[out] member Lowest latency usable member, the earliest one breaks ties
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if no member is usable
+ */
+static SLINGA_ERROR find_primary(unsigned int* member)
+{
+    unsigned char found = 0;
+
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        if(is_member_usable(i) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        if(!found || g_Span_Members[i].latency < g_Span_Members[*member].latency)
+        {
+            *member = i;
+            found = 1;
+        }
+    }
+
+    return found ? SLINGA_SUCCESS : SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Record an access to a save for tiering
+ */
+static void touch_save(unsigned int index)
+{
+    g_Span_Clock++;
+
+    if(!g_Span_Clock)
+    {
+        // wrapped, start everyone over rather than mis-order them
+        memset(g_Span_Last_Used, 0, sizeof(g_Span_Last_Used));
+        g_Span_Clock = 1;
+    }
+
+    g_Span_Last_Used[index] = g_Span_Clock;
+}
+
+/**
+ * @brief Write a save to the primary member, moving its coldest saves to
+ * slower members until the new one fits
+ *
+ * @param[out] member Member the save was written to on success
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_ENOUGH_SPACE if it didn't fit within g_Span_Tier_Max_Moves moves
+ */
+static SLINGA_ERROR write_tiered(FLAGS flags,
+                                 const char* filename,
+                                 const char* savename,
+                                 const PSAVE_METADATA save_metadata,
+                                 const unsigned char* buffer,
+                                 unsigned int size,
+                                 unsigned int* member)
+{
+    unsigned int primary = 0;
+    unsigned int moves = 0;
+    SLINGA_ERROR result = 0;
+
+    g_Span_Tier_Stats.last_moves = 0;
+
+    result = find_primary(&primary);
+    if(result != SLINGA_SUCCESS)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    for(;;)
+    {
+        unsigned int victim = 0;
+
+        result = Slinga_Write(g_Span_Members[primary].device_type, flags, filename, save_metadata, buffer, size);
+        g_Span_Member_Stat_Valid[primary] = 0;
+
+        if(result != SLINGA_NOT_ENOUGH_SPACE || moves >= g_Span_Tier_Max_Moves)
+        {
+            break;
+        }
+
+        if(pick_victim(primary, savename, &victim) != SLINGA_SUCCESS)
+        {
+            // nothing left that can be moved
+            break;
+        }
+
+        result = move_save(victim);
+        if(result != SLINGA_SUCCESS)
+        {
+            g_Span_Tier_Stats.failed_moves++;
+            result = SLINGA_NOT_ENOUGH_SPACE;
+            break;
+        }
+
+        moves++;
+        g_Span_Tier_Stats.last_moves = moves;
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(moves)
+    {
+        g_Span_Tier_Stats.spilled_writes++;
+    }
+
+    *member = primary;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Pick the save to move off a member
+ *
+ * @param[in] member Member to make room on
+ * @param[in] savename Save being written, never picked
+ * @param[out] index Least recently used save that fits in the tiering buffer
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if no save can be moved
+ */
+static SLINGA_ERROR pick_victim(unsigned int member, const char* savename, unsigned int* index)
+{
+    unsigned char found = 0;
+
+    for(unsigned int i = 0; i < g_Span_Num_Saves; i++)
+    {
+        if(g_Span_Owner[i] != member || g_Span_Saves[i].data_size > g_Span_Tier_Buffer_Size)
+        {
+            continue;
+        }
+
+        if(strncmp(g_Span_Saves[i].savename, savename, MAX_SAVENAME) == 0)
+        {
+            continue;
+        }
+
+        if(found)
+        {
+            // untouched saves go first, oldest timestamp first
+            if(g_Span_Last_Used[i] > g_Span_Last_Used[*index])
+            {
+                continue;
+            }
+
+            if(g_Span_Last_Used[i] == g_Span_Last_Used[*index] && g_Span_Saves[i].timestamp >= g_Span_Saves[*index].timestamp)
+            {
+                continue;
+            }
+        }
+
+        *index = i;
+        found = 1;
+    }
+
+    return found ? SLINGA_SUCCESS : SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Move a save to the best slower member with room
+ *
+ * Members that already hold a save of the same name are skipped so the
+ * hidden copy survives.
+ *
+ * @param[in] index Save to move
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+static SLINGA_ERROR move_save(unsigned int index)
+{
+    PSAVE_METADATA metadata = &g_Span_Saves[index];
+    unsigned int from = g_Span_Owner[index];
+    unsigned int excluded = 1 << from;
+    unsigned int bytes_read = 0;
+    unsigned int to = 0;
+    SLINGA_ERROR result = 0;
+
+    // a same named save on a slower member is hidden, not gone. Leave it be
+    for(unsigned int i = 0; i < g_Span_Num_Members; i++)
+    {
+        SAVE_METADATA hidden = {0};
+
+        if(i != from && Slinga_QueryFile(g_Span_Members[i].device_type, 0, metadata->savename, &hidden) == SLINGA_SUCCESS)
+        {
+            excluded |= 1 << i;
+        }
+    }
+
+    result = pick_member(metadata->data_size, excluded, &to);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = Slinga_Read(g_Span_Members[from].device_type, 0, metadata->savename, g_Span_Tier_Buffer, metadata->data_size, &bytes_read);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = Slinga_Write(g_Span_Members[to].device_type, 0, metadata->savename, metadata, g_Span_Tier_Buffer, bytes_read);
+    g_Span_Member_Stat_Valid[to] = 0;
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = Slinga_Delete(g_Span_Members[from].device_type, 0, metadata->savename);
+    g_Span_Member_Stat_Valid[from] = 0;
+    if(result != SLINGA_SUCCESS)
+    {
+        // both copies exist, the directory still points at the original
+        return result;
+    }
+
+    g_Span_Owner[index] = (unsigned char)to;
+
+    g_Span_Tier_Stats.moves++;
+    g_Span_Tier_Stats.bytes_moved += bytes_read;
+
+    return SLINGA_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/** @file span.h
+ *
+ *  @author Slinga
+ *  @brief Virtual device spanning several backup devices
+ *  @bug No known bugs.
+ */
+
+#pragma once
+
+#include "../../libslinga/libslinga_conf.h"
+
+#ifdef INCLUDE_SPAN
+
+#include "../../libslinga.h"
+#include "../bup/bup.h"
+
+//
+// DEVICE_SPAN presents several devices (internal and cartridge by default)
+// as one store with a single directory.
+//
+// - The merged directory is built from one Slinga_List() per member, kept
+//   sorted by save name and patched on every write and delete. Reads,
+//   queries and deletes are routed with a binary search.
+// - If two members hold a save with the same name, the earlier member wins
+//   and the other copy is hidden.
+// - New saves go to the lowest latency member with enough free space, ties
+//   go to the member with the most free space. A save that no longer fits
+//   where it is moves to another member.
+// - Each member's stat is cached and only refreshed after that member was
+//   written to, so Stat doesn't touch every device every time.
+//
+// Everything has to go through DEVICE_SPAN for the cache to stay valid.
+// Call Span_Invalidate() after writing to a member directly.
+//
+// Tiering (off by default, see Span_SetTiering()) keeps writes on the
+// lowest latency member. When it's full, its least recently used saves are
+// moved to slower members, a bounded number per write, until the new save
+// fits. Moved saves stay in the merged directory so reads find them as
+// before. Saves read or written since the directory was built are ordered
+// by last access, the rest by timestamp and ahead of them.
+//
+
+#define SPAN_MAX_MEMBERS    4           ///< @brief Maximum devices in the span
+#define SPAN_MAX_SAVES      MAX_SAVES   ///< @brief Maximum saves across all members
+
+/** @brief Device taking part in the span */
+typedef struct _SPAN_MEMBER
+{
+    DEVICE_TYPE device_type;    ///< @brief Member device. Can't be DEVICE_SPAN
+    unsigned char latency;      ///< @brief Relative access cost. New saves go to the lowest latency member that fits
+} SPAN_MEMBER, *PSPAN_MEMBER;
+
+/** @brief Tiering counters */
+typedef struct _SPAN_TIER_STATS
+{
+    unsigned int moves;             ///< @brief Saves moved to a slower member
+    unsigned int bytes_moved;       ///< @brief Save data moved to a slower member
+    unsigned int failed_moves;      ///< @brief Moves that failed, the write then went to a slower member instead
+    unsigned int spilled_writes;    ///< @brief Writes that needed saves moved first
+    unsigned int last_moves;        ///< @brief Saves moved by the most recent write
+} SPAN_TIER_STATS, *PSPAN_TIER_STATS;
+
+SLINGA_ERROR Span_RegisterHandler(DEVICE_TYPE device_type, PDEVICE_HANDLER* device_handler);
+
+SLINGA_ERROR Span_SetMembers(const SPAN_MEMBER* members, unsigned int num_members);
+SLINGA_ERROR Span_Invalidate(void);
+SLINGA_ERROR Span_SetTiering(unsigned char* buffer, unsigned int buffer_size, unsigned int max_moves);
+SLINGA_ERROR Span_GetTierStats(PSPAN_TIER_STATS stats);
+
+SLINGA_ERROR Span_Init(DEVICE_TYPE device_type);
+SLINGA_ERROR Span_Fini(DEVICE_TYPE device_type);
+
+SLINGA_ERROR Span_GetDeviceName(DEVICE_TYPE device_type, char** device_name);
+SLINGA_ERROR Span_IsPresent(DEVICE_TYPE device_type);
+SLINGA_ERROR Span_IsReadable(DEVICE_TYPE device_type);
+SLINGA_ERROR Span_IsWriteable(DEVICE_TYPE device_type);
+
+SLINGA_ERROR Span_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+SLINGA_ERROR Span_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
+SLINGA_ERROR Span_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR Span_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
+SLINGA_ERROR Span_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+SLINGA_ERROR Span_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Span_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
+SLINGA_ERROR Span_Format(DEVICE_TYPE device_type);
+
+#endif
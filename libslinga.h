@@ -25,6 +25,11 @@
 /** @brief Maximum number of saves */
 #define MAX_SAVES               255
 
+/** @brief Slinga_ListPage() cursors */
+#define SLINGA_LIST_START       0           ///< @brief Cursor for the first page
+#define SLINGA_LIST_END         0xFFFFFFFF  ///< @brief Returned as the next cursor after the last page
+#define SLINGA_LIST_PAGE_LEN    16          ///< @brief Page size the library lists other devices with
+
 // all devices should standardize on this directory
 // for storing saves
 #define SAVES_DIRECTORY "SATSAVES"
@@ -55,10 +60,11 @@ typedef enum
     SLINGA_SAT_SAVE_OUT_OF_RANGE = 0x201,       ///< @brief Save doesn't fit in the SAT bitmap
     SLINGA_SAT_INVALID_PARTITION = 0x202,       ///< @brief Something with the SAT partition is wrong
     SLINGA_SAT_TOO_MANY_BLOCKS = 0x203,         ///< @brief Too many blocks on the SAT paritition
-    SLINGA_SAT_BLOCKS_OUT_OF_ORDER = 0x204,     ///< @brief SAT block entries are out of order
+    SLINGA_SAT_BLOCKS_OUT_OF_ORDER = 0x204,     ///< @brief SAT block entries are out of order. No longer returned, out of order saves are read
     SLINGA_SAT_INVALID_SIZE = 0x205,            ///< @brief Bad copy size
     SLINGA_SAT_INVALID_READ_SIZE = 0x206,       ///< @brief Bad read size
     SLINGA_SAT_INVALID_TAG = 0x207,             ///< @brief Bad SAT block tag
+    SLINGA_SAT_INVALID_SNAPSHOT = 0x208,        ///< @brief Snapshot is corrupt or from a different partition layout
 
     SLINGA_ACTION_REPLAY_UNSUPPORTED_COMPRESSION,     ///< @brief Action Replay: Unknown compression algorithm
     SLINGA_ACTION_REPLAY_CORRUPT_COMPRESSION_HEADER,  ///< @brief Action Replay: Compression header is corrupt
@@ -67,6 +73,21 @@ typedef enum
     SLINGA_ACTION_REPLAY_PARTITION_TOO_LARGE,         ///< @brief Action Replay: The uncompressed partition is too big
     SLINGA_ACTION_REPLAY_EXTENDED_RAM_MISSING,        ///< @brief Action Replay: Extended RAM missing. We need this for decompression
 
+    SLINGA_BUP_INVALID_HEADER = 0x300,          ///< @brief .BUP file header is missing or corrupt
+
+    SLINGA_ODE_NO_TRANSPORT = 0x400,            ///< @brief ODE: No command transport has been attached
+    SLINGA_ODE_TRANSPORT_ERROR = 0x401,         ///< @brief ODE: Transport failed to send or receive
+    SLINGA_ODE_BAD_RESPONSE = 0x402,            ///< @brief ODE: Response doesn't match any outstanding command
+
+    SLINGA_SERIAL_NO_PORT = 0x500,              ///< @brief Serial: No port has been attached
+    SLINGA_SERIAL_PORT_ERROR = 0x501,           ///< @brief Serial: Port failed to send or receive
+    SLINGA_SERIAL_TIMEOUT = 0x502,              ///< @brief Serial: Peer stopped responding
+    SLINGA_SERIAL_PROTOCOL_ERROR = 0x503,       ///< @brief Serial: Peer sent a malformed message
+
+    SLINGA_CD_NO_READER = 0x600,                ///< @brief CD: No sector reader has been attached
+    SLINGA_CD_READ_ERROR = 0x601,               ///< @brief CD: Sector reader failed
+    SLINGA_CD_INVALID_FILESYSTEM = 0x602,       ///< @brief CD: Not an ISO9660 disc, or the file system is corrupt
+
 } SLINGA_ERROR;
 
 /**  @brief Languages supported by the Saturn BIOS */
@@ -104,6 +125,19 @@ typedef struct _BACKUP_STAT
     unsigned int max_saves_possible;    ///< @brief maximum number of saves possible
 } BACKUP_STAT, *PBACKUP_STAT;
 
+///< @brief what Slinga_PlanFit() predicts writing a set of saves would do
+typedef struct _PLAN_FIT
+{
+    unsigned char* fits;                ///< @brief optional, caller provided. Set to 1 for each save that fits, 0 otherwise
+    unsigned int* blocks;               ///< @brief optional, caller provided. Blocks each save needs including SAT table overhead
+    unsigned int block_size;            ///< @brief size of blocks on the medium, same as BACKUP_STAT
+    unsigned int free_blocks;           ///< @brief free blocks before any of the saves are written
+    unsigned int blocks_needed;         ///< @brief blocks needed to write every save
+    unsigned int saves_fit;             ///< @brief number of saves that fit
+    unsigned int blocks_left;           ///< @brief free blocks left after writing the saves that fit
+    unsigned int bytes_left;            ///< @brief free bytes left after writing the saves that fit
+} PLAN_FIT, *PPLAN_FIT;
+
 /** @brief libslinga function flags */
 typedef enum
 {
@@ -146,13 +180,20 @@ SLINGA_ERROR Slinga_IsWriteable(DEVICE_TYPE device_type);
 
 SLINGA_ERROR Slinga_SetSaveMetadata(PSAVE_METADATA save_metadata, const char* filename, const char* name, const char* comment, SLINGA_LANGUAGE language, unsigned int timestamp, unsigned int data_size);
 SLINGA_ERROR Slinga_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+SLINGA_ERROR Slinga_PlanFit(DEVICE_TYPE device_type, const unsigned int* sizes, unsigned int num_saves, PPLAN_FIT plan);
 SLINGA_ERROR Slinga_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR Slinga_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
 SLINGA_ERROR Slinga_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
 
 SLINGA_ERROR Slinga_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
 SLINGA_ERROR Slinga_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Slinga_Reserve(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned int max_size);
 SLINGA_ERROR Slinga_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
 SLINGA_ERROR Slinga_Format(DEVICE_TYPE device_type);
+SLINGA_ERROR Slinga_Snapshot(DEVICE_TYPE device_type, unsigned char* buffer, unsigned int size, unsigned int* snapshot_size);
+SLINGA_ERROR Slinga_Restore(DEVICE_TYPE device_type, const unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Slinga_SnapshotDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, unsigned char* buffer, unsigned int size, unsigned int* diff_size);
+SLINGA_ERROR Slinga_RestoreDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, const unsigned char* diff, unsigned int diff_size);
 
 // TODO install shim to shim.c
 typedef SLINGA_ERROR (*DEVICE_INIT)(DEVICE_TYPE);
@@ -162,12 +203,19 @@ typedef SLINGA_ERROR (*DEVICE_IS_PRESENT)(DEVICE_TYPE);
 typedef SLINGA_ERROR (*DEVICE_IS_READABLE)(DEVICE_TYPE);
 typedef SLINGA_ERROR (*DEVICE_IS_WRITEABLE)(DEVICE_TYPE);
 typedef SLINGA_ERROR (*DEVICE_STAT)(DEVICE_TYPE, PBACKUP_STAT);
+typedef SLINGA_ERROR (*DEVICE_CALC_BLOCKS)(DEVICE_TYPE, unsigned int, unsigned int*);
 typedef SLINGA_ERROR (*DEVICE_LIST)(DEVICE_TYPE, FLAGS, PSAVE_METADATA, unsigned int, unsigned int*);
+typedef SLINGA_ERROR (*DEVICE_LIST_PAGE)(DEVICE_TYPE, FLAGS, unsigned int, PSAVE_METADATA, unsigned int, unsigned int*, unsigned int*);
 typedef SLINGA_ERROR (*DEVICE_QUERY_FILE)(DEVICE_TYPE, FLAGS, const char*, PSAVE_METADATA);
 typedef SLINGA_ERROR (*DEVICE_READ)(DEVICE_TYPE, FLAGS, const char*, unsigned char*, unsigned int, unsigned int*);
 typedef SLINGA_ERROR (*DEVICE_WRITE)(DEVICE_TYPE, FLAGS, const char*, const PSAVE_METADATA, const unsigned char*, unsigned int);
+typedef SLINGA_ERROR (*DEVICE_RESERVE)(DEVICE_TYPE, FLAGS, const char*, unsigned int);
 typedef SLINGA_ERROR (*DEVICE_DELETE)(DEVICE_TYPE, FLAGS, const char*);
 typedef SLINGA_ERROR (*DEVICE_FORMAT)(DEVICE_TYPE);
+typedef SLINGA_ERROR (*DEVICE_SNAPSHOT)(DEVICE_TYPE, unsigned char*, unsigned int, unsigned int*);
+typedef SLINGA_ERROR (*DEVICE_RESTORE)(DEVICE_TYPE, const unsigned char*, unsigned int);
+typedef SLINGA_ERROR (*DEVICE_SNAPSHOT_DIFF)(DEVICE_TYPE, const unsigned char*, unsigned int, unsigned char*, unsigned int, unsigned int*);
+typedef SLINGA_ERROR (*DEVICE_RESTORE_DIFF)(DEVICE_TYPE, const unsigned char*, unsigned int, const unsigned char*, unsigned int);
 
 typedef struct _DEVICE_HANDLER
 {
@@ -178,12 +226,19 @@ typedef struct _DEVICE_HANDLER
     DEVICE_IS_READABLE is_readable;
     DEVICE_IS_WRITEABLE is_writeable;
     DEVICE_STAT stat;
+    DEVICE_CALC_BLOCKS calc_blocks; // optional, Slinga_PlanFit() falls back to rounding up to the stat block size
     DEVICE_LIST list;
+    DEVICE_LIST_PAGE list_page;     // optional, Slinga_ListPage() falls back to list
     DEVICE_QUERY_FILE query_file;
     DEVICE_READ read;
     DEVICE_WRITE write;
+    DEVICE_RESERVE reserve;         // optional, Slinga_Reserve() returns SLINGA_NOT_SUPPORTED without it
     DEVICE_DELETE delete;
     DEVICE_FORMAT format;
+    DEVICE_SNAPSHOT snapshot;       // optional, Slinga_Snapshot() returns SLINGA_NOT_SUPPORTED without it
+    DEVICE_RESTORE restore;         // optional, Slinga_Restore() returns SLINGA_NOT_SUPPORTED without it
+    DEVICE_SNAPSHOT_DIFF snapshot_diff; // optional, Slinga_SnapshotDiff() returns SLINGA_NOT_SUPPORTED without it
+    DEVICE_RESTORE_DIFF restore_diff;   // optional, Slinga_RestoreDiff() returns SLINGA_NOT_SUPPORTED without it
 } DEVICE_HANDLER, *PDEVICE_HANDLER;
 
 #define UNUSED(x) (void)x;
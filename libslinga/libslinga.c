@@ -9,6 +9,13 @@
 #include "../devices/saturn.h"
 #include "../devices/ram.h"
 #include "../devices/action_replay.h"
+#include "../devices/ode/ode.h"
+#include "../devices/serial/serial.h"
+#include "../devices/cd/cd.h"
+#include "../devices/span/span.h"
+
+#include "save_index.h"
+#include "payload_cache.h"
 
 PDEVICE_HANDLER g_Device_Handlers[MAX_DEVICE_TYPE] = {0};
 
@@ -46,15 +53,40 @@ SLINGA_ERROR Slinga_Init(void)
                 Saturn_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
                 break;
     #endif
+    #ifdef INCLUDE_SERIAL
+            case DEVICE_SERIAL:
+                Serial_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
+                break;
+    #endif
     #ifdef INCLUDE_RAM
             case DEVICE_RAM:
                 RAM_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
                 break;
     #endif
+    #ifdef INCLUDE_CD
+            case DEVICE_CD:
+                CD_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
+                break;
+    #endif
     #ifdef INCLUDE_ACTION_REPLAY
             case DEVICE_ACTION_REPLAY:
                 ActionReplay_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
                 break;
+    #endif
+    #ifdef INCLUDE_SATIATIOR
+            case DEVICE_SATIATIOR:
+                ODE_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
+                break;
+    #endif
+    #ifdef INCLUDE_MODE
+            case DEVICE_MODE:
+                ODE_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
+                break;
+    #endif
+    #ifdef INCLUDE_SPAN
+            case DEVICE_SPAN:
+                Span_RegisterHandler(device_type, &g_Device_Handlers[device_type]);
+                break;
     #endif
             default:
                 // device not compiled in, do nothing
@@ -382,6 +414,133 @@ SLINGA_ERROR Slinga_Stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
     return handler->stat(device_type, stat);
 }
 
+/**
+ * @brief Predict which of a set of saves would fit on the device, without writing anything
+ *
+ * Saves are placed in order. A save that doesn't fit in the space left is
+ * skipped and the following saves are still tried, the same as writing them
+ * one after another and ignoring SLINGA_NOT_ENOUGH_SPACE.
+ *
+ * Devices without a calc_blocks handler are charged each save's size rounded
+ * up to whole blocks. Those devices don't use blocks (see BACKUP_STAT), so the
+ * prediction can be off by less than a block in the pessimistic direction.
+ *
+ * @param[in] device_type backup device
+ * @param[in] sizes Size in bytes of each save
+ * @param[in] num_saves Number of elements in sizes
+ * @param[in,out] plan fits and blocks are optional arrays of num_saves elements. Filled out on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_PlanFit(DEVICE_TYPE device_type, const unsigned int* sizes, unsigned int num_saves, PPLAN_FIT plan)
+{
+    PDEVICE_HANDLER handler = NULL;
+    BACKUP_STAT stat = {0};
+    unsigned int blocks_left = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if((!sizes && num_saves) || !plan)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(!handler->stat || !handler->is_writeable)
+    {
+        // should never get here
+        return -1;
+    }
+
+    result = handler->is_writeable(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = handler->stat(device_type, &stat);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stat.block_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    plan->block_size = stat.block_size;
+    plan->free_blocks = stat.free_blocks;
+    plan->blocks_needed = 0;
+    plan->saves_fit = 0;
+
+    blocks_left = stat.free_blocks;
+
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        unsigned int num_blocks = 0;
+        unsigned char fits = 0;
+
+        if(!sizes[i])
+        {
+            return SLINGA_INVALID_PARAMETER;
+        }
+
+        if(handler->calc_blocks)
+        {
+            // exact cost, including any per save overhead
+            result = handler->calc_blocks(device_type, sizes[i], &num_blocks);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+        }
+        else
+        {
+            num_blocks = (sizes[i] + stat.block_size - 1) / stat.block_size;
+        }
+
+        plan->blocks_needed += num_blocks;
+
+        // max_saves_possible covers devices with a fixed size directory
+        if(num_blocks <= blocks_left && plan->saves_fit < stat.max_saves_possible)
+        {
+            blocks_left -= num_blocks;
+            plan->saves_fit++;
+            fits = 1;
+        }
+
+        if(plan->fits)
+        {
+            plan->fits[i] = fits;
+        }
+
+        if(plan->blocks)
+        {
+            plan->blocks[i] = num_blocks;
+        }
+    }
+
+    plan->blocks_left = blocks_left;
+    plan->bytes_left = blocks_left * stat.block_size;
+
+    return SLINGA_SUCCESS;
+}
+
 /**
  * @brief List all saves on the device
  *
@@ -422,6 +581,78 @@ SLINGA_ERROR Slinga_List(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA sa
     return handler->list(device_type, flags, saves, num_saves, saves_found);
 }
 
+/**
+ * @brief List saves one page at a time
+ *
+ * Memory use is fixed by page_len no matter how many saves the device
+ * holds, and each call only scans the part of the device the page covers.
+ *
+ * @param[in] device_type backup device
+ * @param[in] flags flags field
+ * @param[in] cursor SLINGA_LIST_START for the first page, otherwise next_cursor from the previous call
+ * @param[out] page Filled out SAVE_METADATA array on success
+ * @param[in] page_len size in elements of page array
+ * @param[out] saves_found Number of saves written to page on success
+ * @param[out] next_cursor Cursor for the next page, SLINGA_LIST_END after the last page
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_ListPage(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(!page || !page_len || !saves_found || !next_cursor || cursor == SLINGA_LIST_END)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(handler->list_page)
+    {
+        return handler->list_page(device_type, flags, cursor, page, page_len, saves_found, next_cursor);
+    }
+
+    if(!handler->list)
+    {
+        // should never get here
+        return -1;
+    }
+
+    //
+    // the device can't resume a listing, everything has to fit in the first page
+    //
+    if(cursor != SLINGA_LIST_START)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = handler->list(device_type, flags, page, page_len, saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    *next_cursor = SLINGA_LIST_END;
+
+    return SLINGA_SUCCESS;
+}
+
 /**
  * @brief Retrieves metadata of specific file
  *
@@ -476,6 +707,8 @@ SLINGA_ERROR Slinga_QueryFile(DEVICE_TYPE device_type, FLAGS flags, const char*
 SLINGA_ERROR Slinga_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
 {
     PDEVICE_HANDLER handler = NULL;
+    unsigned int read = 0;
+    SLINGA_ERROR result = 0;
 
     if(!g_Context.isInit)
     {
@@ -499,7 +732,45 @@ SLINGA_ERROR Slinga_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filen
         return -1;
     }
 
-    return handler->read(device_type, flags, filename, buffer, size, bytes_read);
+#ifdef INCLUDE_PAYLOAD_CACHE
+    if(payload_cache_read(device_type, filename, buffer, size, bytes_read) == SLINGA_SUCCESS)
+    {
+        return SLINGA_SUCCESS;
+    }
+#endif
+
+    result = handler->read(device_type, flags, filename, buffer, size, &read);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(bytes_read)
+    {
+        *bytes_read = read;
+    }
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    //
+    // some devices stop at size bytes, only cache the read if it was the
+    // whole save. A short read always is
+    //
+    if(read < size)
+    {
+        payload_cache_insert(device_type, filename, buffer, read);
+    }
+    else if(handler->query_file)
+    {
+        SAVE_METADATA metadata = {0};
+
+        if(handler->query_file(device_type, flags, filename, &metadata) == SLINGA_SUCCESS && metadata.data_size == read)
+        {
+            payload_cache_insert(device_type, filename, buffer, read);
+        }
+    }
+#endif
+
+    return SLINGA_SUCCESS;
 }
 
 /**
@@ -516,6 +787,7 @@ SLINGA_ERROR Slinga_Read(DEVICE_TYPE device_type, FLAGS flags, const char* filen
 SLINGA_ERROR Slinga_Write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
 {
     PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
 
     if(!g_Context.isInit)
     {
@@ -539,7 +811,83 @@ SLINGA_ERROR Slinga_Write(DEVICE_TYPE device_type, FLAGS flags, const char* file
         return -1;
     }
 
-    return handler->write(device_type, flags, filename, save_metadata, buffer, size);
+#ifdef INCLUDE_PAYLOAD_CACHE
+    // dropped even if the write fails, the old data may be partly overwritten
+    payload_cache_remove(device_type, filename);
+#endif
+
+    result = handler->write(device_type, flags, filename, save_metadata, buffer, size);
+
+#ifdef INCLUDE_SAVE_INDEX
+    if(result == SLINGA_SUCCESS)
+    {
+        save_index_on_write(device_type, filename);
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * @brief Claim space for a save up front so later writes to it are quick
+ *
+ * The save is created with max_size bytes of zeros, so the space is used as
+ * far as the BIOS is concerned. Slinga_Write() of up to max_size bytes to the
+ * same name copies the data into the claimed blocks without searching the
+ * device or allocating. The save takes the size of the data written and
+ * keeps its blocks for the next write. The first write doesn't need
+ * OVERWRITE_EXISTING_SAVE, later ones do, like any existing save.
+ *
+ * Reservations are not persistent, reserve again after every Slinga_Init().
+ * Reserving an existing save that is already large enough keeps its data.
+ *
+ * @param[in] device_type backup device
+ * @param[in] flags flags field, OVERWRITE_EXISTING_SAVE to replace an existing save smaller than max_size
+ * @param[in] filename name of the save to reserve
+ * @param[in] max_size largest save data in bytes that will be written
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_SUPPORTED if the device can't reserve space
+ */
+SLINGA_ERROR Slinga_Reserve(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned int max_size)
+{
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(!handler->reserve)
+    {
+        return SLINGA_NOT_SUPPORTED;
+    }
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    payload_cache_remove(device_type, filename);
+#endif
+
+    result = handler->reserve(device_type, flags, filename, max_size);
+
+#ifdef INCLUDE_SAVE_INDEX
+    if(result == SLINGA_SUCCESS)
+    {
+        save_index_on_write(device_type, filename);
+    }
+#endif
+
+    return result;
 }
 
 /**
@@ -554,6 +902,9 @@ SLINGA_ERROR Slinga_Write(DEVICE_TYPE device_type, FLAGS flags, const char* file
 
 SLINGA_ERROR Slinga_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
 {
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
     if(!g_Context.isInit)
     {
         return SLINGA_NOT_INITIALIZED;
@@ -564,8 +915,7 @@ SLINGA_ERROR Slinga_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* fil
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    PDEVICE_HANDLER handler = g_Device_Handlers[device_type];
-
+    handler = g_Device_Handlers[device_type];
     if(!handler)
     {
         return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
@@ -577,7 +927,20 @@ SLINGA_ERROR Slinga_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* fil
         return -1;
     }
 
-    return handler->delete(device_type, flags, filename);
+#ifdef INCLUDE_PAYLOAD_CACHE
+    payload_cache_remove(device_type, filename);
+#endif
+
+    result = handler->delete(device_type, flags, filename);
+
+#ifdef INCLUDE_SAVE_INDEX
+    if(result == SLINGA_SUCCESS)
+    {
+        save_index_on_delete(device_type, filename);
+    }
+#endif
+
+    return result;
 }
 
 /**
@@ -589,6 +952,9 @@ SLINGA_ERROR Slinga_Delete(DEVICE_TYPE device_type, FLAGS flags, const char* fil
  */
 SLINGA_ERROR Slinga_Format(DEVICE_TYPE device_type)
 {
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
     if(!g_Context.isInit)
     {
         return SLINGA_NOT_INITIALIZED;
@@ -599,8 +965,7 @@ SLINGA_ERROR Slinga_Format(DEVICE_TYPE device_type)
         return SLINGA_INVALID_DEVICE_TYPE;
     }
 
-    PDEVICE_HANDLER handler = g_Device_Handlers[device_type];
-
+    handler = g_Device_Handlers[device_type];
     if(!handler)
     {
         return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
@@ -612,5 +977,212 @@ SLINGA_ERROR Slinga_Format(DEVICE_TYPE device_type)
         return -1;
     }
 
-    return handler->format(device_type);
+#ifdef INCLUDE_PAYLOAD_CACHE
+    Slinga_InvalidatePayloadCache(device_type);
+#endif
+
+    result = handler->format(device_type);
+
+#ifdef INCLUDE_SAVE_INDEX
+    // rebuilt on the next query, the device is empty or unknown now
+    Slinga_InvalidateIndex(device_type);
+#endif
+
+    return result;
+}
+
+/**
+ * @brief Copy the raw contents of a backup device into a buffer
+ *
+ * The snapshot can be put back with Slinga_Restore(), on the same device or
+ * another one with the same layout. Free blocks are left out, so a mostly
+ * empty device gives a small snapshot. Call with a NULL buffer to get the
+ * size needed.
+ *
+ * @param[in] device_type backup device
+ * @param[out] buffer snapshot on success, or NULL to only get snapshot_size
+ * @param[in] size size in bytes of buffer
+ * @param[out] snapshot_size size in bytes of the snapshot, also set on SLINGA_BUFFER_TOO_SMALL
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_SUPPORTED if the device can't be snapshotted
+ */
+SLINGA_ERROR Slinga_Snapshot(DEVICE_TYPE device_type, unsigned char* buffer, unsigned int size, unsigned int* snapshot_size)
+{
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(!handler->snapshot)
+    {
+        return SLINGA_NOT_SUPPORTED;
+    }
+
+    result = handler->snapshot(device_type, buffer, size, snapshot_size);
+
+    return result;
+}
+
+/**
+ * @brief Replace the contents of a backup device with a Slinga_Snapshot()
+ *
+ * Every save on the device is lost. Reservations are dropped.
+ *
+ * @param[in] device_type backup device
+ * @param[in] buffer snapshot
+ * @param[in] size size in bytes of the snapshot
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_SUPPORTED if the device can't be restored
+ */
+SLINGA_ERROR Slinga_Restore(DEVICE_TYPE device_type, const unsigned char* buffer, unsigned int size)
+{
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(!handler->restore)
+    {
+        return SLINGA_NOT_SUPPORTED;
+    }
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    Slinga_InvalidatePayloadCache(device_type);
+#endif
+
+    result = handler->restore(device_type, buffer, size);
+
+#ifdef INCLUDE_SAVE_INDEX
+    // every save may have changed
+    Slinga_InvalidateIndex(device_type);
+#endif
+
+    return result;
+}
+
+/**
+ * @brief Copy only the parts of a backup device that changed since a Slinga_Snapshot()
+ *
+ * The diff is put back with Slinga_RestoreDiff() and the same base. Its
+ * size depends on how much changed, not on the size of the device. Call
+ * with a NULL buffer to get the size needed.
+ *
+ * @param[in] device_type backup device
+ * @param[in] base snapshot of the device to diff against
+ * @param[in] base_size size in bytes of base
+ * @param[out] buffer diff on success, or NULL to only get diff_size
+ * @param[in] size size in bytes of buffer
+ * @param[out] diff_size size in bytes of the diff, also set on SLINGA_BUFFER_TOO_SMALL
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_SUPPORTED if the device can't be diffed
+ */
+SLINGA_ERROR Slinga_SnapshotDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, unsigned char* buffer, unsigned int size, unsigned int* diff_size)
+{
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(!handler->snapshot_diff)
+    {
+        return SLINGA_NOT_SUPPORTED;
+    }
+
+    result = handler->snapshot_diff(device_type, base, base_size, buffer, size, diff_size);
+
+    return result;
+}
+
+/**
+ * @brief Replace the contents of a backup device with a snapshot and a Slinga_SnapshotDiff() taken against it
+ *
+ * Every save on the device is lost. Reservations are dropped.
+ *
+ * @param[in] device_type backup device
+ * @param[in] base snapshot the diff was taken against
+ * @param[in] base_size size in bytes of base
+ * @param[in] diff diff
+ * @param[in] diff_size size in bytes of diff
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_SUPPORTED if the device can't be restored
+ */
+SLINGA_ERROR Slinga_RestoreDiff(DEVICE_TYPE device_type, const unsigned char* base, unsigned int base_size, const unsigned char* diff, unsigned int diff_size)
+{
+    PDEVICE_HANDLER handler = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!g_Context.isInit)
+    {
+        return SLINGA_NOT_INITIALIZED;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    handler = g_Device_Handlers[device_type];
+    if(!handler)
+    {
+        return SLINGA_DEVICE_TYPE_NOT_COMPILED_IN;
+    }
+
+    if(!handler->restore_diff)
+    {
+        return SLINGA_NOT_SUPPORTED;
+    }
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    Slinga_InvalidatePayloadCache(device_type);
+#endif
+
+    result = handler->restore_diff(device_type, base, base_size, diff, diff_size);
+
+#ifdef INCLUDE_SAVE_INDEX
+    Slinga_InvalidateIndex(device_type);
+#endif
+
+    return result;
 }
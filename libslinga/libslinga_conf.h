@@ -20,6 +20,24 @@
 #define INCLUDE_ACTION_REPLAY     1
 //#define INCLUDE_SATIATIOR       1
 //#define INCLUDE_MODE            1
+//#define INCLUDE_SPAN            1
+
+//
+// Optional layers
+//
+
+//#define INCLUDE_SHIM            1 // BUP library compatible API, see shim.h
+//#define INCLUDE_SAVE_INDEX      1 // Timestamp and size ordered indexes, see save_index.h
+//#define INCLUDE_PAYLOAD_CACHE   1 // LRU cache of recently read saves, see payload_cache.h
+//#define INCLUDE_SAVE_LIST       1 // Compact structure of arrays listing, see save_list.h
+
+//
+// Host only helpers
+//
+
+//#define INCLUDE_ODE_SIMULATOR   1 // ODE transport backed by a host directory
+//#define INCLUDE_SERIAL_HOST     1 // Serial link stand-in backed by a host directory
+//#define INCLUDE_CD_IMAGE        1 // CD sector reader backed by an .iso or .bin
 
 //
 // Include or exclude specific operations
@@ -0,0 +1,512 @@
+/** @file payload_cache.c
+ *
+ *  @author Slinga
+ *  @brief LRU cache of recently read save data
+ *  @bug No known bugs.
+ */
+#include "payload_cache.h"
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+
+#include "../devices/bup/bup.h"
+
+/** @brief Caller provided cache memory */
+unsigned char* g_Payload_Cache_Buffer = NULL;
+unsigned int g_Payload_Cache_Size = 0;
+
+/** @brief Cached saves, in no particular order */
+PAYLOAD_CACHE_ENTRY g_Payload_Cache_Entries[PAYLOAD_CACHE_MAX_ENTRIES] = {0};
+
+/** @brief Incremented on every access, used to find the least recently used entry */
+unsigned int g_Payload_Cache_Clock = 0;
+
+/** @brief Last fingerprint reported for each device */
+unsigned int g_Payload_Cache_Fingerprints[MAX_DEVICE_TYPE] = {0};
+
+PAYLOAD_CACHE_STATS g_Payload_Cache_Stats = {0};
+
+static PPAYLOAD_CACHE_ENTRY find_entry(DEVICE_TYPE device_type, const char* savename);
+static PPAYLOAD_CACHE_ENTRY evict_lru(void);
+static SLINGA_ERROR find_gap(unsigned int size, unsigned int* offset);
+static void compact(void);
+static void free_entry(PPAYLOAD_CACHE_ENTRY entry);
+static void drop_device(DEVICE_TYPE device_type);
+static unsigned int next_clock(void);
+
+/**
+ * @brief Give the cache its memory. Anything cached before is dropped
+ *
+ * @param[in] buffer Memory for cached saves. NULL disables the cache
+ * @param[in] size Size of buffer in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_SetPayloadCache(unsigned char* buffer, unsigned int size)
+{
+    if(buffer && !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(g_Payload_Cache_Entries, 0, sizeof(g_Payload_Cache_Entries));
+
+    g_Payload_Cache_Buffer = buffer;
+    g_Payload_Cache_Size = buffer ? size : 0;
+    g_Payload_Cache_Clock = 0;
+
+    g_Payload_Cache_Stats.bytes_used = 0;
+    g_Payload_Cache_Stats.bytes_total = g_Payload_Cache_Size;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Drop every cached save of a device
+ *
+ * @param[in] device_type backup device
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_InvalidatePayloadCache(DEVICE_TYPE device_type)
+{
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    drop_device(device_type);
+
+#ifdef INCLUDE_SPAN
+    // the device may be a span member, the span's copies came from it
+    if(device_type != DEVICE_SPAN)
+    {
+        drop_device(DEVICE_SPAN);
+    }
+#endif
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Report the current state of a device. Its cached saves are dropped if the fingerprint changed
+ *
+ * Any value that changes when the partition changes works, e.g. a cartridge
+ * ID and insertion count, or a checksum the caller keeps of the SAT blocks.
+ *
+ * @param[in] device_type backup device
+ * @param[in] fingerprint Caller defined fingerprint of the partition
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_SetPayloadCacheFingerprint(DEVICE_TYPE device_type, unsigned int fingerprint)
+{
+    SLINGA_ERROR result = 0;
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(g_Payload_Cache_Fingerprints[device_type] == fingerprint)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    result = Slinga_InvalidatePayloadCache(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    g_Payload_Cache_Fingerprints[device_type] = fingerprint;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Get the cache counters
+ *
+ * @param[out] stats Counters on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_GetPayloadCacheStats(PPAYLOAD_CACHE_STATS stats)
+{
+    if(!stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memcpy(stats, &g_Payload_Cache_Stats, sizeof(PAYLOAD_CACHE_STATS));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Zero the hit, miss, eviction and invalidation counters
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_ResetPayloadCacheStats(void)
+{
+    g_Payload_Cache_Stats.hits = 0;
+    g_Payload_Cache_Stats.misses = 0;
+    g_Payload_Cache_Stats.evictions = 0;
+    g_Payload_Cache_Stats.invalidations = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Copy a save out of the cache
+ *
+ * @param[in] device_type backup device
+ * @param[in] filename Save name, with or without .BUP
+ * @param[out] buffer Save data on success
+ * @param[in] size Size of buffer in bytes
+ * @param[out] bytes_read Bytes copied on success
+ *
+ * Only whole saves are cached, a hit always copies out the complete save.
+ *
+ * @return SLINGA_SUCCESS on a hit, SLINGA_NOT_FOUND on a miss
+ */
+SLINGA_ERROR payload_cache_read(DEVICE_TYPE device_type, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    PPAYLOAD_CACHE_ENTRY entry = NULL;
+
+    if(!g_Payload_Cache_Buffer || !buffer)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    if(bup_get_savename(filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    entry = find_entry(device_type, savename);
+
+    // a smaller buffer is left to the device, it decides how to fail
+    if(!entry || entry->size > size)
+    {
+        g_Payload_Cache_Stats.misses++;
+        return SLINGA_NOT_FOUND;
+    }
+
+    memcpy(buffer, g_Payload_Cache_Buffer + entry->offset, entry->size);
+    entry->last_used = next_clock();
+
+    if(bytes_read)
+    {
+        *bytes_read = entry->size;
+    }
+
+    g_Payload_Cache_Stats.hits++;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Add a save that was just read to the cache, evicting older saves if needed
+ *
+ * @param[in] device_type backup device
+ * @param[in] filename Save name, with or without .BUP
+ * @param[in] buffer Save data, the whole save. Never a partial read
+ * @param[in] size Size of the save data in bytes
+ */
+void payload_cache_insert(DEVICE_TYPE device_type, const char* filename, const unsigned char* buffer, unsigned int size)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    PPAYLOAD_CACHE_ENTRY entry = NULL;
+    unsigned int offset = 0;
+
+    if(!g_Payload_Cache_Buffer || !buffer || !size || size > g_Payload_Cache_Size)
+    {
+        return;
+    }
+
+    if(bup_get_savename(filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+    {
+        return;
+    }
+
+    // replace an older copy
+    entry = find_entry(device_type, savename);
+    if(entry)
+    {
+        free_entry(entry);
+    }
+
+    entry = NULL;
+    for(unsigned int i = 0; i < PAYLOAD_CACHE_MAX_ENTRIES; i++)
+    {
+        if(!g_Payload_Cache_Entries[i].last_used)
+        {
+            entry = &g_Payload_Cache_Entries[i];
+            break;
+        }
+    }
+
+    if(!entry)
+    {
+        entry = evict_lru();
+    }
+
+    //
+    // make room, compacting first if there is enough free space in total
+    //
+    while(find_gap(size, &offset) != SLINGA_SUCCESS)
+    {
+        if(g_Payload_Cache_Size - g_Payload_Cache_Stats.bytes_used >= size)
+        {
+            compact();
+            continue;
+        }
+
+        evict_lru();
+    }
+
+    memcpy(g_Payload_Cache_Buffer + offset, buffer, size);
+
+    entry->device_type = device_type;
+    strcpy(entry->savename, savename);
+    entry->offset = offset;
+    entry->size = size;
+    entry->last_used = next_clock();
+
+    g_Payload_Cache_Stats.bytes_used += size;
+}
+
+/**
+ * @brief Drop the cached copy of a save after it was written or deleted
+ *
+ * @param[in] device_type backup device
+ * @param[in] filename Save name, with or without .BUP
+ */
+void payload_cache_remove(DEVICE_TYPE device_type, const char* filename)
+{
+    char savename[MAX_SAVENAME + 1] = {0};
+    PPAYLOAD_CACHE_ENTRY entry = NULL;
+
+    if(!g_Payload_Cache_Buffer)
+    {
+        return;
+    }
+
+    if(bup_get_savename(filename, savename, sizeof(savename)) != SLINGA_SUCCESS)
+    {
+        return;
+    }
+
+    entry = find_entry(device_type, savename);
+    if(entry)
+    {
+        free_entry(entry);
+        g_Payload_Cache_Stats.invalidations++;
+    }
+
+#ifdef INCLUDE_SPAN
+    // the span may have read the save through this device
+    if(device_type != DEVICE_SPAN)
+    {
+        entry = find_entry(DEVICE_SPAN, savename);
+        if(entry)
+        {
+            free_entry(entry);
+            g_Payload_Cache_Stats.invalidations++;
+        }
+    }
+#endif
+}
+
+//
+// helpers
+//
+
+/**
+ * @brief Find the cached copy of a save
+ *
+ * @return The entry, NULL if the save isn't cached
+ */
+static PPAYLOAD_CACHE_ENTRY find_entry(DEVICE_TYPE device_type, const char* savename)
+{
+    for(unsigned int i = 0; i < PAYLOAD_CACHE_MAX_ENTRIES; i++)
+    {
+        PPAYLOAD_CACHE_ENTRY entry = &g_Payload_Cache_Entries[i];
+
+        if(entry->last_used && entry->device_type == device_type && strcmp(entry->savename, savename) == 0)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Drop the least recently used save
+ *
+ * @return The freed entry, NULL if the cache was empty
+ */
+static PPAYLOAD_CACHE_ENTRY evict_lru(void)
+{
+    PPAYLOAD_CACHE_ENTRY oldest = NULL;
+
+    for(unsigned int i = 0; i < PAYLOAD_CACHE_MAX_ENTRIES; i++)
+    {
+        PPAYLOAD_CACHE_ENTRY entry = &g_Payload_Cache_Entries[i];
+
+        if(entry->last_used && (!oldest || entry->last_used < oldest->last_used))
+        {
+            oldest = entry;
+        }
+    }
+
+    if(oldest)
+    {
+        free_entry(oldest);
+        g_Payload_Cache_Stats.evictions++;
+    }
+
+    return oldest;
+}
+
+/**
+ * @brief Find the first free range of the cache buffer that fits size bytes
+ */
+static SLINGA_ERROR find_gap(unsigned int size, unsigned int* offset)
+{
+    unsigned int start = 0;
+
+    //
+    // try the start of the buffer and the end of every entry
+    // at most 16 entries, so checking each candidate against all of them is fine
+    //
+    for(unsigned int i = 0; i <= PAYLOAD_CACHE_MAX_ENTRIES; i++)
+    {
+        unsigned int fits = 1;
+
+        if(i > 0)
+        {
+            if(!g_Payload_Cache_Entries[i - 1].last_used)
+            {
+                continue;
+            }
+
+            start = g_Payload_Cache_Entries[i - 1].offset + g_Payload_Cache_Entries[i - 1].size;
+        }
+
+        if(start + size > g_Payload_Cache_Size)
+        {
+            continue;
+        }
+
+        for(unsigned int j = 0; j < PAYLOAD_CACHE_MAX_ENTRIES; j++)
+        {
+            PPAYLOAD_CACHE_ENTRY entry = &g_Payload_Cache_Entries[j];
+
+            if(entry->last_used && entry->offset < start + size && start < entry->offset + entry->size)
+            {
+                fits = 0;
+                break;
+            }
+        }
+
+        if(fits)
+        {
+            *offset = start;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Move all cached saves to the start of the buffer, leaving one free range at the end
+ */
+static void compact(void)
+{
+    unsigned int next_offset = 0;
+
+    // move entries down in offset order so nothing is overwritten
+    for(;;)
+    {
+        PPAYLOAD_CACHE_ENTRY lowest = NULL;
+
+        for(unsigned int i = 0; i < PAYLOAD_CACHE_MAX_ENTRIES; i++)
+        {
+            PPAYLOAD_CACHE_ENTRY entry = &g_Payload_Cache_Entries[i];
+
+            if(entry->last_used && entry->offset >= next_offset && (!lowest || entry->offset < lowest->offset))
+            {
+                lowest = entry;
+            }
+        }
+
+        if(!lowest)
+        {
+            break;
+        }
+
+        if(lowest->offset != next_offset)
+        {
+            memmove(g_Payload_Cache_Buffer + next_offset, g_Payload_Cache_Buffer + lowest->offset, lowest->size);
+            lowest->offset = next_offset;
+        }
+
+        next_offset += lowest->size;
+    }
+}
+
+/**
+ * @brief Mark an entry free
+ */
+static void free_entry(PPAYLOAD_CACHE_ENTRY entry)
+{
+    g_Payload_Cache_Stats.bytes_used -= entry->size;
+
+    entry->last_used = 0;
+    entry->size = 0;
+}
+
+/**
+ * @brief Advance the LRU clock. Starts over with every entry at 1 if it wraps
+ */
+static unsigned int next_clock(void)
+{
+    g_Payload_Cache_Clock++;
+
+    if(!g_Payload_Cache_Clock)
+    {
+        for(unsigned int i = 0; i < PAYLOAD_CACHE_MAX_ENTRIES; i++)
+        {
+            if(g_Payload_Cache_Entries[i].last_used)
+            {
+                g_Payload_Cache_Entries[i].last_used = 1;
+            }
+        }
+
+        g_Payload_Cache_Clock = 2;
+    }
+
+    return g_Payload_Cache_Clock;
+}
+
+/**
+ * @brief Drop every cached save of one device
+ */
+static void drop_device(DEVICE_TYPE device_type)
+{
+    for(unsigned int i = 0; i < PAYLOAD_CACHE_MAX_ENTRIES; i++)
+    {
+        if(g_Payload_Cache_Entries[i].last_used && g_Payload_Cache_Entries[i].device_type == device_type)
+        {
+            free_entry(&g_Payload_Cache_Entries[i]);
+            g_Payload_Cache_Stats.invalidations++;
+        }
+    }
+}
+
+#endif
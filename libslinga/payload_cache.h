@@ -0,0 +1,67 @@
+/** @file payload_cache.h
+ *
+ *  @author Slinga
+ *  @brief LRU cache of recently read save data
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "libslinga_conf.h"
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+
+#include "../libslinga.h"
+
+//
+// Optional cache in front of Slinga_Read(). A save that was read recently
+// is copied out of the cache instead of finding it on the device, walking
+// its SAT table and copying it out of the skip byte partition again.
+//
+// The caller hands over the memory the cache lives in with
+// Slinga_SetPayloadCache(), e.g. expansion cartridge RAM on the Saturn or
+// the heap on a host. When the cache is full the least recently used saves
+// are evicted.
+//
+// Only whole saves are cached, a read that stopped short of the end of the
+// save is not. Slinga_Write(), Slinga_Delete() and Slinga_Format() drop the
+// cached copy of the saves they touch, and on a span member the span's copy
+// too. Changes made behind the library's back (a cartridge swap, another
+// program writing the partition) can't be seen; report them with
+// Slinga_SetPayloadCacheFingerprint() or Slinga_InvalidatePayloadCache().
+//
+
+#define PAYLOAD_CACHE_MAX_ENTRIES   16  ///< @brief Maximum number of cached saves
+
+/** @brief One cached save */
+typedef struct _PAYLOAD_CACHE_ENTRY
+{
+    DEVICE_TYPE device_type;            ///< @brief Device the save was read from
+    char savename[MAX_SAVENAME + 1];    ///< @brief Save name, without .BUP
+    unsigned int offset;                ///< @brief Offset of the data in the cache buffer
+    unsigned int size;                  ///< @brief Size of the data in bytes
+    unsigned int last_used;             ///< @brief Clock of the last hit, 0 if the entry is free
+} PAYLOAD_CACHE_ENTRY, *PPAYLOAD_CACHE_ENTRY;
+
+/** @brief Cache counters */
+typedef struct _PAYLOAD_CACHE_STATS
+{
+    unsigned int hits;                  ///< @brief Reads served from the cache
+    unsigned int misses;                ///< @brief Reads that went to the device
+    unsigned int evictions;             ///< @brief Saves dropped to make room
+    unsigned int invalidations;         ///< @brief Saves dropped by a write, delete, format or fingerprint change
+    unsigned int bytes_used;            ///< @brief Bytes of the cache buffer holding save data
+    unsigned int bytes_total;           ///< @brief Size of the cache buffer
+} PAYLOAD_CACHE_STATS, *PPAYLOAD_CACHE_STATS;
+
+SLINGA_ERROR Slinga_SetPayloadCache(unsigned char* buffer, unsigned int size);
+SLINGA_ERROR Slinga_InvalidatePayloadCache(DEVICE_TYPE device_type);
+SLINGA_ERROR Slinga_SetPayloadCacheFingerprint(DEVICE_TYPE device_type, unsigned int fingerprint);
+SLINGA_ERROR Slinga_GetPayloadCacheStats(PPAYLOAD_CACHE_STATS stats);
+SLINGA_ERROR Slinga_ResetPayloadCacheStats(void);
+
+// called by libslinga.c
+SLINGA_ERROR payload_cache_read(DEVICE_TYPE device_type, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+void payload_cache_insert(DEVICE_TYPE device_type, const char* filename, const unsigned char* buffer, unsigned int size);
+void payload_cache_remove(DEVICE_TYPE device_type, const char* filename);
+
+#endif
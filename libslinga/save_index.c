@@ -0,0 +1,447 @@
+/** @file save_index.c
+ *
+ *  @author Slinga
+ *  @brief Timestamp and size ordered save indexes
+ *  @bug No known bugs.
+ */
+#include "save_index.h"
+
+#ifdef INCLUDE_SAVE_INDEX
+
+/** @brief Index slots, assigned by Slinga_EnableIndex() */
+SAVE_INDEX g_Save_Indexes[SAVE_INDEX_MAX_DEVICES] = {0};
+
+static PSAVE_INDEX get_index(DEVICE_TYPE device_type);
+static SLINGA_ERROR load_index(PSAVE_INDEX index);
+static SLINGA_ERROR find_save(const PSAVE_INDEX index, const char* filename, unsigned int* slot);
+static unsigned int key_value(const PSAVE_INDEX index, SAVE_INDEX_KEY key, unsigned int slot);
+static unsigned int search_order(const PSAVE_INDEX index, SAVE_INDEX_KEY key, unsigned int count, unsigned int value, unsigned int below);
+static unsigned int find_in_order(const PSAVE_INDEX index, SAVE_INDEX_KEY key, unsigned int slot);
+static void insert_slot(PSAVE_INDEX index, unsigned int slot);
+static void remove_slot(PSAVE_INDEX index, unsigned int slot);
+
+/**
+ * @brief Start indexing a device. The index is built on the first query
+ *
+ * @param[in] device_type Device to index
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if all index slots are taken
+ */
+SLINGA_ERROR Slinga_EnableIndex(DEVICE_TYPE device_type)
+{
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    if(get_index(device_type))
+    {
+        // already indexed
+        return SLINGA_SUCCESS;
+    }
+
+    for(unsigned int i = 0; i < SAVE_INDEX_MAX_DEVICES; i++)
+    {
+        if(!g_Save_Indexes[i].in_use)
+        {
+            g_Save_Indexes[i].device_type = device_type;
+            g_Save_Indexes[i].in_use = 1;
+            g_Save_Indexes[i].is_valid = 0;
+            g_Save_Indexes[i].num_saves = 0;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_BUFFER_TOO_SMALL;
+}
+
+/**
+ * @brief Stop indexing a device and free its slot
+ *
+ * @param[in] device_type Indexed device
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_DisableIndex(DEVICE_TYPE device_type)
+{
+    PSAVE_INDEX index = NULL;
+
+    index = get_index(device_type);
+    if(!index)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    index->in_use = 0;
+    index->is_valid = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Throw away the index of a device. It is rebuilt on the next query
+ *
+ * @param[in] device_type Indexed device
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_InvalidateIndex(DEVICE_TYPE device_type)
+{
+    PSAVE_INDEX index = NULL;
+
+    index = get_index(device_type);
+    if(!index)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    index->is_valid = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Get the first saves in index order, e.g. the newest num_saves saves
+ *
+ * @param[in] device_type Indexed device
+ * @param[in] key Ordering to use
+ * @param[out] saves Filled out SAVE_METADATA array on success
+ * @param[in] num_saves size in elements of saves array
+ * @param[out] saves_found Number of saves written to saves on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_IndexTop(DEVICE_TYPE device_type, SAVE_INDEX_KEY key, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    // everything is in range, the first num_saves are returned
+    return Slinga_IndexRange(device_type, key, 0, 0xFFFFFFFF, saves, num_saves, saves_found);
+}
+
+/**
+ * @brief Get the saves whose key is between min_value and max_value, in index order
+ *
+ * For example saves modified after T is SAVE_INDEX_BY_TIMESTAMP with
+ * min_value T + 1 and max_value 0xFFFFFFFF.
+ *
+ * @param[in] device_type Indexed device
+ * @param[in] key Ordering to use
+ * @param[in] min_value Smallest key to return, inclusive
+ * @param[in] max_value Largest key to return, inclusive
+ * @param[out] saves Filled out SAVE_METADATA array on success. Can be NULL to only count matches
+ * @param[in] num_saves size in elements of saves array
+ * @param[out] saves_found Number of saves written to saves on success, or number of matches if saves is NULL
+ *
+ * @return SLINGA_SUCCESS on success. If more saves match than fit, the first num_saves are returned
+ */
+SLINGA_ERROR Slinga_IndexRange(DEVICE_TYPE device_type, SAVE_INDEX_KEY key, unsigned int min_value, unsigned int max_value, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    PSAVE_INDEX index = NULL;
+    unsigned int start = 0;
+    unsigned int end = 0;
+    unsigned int found = 0;
+    SLINGA_ERROR result = 0;
+
+    if(key < 0 || key >= SAVE_INDEX_MAX_KEY || !saves_found)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    index = get_index(device_type);
+    if(!index)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    result = load_index(index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(min_value > max_value)
+    {
+        *saves_found = 0;
+        return SLINGA_SUCCESS;
+    }
+
+    // the order is descending, so max_value comes first
+    start = search_order(index, key, index->num_saves, max_value, 0);
+    end = search_order(index, key, index->num_saves, min_value, 1);
+
+    if(!saves)
+    {
+        *saves_found = end - start;
+        return SLINGA_SUCCESS;
+    }
+
+    for(unsigned int i = start; i < end && found < num_saves; i++)
+    {
+        memcpy(&saves[found], &index->saves[index->order[key][i]], sizeof(SAVE_METADATA));
+        found++;
+    }
+
+    *saves_found = found;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Patch the index after a successful Slinga_Write()
+ *
+ * @param[in] device_type Device written to
+ * @param[in] filename Save that was written
+ */
+void save_index_on_write(DEVICE_TYPE device_type, const char* filename)
+{
+    PSAVE_INDEX index = NULL;
+    SAVE_METADATA metadata = {0};
+    unsigned int slot = 0;
+    SLINGA_ERROR result = 0;
+
+    index = get_index(device_type);
+    if(!index || !index->is_valid)
+    {
+        // nothing to patch
+        return;
+    }
+
+    // the device decides the final block count and timestamp
+    result = Slinga_QueryFile(device_type, 0, filename, &metadata);
+    if(result != SLINGA_SUCCESS)
+    {
+        index->is_valid = 0;
+        return;
+    }
+
+    if(find_save(index, metadata.savename, &slot) == SLINGA_SUCCESS)
+    {
+        // overwritten, drop the old position
+        remove_slot(index, slot);
+    }
+    else
+    {
+        if(index->num_saves >= SAVE_INDEX_MAX_SAVES)
+        {
+            index->is_valid = 0;
+            return;
+        }
+
+        slot = index->num_saves;
+        index->num_saves++;
+    }
+
+    memcpy(&index->saves[slot], &metadata, sizeof(SAVE_METADATA));
+    insert_slot(index, slot);
+}
+
+/**
+ * @brief Patch the index after a successful Slinga_Delete()
+ *
+ * @param[in] device_type Device deleted from
+ * @param[in] filename Save that was deleted
+ */
+void save_index_on_delete(DEVICE_TYPE device_type, const char* filename)
+{
+    PSAVE_INDEX index = NULL;
+    unsigned int slot = 0;
+    unsigned int last = 0;
+
+    index = get_index(device_type);
+    if(!index || !index->is_valid)
+    {
+        return;
+    }
+
+    if(find_save(index, filename, &slot) != SLINGA_SUCCESS)
+    {
+        // the index and the device disagree
+        index->is_valid = 0;
+        return;
+    }
+
+    remove_slot(index, slot);
+    index->num_saves--;
+
+    //
+    // move the last save into the hole and repoint its order entries
+    //
+    last = index->num_saves;
+    if(slot != last)
+    {
+        for(unsigned int key = 0; key < SAVE_INDEX_MAX_KEY; key++)
+        {
+            index->order[key][find_in_order(index, key, last)] = (unsigned char)slot;
+        }
+
+        memcpy(&index->saves[slot], &index->saves[last], sizeof(SAVE_METADATA));
+    }
+}
+
+//
+// helpers
+//
+
+/**
+ * @brief Find the index slot assigned to a device
+ *
+ * @return The slot, NULL if the device isn't indexed
+ */
+static PSAVE_INDEX get_index(DEVICE_TYPE device_type)
+{
+    for(unsigned int i = 0; i < SAVE_INDEX_MAX_DEVICES; i++)
+    {
+        if(g_Save_Indexes[i].in_use && g_Save_Indexes[i].device_type == device_type)
+        {
+            return &g_Save_Indexes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief List the device and build both orderings if the index isn't valid
+ */
+static SLINGA_ERROR load_index(PSAVE_INDEX index)
+{
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    if(index->is_valid)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    result = Slinga_List(index->device_type, 0, index->saves, SAVE_INDEX_MAX_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // insert one at a time, the orderings are built as they go
+    index->num_saves = 0;
+    for(unsigned int i = 0; i < saves_found; i++)
+    {
+        index->num_saves++;
+        insert_slot(index, i);
+    }
+
+    index->is_valid = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Find a save by file or save name
+ */
+static SLINGA_ERROR find_save(const PSAVE_INDEX index, const char* filename, unsigned int* slot)
+{
+    for(unsigned int i = 0; i < index->num_saves; i++)
+    {
+        // file backed devices may be given "NAME.BUP"
+        if(strcmp(index->saves[i].savename, filename) == 0 || strcmp(index->saves[i].filename, filename) == 0)
+        {
+            *slot = i;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Value a save is ordered by
+ */
+static unsigned int key_value(const PSAVE_INDEX index, SAVE_INDEX_KEY key, unsigned int slot)
+{
+    if(key == SAVE_INDEX_BY_TIMESTAMP)
+    {
+        return index->saves[slot].timestamp;
+    }
+
+    return index->saves[slot].block_size;
+}
+
+/**
+ * @brief Binary search the descending order of a key
+ *
+ * @param[in] index Index to search
+ * @param[in] key Ordering to search
+ * @param[in] count Number of entries in the order
+ * @param[in] value Value to look for
+ * @param[in] below 0 to find the first entry <= value, 1 to find the first entry < value
+ *
+ * @return Position in the order, count if there is none
+ */
+static unsigned int search_order(const PSAVE_INDEX index, SAVE_INDEX_KEY key, unsigned int count, unsigned int value, unsigned int below)
+{
+    unsigned int low = 0;
+    unsigned int high = count;
+
+    while(low < high)
+    {
+        unsigned int middle = low + (high - low) / 2;
+        unsigned int current = key_value(index, key, index->order[key][middle]);
+
+        if(current > value || (below && current == value))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief Position of a slot in the order of a key. The order must contain the slot
+ */
+static unsigned int find_in_order(const PSAVE_INDEX index, SAVE_INDEX_KEY key, unsigned int slot)
+{
+    unsigned int i = 0;
+
+    // only saves with the same value have to be scanned
+    for(i = search_order(index, key, index->num_saves, key_value(index, key, slot), 0); i < index->num_saves - 1; i++)
+    {
+        if(index->order[key][i] == slot)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief Add a slot to every ordering. num_saves must already include it
+ */
+static void insert_slot(PSAVE_INDEX index, unsigned int slot)
+{
+    for(unsigned int key = 0; key < SAVE_INDEX_MAX_KEY; key++)
+    {
+        // the order doesn't contain slot yet
+        unsigned int count = index->num_saves - 1;
+        unsigned int position = search_order(index, key, count, key_value(index, key, slot), 1);
+
+        memmove(&index->order[key][position + 1], &index->order[key][position], count - position);
+        index->order[key][position] = (unsigned char)slot;
+    }
+}
+
+/**
+ * @brief Remove a slot from every ordering. num_saves is left alone
+ */
+static void remove_slot(PSAVE_INDEX index, unsigned int slot)
+{
+    for(unsigned int key = 0; key < SAVE_INDEX_MAX_KEY; key++)
+    {
+        unsigned int position = find_in_order(index, key, slot);
+
+        memmove(&index->order[key][position], &index->order[key][position + 1], index->num_saves - position - 1);
+    }
+}
+
+#endif
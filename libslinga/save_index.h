@@ -0,0 +1,60 @@
+/** @file save_index.h
+ *
+ *  @author Slinga
+ *  @brief Timestamp and size ordered save indexes
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "libslinga_conf.h"
+
+#ifdef INCLUDE_SAVE_INDEX
+
+#include "../libslinga.h"
+
+//
+// Optional per-device indexes for the usual save menu queries: most recent
+// saves, largest saves, saves modified after a given time. Each indexed
+// device keeps a copy of its directory plus two orderings of it, newest
+// first and most blocks first, so top-K and range queries are a binary
+// search and a copy instead of a Slinga_List() and a sort.
+//
+// An index is built on the first query after Slinga_EnableIndex(), then
+// Slinga_Write(), Slinga_Delete() and Slinga_Format() keep it current.
+// Call Slinga_InvalidateIndex() after changing the device any other way.
+//
+
+#define SAVE_INDEX_MAX_DEVICES  2           ///< @brief Number of devices that can be indexed at once
+#define SAVE_INDEX_MAX_SAVES    MAX_SAVES   ///< @brief Maximum saves per indexed device
+
+/** @brief Index orderings */
+typedef enum
+{
+    SAVE_INDEX_BY_TIMESTAMP = 0,    ///< @brief Timestamp, newest first
+    SAVE_INDEX_BY_BLOCKS = 1,       ///< @brief Block count, largest first
+    SAVE_INDEX_MAX_KEY,
+} SAVE_INDEX_KEY;
+
+/** @brief Directory copy and orderings of one device */
+typedef struct _SAVE_INDEX
+{
+    DEVICE_TYPE device_type;                                        ///< @brief Indexed device
+    unsigned char in_use;                                           ///< @brief Slot is assigned to device_type
+    unsigned char is_valid;                                         ///< @brief saves and order reflect the device
+    unsigned int num_saves;                                         ///< @brief Number of saves on the device
+    SAVE_METADATA saves[SAVE_INDEX_MAX_SAVES];                      ///< @brief Directory, unordered
+    unsigned char order[SAVE_INDEX_MAX_KEY][SAVE_INDEX_MAX_SAVES];  ///< @brief Indexes into saves, one ordering per key
+} SAVE_INDEX, *PSAVE_INDEX;
+
+SLINGA_ERROR Slinga_EnableIndex(DEVICE_TYPE device_type);
+SLINGA_ERROR Slinga_DisableIndex(DEVICE_TYPE device_type);
+SLINGA_ERROR Slinga_InvalidateIndex(DEVICE_TYPE device_type);
+
+SLINGA_ERROR Slinga_IndexTop(DEVICE_TYPE device_type, SAVE_INDEX_KEY key, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+SLINGA_ERROR Slinga_IndexRange(DEVICE_TYPE device_type, SAVE_INDEX_KEY key, unsigned int min_value, unsigned int max_value, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+
+// called by libslinga.c
+void save_index_on_write(DEVICE_TYPE device_type, const char* filename);
+void save_index_on_delete(DEVICE_TYPE device_type, const char* filename);
+
+#endif
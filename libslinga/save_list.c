@@ -0,0 +1,261 @@
+/** @file save_list.c
+ *
+ *  @author Slinga
+ *  @brief Compact structure of arrays save listing
+ *  @bug No known bugs.
+ */
+#include "save_list.h"
+
+#ifdef INCLUDE_SAVE_LIST
+
+/** @brief One page of Slinga_ListPage(), shared by every device and list */
+SAVE_METADATA g_Save_List_Page[SLINGA_LIST_PAGE_LEN] = {0};
+
+static int compare_entries(const PSAVE_LIST list, SAVE_LIST_KEY key, unsigned short a, unsigned short b);
+
+/**
+ * @brief Empty a save list. The arrays are kept
+ *
+ * @param[in] list List to clear
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_ClearSaveList(PSAVE_LIST list)
+{
+    if(!list)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    list->count = 0;
+    list->pool_used = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief List all saves on the device and append them to a compact list
+ *
+ * @param[in] device_type backup device
+ * @param[in] flags flags field
+ * @param[in,out] list List to append to. Nothing is appended on failure
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if the saves don't fit in list
+ */
+SLINGA_ERROR Slinga_ListCompact(DEVICE_TYPE device_type, FLAGS flags, PSAVE_LIST list)
+{
+    unsigned int cursor = SLINGA_LIST_START;
+    unsigned int count = 0;
+    unsigned int pool_used = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!list)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // undo the pages already appended if a later one fails
+    count = list->count;
+    pool_used = list->pool_used;
+
+    while(cursor != SLINGA_LIST_END)
+    {
+        unsigned int saves_found = 0;
+
+        result = Slinga_ListPage(device_type, flags, cursor, g_Save_List_Page, SLINGA_LIST_PAGE_LEN, &saves_found, &cursor);
+        if(result == SLINGA_SUCCESS)
+        {
+            result = Slinga_AddToSaveList(list, device_type, g_Save_List_Page, saves_found);
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            list->count = count;
+            list->pool_used = pool_used;
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Append saves to a compact list
+ *
+ * @param[in,out] list List to append to. Nothing is appended on failure
+ * @param[in] device_type Recorded in list->device
+ * @param[in] saves Saves to append
+ * @param[in] num_saves Number of saves
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if the saves don't fit in list
+ */
+SLINGA_ERROR Slinga_AddToSaveList(PSAVE_LIST list, DEVICE_TYPE device_type, const SAVE_METADATA* saves, unsigned int num_saves)
+{
+    unsigned int pool_needed = 0;
+
+    if(!list || !list->pool || !list->name || !list->data_size || (!saves && num_saves))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(list->pool_size > 0x10000)
+    {
+        // pool offsets are 16 bits
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // check everything fits first so a failure leaves the list untouched
+    if(num_saves > list->capacity - list->count)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        pool_needed += strnlen(saves[i].savename, MAX_SAVENAME) + strnlen(saves[i].comment, MAX_COMMENT) + 2;
+    }
+
+    if(pool_needed > list->pool_size - list->pool_used)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        unsigned int index = list->count + i;
+        unsigned int len = 0;
+
+        list->name[index] = (unsigned short)list->pool_used;
+
+        len = strnlen(saves[i].savename, MAX_SAVENAME);
+        memcpy(&list->pool[list->pool_used], saves[i].savename, len);
+        list->pool[list->pool_used + len] = '\0';
+        list->pool_used += len + 1;
+
+        len = strnlen(saves[i].comment, MAX_COMMENT);
+        memcpy(&list->pool[list->pool_used], saves[i].comment, len);
+        list->pool[list->pool_used + len] = '\0';
+        list->pool_used += len + 1;
+
+        list->data_size[index] = saves[i].data_size;
+
+        if(list->timestamp)
+        {
+            list->timestamp[index] = saves[i].timestamp;
+        }
+
+        if(list->block_size)
+        {
+            list->block_size[index] = saves[i].block_size;
+        }
+
+        if(list->language)
+        {
+            list->language[index] = saves[i].language;
+        }
+
+        if(list->device)
+        {
+            list->device[index] = (unsigned char)device_type;
+        }
+    }
+
+    list->count += num_saves;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Sort a compact list without moving its entries
+ *
+ * @param[in] list List to sort
+ * @param[in] key What to sort by. The matching array must not be NULL
+ * @param[out] order list->count entry indexes in sorted order
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_SortSaveList(const PSAVE_LIST list, SAVE_LIST_KEY key, unsigned short* order)
+{
+    // Ciura's gap sequence
+    const unsigned short gaps[] = {701, 301, 132, 57, 23, 10, 4, 1};
+
+    if(!list || !order)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if((key == SAVE_LIST_BY_TIMESTAMP && !list->timestamp) ||
+       (key == SAVE_LIST_BY_DEVICE && !list->device) ||
+       key > SAVE_LIST_BY_DEVICE)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(list->count > 0x10000)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    for(unsigned int i = 0; i < list->count; i++)
+    {
+        order[i] = (unsigned short)i;
+    }
+
+    // shell sort, no extra memory and quick enough for a few thousand saves
+    for(unsigned int g = 0; g < sizeof(gaps)/sizeof(gaps[0]); g++)
+    {
+        unsigned int gap = gaps[g];
+
+        for(unsigned int i = gap; i < list->count; i++)
+        {
+            unsigned short temp = order[i];
+            unsigned int j = i;
+
+            while(j >= gap && compare_entries(list, key, order[j - gap], temp) > 0)
+            {
+                order[j] = order[j - gap];
+                j -= gap;
+            }
+
+            order[j] = temp;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+// returns < 0 if entry a sorts before entry b
+static int compare_entries(const PSAVE_LIST list, SAVE_LIST_KEY key, unsigned short a, unsigned short b)
+{
+    switch(key)
+    {
+        case SAVE_LIST_BY_TIMESTAMP:
+            if(list->timestamp[a] != list->timestamp[b])
+            {
+                return list->timestamp[a] > list->timestamp[b] ? -1 : 1;
+            }
+            break;
+
+        case SAVE_LIST_BY_SIZE:
+            if(list->data_size[a] != list->data_size[b])
+            {
+                return list->data_size[a] > list->data_size[b] ? -1 : 1;
+            }
+            break;
+
+        case SAVE_LIST_BY_DEVICE:
+            if(list->device[a] != list->device[b])
+            {
+                return list->device[a] < list->device[b] ? -1 : 1;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    // ties and SAVE_LIST_BY_NAME
+    return strcmp(SAVE_LIST_NAME(list, a), SAVE_LIST_NAME(list, b));
+}
+
+#endif
@@ -0,0 +1,64 @@
+/** @file save_list.h
+ *
+ *  @author Slinga
+ *  @brief Compact structure of arrays save listing
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "libslinga_conf.h"
+
+#ifdef INCLUDE_SAVE_LIST
+
+#include "../libslinga.h"
+
+//
+// Slinga_List() fills an array of SAVE_METADATA, ~72 bytes per save mostly
+// spent on padded strings. SAVE_LIST keeps the same information in parallel
+// arrays with the save names and comments packed into a string pool, about
+// a third of the size. Listing several devices appends to the same list, and
+// sorting or filtering only touches the array being compared.
+//
+// The caller owns every array. Each per-save array must hold capacity
+// entries. Optional arrays may be NULL.
+//
+
+/** @brief Sort keys for Slinga_SortSaveList() */
+typedef enum
+{
+    SAVE_LIST_BY_NAME = 0,          ///< @brief Save name, ascending
+    SAVE_LIST_BY_TIMESTAMP = 1,     ///< @brief Timestamp, newest first
+    SAVE_LIST_BY_SIZE = 2,          ///< @brief Data size, largest first
+    SAVE_LIST_BY_DEVICE = 3,        ///< @brief Device, then save name
+} SAVE_LIST_KEY;
+
+/** @brief Structure of arrays save listing */
+typedef struct _SAVE_LIST
+{
+    unsigned int capacity;          ///< @brief Number of entries in each per-save array
+    unsigned int count;             ///< @brief Number of saves in the list
+
+    char* pool;                     ///< @brief String pool, "savename\0comment\0" per save
+    unsigned int pool_size;         ///< @brief Size of pool in bytes, at most 64KB
+    unsigned int pool_used;         ///< @brief Bytes of pool in use
+
+    unsigned short* name;           ///< @brief Offset of the save name in pool. The comment follows it
+    unsigned int* data_size;        ///< @brief Size of the save data in bytes
+    unsigned int* timestamp;        ///< @brief Save modified time. Optional
+    unsigned short* block_size;     ///< @brief Blocks used by the save. Optional
+    unsigned char* language;        ///< @brief Language of the save. Optional
+    unsigned char* device;          ///< @brief DEVICE_TYPE the save was listed from. Optional
+} SAVE_LIST, *PSAVE_LIST;
+
+/** @brief Save name of entry i */
+#define SAVE_LIST_NAME(list, i)     (&(list)->pool[(list)->name[(i)]])
+
+/** @brief Comment of entry i */
+#define SAVE_LIST_COMMENT(list, i)  (SAVE_LIST_NAME(list, i) + strlen(SAVE_LIST_NAME(list, i)) + 1)
+
+SLINGA_ERROR Slinga_ClearSaveList(PSAVE_LIST list);
+SLINGA_ERROR Slinga_ListCompact(DEVICE_TYPE device_type, FLAGS flags, PSAVE_LIST list);
+SLINGA_ERROR Slinga_AddToSaveList(PSAVE_LIST list, DEVICE_TYPE device_type, const SAVE_METADATA* saves, unsigned int num_saves);
+SLINGA_ERROR Slinga_SortSaveList(const PSAVE_LIST list, SAVE_LIST_KEY key, unsigned short* order);
+
+#endif
@@ -0,0 +1,791 @@
+/** @file shim.c
+ *
+ *  @author Slinga
+ *  @brief BUP library compatible API on top of libslinga
+ *  @bug Only partition 0 is supported.
+ */
+#include "shim.h"
+
+#ifdef INCLUDE_SHIM
+
+#include "../devices/bup/bup.h"
+
+// SAT layout used to estimate BupStat datanum
+#define SHIM_SAT_TAG_SIZE       4   // every block starts with a tag
+#define SHIM_SAT_HEADER_SIZE    30  // savename, language, comment, timestamp, data size
+#define SHIM_SAT_ENTRY_SIZE     2   // one per data block plus the terminator
+
+/** @brief BUP device to libslinga device mapping and cached state */
+SHIM_DEVICE g_Shim_Devices[SHIM_MAX_DEVICES] = {{.device_type = DEVICE_INTERNAL}, {.device_type = DEVICE_CARTRIDGE}, {.device_type = DEVICE_SERIAL}};
+
+/** @brief One page of Slinga_ListPage() while filling a directory */
+SAVE_METADATA g_Shim_Page[SLINGA_LIST_PAGE_LEN] = {0};
+
+/** @brief Caller provided buffer used by Shim_Verify() */
+unsigned char* g_Shim_Verify_Buffer = NULL;
+unsigned int g_Shim_Verify_Buffer_Size = 0;
+
+static SLINGA_ERROR get_device(unsigned int device, PSHIM_DEVICE* shim_device);
+static SLINGA_ERROR load_directory(PSHIM_DEVICE shim_device);
+static SLINGA_ERROR load_stat(PSHIM_DEVICE shim_device);
+static SLINGA_ERROR find_save(PSHIM_DEVICE shim_device, const char* filename, unsigned int* index);
+static SLINGA_ERROR update_save(PSHIM_DEVICE shim_device, const char* filename);
+static void remove_save(PSHIM_DEVICE shim_device, unsigned int index);
+static void metadata_to_dir(const PSAVE_METADATA metadata, PSHIM_DIR dir);
+static unsigned int calc_blocks_needed(unsigned int datasize, unsigned int block_size);
+static int to_bup_result(SLINGA_ERROR result);
+
+/**
+ * @brief Back a BUP device with a libslinga device. Defaults are internal, cartridge and serial
+ *
+ * @param[in] device BUP device number (0 - 2)
+ * @param[in] device_type libslinga device to use, e.g. DEVICE_SATIATIOR to redirect cartridge saves to an ODE
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Shim_MapDevice(unsigned int device, DEVICE_TYPE device_type)
+{
+    if(device >= SHIM_MAX_DEVICES)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    g_Shim_Devices[device].device_type = device_type;
+
+    return Shim_Invalidate(device);
+}
+
+/**
+ * @brief Drop the cached directory and stat of a BUP device
+ *
+ * @param[in] device BUP device number (0 - 2)
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Shim_Invalidate(unsigned int device)
+{
+    if(device >= SHIM_MAX_DEVICES)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_Shim_Devices[device].dir_valid = 0;
+    g_Shim_Devices[device].stat_valid = 0;
+    g_Shim_Devices[device].num_saves = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Provide the buffer Shim_Verify() reads saves into
+ *
+ * @param[in] buffer Buffer big enough for the largest save to verify. NULL to remove
+ * @param[in] size Size of buffer in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Shim_SetVerifyBuffer(unsigned char* buffer, unsigned int size)
+{
+    if(buffer && !size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    g_Shim_Verify_Buffer = buffer;
+    g_Shim_Verify_Buffer_Size = buffer ? size : 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief BUP_Init. Initializes libslinga if needed and reports which devices are connected
+ *
+ * @param[in] lib Unused, BUP library load address
+ * @param[in] work Unused, BUP library work RAM
+ * @param[out] config One entry per BUP device
+ */
+void Shim_Init(unsigned int* lib, unsigned int* work, PSHIM_CONFIG config)
+{
+    UNUSED(lib);
+    UNUSED(work);
+
+    if(!g_Context.isInit)
+    {
+        Slinga_Init();
+    }
+
+    for(unsigned int i = 0; i < SHIM_MAX_DEVICES; i++)
+    {
+        Shim_Invalidate(i);
+
+        if(!config)
+        {
+            continue;
+        }
+
+        if(Slinga_IsPresent(g_Shim_Devices[i].device_type) == SLINGA_SUCCESS)
+        {
+            config[i].unit_id = (unsigned short)(i + 1);
+            config[i].partition = 1;
+        }
+        else
+        {
+            config[i].unit_id = 0;
+            config[i].partition = 0;
+        }
+    }
+}
+
+/**
+ * @brief BUP_SelPart. Only partition 0 exists
+ *
+ * @return SHIM_BUP_SUCCESS on success
+ */
+int Shim_SelPart(unsigned int device, unsigned short num)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(num != 0)
+    {
+        return SHIM_BUP_NON;
+    }
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_Format
+ *
+ * @return SHIM_BUP_SUCCESS on success
+ */
+int Shim_Format(unsigned int device)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    result = Slinga_Format(shim_device->device_type);
+
+    // whatever happened, the old directory is gone
+    Shim_Invalidate(device);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    // an empty device doesn't need listing
+    shim_device->dir_valid = 1;
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_Stat
+ *
+ * @param[in] device BUP device number
+ * @param[in] datasize Save size used to calculate stat->datanum
+ * @param[out] stat Device stats
+ *
+ * @return SHIM_BUP_SUCCESS on success
+ */
+int Shim_Stat(unsigned int device, unsigned int datasize, PSHIM_STAT stat)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    unsigned int blocks_needed = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(!stat)
+    {
+        return SHIM_BUP_BROKEN;
+    }
+
+    result = load_stat(shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    stat->totalsize = shim_device->stat.total_bytes;
+    stat->totalblock = shim_device->stat.total_blocks;
+    stat->blocksize = shim_device->stat.block_size;
+    stat->freesize = shim_device->stat.free_bytes;
+    stat->freeblock = shim_device->stat.free_blocks;
+    stat->datanum = 0;
+
+    blocks_needed = calc_blocks_needed(datasize, shim_device->stat.block_size);
+    if(blocks_needed)
+    {
+        stat->datanum = shim_device->stat.free_blocks / blocks_needed;
+    }
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_Write
+ *
+ * @param[in] device BUP device number
+ * @param[in] dir Save name, comment, language, date and size
+ * @param[in] data Save data, dir->datasize bytes
+ * @param[in] wmode SHIM_OVERWRITE_ON to replace an existing save, SHIM_OVERWRITE_OFF to fail instead
+ *
+ * @return SHIM_BUP_SUCCESS on success, SHIM_BUP_FOUND if the save exists and wmode is SHIM_OVERWRITE_OFF
+ */
+int Shim_Write(unsigned int device, const PSHIM_DIR dir, const unsigned char* data, unsigned char wmode)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    SAVE_METADATA metadata = {0};
+    char savename[SHIM_MAX_SAVENAME] = {0};
+    char comment[SHIM_MAX_COMMENT] = {0};
+    unsigned int index = 0;
+    FLAGS flags = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(!dir || !data)
+    {
+        return SHIM_BUP_BROKEN;
+    }
+
+    // BupDir strings aren't guaranteed to be terminated
+    memcpy(savename, dir->filename, sizeof(savename) - 1);
+    memcpy(comment, dir->comment, sizeof(comment) - 1);
+
+    result = load_directory(shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(find_save(shim_device, savename, &index) == SLINGA_SUCCESS)
+    {
+        if(wmode != SHIM_OVERWRITE_ON)
+        {
+            return SHIM_BUP_FOUND;
+        }
+
+        flags |= OVERWRITE_EXISTING_SAVE;
+    }
+
+    result = Slinga_SetSaveMetadata(&metadata, savename, savename, comment, dir->language, dir->date, dir->datasize);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    result = Slinga_Write(shim_device->device_type, flags, savename, &metadata, data, dir->datasize);
+
+    // free space changed, or might have if the write failed halfway
+    shim_device->stat_valid = 0;
+
+    if(result != SLINGA_SUCCESS)
+    {
+        Shim_Invalidate(device);
+        return to_bup_result(result);
+    }
+
+    result = update_save(shim_device, savename);
+    if(result != SLINGA_SUCCESS)
+    {
+        // the save is on the device, we just lost track of it
+        Shim_Invalidate(device);
+    }
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_Read
+ *
+ * @param[in] device BUP device number
+ * @param[in] filename Save name
+ * @param[out] data Save data. Must be large enough to hold the whole save
+ *
+ * @return SHIM_BUP_SUCCESS on success
+ */
+int Shim_Read(unsigned int device, const char* filename, unsigned char* data)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    unsigned int index = 0;
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(!filename || !data)
+    {
+        return SHIM_BUP_BROKEN;
+    }
+
+    result = load_directory(shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    // misses are answered from the directory without touching the device
+    result = find_save(shim_device, filename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    result = Slinga_Read(shim_device->device_type, 0, shim_device->saves[index].filename, data, shim_device->saves[index].datasize, &bytes_read);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_Delete
+ *
+ * @return SHIM_BUP_SUCCESS on success
+ */
+int Shim_Delete(unsigned int device, const char* filename)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(!filename)
+    {
+        return SHIM_BUP_BROKEN;
+    }
+
+    result = load_directory(shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    result = find_save(shim_device, filename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    result = Slinga_Delete(shim_device->device_type, 0, shim_device->saves[index].filename);
+    shim_device->stat_valid = 0;
+    if(result != SLINGA_SUCCESS)
+    {
+        Shim_Invalidate(device);
+        return to_bup_result(result);
+    }
+
+    remove_save(shim_device, index);
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_Dir. Lists saves whose name starts with filename
+ *
+ * @param[in] device BUP device number
+ * @param[in] filename Save name prefix. "" matches everything
+ * @param[in] tbsize Number of entries in dir
+ * @param[out] dir Matching saves
+ *
+ * @return Number of matching saves. Negative number of matching saves if they don't all fit in dir
+ */
+int Shim_Dir(unsigned int device, const char* filename, unsigned short tbsize, PSHIM_DIR dir)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    unsigned int prefix_len = 0;
+    int found = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return -to_bup_result(result);
+    }
+
+    result = load_directory(shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return -to_bup_result(result);
+    }
+
+    if(filename)
+    {
+        prefix_len = strnlen(filename, SHIM_MAX_SAVENAME - 1);
+    }
+
+    for(unsigned int i = 0; i < shim_device->num_saves; i++)
+    {
+        if(strncmp(shim_device->saves[i].filename, filename ? filename : "", prefix_len) != 0)
+        {
+            continue;
+        }
+
+        if(dir && (unsigned int)found < tbsize)
+        {
+            memcpy(&dir[found], &shim_device->saves[i], sizeof(SHIM_DIR));
+        }
+
+        found++;
+    }
+
+    if(found > tbsize)
+    {
+        return -found;
+    }
+
+    return found;
+}
+
+/**
+ * @brief BUP_Verify. Requires a buffer set with Shim_SetVerifyBuffer()
+ *
+ * @param[in] device BUP device number
+ * @param[in] filename Save name
+ * @param[in] data Expected save data
+ *
+ * @return SHIM_BUP_SUCCESS if the save matches data, SHIM_BUP_NO_MATCH if it doesn't
+ */
+int Shim_Verify(unsigned int device, const char* filename, const unsigned char* data)
+{
+    PSHIM_DEVICE shim_device = NULL;
+    unsigned int index = 0;
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
+
+    result = get_device(device, &shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(!filename || !data)
+    {
+        return SHIM_BUP_BROKEN;
+    }
+
+    result = load_directory(shim_device);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    result = find_save(shim_device, filename, &index);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(shim_device->saves[index].datasize > g_Shim_Verify_Buffer_Size)
+    {
+        // no buffer, or it's too small for this save
+        return SHIM_BUP_BROKEN;
+    }
+
+    result = Slinga_Read(shim_device->device_type, 0, shim_device->saves[index].filename, g_Shim_Verify_Buffer, shim_device->saves[index].datasize, &bytes_read);
+    if(result != SLINGA_SUCCESS)
+    {
+        return to_bup_result(result);
+    }
+
+    if(bytes_read != shim_device->saves[index].datasize || memcmp(g_Shim_Verify_Buffer, data, bytes_read) != 0)
+    {
+        return SHIM_BUP_NO_MATCH;
+    }
+
+    return SHIM_BUP_SUCCESS;
+}
+
+/**
+ * @brief BUP_GetDate
+ *
+ * @param[in] date Save timestamp
+ * @param[out] backup_date Date
+ */
+void Shim_GetDate(unsigned int date, PBACKUP_DATE backup_date)
+{
+    Slinga_ConvertTimestampToDate(date, backup_date);
+}
+
+/**
+ * @brief BUP_SetDate
+ *
+ * @param[in] backup_date Date
+ *
+ * @return Save timestamp, 0 if backup_date is invalid
+ */
+unsigned int Shim_SetDate(const PBACKUP_DATE backup_date)
+{
+    unsigned int timestamp = 0;
+
+    if(Slinga_ConvertDateToTimestamp(backup_date, &timestamp) != SLINGA_SUCCESS)
+    {
+        return 0;
+    }
+
+    return timestamp;
+}
+
+//
+// helper functions
+//
+
+static SLINGA_ERROR get_device(unsigned int device, PSHIM_DEVICE* shim_device)
+{
+    SLINGA_ERROR result = 0;
+
+    if(device >= SHIM_MAX_DEVICES)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    // presence is cached by the device after the first check
+    result = Slinga_IsPresent(g_Shim_Devices[device].device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        Shim_Invalidate(device);
+        return result;
+    }
+
+    *shim_device = &g_Shim_Devices[device];
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Fill the directory a page at a time if it isn't already
+ */
+static SLINGA_ERROR load_directory(PSHIM_DEVICE shim_device)
+{
+    unsigned int cursor = SLINGA_LIST_START;
+    SLINGA_ERROR result = 0;
+
+    if(shim_device->dir_valid)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    shim_device->num_saves = 0;
+
+    while(cursor != SLINGA_LIST_END)
+    {
+        unsigned int saves_found = 0;
+
+        result = Slinga_ListPage(shim_device->device_type, 0, cursor, g_Shim_Page, SLINGA_LIST_PAGE_LEN, &saves_found, &cursor);
+        if(result != SLINGA_SUCCESS)
+        {
+            shim_device->num_saves = 0;
+            return result;
+        }
+
+        if(saves_found > MAX_SAVES - shim_device->num_saves)
+        {
+            shim_device->num_saves = 0;
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        for(unsigned int i = 0; i < saves_found; i++)
+        {
+            metadata_to_dir(&g_Shim_Page[i], &shim_device->saves[shim_device->num_saves++]);
+        }
+    }
+
+    shim_device->dir_valid = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR load_stat(PSHIM_DEVICE shim_device)
+{
+    SLINGA_ERROR result = 0;
+
+    if(shim_device->stat_valid)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    result = Slinga_Stat(shim_device->device_type, &shim_device->stat);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    shim_device->stat_valid = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR find_save(PSHIM_DEVICE shim_device, const char* filename, unsigned int* index)
+{
+    for(unsigned int i = 0; i < shim_device->num_saves; i++)
+    {
+        if(strncmp(shim_device->saves[i].filename, filename, SHIM_MAX_SAVENAME - 1) == 0)
+        {
+            *index = i;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+/**
+ * @brief Refresh one directory entry after a write instead of listing the whole device
+ */
+static SLINGA_ERROR update_save(PSHIM_DEVICE shim_device, const char* filename)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Slinga_QueryFile(shim_device->device_type, 0, filename, &metadata);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(find_save(shim_device, filename, &index) != SLINGA_SUCCESS)
+    {
+        if(shim_device->num_saves >= MAX_SAVES)
+        {
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        index = shim_device->num_saves++;
+    }
+
+    metadata_to_dir(&metadata, &shim_device->saves[index]);
+
+    return SLINGA_SUCCESS;
+}
+
+static void remove_save(PSHIM_DEVICE shim_device, unsigned int index)
+{
+    // keep the device's listing order
+    memmove(&shim_device->saves[index], &shim_device->saves[index + 1], (shim_device->num_saves - index - 1) * sizeof(SHIM_DIR));
+    shim_device->num_saves--;
+}
+
+static void metadata_to_dir(const PSAVE_METADATA metadata, PSHIM_DIR dir)
+{
+    memset(dir, 0, sizeof(SHIM_DIR));
+
+    // savename is what BUP calls filename
+    memcpy(dir->filename, metadata->savename, LIBSLINGA_MIN(strlen(metadata->savename), sizeof(dir->filename) - 1));
+    memcpy(dir->comment, metadata->comment, LIBSLINGA_MIN(strlen(metadata->comment), sizeof(dir->comment) - 1));
+    dir->language = metadata->language;
+    dir->date = metadata->timestamp;
+    dir->datasize = metadata->data_size;
+    dir->blocksize = metadata->block_size;
+}
+
+/**
+ * @brief Estimate how many blocks a save of datasize bytes takes
+ *
+ * Block devices use the SAT layout: a tagged start block holding the header,
+ * then the block table (one entry per data block plus a terminator) and the
+ * data, with a tag at the start of every block. File backed devices report
+ * BUP_BLOCK_SIZE blocks and have no overhead.
+ */
+static unsigned int calc_blocks_needed(unsigned int datasize, unsigned int block_size)
+{
+    unsigned int usable = 0;
+    unsigned int blocks = 1;
+
+    if(block_size <= BUP_BLOCK_SIZE)
+    {
+        return bup_calc_blocks(datasize);
+    }
+
+    usable = block_size - SHIM_SAT_TAG_SIZE;
+
+    // table size depends on the block count, iterate until it settles
+    for(;;)
+    {
+        unsigned int total = SHIM_SAT_HEADER_SIZE + (blocks + 1) * SHIM_SAT_ENTRY_SIZE + datasize;
+        unsigned int needed = (total + usable - 1) / usable;
+
+        if(needed <= blocks)
+        {
+            return blocks;
+        }
+
+        blocks = needed;
+    }
+}
+
+static int to_bup_result(SLINGA_ERROR result)
+{
+    switch(result)
+    {
+        case SLINGA_SUCCESS:
+            return SHIM_BUP_SUCCESS;
+
+        case SLINGA_INVALID_DEVICE_TYPE:
+        case SLINGA_DEVICE_NOT_PRESENT:
+        case SLINGA_DEVICE_TYPE_NOT_COMPILED_IN:
+        case SLINGA_NOT_INITIALIZED:
+            return SHIM_BUP_NON;
+
+        case SLINGA_NOT_FORMATTED:
+        case SLINGA_SAT_UNFORMATTED:
+            return SHIM_BUP_UNFORMAT;
+
+        case SLINGA_NOT_SUPPORTED:
+            // only writes get here, the device is read-only
+            return SHIM_BUP_WRITE_PROTECT;
+
+        case SLINGA_NOT_ENOUGH_SPACE:
+            return SHIM_BUP_NOT_ENOUGH_MEMORY;
+
+        case SLINGA_NOT_FOUND:
+            return SHIM_BUP_NOT_FOUND;
+
+        case SLINGA_FILE_EXISTS:
+            return SHIM_BUP_FOUND;
+
+        default:
+            return SHIM_BUP_BROKEN;
+    }
+}
+
+#endif
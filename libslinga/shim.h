@@ -0,0 +1,108 @@
+/** @file shim.h
+ *
+ *  @author Slinga
+ *  @brief BUP library compatible API on top of libslinga
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "libslinga_conf.h"
+
+#ifdef INCLUDE_SHIM
+
+#include "../libslinga.h"
+#include "timestamp.h"
+
+//
+// Drop in replacement for the BIOS backup library (the BUP_* functions
+// reached through the pointer at 0x06000354). Functions take the same
+// arguments and return the same result codes as their BUP counterparts.
+//
+// Games call BUP_Dir and BUP_Stat constantly, often before every read or
+// write. Each BUP device keeps a copy of its directory and stat that is
+// filled on first use and then patched by Shim_Write() and Shim_Delete(),
+// so repeated calls don't walk the partition again.
+//
+// The directory copy is only valid as long as everything goes through the
+// shim. Call Shim_Invalidate() after touching the device with Slinga_*.
+//
+
+#define SHIM_MAX_DEVICES        3   ///< @brief BUP device 0 (internal), 1 (cartridge), 2 (serial)
+#define SHIM_MAX_SAVENAME       12  ///< @brief BupDir filename, NULL terminated
+#define SHIM_MAX_COMMENT        11  ///< @brief BupDir comment, NULL terminated
+
+/** @brief BUP_Write wmode */
+#define SHIM_OVERWRITE_ON       0   ///< @brief Replace an existing save
+#define SHIM_OVERWRITE_OFF      1   ///< @brief Fail with SHIM_BUP_FOUND if the save exists
+
+/** @brief BUP library result codes */
+typedef enum
+{
+    SHIM_BUP_SUCCESS = 0,           ///< @brief Success
+    SHIM_BUP_NON = 1,               ///< @brief Device not connected
+    SHIM_BUP_UNFORMAT = 2,          ///< @brief Device not formatted
+    SHIM_BUP_WRITE_PROTECT = 3,     ///< @brief Device is write protected
+    SHIM_BUP_NOT_ENOUGH_MEMORY = 4, ///< @brief Not enough free space
+    SHIM_BUP_NOT_FOUND = 5,         ///< @brief Save not found
+    SHIM_BUP_FOUND = 6,             ///< @brief Save already exists
+    SHIM_BUP_NO_MATCH = 7,          ///< @brief Verify failed
+    SHIM_BUP_BROKEN = 8,            ///< @brief Device is corrupt
+} SHIM_BUP_RESULT;
+
+/** @brief BupConfig */
+typedef struct _SHIM_CONFIG
+{
+    unsigned short unit_id;         ///< @brief 0 if the device is not connected
+    unsigned short partition;       ///< @brief Number of partitions
+} SHIM_CONFIG, *PSHIM_CONFIG;
+
+/** @brief BupStat */
+typedef struct _SHIM_STAT
+{
+    unsigned int totalsize;         ///< @brief Total size in bytes
+    unsigned int totalblock;        ///< @brief Total size in blocks
+    unsigned int blocksize;         ///< @brief Block size in bytes
+    unsigned int freesize;          ///< @brief Free size in bytes
+    unsigned int freeblock;         ///< @brief Free size in blocks
+    unsigned int datanum;           ///< @brief Number of saves of the requested size that would fit
+} SHIM_STAT, *PSHIM_STAT;
+
+/** @brief BupDir */
+typedef struct _SHIM_DIR
+{
+    char filename[SHIM_MAX_SAVENAME];   ///< @brief Save name
+    char comment[SHIM_MAX_COMMENT];     ///< @brief Save comment
+    unsigned char language;             ///< @brief Language of the save
+    unsigned int date;                  ///< @brief Timestamp of the save
+    unsigned int datasize;              ///< @brief Save size in bytes
+    unsigned short blocksize;           ///< @brief Save size in blocks
+} SHIM_DIR, *PSHIM_DIR;
+
+/** @brief Cached state of one BUP device. Treat as opaque */
+typedef struct _SHIM_DEVICE
+{
+    DEVICE_TYPE device_type;        ///< @brief libslinga device backing the BUP device
+    unsigned char dir_valid;        ///< @brief 1 if saves is up to date
+    unsigned char stat_valid;       ///< @brief 1 if stat is up to date
+    unsigned int num_saves;         ///< @brief Number of entries in saves
+    SHIM_DIR saves[MAX_SAVES];      ///< @brief Directory
+    BACKUP_STAT stat;               ///< @brief Device stat
+} SHIM_DEVICE, *PSHIM_DEVICE;
+
+SLINGA_ERROR Shim_MapDevice(unsigned int device, DEVICE_TYPE device_type);
+SLINGA_ERROR Shim_Invalidate(unsigned int device);
+SLINGA_ERROR Shim_SetVerifyBuffer(unsigned char* buffer, unsigned int size);
+
+void Shim_Init(unsigned int* lib, unsigned int* work, PSHIM_CONFIG config);
+int Shim_SelPart(unsigned int device, unsigned short num);
+int Shim_Format(unsigned int device);
+int Shim_Stat(unsigned int device, unsigned int datasize, PSHIM_STAT stat);
+int Shim_Write(unsigned int device, const PSHIM_DIR dir, const unsigned char* data, unsigned char wmode);
+int Shim_Read(unsigned int device, const char* filename, unsigned char* data);
+int Shim_Delete(unsigned int device, const char* filename);
+int Shim_Dir(unsigned int device, const char* filename, unsigned short tbsize, PSHIM_DIR dir);
+int Shim_Verify(unsigned int device, const char* filename, const unsigned char* data);
+void Shim_GetDate(unsigned int date, PBACKUP_DATE backup_date);
+unsigned int Shim_SetDate(const PBACKUP_DATE backup_date);
+
+#endif
@@ -9,6 +9,8 @@
 // Function prototypes
 int is_leap_year(int year);
 int days_in_month(int month, int year);
+static unsigned int days_from_civil(unsigned int year, unsigned int month, unsigned int day);
+static void civil_from_days(unsigned int days, unsigned int* year, unsigned int* month, unsigned int* day);
 
 /**
  * @brief Convert backup date to backup timestamp (seconds since 1980)
@@ -20,43 +22,32 @@ int days_in_month(int month, int year);
  */
 SLINGA_ERROR Slinga_ConvertDateToTimestamp(const PBACKUP_DATE date, unsigned int* timestamp)
 {
-    if(!date)
+    unsigned int days = 0;
+    unsigned int seconds = 0;
+
+    if(!date || !timestamp)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
     // sanity check date
-    if(date->month > MAX_MONTH || date->day > MAX_DAY ||
+    if(date->month < 1 || date->month > MAX_MONTH || date->day < 1 ||
+       date->day > days_in_month(date->month, date->year + EPOCH_YEAR) ||
        date->hour > MAX_HOUR || date->minute > MAX_MINUTE)
     {
         return SLINGA_INVALID_PARAMETER;
     }
 
-    int seconds = 0;
-
-    // Add seconds for years since 1980
-    // account for leap year
-    // year is stored as year-1980
-    for (int y = 0; y < date->year; y++)
-    {
-        // year is stored as year-1980
-        seconds += (is_leap_year(y + 1980) ? DAYS_IN_LEAP_YEAR : DAYS_IN_YEAR) * SECONDS_IN_DAY;
-    }
+    days = days_from_civil(date->year + EPOCH_YEAR, date->month, date->day);
+    seconds = date->hour * SECONDS_IN_HOUR + date->minute * SECONDS_IN_MINUTE;
 
-    // Add seconds for months in the current year
-    // months is 1-12, not 0-11
-    for (int m = 1; m < date->month; m++)
+    // anything past early 2116 doesn't fit in 32 bits
+    if(days > (0xFFFFFFFF - seconds) / SECONDS_IN_DAY)
     {
-        seconds += days_in_month(m, date->year) * SECONDS_IN_DAY;
+        return SLINGA_INVALID_PARAMETER;
     }
 
-    // Add seconds for days in the current month
-    seconds += (date->day - 1) * SECONDS_IN_DAY;
-
-    // Add seconds for hours and minutes
-    seconds += date->hour * MINUTES_IN_HOUR + date->minute * SECONDS_IN_MINUTE;
-
-    *timestamp = seconds;
+    *timestamp = days * SECONDS_IN_DAY + seconds;
 
     return SLINGA_SUCCESS;
 }
@@ -65,47 +56,58 @@ SLINGA_ERROR Slinga_ConvertDateToTimestamp(const PBACKUP_DATE date, unsigned int
  * @brief Convert backup timestamp to backup date 
  *
  * @param[in] timestamp - seconds since 1980. This is the value used by the BUP header and saves
- * @param[out] date - name of backup device on success
+ * @param[out] date - date on success
  *
  * @return SLINGA_SUCCESS on success
  */
 SLINGA_ERROR Slinga_ConvertTimestampToDate(unsigned int timestamp, PBACKUP_DATE date)
 {
+    unsigned int days = 0;
+    unsigned int seconds = 0;
+    unsigned int year = 0;
+    unsigned int month = 0;
+    unsigned int day = 0;
+
     if(!date)
     {
         return SLINGA_INVALID_PARAMETER;
     }
-        
-    const int days_since_1980 = timestamp / SECONDS_IN_DAY;
-    int day_of_week = (days_since_1980 + 2) % DAYS_IN_WEEK;
-
-    int year = 1980;
-    while (timestamp >= (is_leap_year(year) ? 366 : 365) * SECONDS_IN_DAY) {
-        timestamp -= (is_leap_year(year) ? 366 : 365) * SECONDS_IN_DAY;
-        year++;
-    }
-
-    int month = 1;
-    while (timestamp >= days_in_month(month, year) * SECONDS_IN_DAY) {
-        timestamp -= days_in_month(month, year) * SECONDS_IN_DAY;
-        month++;
-    }
 
-    int day = timestamp / SECONDS_IN_DAY;
-    timestamp %= SECONDS_IN_DAY;
+    days = timestamp / SECONDS_IN_DAY;
+    seconds = timestamp % SECONDS_IN_DAY;
 
-    int hour = timestamp / SECONDS_IN_HOUR;
-    timestamp %= SECONDS_IN_HOUR;
+    civil_from_days(days, &year, &month, &day);
 
-    int minute = timestamp / SECONDS_IN_MINUTE;
-    timestamp %= SECONDS_IN_MINUTE;
-
-    date->year = year - 1980;
+    date->year = year - EPOCH_YEAR;
     date->month = month;
     date->day = day;
-    date->hour = hour;
-    date->minute = minute;
-    date->day_of_week = day_of_week;    
+    date->hour = seconds / SECONDS_IN_HOUR;
+    date->minute = (seconds % SECONDS_IN_HOUR) / SECONDS_IN_MINUTE;
+    date->day_of_week = (days + EPOCH_DAY_OF_WEEK) % DAYS_IN_WEEK;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Convert the timestamps of a list of saves to dates
+ *
+ * @param[in] saves - saves, usually from Slinga_List()
+ * @param[in] num_saves - number of entries in saves and dates
+ * @param[out] dates - date of each save on success
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Slinga_ConvertTimestampsToDates(const SAVE_METADATA* saves, unsigned int num_saves, PBACKUP_DATE dates)
+{
+    if(!saves || !dates)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        Slinga_ConvertTimestampToDate(saves[i].timestamp, &dates[i]);
+    }
 
     return SLINGA_SUCCESS;
 }
@@ -132,3 +134,47 @@ int days_in_month(int month, int year)
     return days_in_month[month];
 }
 
+//
+// Closed form conversions from http://howardhinnant.github.io/date_algorithms.html
+// Years start in March so the leap day is the last day of the year, then
+// everything is counted in 400 year eras of 146097 days. Only dates after
+// 1980 are used so everything stays unsigned.
+//
+
+// returns the number of days between Jan 1, 1980 and year/month/day
+static unsigned int days_from_civil(unsigned int year, unsigned int month, unsigned int day)
+{
+    unsigned int era = 0;
+    unsigned int year_of_era = 0;
+    unsigned int day_of_year = 0;
+    unsigned int day_of_era = 0;
+
+    year -= (month <= 2);
+    era = year / 400;
+    year_of_era = year - era * 400;
+    day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * DAYS_IN_ERA + day_of_era - DAYS_BEFORE_EPOCH;
+}
+
+// inverse of days_from_civil()
+static void civil_from_days(unsigned int days, unsigned int* year, unsigned int* month, unsigned int* day)
+{
+    unsigned int era = 0;
+    unsigned int day_of_era = 0;
+    unsigned int year_of_era = 0;
+    unsigned int day_of_year = 0;
+    unsigned int month_from_march = 0;
+
+    days += DAYS_BEFORE_EPOCH;
+    era = days / DAYS_IN_ERA;
+    day_of_era = days - era * DAYS_IN_ERA;
+    year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    month_from_march = (5 * day_of_year + 2) / 153;
+
+    *day = day_of_year - (153 * month_from_march + 2) / 5 + 1;
+    *month = month_from_march < 10 ? month_from_march + 3 : month_from_march - 9;
+    *year = year_of_era + era * 400 + (*month <= 2);
+}
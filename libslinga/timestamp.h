@@ -17,6 +17,11 @@
 #define DAYS_IN_YEAR      365
 #define DAYS_IN_LEAP_YEAR (DAYS_IN_YEAR + 1)
 
+#define EPOCH_YEAR        1980
+#define EPOCH_DAY_OF_WEEK 2         // Jan 1, 1980 was a Tuesday
+#define DAYS_IN_ERA       146097    // days in 400 Gregorian years
+#define DAYS_BEFORE_EPOCH 723120    // days between Mar 1, 0000 and Jan 1, 1980
+
 #define MAX_MONTH         12
 #define MAX_DAY           31
 #define MAX_HOUR          23
@@ -35,3 +40,4 @@ typedef struct _BACKUP_DATE
 
 SLINGA_ERROR Slinga_ConvertDateToTimestamp(const PBACKUP_DATE backup_date, unsigned int* seconds_since_1980);
 SLINGA_ERROR Slinga_ConvertTimestampToDate(unsigned int timestamp, PBACKUP_DATE date);
+SLINGA_ERROR Slinga_ConvertTimestampsToDates(const SAVE_METADATA* saves, unsigned int num_saves, PBACKUP_DATE dates);
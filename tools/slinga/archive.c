@@ -0,0 +1,620 @@
+/** @file archive.c
+ *
+ *  @author Slinga
+ *  @brief Deduplicating store of saves pulled from many images
+ *  @bug No known bugs.
+ */
+#include "archive.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define ARCHIVE_MAX_LINE    (ARCHIVE_MAX_PATH * 2 + 128)    // escaped .refs line
+
+static SLINGA_ERROR write_object(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], const unsigned char* data, unsigned int size, int* is_new);
+static SLINGA_ERROR append_ref(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], const char* line);
+static unsigned int escape_field(char* dst, unsigned int dst_size, const char* src, unsigned int src_size);
+static unsigned int unescape_field(char* dst, unsigned int dst_size, const char* src);
+static SLINGA_ERROR parse_ref(char* line, PARCHIVE_RECORD record);
+static void add_stats(PARCHIVE_STATS total, const ARCHIVE_STATS* stats);
+
+/**
+ * @brief Open an archive, creating the directory if needed
+ *
+ * @param[out] archive Archive on success
+ * @param[in] root Archive directory
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Archive_Open(PARCHIVE archive, const char* root)
+{
+    char path[ARCHIVE_MAX_PATH] = {0};
+
+    if(!archive || !root || strlen(root) + sizeof("/objects/00/") + SHA256_HEX_SIZE + 16 > sizeof(archive->root))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    strcpy(archive->root, root);
+
+    snprintf(path, sizeof(path), "%s/objects", root);
+
+    if((mkdir(root, 0755) != 0 && errno != EEXIST) || (mkdir(path, 0755) != 0 && errno != EEXIST))
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Store one save. The data is only written if the archive doesn't have it yet
+ *
+ * @param[in] archive Archive
+ * @param[in] image_path Image the save came from, recorded as given
+ * @param[in] metadata Save metadata
+ * @param[in] data Save data
+ * @param[in] size Size of data in bytes
+ * @param[out] digest SHA-256 of data on success
+ * @param[out] is_new Optional, set to 1 if the data was stored, 0 if it was already there
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Archive_AddSave(const PARCHIVE archive, const char* image_path, const PSAVE_METADATA metadata, const unsigned char* data, unsigned int size, unsigned char digest[SHA256_SIZE], int* is_new)
+{
+    char line[ARCHIVE_MAX_LINE] = {0};
+    unsigned int len = 0;
+    int created = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!archive || !image_path || !metadata || (!data && size) || !digest)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    SHA256_Hash(data, size, digest);
+
+    result = write_object(archive, digest, data, size, &created);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    len = escape_field(line, sizeof(line), image_path, strlen(image_path));
+    line[len++] = '\t';
+    len += escape_field(line + len, sizeof(line) - len, metadata->savename, strnlen(metadata->savename, MAX_SAVENAME));
+    line[len++] = '\t';
+    len += escape_field(line + len, sizeof(line) - len, metadata->comment, strnlen(metadata->comment, MAX_COMMENT));
+    snprintf(line + len, sizeof(line) - len, "\t%u\t%u\t%u\n", metadata->language, metadata->timestamp, size);
+
+    result = append_ref(archive, digest, line);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(is_new)
+    {
+        *is_new = created;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Store every save of an image
+ *
+ * @param[in] archive Archive
+ * @param[in] image_path Image to import
+ * @param[in,out] stats Counters to add to
+ *
+ * @return SLINGA_SUCCESS if the image could be listed, even if single saves failed
+ */
+SLINGA_ERROR Archive_ImportImage(const PARCHIVE archive, const char* image_path, PARCHIVE_STATS stats)
+{
+    static SAVE_METADATA saves[MAX_SAVES];
+    char full_path[PATH_MAX] = {0};
+    unsigned char digest[SHA256_SIZE] = {0};
+    unsigned char* data = NULL;
+    unsigned int saves_found = 0;
+    IMAGE image = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!archive || !image_path || !stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    // the same image reached by two relative paths is one image
+    if(!realpath(image_path, full_path) || strlen(full_path) >= ARCHIVE_MAX_PATH)
+    {
+        stats->failed_images++;
+        return SLINGA_NOT_FOUND;
+    }
+
+    result = Image_Open(&image, full_path, IMAGE_LAYOUT_UNKNOWN);
+    if(result != SLINGA_SUCCESS)
+    {
+        stats->failed_images++;
+        return result;
+    }
+
+    result = sat_list_saves(&image.partition_info, saves, MAX_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        Image_Close(&image);
+        stats->failed_images++;
+        return result;
+    }
+
+    // no save is bigger than the partition
+    data = malloc(image.size);
+    if(!data)
+    {
+        Image_Close(&image);
+        stats->failed_images++;
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    for(unsigned int i = 0; i < saves_found; i++)
+    {
+        unsigned int bytes_read = 0;
+        int is_new = 0;
+
+        result = sat_read(saves[i].savename, data, saves[i].data_size, &bytes_read, &image.partition_info);
+        if(result == SLINGA_SUCCESS)
+        {
+            result = Archive_AddSave(archive, full_path, &saves[i], data, bytes_read, digest, &is_new);
+        }
+
+        if(result != SLINGA_SUCCESS)
+        {
+            stats->failed_saves++;
+            continue;
+        }
+
+        stats->saves++;
+        stats->bytes += bytes_read;
+
+        if(is_new)
+        {
+            stats->new_objects++;
+            stats->new_bytes += bytes_read;
+        }
+    }
+
+    free(data);
+    Image_Close(&image);
+
+    stats->images++;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Store every save of many images, spread over worker processes
+ *
+ * @param[in] archive Archive
+ * @param[in] image_paths Images to import
+ * @param[in] num_images Number of images
+ * @param[in] jobs Worker processes, 0 or 1 to import in this process
+ * @param[out] stats Totals of every worker
+ *
+ * @return SLINGA_SUCCESS if every worker ran, check stats for images that failed
+ */
+SLINGA_ERROR Archive_Import(const PARCHIVE archive, char** image_paths, unsigned int num_images, unsigned int jobs, PARCHIVE_STATS stats)
+{
+    int pipes[64] = {0};
+    pid_t pids[64] = {0};
+    unsigned int started = 0;
+    SLINGA_ERROR result = SLINGA_SUCCESS;
+
+    if(!archive || (!image_paths && num_images) || !stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(stats, 0, sizeof(ARCHIVE_STATS));
+
+    if(jobs > sizeof(pids) / sizeof(pids[0]))
+    {
+        jobs = sizeof(pids) / sizeof(pids[0]);
+    }
+
+    if(jobs > num_images)
+    {
+        jobs = num_images;
+    }
+
+    if(jobs <= 1)
+    {
+        for(unsigned int i = 0; i < num_images; i++)
+        {
+            Archive_ImportImage(archive, image_paths[i], stats);
+        }
+
+        return SLINGA_SUCCESS;
+    }
+
+    // each worker takes every jobs'th image and reports its counters through a pipe
+    for(started = 0; started < jobs; started++)
+    {
+        int fds[2] = {0};
+
+        if(pipe(fds) != 0)
+        {
+            result = SLINGA_NOT_ENOUGH_SPACE;
+            break;
+        }
+
+        fflush(NULL);
+
+        pids[started] = fork();
+        if(pids[started] < 0)
+        {
+            close(fds[0]);
+            close(fds[1]);
+            result = SLINGA_NOT_ENOUGH_SPACE;
+            break;
+        }
+
+        if(pids[started] == 0)
+        {
+            ARCHIVE_STATS worker_stats = {0};
+
+            close(fds[0]);
+
+            for(unsigned int i = started; i < num_images; i += jobs)
+            {
+                Archive_ImportImage(archive, image_paths[i], &worker_stats);
+            }
+
+            _exit(write(fds[1], &worker_stats, sizeof(worker_stats)) == sizeof(worker_stats) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        pipes[started] = fds[0];
+    }
+
+    for(unsigned int i = 0; i < started; i++)
+    {
+        ARCHIVE_STATS worker_stats = {0};
+        int status = 0;
+
+        if(read(pipes[i], &worker_stats, sizeof(worker_stats)) == sizeof(worker_stats))
+        {
+            add_stats(stats, &worker_stats);
+        }
+        else
+        {
+            result = SLINGA_NOT_ENOUGH_SPACE;
+        }
+
+        close(pipes[i]);
+        waitpid(pids[i], &status, 0);
+    }
+
+    return result;
+}
+
+/**
+ * @brief List every image holding a save with the given data
+ *
+ * @param[in] archive Archive
+ * @param[in] digest SHA-256 of the save data
+ * @param[out] records Optional, copies of the save
+ * @param[in] num_records Number of entries in records
+ * @param[out] records_found Copies in the archive, may be more than num_records
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if the archive doesn't have the data, SLINGA_BUFFER_TOO_SMALL if records is too small
+ */
+SLINGA_ERROR Archive_Find(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], PARCHIVE_RECORD records, unsigned int num_records, unsigned int* records_found)
+{
+    char path[ARCHIVE_MAX_PATH] = {0};
+    char line[ARCHIVE_MAX_LINE] = {0};
+    unsigned int found = 0;
+    FILE* fp = NULL;
+    SLINGA_ERROR result = 0;
+
+    if(!archive || !digest || !records_found)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = Archive_GetObjectPath(archive, digest, ".refs", path, sizeof(path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    fp = fopen(path, "r");
+    if(!fp)
+    {
+        *records_found = 0;
+        return SLINGA_NOT_FOUND;
+    }
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        ARCHIVE_RECORD record = {0};
+
+        if(parse_ref(line, &record) != SLINGA_SUCCESS)
+        {
+            continue;
+        }
+
+        if(records && found < num_records)
+        {
+            records[found] = record;
+        }
+
+        found++;
+    }
+
+    fclose(fp);
+
+    *records_found = found;
+
+    return (records && found > num_records) ? SLINGA_BUFFER_TOO_SMALL : SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Path of an object or its metadata in the archive
+ *
+ * @param[in] archive Archive
+ * @param[in] digest SHA-256 of the save data
+ * @param[in] suffix "" for the data, ".refs" for the metadata
+ * @param[out] path Path on success
+ * @param[in] path_size Size of path in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Archive_GetObjectPath(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], const char* suffix, char* path, unsigned int path_size)
+{
+    char hex[SHA256_HEX_SIZE] = {0};
+    int len = 0;
+
+    if(!archive || !digest || !suffix || !path)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    SHA256_ToHex(digest, hex);
+
+    len = snprintf(path, path_size, "%s/objects/%.2s/%s%s", archive->root, hex, hex, suffix);
+    if(len < 0 || (unsigned int)len >= path_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// helper functions
+//
+
+// publishes the object with link() so exactly one writer creates it
+static SLINGA_ERROR write_object(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], const unsigned char* data, unsigned int size, int* is_new)
+{
+    char path[ARCHIVE_MAX_PATH] = {0};
+    char temp_path[ARCHIVE_MAX_PATH + 32] = {0};
+    struct stat st;
+    FILE* fp = NULL;
+    size_t written = 0;
+    char* slash = NULL;
+    SLINGA_ERROR result = 0;
+
+    *is_new = 0;
+
+    result = Archive_GetObjectPath(archive, digest, "", path, sizeof(path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(stat(path, &st) == 0)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    // objects/ab
+    slash = strrchr(path, '/');
+    *slash = '\0';
+    if(mkdir(path, 0755) != 0 && errno != EEXIST)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+    *slash = '/';
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp.%d", path, (int)getpid());
+
+    fp = fopen(temp_path, "wb");
+    if(!fp)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    written = fwrite(data, 1, size, fp);
+
+    if(fclose(fp) != 0 || written != size)
+    {
+        unlink(temp_path);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    if(link(temp_path, path) == 0)
+    {
+        *is_new = 1;
+    }
+    else if(errno != EEXIST)
+    {
+        unlink(temp_path);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    unlink(temp_path);
+
+    return SLINGA_SUCCESS;
+}
+
+// one write() with O_APPEND, so lines from different workers never interleave
+static SLINGA_ERROR append_ref(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], const char* line)
+{
+    char path[ARCHIVE_MAX_PATH] = {0};
+    char existing[ARCHIVE_MAX_LINE] = {0};
+    size_t len = strlen(line);
+    FILE* fp = NULL;
+    int fd = -1;
+    SLINGA_ERROR result = 0;
+
+    result = Archive_GetObjectPath(archive, digest, ".refs", path, sizeof(path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // importing an image again doesn't add the same lines again
+    fp = fopen(path, "r");
+    if(fp)
+    {
+        while(fgets(existing, sizeof(existing), fp))
+        {
+            if(strcmp(existing, line) == 0)
+            {
+                fclose(fp);
+                return SLINGA_SUCCESS;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd < 0)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    if(write(fd, line, len) != (ssize_t)len)
+    {
+        close(fd);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    close(fd);
+
+    return SLINGA_SUCCESS;
+}
+
+// returns the escaped length, stops early if dst is too small
+static unsigned int escape_field(char* dst, unsigned int dst_size, const char* src, unsigned int src_size)
+{
+    unsigned int len = 0;
+
+    for(unsigned int i = 0; i < src_size && len + 3 < dst_size; i++)
+    {
+        switch(src[i])
+        {
+            case '\t':
+                dst[len++] = '\\';
+                dst[len++] = 't';
+                break;
+            case '\n':
+                dst[len++] = '\\';
+                dst[len++] = 'n';
+                break;
+            case '\\':
+                dst[len++] = '\\';
+                dst[len++] = '\\';
+                break;
+            default:
+                dst[len++] = src[i];
+                break;
+        }
+    }
+
+    dst[len] = '\0';
+
+    return len;
+}
+
+static unsigned int unescape_field(char* dst, unsigned int dst_size, const char* src)
+{
+    unsigned int len = 0;
+
+    for(; *src && len + 1 < dst_size; src++)
+    {
+        if(*src == '\\' && src[1])
+        {
+            src++;
+            dst[len++] = (*src == 't') ? '\t' : (*src == 'n') ? '\n' : *src;
+        }
+        else
+        {
+            dst[len++] = *src;
+        }
+    }
+
+    dst[len] = '\0';
+
+    return len;
+}
+
+static SLINGA_ERROR parse_ref(char* line, PARCHIVE_RECORD record)
+{
+    char* fields[6] = {0};
+    unsigned int num_fields = 0;
+    char* c = line;
+
+    fields[num_fields++] = c;
+
+    for(; *c && *c != '\n'; c++)
+    {
+        if(*c == '\t')
+        {
+            *c = '\0';
+
+            if(num_fields == 6)
+            {
+                return SLINGA_INVALID_PARAMETER;
+            }
+
+            fields[num_fields++] = c + 1;
+        }
+    }
+
+    *c = '\0';
+
+    if(num_fields != 6)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    unescape_field(record->image, sizeof(record->image), fields[0]);
+    unescape_field(record->metadata.savename, sizeof(record->metadata.savename), fields[1]);
+    unescape_field(record->metadata.comment, sizeof(record->metadata.comment), fields[2]);
+    record->metadata.language = (unsigned char)strtoul(fields[3], NULL, 10);
+    record->metadata.timestamp = (unsigned int)strtoul(fields[4], NULL, 10);
+    record->metadata.data_size = (unsigned int)strtoul(fields[5], NULL, 10);
+
+    return SLINGA_SUCCESS;
+}
+
+static void add_stats(PARCHIVE_STATS total, const ARCHIVE_STATS* stats)
+{
+    total->images += stats->images;
+    total->failed_images += stats->failed_images;
+    total->saves += stats->saves;
+    total->failed_saves += stats->failed_saves;
+    total->new_objects += stats->new_objects;
+    total->bytes += stats->bytes;
+    total->new_bytes += stats->new_bytes;
+}
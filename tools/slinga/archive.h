@@ -0,0 +1,62 @@
+/** @file archive.h
+ *
+ *  @author Slinga
+ *  @brief Deduplicating store of saves pulled from many images
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "image.h"
+#include "sha256.h"
+
+//
+// Each distinct save payload is stored once, named by its SHA-256:
+//
+// ROOT/objects/ab/abcdef...        save data
+// ROOT/objects/ab/abcdef....refs   one line per image holding that data:
+//                                  image \t savename \t comment \t language \t timestamp \t size
+//
+// Importing the same save from a thousand images stores one object and a
+// thousand lines of metadata. "Which images contain this save" is a probe
+// of one .refs file. Tabs, newlines and backslashes in the fields are
+// escaped as \t, \n and \\.
+//
+// The SAT engine keeps its scratch state in globals, so parallel imports
+// run in worker processes rather than threads. Objects are published with
+// link() and metadata lines are single O_APPEND writes, so workers never
+// need to coordinate.
+//
+
+#define ARCHIVE_MAX_PATH    512     ///< @brief Longest path inside the archive
+
+/** @brief Archive on disk */
+typedef struct _ARCHIVE
+{
+    char root[ARCHIVE_MAX_PATH];    ///< @brief Archive directory
+} ARCHIVE, *PARCHIVE;
+
+/** @brief One copy of a save, read back from a .refs file */
+typedef struct _ARCHIVE_RECORD
+{
+    char image[ARCHIVE_MAX_PATH];   ///< @brief Image the save was imported from
+    SAVE_METADATA metadata;         ///< @brief Save metadata in that image
+} ARCHIVE_RECORD, *PARCHIVE_RECORD;
+
+/** @brief Import counters */
+typedef struct _ARCHIVE_STATS
+{
+    unsigned int images;            ///< @brief Images imported
+    unsigned int failed_images;     ///< @brief Images that couldn't be opened or listed
+    unsigned int saves;             ///< @brief Saves imported
+    unsigned int failed_saves;      ///< @brief Saves that couldn't be read or stored
+    unsigned int new_objects;       ///< @brief Saves whose data wasn't in the archive yet
+    unsigned long long bytes;       ///< @brief Save data imported
+    unsigned long long new_bytes;   ///< @brief Save data actually stored
+} ARCHIVE_STATS, *PARCHIVE_STATS;
+
+SLINGA_ERROR Archive_Open(PARCHIVE archive, const char* root);
+SLINGA_ERROR Archive_AddSave(const PARCHIVE archive, const char* image_path, const PSAVE_METADATA metadata, const unsigned char* data, unsigned int size, unsigned char digest[SHA256_SIZE], int* is_new);
+SLINGA_ERROR Archive_ImportImage(const PARCHIVE archive, const char* image_path, PARCHIVE_STATS stats);
+SLINGA_ERROR Archive_Import(const PARCHIVE archive, char** image_paths, unsigned int num_images, unsigned int jobs, PARCHIVE_STATS stats);
+SLINGA_ERROR Archive_Find(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], PARCHIVE_RECORD records, unsigned int num_records, unsigned int* records_found);
+SLINGA_ERROR Archive_GetObjectPath(const PARCHIVE archive, const unsigned char digest[SHA256_SIZE], const char* suffix, char* path, unsigned int path_size);
@@ -0,0 +1,1052 @@
+/** @file corpus.c
+ *
+ *  @author Slinga
+ *  @brief Persistent search index over the saves of many images
+ *  @bug No known bugs.
+ */
+#include "corpus.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// qsort() has no context argument
+static const CORPUS_SAVE* g_Sort_Saves = NULL;
+
+static SLINGA_ERROR index_image(PCORPUS corpus, const char* path, PCORPUS_STATS stats);
+static SLINGA_ERROR list_saves(PCORPUS corpus, const PPARTITION_INFO partition_info, unsigned int image);
+static void drop_saves(PCORPUS corpus, unsigned int image);
+static unsigned int find_image(PCORPUS corpus, const char* path);
+static SLINGA_ERROR add_image(PCORPUS corpus, const char* path, unsigned int* image);
+static SLINGA_ERROR build_lookup(PCORPUS corpus, unsigned int min_images);
+static SLINGA_ERROR build_orders(PCORPUS corpus);
+static SLINGA_ERROR grow(void** array, unsigned int* capacity, unsigned int needed, size_t element_size);
+static unsigned int hash_path(const char* path);
+static long long get_mtime(const struct stat* st);
+static void find_prefix(const PCORPUS corpus, CORPUS_ORDER order, size_t field, const char* prefix, unsigned int* first, unsigned int* last);
+static void find_range(const PCORPUS corpus, CORPUS_ORDER order, size_t field, unsigned int min, unsigned int max, unsigned int* first, unsigned int* last);
+static int matches_query(const CORPUS_SAVE* save, const PCORPUS_QUERY query);
+static int compare_name(const void* a, const void* b);
+static int compare_comment(const void* a, const void* b);
+static int compare_size(const void* a, const void* b);
+static int compare_timestamp(const void* a, const void* b);
+
+/**
+ * @brief Load an index, or start an empty one if the file doesn't exist yet
+ *
+ * @param[out] corpus Index on success, release with Corpus_Close()
+ * @param[in] path Index file
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Corpus_Open(PCORPUS corpus, const char* path)
+{
+    CORPUS_HEADER header = {0};
+    struct stat st;
+    unsigned long long expected_size = 0;
+    FILE* fp = NULL;
+    int ok = 1;
+
+    if(!corpus || !path || strlen(path) >= sizeof(corpus->path))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(corpus, 0, sizeof(CORPUS));
+    strcpy(corpus->path, path);
+
+    fp = fopen(path, "rb");
+    if(!fp)
+    {
+        // a new index is empty, and trivially sorted
+        corpus->is_sorted = 1;
+        return (errno == ENOENT) ? SLINGA_SUCCESS : SLINGA_NOT_FOUND;
+    }
+
+    if(fstat(fileno(fp), &st) != 0 || fread(&header, sizeof(header), 1, fp) != 1)
+    {
+        fclose(fp);
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    expected_size = sizeof(header) +
+                    ((unsigned long long)header.num_images * sizeof(CORPUS_IMAGE)) +
+                    ((unsigned long long)header.num_saves * (sizeof(CORPUS_SAVE) + (CORPUS_ORDER_MAX * sizeof(unsigned int)))) +
+                    header.strings_size;
+
+    if(memcmp(header.magic, CORPUS_MAGIC, sizeof(header.magic)) != 0 || header.version != CORPUS_VERSION ||
+       expected_size != (unsigned long long)st.st_size)
+    {
+        fclose(fp);
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    corpus->num_images = corpus->images_capacity = header.num_images;
+    corpus->num_saves = corpus->saves_capacity = header.num_saves;
+    corpus->strings_size = corpus->strings_capacity = header.strings_size;
+
+    // malloc(0) may return NULL, so allocate at least one element
+    corpus->images = malloc((header.num_images + 1) * sizeof(CORPUS_IMAGE));
+    corpus->saves = malloc((header.num_saves + 1) * sizeof(CORPUS_SAVE));
+    corpus->strings = malloc(header.strings_size + 1);
+    ok = corpus->images && corpus->saves && corpus->strings;
+
+    ok = ok && fread(corpus->images, sizeof(CORPUS_IMAGE), header.num_images, fp) == header.num_images;
+    ok = ok && fread(corpus->saves, sizeof(CORPUS_SAVE), header.num_saves, fp) == header.num_saves;
+
+    for(unsigned int i = 0; i < CORPUS_ORDER_MAX; i++)
+    {
+        corpus->order[i] = malloc((header.num_saves + 1) * sizeof(unsigned int));
+        ok = ok && corpus->order[i] && fread(corpus->order[i], sizeof(unsigned int), header.num_saves, fp) == header.num_saves;
+    }
+
+    ok = ok && fread(corpus->strings, 1, header.strings_size, fp) == header.strings_size;
+
+    fclose(fp);
+
+    // a damaged file must not send a query out of bounds
+    ok = ok && (header.strings_size == 0 || corpus->strings[header.strings_size - 1] == '\0');
+
+    for(unsigned int i = 0; ok && i < header.num_images; i++)
+    {
+        const CORPUS_IMAGE* image = &corpus->images[i];
+
+        ok = image->path < header.strings_size && !image->is_removed &&
+             image->first_save <= header.num_saves && image->num_saves <= header.num_saves - image->first_save;
+    }
+
+    for(unsigned int i = 0; ok && i < header.num_saves; i++)
+    {
+        ok = corpus->saves[i].image < header.num_images;
+
+        for(unsigned int j = 0; ok && j < CORPUS_ORDER_MAX; j++)
+        {
+            ok = corpus->order[j][i] < header.num_saves;
+        }
+    }
+
+    if(!ok)
+    {
+        Corpus_Close(corpus);
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    corpus->is_sorted = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Write the index back if it changed. The old file is replaced atomically
+ *
+ * @param[in] corpus Index
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Corpus_Save(PCORPUS corpus)
+{
+    char temp_path[CORPUS_MAX_PATH + 8] = {0};
+    CORPUS_HEADER header = {0};
+    FILE* fp = NULL;
+    int ok = 1;
+    SLINGA_ERROR result = 0;
+
+    if(!corpus)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(!corpus->is_dirty)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    result = build_orders(corpus);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    memcpy(header.magic, CORPUS_MAGIC, sizeof(header.magic));
+    header.version = CORPUS_VERSION;
+    header.num_images = corpus->num_images;
+    header.num_saves = corpus->num_saves;
+    header.strings_size = corpus->strings_size;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", corpus->path);
+
+    fp = fopen(temp_path, "wb");
+    if(!fp)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(corpus->images, sizeof(CORPUS_IMAGE), corpus->num_images, fp) == corpus->num_images;
+    ok = ok && fwrite(corpus->saves, sizeof(CORPUS_SAVE), corpus->num_saves, fp) == corpus->num_saves;
+
+    for(unsigned int i = 0; i < CORPUS_ORDER_MAX; i++)
+    {
+        ok = ok && fwrite(corpus->order[i], sizeof(unsigned int), corpus->num_saves, fp) == corpus->num_saves;
+    }
+
+    ok = ok && fwrite(corpus->strings, 1, corpus->strings_size, fp) == corpus->strings_size;
+
+    if(fclose(fp) != 0 || !ok || rename(temp_path, corpus->path) != 0)
+    {
+        remove(temp_path);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    corpus->is_dirty = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Release an index without saving it
+ *
+ * @param[in] corpus Index
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Corpus_Close(PCORPUS corpus)
+{
+    if(!corpus)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    free(corpus->images);
+    free(corpus->saves);
+    free(corpus->strings);
+    free(corpus->lookup);
+
+    for(unsigned int i = 0; i < CORPUS_ORDER_MAX; i++)
+    {
+        free(corpus->order[i]);
+    }
+
+    memset(corpus, 0, sizeof(CORPUS));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Add images to the index, or index them again if they changed
+ *
+ * @param[in] corpus Index
+ * @param[in] image_paths Images to index
+ * @param[in] num_images Number of images
+ * @param[in,out] stats Counters to add to
+ *
+ * @return SLINGA_SUCCESS if the index could be updated, check stats for images that failed
+ */
+SLINGA_ERROR Corpus_Update(PCORPUS corpus, char** image_paths, unsigned int num_images, PCORPUS_STATS stats)
+{
+    char full_path[PATH_MAX] = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!corpus || (!image_paths && num_images) || !stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = build_lookup(corpus, corpus->num_images + num_images);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < num_images; i++)
+    {
+        stats->checked++;
+
+        // the same image reached by two relative paths is one image
+        if(!realpath(image_paths[i], full_path) || strlen(full_path) >= CORPUS_MAX_PATH)
+        {
+            stats->failed++;
+            continue;
+        }
+
+        result = index_image(corpus, full_path, stats);
+        if(result == SLINGA_BUFFER_TOO_SMALL)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Check every indexed image again, dropping the ones that are gone
+ *
+ * @param[in] corpus Index
+ * @param[in,out] stats Counters to add to
+ *
+ * @return SLINGA_SUCCESS if the index could be updated, check stats for images that failed
+ */
+SLINGA_ERROR Corpus_Refresh(PCORPUS corpus, PCORPUS_STATS stats)
+{
+    char path[CORPUS_MAX_PATH] = {0};
+    struct stat st;
+    unsigned int num_images = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!corpus || !stats)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = build_lookup(corpus, corpus->num_images);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    num_images = corpus->num_images;
+
+    for(unsigned int i = 0; i < num_images; i++)
+    {
+        if(corpus->images[i].is_removed)
+        {
+            continue;
+        }
+
+        stats->checked++;
+
+        // copied, the strings may move while indexing
+        strcpy(path, corpus->strings + corpus->images[i].path);
+
+        if(stat(path, &st) != 0 && errno == ENOENT)
+        {
+            drop_saves(corpus, i);
+            corpus->images[i].is_removed = 1;
+            corpus->is_sorted = 0;
+            corpus->is_dirty = 1;
+            stats->removed++;
+            continue;
+        }
+
+        result = index_image(corpus, path, stats);
+        if(result == SLINGA_BUFFER_TOO_SMALL)
+        {
+            return result;
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Set a query to match every save
+ *
+ * @param[out] query Query to reset
+ */
+void Corpus_InitQuery(PCORPUS_QUERY query)
+{
+    memset(query, 0, sizeof(CORPUS_QUERY));
+    query->max_size = UINT_MAX;
+    query->max_timestamp = UINT_MAX;
+}
+
+/**
+ * @brief Find every save matching a query
+ *
+ * @param[in] corpus Index
+ * @param[in] query Search terms, start from Corpus_InitQuery()
+ * @param[out] matches Optional, save rows that matched
+ * @param[in] num_matches Number of entries in matches
+ * @param[out] matches_found Saves that matched, may be more than num_matches
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_BUFFER_TOO_SMALL if matches is too small
+ */
+SLINGA_ERROR Corpus_Find(PCORPUS corpus, const PCORPUS_QUERY query, unsigned int* matches, unsigned int num_matches, unsigned int* matches_found)
+{
+    CORPUS_ORDER best_order = CORPUS_ORDER_NAME;
+    unsigned int best_first = 0;
+    unsigned int best_last = 0;
+    unsigned int found = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!corpus || !query || !matches_found)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = build_orders(corpus);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    best_last = corpus->num_saves;
+
+    // every term narrows one ordering to a run, walk the shortest run and check the other terms
+    for(unsigned int i = 0; i < CORPUS_ORDER_MAX; i++)
+    {
+        unsigned int first = 0;
+        unsigned int last = corpus->num_saves;
+
+        switch(i)
+        {
+            case CORPUS_ORDER_NAME:
+                if(query->name)
+                {
+                    find_prefix(corpus, i, offsetof(CORPUS_SAVE, savename), query->name, &first, &last);
+                }
+                break;
+            case CORPUS_ORDER_COMMENT:
+                if(query->comment)
+                {
+                    find_prefix(corpus, i, offsetof(CORPUS_SAVE, comment), query->comment, &first, &last);
+                }
+                break;
+            case CORPUS_ORDER_SIZE:
+                find_range(corpus, i, offsetof(CORPUS_SAVE, data_size), query->min_size, query->max_size, &first, &last);
+                break;
+            case CORPUS_ORDER_TIMESTAMP:
+                find_range(corpus, i, offsetof(CORPUS_SAVE, timestamp), query->min_timestamp, query->max_timestamp, &first, &last);
+                break;
+        }
+
+        if(last - first < best_last - best_first)
+        {
+            best_order = i;
+            best_first = first;
+            best_last = last;
+        }
+    }
+
+    for(unsigned int i = best_first; i < best_last; i++)
+    {
+        unsigned int row = corpus->order[best_order][i];
+
+        if(!matches_query(&corpus->saves[row], query))
+        {
+            continue;
+        }
+
+        if(matches && found < num_matches)
+        {
+            matches[found] = row;
+        }
+
+        found++;
+    }
+
+    *matches_found = found;
+
+    return (matches && found > num_matches) ? SLINGA_BUFFER_TOO_SMALL : SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Path of an indexed image
+ *
+ * @param[in] corpus Index
+ * @param[in] image Row in the image table, see CORPUS_SAVE
+ *
+ * @return Path, NULL if image is out of range
+ */
+const char* Corpus_GetImagePath(const PCORPUS corpus, unsigned int image)
+{
+    if(!corpus || image >= corpus->num_images)
+    {
+        return NULL;
+    }
+
+    return corpus->strings + corpus->images[image].path;
+}
+
+//
+// helper functions
+//
+
+// returns SLINGA_BUFFER_TOO_SMALL only if out of memory, the other failures just count
+static SLINGA_ERROR index_image(PCORPUS corpus, const char* path, PCORPUS_STATS stats)
+{
+    unsigned char fingerprint[SHA256_SIZE] = {0};
+    IMAGE image = {0};
+    struct stat st;
+    unsigned int row = find_image(corpus, path);
+    unsigned int first_save = corpus->num_saves;
+    int is_new = (row == CORPUS_NO_IMAGE);
+    SLINGA_ERROR result = 0;
+
+    if(stat(path, &st) != 0)
+    {
+        stats->failed++;
+        return SLINGA_NOT_FOUND;
+    }
+
+    // the common case, nothing read at all
+    if(row != CORPUS_NO_IMAGE && !corpus->images[row].is_removed &&
+       corpus->images[row].size == (unsigned long long)st.st_size && corpus->images[row].mtime == get_mtime(&st))
+    {
+        stats->unchanged++;
+        return SLINGA_SUCCESS;
+    }
+
+    result = Image_Open(&image, path, IMAGE_LAYOUT_UNKNOWN);
+    if(result != SLINGA_SUCCESS)
+    {
+        stats->failed++;
+        return result;
+    }
+
+    SHA256_Hash(image.buffer, image.size, fingerprint);
+
+    // copied or touched, but the same bytes
+    if(row != CORPUS_NO_IMAGE && !corpus->images[row].is_removed &&
+       memcmp(corpus->images[row].fingerprint, fingerprint, SHA256_SIZE) == 0)
+    {
+        corpus->images[row].size = st.st_size;
+        corpus->images[row].mtime = get_mtime(&st);
+        corpus->is_dirty = 1;
+        stats->touched++;
+        Image_Close(&image);
+        return SLINGA_SUCCESS;
+    }
+
+    if(is_new)
+    {
+        result = add_image(corpus, path, &row);
+        if(result != SLINGA_SUCCESS)
+        {
+            Image_Close(&image);
+            stats->failed++;
+            return result;
+        }
+    }
+
+    // the new rows go after every existing row so the old ones can be dropped as a block
+    result = list_saves(corpus, &image.partition_info, row);
+
+    Image_Close(&image);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        corpus->num_saves = first_save;
+        stats->failed++;
+
+        // a new image that couldn't be parsed stays out of the index
+        if(is_new)
+        {
+            corpus->images[row].is_removed = 1;
+            corpus->is_sorted = 0;
+        }
+
+        return result;
+    }
+
+    drop_saves(corpus, row);
+
+    corpus->images[row].first_save = first_save;
+    corpus->images[row].num_saves = corpus->num_saves - first_save;
+    corpus->images[row].is_removed = 0;
+    corpus->images[row].size = st.st_size;
+    corpus->images[row].mtime = get_mtime(&st);
+    memcpy(corpus->images[row].fingerprint, fingerprint, SHA256_SIZE);
+
+    corpus->is_sorted = 0;
+    corpus->is_dirty = 1;
+    stats->indexed++;
+
+    return SLINGA_SUCCESS;
+}
+
+// appends a row per save, one page of one save at a time so every save's cursor is known
+static SLINGA_ERROR list_saves(PCORPUS corpus, const PPARTITION_INFO partition_info, unsigned int image)
+{
+    unsigned int cursor = SLINGA_LIST_START;
+    SLINGA_ERROR result = 0;
+
+    result = sat_check_formatted(partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    while(cursor != SLINGA_LIST_END)
+    {
+        SAVE_METADATA metadata = {0};
+        PCORPUS_SAVE save = NULL;
+        unsigned int saves_found = 0;
+        unsigned int next_cursor = 0;
+
+        result = sat_list_page(partition_info, cursor, &metadata, 1, &saves_found, &next_cursor);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        if(saves_found == 0)
+        {
+            break;
+        }
+
+        result = grow((void**)&corpus->saves, &corpus->saves_capacity, corpus->num_saves + 1, sizeof(CORPUS_SAVE));
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+
+        save = &corpus->saves[corpus->num_saves++];
+        memset(save, 0, sizeof(CORPUS_SAVE));
+
+        save->image = image;
+        save->cursor = cursor;
+        memcpy(save->savename, metadata.savename, MAX_SAVENAME);
+        memcpy(save->comment, metadata.comment, MAX_COMMENT);
+        save->timestamp = metadata.timestamp;
+        save->data_size = metadata.data_size;
+        save->language = metadata.language;
+
+        cursor = next_cursor;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static void drop_saves(PCORPUS corpus, unsigned int image)
+{
+    const CORPUS_IMAGE* entry = &corpus->images[image];
+
+    for(unsigned int i = 0; i < entry->num_saves; i++)
+    {
+        corpus->saves[entry->first_save + i].image = CORPUS_NO_IMAGE;
+    }
+}
+
+// row of path, CORPUS_NO_IMAGE if it isn't indexed. Needs build_lookup()
+static unsigned int find_image(PCORPUS corpus, const char* path)
+{
+    unsigned int mask = corpus->lookup_size - 1;
+
+    for(unsigned int slot = hash_path(path) & mask; corpus->lookup[slot] != CORPUS_NO_IMAGE; slot = (slot + 1) & mask)
+    {
+        unsigned int row = corpus->lookup[slot];
+
+        if(strcmp(corpus->strings + corpus->images[row].path, path) == 0)
+        {
+            return row;
+        }
+    }
+
+    return CORPUS_NO_IMAGE;
+}
+
+static SLINGA_ERROR add_image(PCORPUS corpus, const char* path, unsigned int* image)
+{
+    unsigned int length = strlen(path) + 1;
+    unsigned int mask = 0;
+    unsigned int slot = 0;
+    PCORPUS_IMAGE entry = NULL;
+    SLINGA_ERROR result = 0;
+
+    result = build_lookup(corpus, corpus->num_images + 1);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = grow((void**)&corpus->images, &corpus->images_capacity, corpus->num_images + 1, sizeof(CORPUS_IMAGE));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = grow((void**)&corpus->strings, &corpus->strings_capacity, corpus->strings_size + length, 1);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    entry = &corpus->images[corpus->num_images];
+    memset(entry, 0, sizeof(CORPUS_IMAGE));
+
+    entry->path = corpus->strings_size;
+    entry->first_save = corpus->num_saves;
+    memcpy(corpus->strings + corpus->strings_size, path, length);
+    corpus->strings_size += length;
+
+    mask = corpus->lookup_size - 1;
+    for(slot = hash_path(path) & mask; corpus->lookup[slot] != CORPUS_NO_IMAGE; slot = (slot + 1) & mask)
+    {
+    }
+
+    corpus->lookup[slot] = corpus->num_images;
+    *image = corpus->num_images++;
+
+    return SLINGA_SUCCESS;
+}
+
+// (re)builds the path table so it stays at most half full with min_images
+static SLINGA_ERROR build_lookup(PCORPUS corpus, unsigned int min_images)
+{
+    unsigned int size = 64;
+    unsigned int* lookup = NULL;
+
+    if(corpus->lookup && min_images * 2 <= corpus->lookup_size)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    while(size < min_images * 2)
+    {
+        size *= 2;
+    }
+
+    lookup = malloc(size * sizeof(unsigned int));
+    if(!lookup)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memset(lookup, 0xFF, size * sizeof(unsigned int));
+
+    for(unsigned int i = 0; i < corpus->num_images; i++)
+    {
+        unsigned int slot = hash_path(corpus->strings + corpus->images[i].path) & (size - 1);
+
+        while(lookup[slot] != CORPUS_NO_IMAGE)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+
+        lookup[slot] = i;
+    }
+
+    free(corpus->lookup);
+    corpus->lookup = lookup;
+    corpus->lookup_size = size;
+
+    return SLINGA_SUCCESS;
+}
+
+// drops removed rows and sorts every ordering again
+static SLINGA_ERROR build_orders(PCORPUS corpus)
+{
+    static int (* const compare[CORPUS_ORDER_MAX])(const void*, const void*) =
+    {
+        compare_name, compare_comment, compare_size, compare_timestamp,
+    };
+    unsigned int* remap = NULL;
+    char* strings = NULL;
+    unsigned int num_images = 0;
+    unsigned int num_saves = 0;
+    unsigned int strings_size = 0;
+
+    if(corpus->is_sorted)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    remap = malloc((corpus->num_images + 1) * sizeof(unsigned int));
+    strings = malloc(corpus->strings_size + 1);
+    if(!remap || !strings)
+    {
+        free(remap);
+        free(strings);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    // compact the images and their paths
+    for(unsigned int i = 0; i < corpus->num_images; i++)
+    {
+        CORPUS_IMAGE entry = corpus->images[i];
+        unsigned int length = 0;
+
+        if(entry.is_removed)
+        {
+            remap[i] = CORPUS_NO_IMAGE;
+            continue;
+        }
+
+        length = strlen(corpus->strings + entry.path) + 1;
+        memcpy(strings + strings_size, corpus->strings + entry.path, length);
+
+        entry.path = strings_size;
+        entry.first_save = CORPUS_NO_IMAGE;
+        entry.num_saves = 0;
+        strings_size += length;
+
+        remap[i] = num_images;
+        corpus->images[num_images++] = entry;
+    }
+
+    // compact the saves, each image's rows stay together
+    for(unsigned int i = 0; i < corpus->num_saves; i++)
+    {
+        CORPUS_SAVE save = corpus->saves[i];
+        PCORPUS_IMAGE entry = NULL;
+
+        if(save.image == CORPUS_NO_IMAGE || remap[save.image] == CORPUS_NO_IMAGE)
+        {
+            continue;
+        }
+
+        save.image = remap[save.image];
+        entry = &corpus->images[save.image];
+
+        if(entry->first_save == CORPUS_NO_IMAGE)
+        {
+            entry->first_save = num_saves;
+        }
+
+        entry->num_saves++;
+        corpus->saves[num_saves++] = save;
+    }
+
+    for(unsigned int i = 0; i < num_images; i++)
+    {
+        if(corpus->images[i].first_save == CORPUS_NO_IMAGE)
+        {
+            corpus->images[i].first_save = num_saves;
+        }
+    }
+
+    free(remap);
+    free(corpus->strings);
+
+    corpus->strings = strings;
+    corpus->strings_size = strings_size;
+    corpus->strings_capacity = corpus->strings_size + 1;
+    corpus->num_images = num_images;
+    corpus->num_saves = num_saves;
+
+    // rows moved, the path table is rebuilt on the next update
+    free(corpus->lookup);
+    corpus->lookup = NULL;
+    corpus->lookup_size = 0;
+
+    g_Sort_Saves = corpus->saves;
+
+    for(unsigned int i = 0; i < CORPUS_ORDER_MAX; i++)
+    {
+        unsigned int* order = realloc(corpus->order[i], (num_saves + 1) * sizeof(unsigned int));
+
+        if(!order)
+        {
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        corpus->order[i] = order;
+
+        for(unsigned int j = 0; j < num_saves; j++)
+        {
+            order[j] = j;
+        }
+
+        qsort(order, num_saves, sizeof(unsigned int), compare[i]);
+    }
+
+    g_Sort_Saves = NULL;
+    corpus->is_sorted = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+// doubles the array until it holds needed elements
+static SLINGA_ERROR grow(void** array, unsigned int* capacity, unsigned int needed, size_t element_size)
+{
+    unsigned int new_capacity = *capacity ? *capacity : 64;
+    void* bigger = NULL;
+
+    if(needed <= *capacity && *array)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    while(new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+
+    bigger = realloc(*array, new_capacity * element_size);
+    if(!bigger)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    *array = bigger;
+    *capacity = new_capacity;
+
+    return SLINGA_SUCCESS;
+}
+
+// FNV-1a
+static unsigned int hash_path(const char* path)
+{
+    unsigned int hash = 0x811C9DC5;
+
+    for(; *path; path++)
+    {
+        hash = (hash ^ (unsigned char)*path) * 0x01000193;
+    }
+
+    return hash;
+}
+
+static long long get_mtime(const struct stat* st)
+{
+    return ((long long)st->st_mtim.tv_sec * 1000000000LL) + st->st_mtim.tv_nsec;
+}
+
+// [first, last) of the rows whose field starts with prefix
+static void find_prefix(const PCORPUS corpus, CORPUS_ORDER order, size_t field, const char* prefix, unsigned int* first, unsigned int* last)
+{
+    const unsigned int* rows = corpus->order[order];
+    size_t length = strlen(prefix);
+    unsigned int low = 0;
+    unsigned int high = corpus->num_saves;
+
+    while(low < high)
+    {
+        unsigned int middle = low + ((high - low) / 2);
+
+        if(strncmp((const char*)&corpus->saves[rows[middle]] + field, prefix, length) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *first = low;
+    high = corpus->num_saves;
+
+    while(low < high)
+    {
+        unsigned int middle = low + ((high - low) / 2);
+
+        if(strncmp((const char*)&corpus->saves[rows[middle]] + field, prefix, length) <= 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *last = low;
+}
+
+// [first, last) of the rows whose field is in [min, max]
+static void find_range(const PCORPUS corpus, CORPUS_ORDER order, size_t field, unsigned int min, unsigned int max, unsigned int* first, unsigned int* last)
+{
+    const unsigned int* rows = corpus->order[order];
+    unsigned int low = 0;
+    unsigned int high = corpus->num_saves;
+    unsigned int value = 0;
+
+    while(low < high)
+    {
+        unsigned int middle = low + ((high - low) / 2);
+
+        memcpy(&value, (const char*)&corpus->saves[rows[middle]] + field, sizeof(value));
+
+        if(value < min)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *first = low;
+    high = corpus->num_saves;
+
+    while(low < high)
+    {
+        unsigned int middle = low + ((high - low) / 2);
+
+        memcpy(&value, (const char*)&corpus->saves[rows[middle]] + field, sizeof(value));
+
+        if(value <= max)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *last = (low > *first) ? low : *first;
+}
+
+static int matches_query(const CORPUS_SAVE* save, const PCORPUS_QUERY query)
+{
+    if(query->name && strncmp(save->savename, query->name, strlen(query->name)) != 0)
+    {
+        return 0;
+    }
+
+    if(query->comment && strncmp(save->comment, query->comment, strlen(query->comment)) != 0)
+    {
+        return 0;
+    }
+
+    return save->data_size >= query->min_size && save->data_size <= query->max_size &&
+           save->timestamp >= query->min_timestamp && save->timestamp <= query->max_timestamp;
+}
+
+// ties are broken on the row so the orderings don't depend on qsort()
+static int compare_name(const void* a, const void* b)
+{
+    unsigned int row_a = *(const unsigned int*)a;
+    unsigned int row_b = *(const unsigned int*)b;
+    int result = strcmp(g_Sort_Saves[row_a].savename, g_Sort_Saves[row_b].savename);
+
+    return result ? result : (row_a > row_b) - (row_a < row_b);
+}
+
+static int compare_comment(const void* a, const void* b)
+{
+    unsigned int row_a = *(const unsigned int*)a;
+    unsigned int row_b = *(const unsigned int*)b;
+    int result = strcmp(g_Sort_Saves[row_a].comment, g_Sort_Saves[row_b].comment);
+
+    return result ? result : (row_a > row_b) - (row_a < row_b);
+}
+
+static int compare_size(const void* a, const void* b)
+{
+    unsigned int row_a = *(const unsigned int*)a;
+    unsigned int row_b = *(const unsigned int*)b;
+    unsigned int size_a = g_Sort_Saves[row_a].data_size;
+    unsigned int size_b = g_Sort_Saves[row_b].data_size;
+
+    if(size_a != size_b)
+    {
+        return (size_a > size_b) ? 1 : -1;
+    }
+
+    return (row_a > row_b) - (row_a < row_b);
+}
+
+static int compare_timestamp(const void* a, const void* b)
+{
+    unsigned int row_a = *(const unsigned int*)a;
+    unsigned int row_b = *(const unsigned int*)b;
+    unsigned int timestamp_a = g_Sort_Saves[row_a].timestamp;
+    unsigned int timestamp_b = g_Sort_Saves[row_b].timestamp;
+
+    if(timestamp_a != timestamp_b)
+    {
+        return (timestamp_a > timestamp_b) ? 1 : -1;
+    }
+
+    return (row_a > row_b) - (row_a < row_b);
+}
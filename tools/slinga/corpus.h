@@ -0,0 +1,124 @@
+/** @file corpus.h
+ *
+ *  @author Slinga
+ *  @brief Persistent search index over the saves of many images
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "image.h"
+#include "sha256.h"
+
+//
+// The index file holds a row for every save of every indexed image plus
+// four orderings of those rows: by name, by comment, by size and by
+// timestamp. A prefix or range query binary searches one ordering and
+// walks the matching run, so it never touches the images themselves.
+//
+// Each image row keeps the file's size and mtime and a SHA-256 of its
+// contents. Updating stats every image and only reads the ones whose size
+// or mtime moved; only the ones whose contents actually changed are parsed
+// again. The file is written in host byte order and replaced atomically.
+//
+
+#define CORPUS_MAX_PATH     256         ///< @brief Longest image path, same as IMAGE
+#define CORPUS_MAGIC        "SLIX"
+#define CORPUS_VERSION      (1)
+#define CORPUS_NO_IMAGE     0xFFFFFFFF  ///< @brief Image of a save row that was dropped
+
+/** @brief Index file header, followed by the images, saves, the four orderings and the path strings */
+typedef struct _CORPUS_HEADER
+{
+    char magic[4];                  ///< @brief CORPUS_MAGIC
+    unsigned int version;           ///< @brief CORPUS_VERSION
+    unsigned int num_images;        ///< @brief Rows in the image table
+    unsigned int num_saves;         ///< @brief Rows in the save table and in each ordering
+    unsigned int strings_size;      ///< @brief Bytes of NULL terminated paths
+} CORPUS_HEADER, *PCORPUS_HEADER;
+
+/** @brief One indexed image */
+typedef struct _CORPUS_IMAGE
+{
+    unsigned int path;                          ///< @brief Offset of the path in the strings
+    unsigned int first_save;                    ///< @brief First row of the image's saves, they are contiguous
+    unsigned int num_saves;                     ///< @brief Saves indexed for the image
+    unsigned int is_removed;                    ///< @brief Dropped, only set in memory until saved
+    unsigned long long size;                    ///< @brief File size when indexed
+    long long mtime;                            ///< @brief File mtime in nanoseconds when indexed
+    unsigned char fingerprint[SHA256_SIZE];     ///< @brief SHA-256 of the file when indexed
+} CORPUS_IMAGE, *PCORPUS_IMAGE;
+
+/** @brief One indexed save */
+typedef struct _CORPUS_SAVE
+{
+    unsigned int image;                     ///< @brief Row in the image table
+    unsigned int cursor;                    ///< @brief sat_list_page() cursor that lists the save first
+    char savename[MAX_SAVENAME + 1];        ///< @brief Save name
+    char comment[MAX_COMMENT + 1];          ///< @brief Save comment
+    unsigned int timestamp;                 ///< @brief Save timestamp
+    unsigned int data_size;                 ///< @brief Save size in bytes
+    unsigned char language;                 ///< @brief Save language
+} CORPUS_SAVE, *PCORPUS_SAVE;
+
+/** @brief Orderings of the save table */
+typedef enum
+{
+    CORPUS_ORDER_NAME = 0,
+    CORPUS_ORDER_COMMENT = 1,
+    CORPUS_ORDER_SIZE = 2,
+    CORPUS_ORDER_TIMESTAMP = 3,
+    CORPUS_ORDER_MAX,
+} CORPUS_ORDER;
+
+/** @brief Index loaded in memory */
+typedef struct _CORPUS
+{
+    char path[CORPUS_MAX_PATH];             ///< @brief Index file
+    PCORPUS_IMAGE images;                   ///< @brief Image table
+    unsigned int num_images;                ///< @brief Rows in images
+    unsigned int images_capacity;           ///< @brief Rows allocated for images
+    PCORPUS_SAVE saves;                     ///< @brief Save table, may hold dropped rows until saved
+    unsigned int num_saves;                 ///< @brief Rows in saves
+    unsigned int saves_capacity;            ///< @brief Rows allocated for saves
+    unsigned int* order[CORPUS_ORDER_MAX];  ///< @brief Save rows in each order, valid if is_sorted
+    char* strings;                          ///< @brief Image paths
+    unsigned int strings_size;              ///< @brief Bytes used in strings
+    unsigned int strings_capacity;          ///< @brief Bytes allocated for strings
+    unsigned int* lookup;                   ///< @brief Open addressed path hash table of image rows, built on demand
+    unsigned int lookup_size;               ///< @brief Slots in lookup, a power of 2
+    unsigned char is_sorted;                ///< @brief Dropped rows are gone and the orders are current
+    unsigned char is_dirty;                 ///< @brief Tables changed since the file was read
+} CORPUS, *PCORPUS;
+
+/** @brief Search terms, every term that is set must match */
+typedef struct _CORPUS_QUERY
+{
+    const char* name;               ///< @brief Save name prefix, NULL for any
+    const char* comment;            ///< @brief Comment prefix, NULL for any
+    unsigned int min_size;          ///< @brief Smallest save size
+    unsigned int max_size;          ///< @brief Largest save size
+    unsigned int min_timestamp;     ///< @brief Oldest timestamp
+    unsigned int max_timestamp;     ///< @brief Newest timestamp
+} CORPUS_QUERY, *PCORPUS_QUERY;
+
+/** @brief Update counters */
+typedef struct _CORPUS_STATS
+{
+    unsigned int checked;           ///< @brief Images looked at
+    unsigned int unchanged;         ///< @brief Images skipped on size and mtime alone
+    unsigned int touched;           ///< @brief Images read whose contents hadn't changed
+    unsigned int indexed;           ///< @brief Images parsed
+    unsigned int removed;           ///< @brief Images dropped because they are gone
+    unsigned int failed;            ///< @brief Images that couldn't be read or parsed
+} CORPUS_STATS, *PCORPUS_STATS;
+
+SLINGA_ERROR Corpus_Open(PCORPUS corpus, const char* path);
+SLINGA_ERROR Corpus_Save(PCORPUS corpus);
+SLINGA_ERROR Corpus_Close(PCORPUS corpus);
+
+SLINGA_ERROR Corpus_Update(PCORPUS corpus, char** image_paths, unsigned int num_images, PCORPUS_STATS stats);
+SLINGA_ERROR Corpus_Refresh(PCORPUS corpus, PCORPUS_STATS stats);
+
+void Corpus_InitQuery(PCORPUS_QUERY query);
+SLINGA_ERROR Corpus_Find(PCORPUS corpus, const PCORPUS_QUERY query, unsigned int* matches, unsigned int num_matches, unsigned int* matches_found);
+const char* Corpus_GetImagePath(const PCORPUS corpus, unsigned int image);
@@ -0,0 +1,425 @@
+/** @file image.c
+ *
+ *  @author Slinga
+ *  @brief Backup memory images on the host
+ *  @bug No known bugs.
+ */
+#include "image.h"
+#include "../../devices/saturn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Partition geometry of one device type, packed */
+typedef struct _IMAGE_GEOMETRY
+{
+    const char* name;           // name on the command line
+    unsigned int size;          // valid bytes in the partition
+    unsigned int block_size;    // valid bytes per block
+} IMAGE_GEOMETRY;
+
+/** @brief Geometry of each IMAGE_TYPE, same as get_partition_info() in devices/saturn.c */
+static const IMAGE_GEOMETRY g_Image_Geometry[IMAGE_TYPE_MAX] =
+{
+    {"internal", INTERNAL_MEMORY_SIZE / 2, INTERNAL_MEMORY_BLOCK_SIZE / 2},
+    {"512k", CARTRIDGE_NUM_BLOCKS_0x400 * (CARTRIDGE_BLOCK_SIZE_0x200 / 2), CARTRIDGE_BLOCK_SIZE_0x200 / 2},
+    {"1mb", CARTRIDGE_NUM_BLOCKS_0x800 * (CARTRIDGE_BLOCK_SIZE_0x200 / 2), CARTRIDGE_BLOCK_SIZE_0x200 / 2},
+    {"2mb", CARTRIDGE_NUM_BLOCKS_0x1000 * (CARTRIDGE_BLOCK_SIZE_0x200 / 2), CARTRIDGE_BLOCK_SIZE_0x200 / 2},
+    {"4mb", CARTRIDGE_NUM_BLOCKS_0x1000 * (CARTRIDGE_BLOCK_SIZE_0x400 / 2), CARTRIDGE_BLOCK_SIZE_0x400 / 2},
+};
+
+static IMAGE_LAYOUT detect_layout(const unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR set_partition_info(PIMAGE image);
+static SLINGA_ERROR write_file(const char* path, const unsigned char* buffer, unsigned int size);
+
+/**
+ * @brief Read an image into memory
+ *
+ * @param[out] image Loaded image on success. Release with Image_Close()
+ * @param[in] path Image file
+ * @param[in] layout Layout of the file, IMAGE_LAYOUT_UNKNOWN to detect it
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if the file can't be read
+ */
+SLINGA_ERROR Image_Open(PIMAGE image, const char* path, IMAGE_LAYOUT layout)
+{
+    FILE* fp = NULL;
+    long file_size = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!image || !path || strlen(path) >= sizeof(image->path))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(image, 0, sizeof(IMAGE));
+    strcpy(image->path, path);
+
+    fp = fopen(path, "rb");
+    if(!fp)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    if(fseek(fp, 0, SEEK_END) != 0 || (file_size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    image->size = (unsigned int)file_size;
+    image->buffer = malloc(image->size);
+    if(!image->buffer)
+    {
+        fclose(fp);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    if(fread(image->buffer, 1, image->size, fp) != image->size)
+    {
+        fclose(fp);
+        Image_Close(image);
+        return SLINGA_NOT_FOUND;
+    }
+
+    fclose(fp);
+
+    image->layout = layout;
+    if(image->layout == IMAGE_LAYOUT_UNKNOWN)
+    {
+        image->layout = detect_layout(image->buffer, image->size);
+    }
+
+    result = set_partition_info(image);
+    if(result != SLINGA_SUCCESS)
+    {
+        Image_Close(image);
+        return result;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Create a freshly formatted image in memory. Nothing is written until Image_Save()
+ *
+ * @param[out] image New image on success. Release with Image_Close()
+ * @param[in] path File Image_Save() writes to
+ * @param[in] type Device the image is for
+ * @param[in] layout Layout to save with, IMAGE_LAYOUT_UNKNOWN for packed
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Image_Create(PIMAGE image, const char* path, IMAGE_TYPE type, IMAGE_LAYOUT layout)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!image || !path || strlen(path) >= sizeof(image->path) || type >= IMAGE_TYPE_MAX)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(image, 0, sizeof(IMAGE));
+    strcpy(image->path, path);
+
+    image->layout = (layout == IMAGE_LAYOUT_INTERLEAVED) ? IMAGE_LAYOUT_INTERLEAVED : IMAGE_LAYOUT_PACKED;
+    image->size = g_Image_Geometry[type].size;
+
+    if(image->layout == IMAGE_LAYOUT_INTERLEAVED)
+    {
+        image->size *= 2;
+    }
+
+    image->buffer = malloc(image->size);
+    if(!image->buffer)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memset(image->buffer, image->layout == IMAGE_LAYOUT_INTERLEAVED ? IMAGE_FILL_BYTE : 0, image->size);
+
+    result = set_partition_info(image);
+    if(result != SLINGA_SUCCESS)
+    {
+        Image_Close(image);
+        return result;
+    }
+
+    // sat_format() doesn't clear every block
+    for(unsigned int i = image->partition_info.skip_bytes; i < image->size; i += 1 + image->partition_info.skip_bytes)
+    {
+        image->buffer[i] = 0;
+    }
+
+    result = sat_format(&image->partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        Image_Close(image);
+        return result;
+    }
+
+    image->is_dirty = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Write the image back to its file if it changed
+ *
+ * The file is replaced in one step, a failed save leaves the old file alone.
+ *
+ * @param[in] image Image to save
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Image_Save(PIMAGE image)
+{
+    SLINGA_ERROR result = 0;
+
+    if(!image || !image->buffer)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(!image->is_dirty)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    result = write_file(image->path, image->buffer, image->size);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    image->is_dirty = 0;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Write the image to another file, converting the layout if needed
+ *
+ * @param[in] image Image to write
+ * @param[in] path Destination file
+ * @param[in] layout Layout of the destination, IMAGE_LAYOUT_UNKNOWN to keep the current one
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Image_SaveAs(const PIMAGE image, const char* path, IMAGE_LAYOUT layout)
+{
+    unsigned char* converted = NULL;
+    unsigned int size = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!image || !image->buffer || !path)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(layout == IMAGE_LAYOUT_UNKNOWN || layout == image->layout)
+    {
+        return write_file(path, image->buffer, image->size);
+    }
+
+    size = (layout == IMAGE_LAYOUT_INTERLEAVED) ? image->size * 2 : image->size / 2;
+
+    converted = malloc(size);
+    if(!converted)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    if(layout == IMAGE_LAYOUT_INTERLEAVED)
+    {
+        for(unsigned int i = 0; i < image->size; i++)
+        {
+            converted[i * 2] = IMAGE_FILL_BYTE;
+            converted[(i * 2) + 1] = image->buffer[i];
+        }
+    }
+    else
+    {
+        for(unsigned int i = 0; i < size; i++)
+        {
+            converted[i] = image->buffer[(i * 2) + 1];
+        }
+    }
+
+    result = write_file(path, converted, size);
+
+    free(converted);
+
+    return result;
+}
+
+/**
+ * @brief Release an image. Unsaved changes are lost
+ *
+ * @param[in] image Image from Image_Open() or Image_Create()
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Image_Close(PIMAGE image)
+{
+    if(!image)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(image->partition_info.partition_buf)
+    {
+        sat_release(&image->partition_info);
+    }
+
+    free(image->buffer);
+    image->buffer = NULL;
+    image->size = 0;
+    memset(&image->partition_info, 0, sizeof(PARTITION_INFO));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Printable name of a layout
+ *
+ * @param[in] layout Layout
+ *
+ * @return Name of the layout
+ */
+const char* Image_GetLayoutName(IMAGE_LAYOUT layout)
+{
+    switch(layout)
+    {
+        case IMAGE_LAYOUT_PACKED:
+            return "packed";
+        case IMAGE_LAYOUT_INTERLEAVED:
+            return "interleaved";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @brief Look up a device type by its command line name ("internal", "512k", "1mb", "2mb", "4mb")
+ *
+ * @param[in] name Name of the device type
+ * @param[out] type Device type on success
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND for an unknown name
+ */
+SLINGA_ERROR Image_GetTypeFromName(const char* name, IMAGE_TYPE* type)
+{
+    if(!name || !type)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    for(unsigned int i = 0; i < IMAGE_TYPE_MAX; i++)
+    {
+        if(strcmp(name, g_Image_Geometry[i].name) == 0)
+        {
+            *type = (IMAGE_TYPE)i;
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_NOT_FOUND;
+}
+
+//
+// helper functions
+//
+
+// the format string is in the first block of every formatted partition
+static IMAGE_LAYOUT detect_layout(const unsigned char* buffer, unsigned int size)
+{
+    unsigned int matches = 0;
+
+    if(size >= BACKUP_RAM_FORMAT_STR_LEN && memcmp(buffer, BACKUP_RAM_FORMAT_STR, BACKUP_RAM_FORMAT_STR_LEN) == 0)
+    {
+        return IMAGE_LAYOUT_PACKED;
+    }
+
+    if(size >= BACKUP_RAM_FORMAT_STR_LEN * 2)
+    {
+        for(matches = 0; matches < BACKUP_RAM_FORMAT_STR_LEN; matches++)
+        {
+            if(buffer[(matches * 2) + 1] != (unsigned char)BACKUP_RAM_FORMAT_STR[matches])
+            {
+                break;
+            }
+        }
+
+        if(matches == BACKUP_RAM_FORMAT_STR_LEN)
+        {
+            return IMAGE_LAYOUT_INTERLEAVED;
+        }
+    }
+
+    // unformatted, go by size. A packed image of the same size wins
+    for(unsigned int i = 0; i < IMAGE_TYPE_MAX; i++)
+    {
+        if(size == g_Image_Geometry[i].size)
+        {
+            return IMAGE_LAYOUT_PACKED;
+        }
+    }
+
+    return IMAGE_LAYOUT_INTERLEAVED;
+}
+
+static SLINGA_ERROR set_partition_info(PIMAGE image)
+{
+    unsigned int skip_bytes = (image->layout == IMAGE_LAYOUT_INTERLEAVED) ? 1 : 0;
+
+    if((image->size >> skip_bytes) << skip_bytes != image->size)
+    {
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    for(unsigned int i = 0; i < IMAGE_TYPE_MAX; i++)
+    {
+        if((image->size >> skip_bytes) == g_Image_Geometry[i].size)
+        {
+            image->partition_info.partition_buf = image->buffer;
+            image->partition_info.partition_size = image->size;
+            image->partition_info.block_size = g_Image_Geometry[i].block_size << skip_bytes;
+            image->partition_info.skip_bytes = skip_bytes;
+
+            return SLINGA_SUCCESS;
+        }
+    }
+
+    return SLINGA_SAT_INVALID_PARTITION;
+}
+
+// writes to a temporary file first so an interrupted write never truncates the image
+static SLINGA_ERROR write_file(const char* path, const unsigned char* buffer, unsigned int size)
+{
+    char temp_path[sizeof(((PIMAGE)0)->path) + 8] = {0};
+    FILE* fp = NULL;
+    size_t written = 0;
+
+    if(snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    fp = fopen(temp_path, "wb");
+    if(!fp)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    written = fwrite(buffer, 1, size, fp);
+
+    if(fclose(fp) != 0 || written != size || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    return SLINGA_SUCCESS;
+}
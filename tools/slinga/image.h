@@ -0,0 +1,62 @@
+/** @file image.h
+ *
+ *  @author Slinga
+ *  @brief Backup memory images on the host
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "../../devices/sat/sat.h"
+
+//
+// An image is a file holding a whole SAT partition, internal memory or a
+// backup cartridge. Two layouts are handled:
+// - packed: only the valid bytes, as dumped by most save copiers
+// - interleaved: every other byte valid like the hardware, as kept by Yabause and Kronos
+//
+// The layout is detected from where the "BackUpRam Format" string is in the
+// first block, falling back to the file size. The whole image is read into
+// memory once and handed to the SAT engine, so any number of operations can
+// run against it before it is written back.
+//
+
+#define IMAGE_FILL_BYTE     0xFF    ///< @brief Value of the invalid bytes of interleaved images
+
+/** @brief How the partition bytes are stored in the file */
+typedef enum
+{
+    IMAGE_LAYOUT_UNKNOWN = 0,       ///< @brief Detect when opening
+    IMAGE_LAYOUT_PACKED = 1,        ///< @brief Valid bytes only
+    IMAGE_LAYOUT_INTERLEAVED = 2,   ///< @brief Every other byte is valid
+} IMAGE_LAYOUT;
+
+/** @brief Device types an image can be created for */
+typedef enum
+{
+    IMAGE_TYPE_INTERNAL = 0,        ///< @brief 32 KB internal memory
+    IMAGE_TYPE_CARTRIDGE_512K = 1,  ///< @brief 4 Mb cartridge
+    IMAGE_TYPE_CARTRIDGE_1MB = 2,   ///< @brief 8 Mb cartridge
+    IMAGE_TYPE_CARTRIDGE_2MB = 3,   ///< @brief 16 Mb cartridge
+    IMAGE_TYPE_CARTRIDGE_4MB = 4,   ///< @brief 32 Mb cartridge
+    IMAGE_TYPE_MAX,
+} IMAGE_TYPE;
+
+/** @brief Image loaded in memory */
+typedef struct _IMAGE
+{
+    char path[256];                 ///< @brief File the image was read from and is saved to
+    IMAGE_LAYOUT layout;            ///< @brief Layout of the file
+    unsigned char* buffer;          ///< @brief Contents of the file, interleaved images are kept interleaved
+    unsigned int size;              ///< @brief Size of buffer in bytes
+    PARTITION_INFO partition_info;  ///< @brief Partition for the SAT engine, points into buffer
+    unsigned char is_dirty;         ///< @brief buffer changed since it was read
+} IMAGE, *PIMAGE;
+
+SLINGA_ERROR Image_Open(PIMAGE image, const char* path, IMAGE_LAYOUT layout);
+SLINGA_ERROR Image_Create(PIMAGE image, const char* path, IMAGE_TYPE type, IMAGE_LAYOUT layout);
+SLINGA_ERROR Image_Save(PIMAGE image);
+SLINGA_ERROR Image_SaveAs(const PIMAGE image, const char* path, IMAGE_LAYOUT layout);
+SLINGA_ERROR Image_Close(PIMAGE image);
+
+const char* Image_GetLayoutName(IMAGE_LAYOUT layout);
+SLINGA_ERROR Image_GetTypeFromName(const char* name, IMAGE_TYPE* type);
@@ -0,0 +1,262 @@
+/** @file sha256.c
+ *
+ *  @author Slinga
+ *  @brief SHA-256, used to name archived saves by their contents
+ *  @bug No known bugs.
+ */
+#include "sha256.h"
+
+#include <string.h>
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const unsigned int g_SHA256_K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void transform(PSHA256 sha, const unsigned char* block);
+
+/**
+ * @brief Start a new hash
+ *
+ * @param[out] sha Hash state
+ */
+void SHA256_Init(PSHA256 sha)
+{
+    static const unsigned int initial_state[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(sha->state, initial_state, sizeof(sha->state));
+    sha->length = 0;
+    sha->block_used = 0;
+}
+
+/**
+ * @brief Add bytes to the hash
+ *
+ * @param[in,out] sha Hash state
+ * @param[in] buffer Bytes to add
+ * @param[in] size Size of buffer in bytes
+ */
+void SHA256_Update(PSHA256 sha, const unsigned char* buffer, unsigned int size)
+{
+    sha->length += size;
+
+    while(size > 0)
+    {
+        unsigned int count = sizeof(sha->block) - sha->block_used;
+
+        if(count > size)
+        {
+            count = size;
+        }
+
+        // whole blocks skip the copy
+        if(sha->block_used == 0 && count == sizeof(sha->block))
+        {
+            transform(sha, buffer);
+        }
+        else
+        {
+            memcpy(sha->block + sha->block_used, buffer, count);
+            sha->block_used += count;
+
+            if(sha->block_used == sizeof(sha->block))
+            {
+                transform(sha, sha->block);
+                sha->block_used = 0;
+            }
+        }
+
+        buffer += count;
+        size -= count;
+    }
+}
+
+/**
+ * @brief Finish the hash
+ *
+ * @param[in,out] sha Hash state. Must be started again to be reused
+ * @param[out] digest Hash of every byte added
+ */
+void SHA256_Final(PSHA256 sha, unsigned char digest[SHA256_SIZE])
+{
+    unsigned long long bits = sha->length * 8;
+
+    sha->block[sha->block_used++] = 0x80;
+
+    if(sha->block_used > sizeof(sha->block) - 8)
+    {
+        memset(sha->block + sha->block_used, 0, sizeof(sha->block) - sha->block_used);
+        transform(sha, sha->block);
+        sha->block_used = 0;
+    }
+
+    memset(sha->block + sha->block_used, 0, sizeof(sha->block) - 8 - sha->block_used);
+
+    for(unsigned int i = 0; i < 8; i++)
+    {
+        sha->block[63 - i] = (unsigned char)(bits >> (i * 8));
+    }
+
+    transform(sha, sha->block);
+
+    for(unsigned int i = 0; i < 8; i++)
+    {
+        digest[(i * 4) + 0] = (unsigned char)(sha->state[i] >> 24);
+        digest[(i * 4) + 1] = (unsigned char)(sha->state[i] >> 16);
+        digest[(i * 4) + 2] = (unsigned char)(sha->state[i] >> 8);
+        digest[(i * 4) + 3] = (unsigned char)(sha->state[i]);
+    }
+}
+
+/**
+ * @brief Hash a buffer in one call
+ *
+ * @param[in] buffer Bytes to hash
+ * @param[in] size Size of buffer in bytes
+ * @param[out] digest Hash of buffer
+ */
+void SHA256_Hash(const unsigned char* buffer, unsigned int size, unsigned char digest[SHA256_SIZE])
+{
+    SHA256 sha;
+
+    SHA256_Init(&sha);
+    SHA256_Update(&sha, buffer, size);
+    SHA256_Final(&sha, digest);
+}
+
+/**
+ * @brief Format a digest as lowercase hex
+ *
+ * @param[in] digest Digest
+ * @param[out] hex NULL terminated hex string
+ */
+void SHA256_ToHex(const unsigned char digest[SHA256_SIZE], char hex[SHA256_HEX_SIZE])
+{
+    static const char digits[] = "0123456789abcdef";
+
+    for(unsigned int i = 0; i < SHA256_SIZE; i++)
+    {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[(i * 2) + 1] = digits[digest[i] & 0x0F];
+    }
+
+    hex[SHA256_SIZE * 2] = '\0';
+}
+
+/**
+ * @brief Parse a digest written by SHA256_ToHex()
+ *
+ * @param[in] hex Hex string, upper or lowercase
+ * @param[out] digest Digest on success
+ *
+ * @return 1 on success, 0 if hex isn't a digest
+ */
+int SHA256_FromHex(const char* hex, unsigned char digest[SHA256_SIZE])
+{
+    if(strlen(hex) != SHA256_SIZE * 2)
+    {
+        return 0;
+    }
+
+    for(unsigned int i = 0; i < SHA256_SIZE * 2; i++)
+    {
+        char c = hex[i];
+        unsigned int nibble = 0;
+
+        if(c >= '0' && c <= '9')
+        {
+            nibble = c - '0';
+        }
+        else if(c >= 'a' && c <= 'f')
+        {
+            nibble = c - 'a' + 10;
+        }
+        else if(c >= 'A' && c <= 'F')
+        {
+            nibble = c - 'A' + 10;
+        }
+        else
+        {
+            return 0;
+        }
+
+        if(i % 2 == 0)
+        {
+            digest[i / 2] = (unsigned char)(nibble << 4);
+        }
+        else
+        {
+            digest[i / 2] |= (unsigned char)nibble;
+        }
+    }
+
+    return 1;
+}
+
+//
+// helper functions
+//
+
+static void transform(PSHA256 sha, const unsigned char* block)
+{
+    unsigned int w[64];
+    unsigned int a, b, c, d, e, f, g, h;
+
+    for(unsigned int i = 0; i < 16; i++)
+    {
+        w[i] = ((unsigned int)block[i * 4] << 24) | ((unsigned int)block[(i * 4) + 1] << 16) | ((unsigned int)block[(i * 4) + 2] << 8) | block[(i * 4) + 3];
+    }
+
+    for(unsigned int i = 16; i < 64; i++)
+    {
+        unsigned int s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned int s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = sha->state[0];
+    b = sha->state[1];
+    c = sha->state[2];
+    d = sha->state[3];
+    e = sha->state[4];
+    f = sha->state[5];
+    g = sha->state[6];
+    h = sha->state[7];
+
+    for(unsigned int i = 0; i < 64; i++)
+    {
+        unsigned int t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + g_SHA256_K[i] + w[i];
+        unsigned int t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    sha->state[0] += a;
+    sha->state[1] += b;
+    sha->state[2] += c;
+    sha->state[3] += d;
+    sha->state[4] += e;
+    sha->state[5] += f;
+    sha->state[6] += g;
+    sha->state[7] += h;
+}
@@ -0,0 +1,27 @@
+/** @file sha256.h
+ *
+ *  @author Slinga
+ *  @brief SHA-256, used to name archived saves by their contents
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#define SHA256_SIZE         32                      ///< @brief Digest size in bytes
+#define SHA256_HEX_SIZE     (SHA256_SIZE * 2 + 1)   ///< @brief Digest as hex, with NULL terminator
+
+/** @brief Running hash. Treat as opaque */
+typedef struct _SHA256
+{
+    unsigned int state[8];          ///< @brief Hash so far
+    unsigned long long length;      ///< @brief Bytes hashed so far
+    unsigned char block[64];        ///< @brief Bytes waiting for a full block
+    unsigned int block_used;        ///< @brief Bytes in block
+} SHA256, *PSHA256;
+
+void SHA256_Init(PSHA256 sha);
+void SHA256_Update(PSHA256 sha, const unsigned char* buffer, unsigned int size);
+void SHA256_Final(PSHA256 sha, unsigned char digest[SHA256_SIZE]);
+
+void SHA256_Hash(const unsigned char* buffer, unsigned int size, unsigned char digest[SHA256_SIZE]);
+void SHA256_ToHex(const unsigned char digest[SHA256_SIZE], char hex[SHA256_HEX_SIZE]);
+int SHA256_FromHex(const char* hex, unsigned char digest[SHA256_SIZE]);
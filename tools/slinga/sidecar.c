@@ -0,0 +1,569 @@
+/** @file sidecar.c
+ *
+ *  @author Slinga
+ *  @brief Directory of an image cached in a file next to it
+ *  @bug No known bugs.
+ */
+#include "sidecar.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static SLINGA_ERROR check_stamp(const PSIDECAR sidecar, const char* image_path);
+static SLINGA_ERROR check_layout(const PSIDECAR sidecar);
+static void set_stamp(PSIDECAR_HEADER header, const struct stat* st);
+static unsigned int get_header_size(const PSIDECAR_HEADER header);
+
+/**
+ * @brief Build the sidecar of an image
+ *
+ * @param[out] sidecar Sidecar on success, release with Sidecar_Free()
+ * @param[in] image Image as it is on disk, it must not have unsaved changes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Sidecar_Build(PSIDECAR sidecar, const PIMAGE image)
+{
+    static SAVE_METADATA saves[MAX_SAVES];
+    unsigned short blocks[SAT_MAX_CHAIN_BLOCKS] = {0};
+    const PPARTITION_INFO partition_info = &image->partition_info;
+    unsigned int num_blocks = 0;
+    unsigned int saves_found = 0;
+    unsigned int chain_capacity = 0;
+    struct stat st;
+    SHA256 sha;
+    SLINGA_ERROR result = 0;
+
+    if(!sidecar || !image || !image->buffer || image->is_dirty)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(sidecar, 0, sizeof(SIDECAR));
+
+    if(stat(image->path, &st) != 0)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    result = sat_list_saves(partition_info, saves, MAX_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    num_blocks = partition_info->partition_size / partition_info->block_size;
+
+    memcpy(sidecar->header.magic, SIDECAR_MAGIC, sizeof(sidecar->header.magic));
+    sidecar->header.version = SIDECAR_VERSION;
+    sidecar->header.layout = image->layout;
+    sidecar->header.partition_size = partition_info->partition_size;
+    sidecar->header.block_size = partition_info->block_size;
+    sidecar->header.skip_bytes = partition_info->skip_bytes;
+    sidecar->header.num_saves = saves_found;
+    sidecar->header.bitmap_size = (num_blocks + 7) / 8;
+    set_stamp(&sidecar->header, &st);
+
+    result = sat_get_used_blocks(partition_info, &sidecar->header.used_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    sidecar->saves = calloc(saves_found + 1, sizeof(SIDECAR_SAVE));
+    sidecar->bitmap = calloc(sidecar->header.bitmap_size, 1);
+    if(!sidecar->saves || !sidecar->bitmap)
+    {
+        Sidecar_Free(sidecar);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    // the two header blocks are always in use
+    sidecar->bitmap[0] |= 0x03;
+
+    SHA256_Init(&sha);
+
+    for(unsigned int i = 0; i < saves_found; i++)
+    {
+        PSIDECAR_SAVE save = &sidecar->saves[i];
+        unsigned int chain_blocks = 0;
+        unsigned int data_offset = 0;
+
+        result = sat_query_chain(saves[i].savename, partition_info, blocks, SAT_MAX_CHAIN_BLOCKS, &chain_blocks, &data_offset);
+        if(result != SLINGA_SUCCESS)
+        {
+            Sidecar_Free(sidecar);
+            return result;
+        }
+
+        if(sidecar->header.num_chain_blocks + chain_blocks > chain_capacity)
+        {
+            unsigned short* bigger = NULL;
+
+            chain_capacity = (sidecar->header.num_chain_blocks + chain_blocks) * 2;
+            bigger = realloc(sidecar->chain_blocks, chain_capacity * sizeof(unsigned short));
+            if(!bigger)
+            {
+                Sidecar_Free(sidecar);
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            sidecar->chain_blocks = bigger;
+        }
+
+        memcpy(save->savename, saves[i].savename, MAX_SAVENAME);
+        memcpy(save->comment, saves[i].comment, MAX_COMMENT);
+        save->language = saves[i].language;
+        save->timestamp = saves[i].timestamp;
+        save->data_size = saves[i].data_size;
+        save->first_block = sidecar->header.num_chain_blocks;
+        save->num_blocks = chain_blocks;
+
+        memcpy(&sidecar->chain_blocks[save->first_block], blocks, chain_blocks * sizeof(unsigned short));
+        sidecar->header.num_chain_blocks += chain_blocks;
+
+        for(unsigned int j = 0; j < chain_blocks; j++)
+        {
+            sidecar->bitmap[blocks[j] / 8] |= (unsigned char)(1 << (blocks[j] % 8));
+        }
+
+        SHA256_Update(&sha, image->buffer + (blocks[0] * partition_info->block_size), get_header_size(&sidecar->header));
+    }
+
+    SHA256_Final(&sha, sidecar->header.fingerprint);
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Write the sidecar next to its image. The old sidecar is replaced atomically
+ *
+ * @param[in] sidecar Sidecar from Sidecar_Build()
+ * @param[in] image_path Image the sidecar belongs to
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Sidecar_Write(const PSIDECAR sidecar, const char* image_path)
+{
+    char path[PATH_MAX] = {0};
+    char temp_path[PATH_MAX + 8] = {0};
+    FILE* fp = NULL;
+    int ok = 1;
+    SLINGA_ERROR result = 0;
+
+    if(!sidecar || !image_path)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = Sidecar_GetPath(image_path, path, sizeof(path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    fp = fopen(temp_path, "wb");
+    if(!fp)
+    {
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    ok = fwrite(&sidecar->header, sizeof(SIDECAR_HEADER), 1, fp) == 1;
+    ok = ok && fwrite(sidecar->saves, sizeof(SIDECAR_SAVE), sidecar->header.num_saves, fp) == sidecar->header.num_saves;
+    ok = ok && fwrite(sidecar->chain_blocks, sizeof(unsigned short), sidecar->header.num_chain_blocks, fp) == sidecar->header.num_chain_blocks;
+    ok = ok && fwrite(sidecar->bitmap, 1, sidecar->header.bitmap_size, fp) == sidecar->header.bitmap_size;
+
+    if(fclose(fp) != 0 || !ok || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+        return SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Load the sidecar of an image and check it still matches the image
+ *
+ * @param[out] sidecar Sidecar on success, release with Sidecar_Free()
+ * @param[in] image_path Image the sidecar belongs to
+ *
+ * @return SLINGA_SUCCESS on success, SLINGA_NOT_FOUND if there is no sidecar, SLINGA_SAT_INVALID_PARTITION if it is stale or damaged
+ */
+SLINGA_ERROR Sidecar_Read(PSIDECAR sidecar, const char* image_path)
+{
+    char path[PATH_MAX] = {0};
+    struct stat st;
+    unsigned long long expected_size = 0;
+    FILE* fp = NULL;
+    int ok = 1;
+    SLINGA_ERROR result = 0;
+
+    if(!sidecar || !image_path)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(sidecar, 0, sizeof(SIDECAR));
+
+    result = Sidecar_GetPath(image_path, path, sizeof(path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    fp = fopen(path, "rb");
+    if(!fp)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    if(fstat(fileno(fp), &st) != 0 || fread(&sidecar->header, sizeof(SIDECAR_HEADER), 1, fp) != 1)
+    {
+        fclose(fp);
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    expected_size = sizeof(SIDECAR_HEADER) +
+                    ((unsigned long long)sidecar->header.num_saves * sizeof(SIDECAR_SAVE)) +
+                    ((unsigned long long)sidecar->header.num_chain_blocks * sizeof(unsigned short)) +
+                    sidecar->header.bitmap_size;
+
+    if(memcmp(sidecar->header.magic, SIDECAR_MAGIC, sizeof(sidecar->header.magic)) != 0 ||
+       sidecar->header.version != SIDECAR_VERSION ||
+       sidecar->header.num_saves > MAX_SAVES ||
+       expected_size != (unsigned long long)st.st_size)
+    {
+        fclose(fp);
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    sidecar->saves = calloc(sidecar->header.num_saves + 1, sizeof(SIDECAR_SAVE));
+    sidecar->chain_blocks = calloc(sidecar->header.num_chain_blocks + 1, sizeof(unsigned short));
+    sidecar->bitmap = calloc(sidecar->header.bitmap_size + 1, 1);
+    ok = sidecar->saves && sidecar->chain_blocks && sidecar->bitmap;
+
+    ok = ok && fread(sidecar->saves, sizeof(SIDECAR_SAVE), sidecar->header.num_saves, fp) == sidecar->header.num_saves;
+    ok = ok && fread(sidecar->chain_blocks, sizeof(unsigned short), sidecar->header.num_chain_blocks, fp) == sidecar->header.num_chain_blocks;
+    ok = ok && fread(sidecar->bitmap, 1, sidecar->header.bitmap_size, fp) == sidecar->header.bitmap_size;
+
+    fclose(fp);
+
+    if(!ok)
+    {
+        Sidecar_Free(sidecar);
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    result = check_layout(sidecar);
+    if(result == SLINGA_SUCCESS)
+    {
+        result = check_stamp(sidecar, image_path);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        Sidecar_Free(sidecar);
+        return result;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Release a sidecar
+ *
+ * @param[in] sidecar Sidecar
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Sidecar_Free(PSIDECAR sidecar)
+{
+    if(!sidecar)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    free(sidecar->saves);
+    free(sidecar->chain_blocks);
+    free(sidecar->bitmap);
+
+    memset(sidecar, 0, sizeof(SIDECAR));
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Read one save, loading only the blocks of its chain from the image
+ *
+ * @param[in] sidecar Sidecar from Sidecar_Read()
+ * @param[in] image_path Image the sidecar belongs to
+ * @param[in] savename Save to read
+ * @param[out] metadata Optional, metadata of the save
+ * @param[out] buffer Optional, save data. Must hold the whole save
+ * @param[in] size Size of buffer in bytes
+ * @param[out] bytes_read Optional, bytes read into buffer
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Sidecar_ReadSave(const PSIDECAR sidecar, const char* image_path, const char* savename, PSAVE_METADATA metadata, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    const SIDECAR_SAVE* save = NULL;
+    PARTITION_INFO partition_info = {0};
+    unsigned char* partition = NULL;
+    int fd = -1;
+    SLINGA_ERROR result = SLINGA_SUCCESS;
+
+    if(!sidecar || !image_path || !savename)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    for(unsigned int i = 0; i < sidecar->header.num_saves; i++)
+    {
+        if(strncmp(sidecar->saves[i].savename, savename, SAT_MAX_SAVE_NAME) == 0)
+        {
+            save = &sidecar->saves[i];
+            break;
+        }
+    }
+
+    if(!save)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    if(metadata)
+    {
+        memset(metadata, 0, sizeof(SAVE_METADATA));
+        memcpy(metadata->savename, save->savename, MAX_SAVENAME);
+        memcpy(metadata->comment, save->comment, MAX_COMMENT);
+        metadata->language = save->language;
+        metadata->timestamp = save->timestamp;
+        metadata->data_size = save->data_size;
+    }
+
+    if(!buffer)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    if(size < save->data_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    // blocks that aren't loaded stay zero, which the SAT engine sees as free
+    partition = calloc(sidecar->header.partition_size, 1);
+    if(!partition)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    fd = open(image_path, O_RDONLY);
+    if(fd < 0)
+    {
+        free(partition);
+        return SLINGA_NOT_FOUND;
+    }
+
+    for(unsigned int i = 0; i < save->num_blocks; i++)
+    {
+        unsigned int offset = sidecar->chain_blocks[save->first_block + i] * sidecar->header.block_size;
+
+        if(pread(fd, partition + offset, sidecar->header.block_size, offset) != (ssize_t)sidecar->header.block_size)
+        {
+            result = SLINGA_SAT_INVALID_PARTITION;
+            break;
+        }
+    }
+
+    close(fd);
+
+    if(result == SLINGA_SUCCESS)
+    {
+        partition_info.partition_buf = partition;
+        partition_info.partition_size = sidecar->header.partition_size;
+        partition_info.block_size = sidecar->header.block_size;
+        partition_info.skip_bytes = sidecar->header.skip_bytes;
+
+        result = sat_read(save->savename, buffer, save->data_size, bytes_read, &partition_info);
+
+        sat_release(&partition_info);
+    }
+
+    free(partition);
+
+    return result;
+}
+
+/**
+ * @brief Path of the sidecar of an image
+ *
+ * @param[in] image_path Image
+ * @param[out] path Sidecar path on success
+ * @param[in] path_size Size of path in bytes
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Sidecar_GetPath(const char* image_path, char* path, unsigned int path_size)
+{
+    int length = 0;
+
+    if(!image_path || !path)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    length = snprintf(path, path_size, "%s%s", image_path, SIDECAR_SUFFIX);
+    if(length < 0 || (unsigned int)length >= path_size)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Check if an image has a sidecar, current or not
+ *
+ * @param[in] image_path Image
+ *
+ * @return 1 if the sidecar file exists
+ */
+int Sidecar_Exists(const char* image_path)
+{
+    char path[PATH_MAX] = {0};
+
+    if(Sidecar_GetPath(image_path, path, sizeof(path)) != SLINGA_SUCCESS)
+    {
+        return 0;
+    }
+
+    return access(path, F_OK) == 0;
+}
+
+//
+// helper functions
+//
+
+// size and mtime first, then the start block header of every listed save
+static SLINGA_ERROR check_stamp(const PSIDECAR sidecar, const char* image_path)
+{
+    unsigned char header[sizeof(SAT_START_BLOCK_HEADER) * 2] = {0};
+    unsigned char fingerprint[SHA256_SIZE] = {0};
+    unsigned int header_size = get_header_size(&sidecar->header);
+    SIDECAR_HEADER stamp = {0};
+    struct stat st;
+    SHA256 sha;
+    int fd = -1;
+
+    if(stat(image_path, &st) != 0)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    set_stamp(&stamp, &st);
+
+    if(stamp.image_size != sidecar->header.image_size || stamp.image_mtime != sidecar->header.image_mtime)
+    {
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    fd = open(image_path, O_RDONLY);
+    if(fd < 0)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    SHA256_Init(&sha);
+
+    for(unsigned int i = 0; i < sidecar->header.num_saves; i++)
+    {
+        unsigned int start_block = sidecar->chain_blocks[sidecar->saves[i].first_block];
+
+        if(pread(fd, header, header_size, (off_t)start_block * sidecar->header.block_size) != (ssize_t)header_size)
+        {
+            close(fd);
+            return SLINGA_SAT_INVALID_PARTITION;
+        }
+
+        SHA256_Update(&sha, header, header_size);
+    }
+
+    close(fd);
+
+    SHA256_Final(&sha, fingerprint);
+
+    if(memcmp(fingerprint, sidecar->header.fingerprint, SHA256_SIZE) != 0)
+    {
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+// a damaged sidecar must not send a read out of bounds
+static SLINGA_ERROR check_layout(const PSIDECAR sidecar)
+{
+    const PSIDECAR_HEADER header = &sidecar->header;
+    unsigned int num_blocks = 0;
+
+    if(header->skip_bytes > 1 || header->block_size < ((unsigned int)MIN_BLOCK_SIZE << header->skip_bytes) ||
+       header->block_size > ((unsigned int)SAT_MAX_BLOCK_SIZE << header->skip_bytes) ||
+       header->partition_size % header->block_size != 0 ||
+       header->image_size != header->partition_size)
+    {
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    num_blocks = header->partition_size / header->block_size;
+
+    if(header->bitmap_size != (num_blocks + 7) / 8)
+    {
+        return SLINGA_SAT_INVALID_PARTITION;
+    }
+
+    for(unsigned int i = 0; i < header->num_chain_blocks; i++)
+    {
+        if(sidecar->chain_blocks[i] < 2 || sidecar->chain_blocks[i] >= num_blocks)
+        {
+            return SLINGA_SAT_INVALID_PARTITION;
+        }
+    }
+
+    for(unsigned int i = 0; i < header->num_saves; i++)
+    {
+        PSIDECAR_SAVE save = &sidecar->saves[i];
+
+        if(!save->num_blocks || save->first_block > header->num_chain_blocks ||
+           save->num_blocks > header->num_chain_blocks - save->first_block)
+        {
+            return SLINGA_SAT_INVALID_PARTITION;
+        }
+
+        save->savename[MAX_SAVENAME] = '\0';
+        save->comment[MAX_COMMENT] = '\0';
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static void set_stamp(PSIDECAR_HEADER header, const struct stat* st)
+{
+    header->image_size = st->st_size;
+    header->image_mtime = ((long long)st->st_mtim.tv_sec * 1000000000LL) + st->st_mtim.tv_nsec;
+}
+
+// the start block header as stored in the image, skip bytes included
+static unsigned int get_header_size(const PSIDECAR_HEADER header)
+{
+    return sizeof(SAT_START_BLOCK_HEADER) << header->skip_bytes;
+}
@@ -0,0 +1,79 @@
+/** @file sidecar.h
+ *
+ *  @author Slinga
+ *  @brief Directory of an image cached in a file next to it
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "image.h"
+#include "sha256.h"
+
+//
+// IMAGE.slx holds what it takes to answer list and stat, and to read a
+// save, without loading and walking the whole image: the save directory,
+// every save's block chain and the used block map.
+//
+// It is stamped with the image's size and mtime and a SHA-256 of the
+// start block header of every save it lists. Loading checks the stamp and
+// reads just those headers back from the image, so a sidecar that no
+// longer matches is caught in O(saves). Reading a save then reads just the
+// blocks of its chain.
+//
+// The tool rewrites the sidecar, through a temporary file and a rename,
+// every time it writes an image that has one. An image written by anything
+// else changes its mtime, which makes the sidecar stale until it is built
+// again.
+//
+
+#define SIDECAR_SUFFIX      ".slx"
+#define SIDECAR_MAGIC       "SLSC"
+#define SIDECAR_VERSION     (1)
+
+/** @brief Sidecar file header, followed by the saves, the chains and the used block map */
+typedef struct _SIDECAR_HEADER
+{
+    char magic[4];                          ///< @brief SIDECAR_MAGIC
+    unsigned int version;                   ///< @brief SIDECAR_VERSION
+    unsigned int layout;                    ///< @brief IMAGE_LAYOUT of the image
+    unsigned int partition_size;            ///< @brief PARTITION_INFO of the image
+    unsigned int block_size;
+    unsigned int skip_bytes;
+    unsigned int num_saves;                 ///< @brief Entries in the directory
+    unsigned int num_chain_blocks;          ///< @brief Block indexes of all chains
+    unsigned int bitmap_size;               ///< @brief Bytes in the used block map
+    unsigned int used_blocks;               ///< @brief Blocks used by saves, the two header blocks not included
+    unsigned long long image_size;          ///< @brief Image file size when built
+    long long image_mtime;                  ///< @brief Image file mtime in nanoseconds when built
+    unsigned char fingerprint[SHA256_SIZE]; ///< @brief SHA-256 of every listed save's start block header, as stored
+} SIDECAR_HEADER, *PSIDECAR_HEADER;
+
+/** @brief One save in the directory */
+typedef struct _SIDECAR_SAVE
+{
+    char savename[MAX_SAVENAME + 1];        ///< @brief Save name
+    char comment[MAX_COMMENT + 1];          ///< @brief Save comment
+    unsigned char language;                 ///< @brief Save language
+    unsigned int timestamp;                 ///< @brief Save timestamp
+    unsigned int data_size;                 ///< @brief Save size in bytes
+    unsigned int first_block;               ///< @brief Index of the save's chain in the chain blocks
+    unsigned int num_blocks;                ///< @brief Blocks in the chain, the first is the start block
+} SIDECAR_SAVE, *PSIDECAR_SAVE;
+
+/** @brief Sidecar in memory */
+typedef struct _SIDECAR
+{
+    SIDECAR_HEADER header;                  ///< @brief Geometry and stamp
+    PSIDECAR_SAVE saves;                    ///< @brief Directory
+    unsigned short* chain_blocks;           ///< @brief Chains of every save
+    unsigned char* bitmap;                  ///< @brief Used block map, one bit per block
+} SIDECAR, *PSIDECAR;
+
+SLINGA_ERROR Sidecar_Build(PSIDECAR sidecar, const PIMAGE image);
+SLINGA_ERROR Sidecar_Write(const PSIDECAR sidecar, const char* image_path);
+SLINGA_ERROR Sidecar_Read(PSIDECAR sidecar, const char* image_path);
+SLINGA_ERROR Sidecar_Free(PSIDECAR sidecar);
+
+SLINGA_ERROR Sidecar_ReadSave(const PSIDECAR sidecar, const char* image_path, const char* savename, PSAVE_METADATA metadata, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+SLINGA_ERROR Sidecar_GetPath(const char* image_path, char* path, unsigned int path_size);
+int Sidecar_Exists(const char* image_path);
@@ -0,0 +1,1577 @@
+/** @file slinga.c
+ *
+ *  @author Slinga
+ *  @brief Host command line tool for backup memory images
+ *  @bug No known bugs.
+ */
+#include "archive.h"
+#include "corpus.h"
+#include "image.h"
+#include "sidecar.h"
+#include "watch.h"
+#include "../../devices/bup/bup.h"
+#include "../../libslinga/timestamp.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// slinga [--layout packed|interleaved] [--sidecar] IMAGE COMMAND [ARGS]
+//
+// The image is read once, every command runs against the copy in memory and
+// the file is written back once at the end if anything changed. "batch"
+// runs one command per line of a script the same way, so a long list of
+// operations parses and writes the image only once.
+//
+// Save data is streamed: "-" in place of a file means stdout for extract and
+// stdin for inject, so saves can be piped between images and other tools.
+//
+// With --sidecar, list, stat and extract are answered from IMAGE.slx when it
+// is current, without loading the image, see sidecar.h. Any other run
+// builds the sidecar if it is missing or stale. Once an image has a sidecar
+// it is kept up to date on every write, with or without --sidecar.
+//
+// slinga --archive DIR COMMAND [ARGS]
+//
+// Works on a deduplicating archive of saves instead of an image, see
+// archive.h.
+//
+// slinga --index FILE COMMAND [ARGS]
+//
+// Keeps a search index over the saves of any number of images, see
+// corpus.h. Queries are answered from the index file alone.
+//
+// slinga --watch [--debounce MS] DIR...
+//
+// Follows the images in the directories and prints a line for every save
+// that is added, modified or deleted, see watch.h:
+// EVENT \t IMAGE \t SAVENAME \t SIZE \t TIMESTAMP
+//
+
+#define MAX_ARGS            16      ///< @brief Arguments of one command, including its name
+#define MAX_BATCH_LINE      1024    ///< @brief Longest batch line
+#define SECONDS_1970_TO_1980 315532800
+
+static volatile int g_Stop = 0;     ///< @brief Set by SIGINT and SIGTERM to end --watch
+
+/** @brief State shared by the commands of one run */
+typedef struct _TOOL_CONTEXT
+{
+    PIMAGE image;               ///< @brief Image the commands run against
+    unsigned char stdin_busy;   ///< @brief stdin holds a batch script and can't be used for save data
+    unsigned char in_batch;     ///< @brief Running from a batch script
+} TOOL_CONTEXT, *PTOOL_CONTEXT;
+
+typedef SLINGA_ERROR (*COMMAND_HANDLER)(PTOOL_CONTEXT context, int argc, char** argv);
+typedef SLINGA_ERROR (*SIDECAR_HANDLER)(PSIDECAR sidecar, const char* image_path, int argc, char** argv);
+
+/** @brief One subcommand */
+typedef struct _COMMAND
+{
+    const char* name;           ///< @brief Name on the command line
+    const char* usage;          ///< @brief Arguments, for the usage text
+    int min_args;               ///< @brief Arguments needed after the name
+    COMMAND_HANDLER handler;    ///< @brief Runs the command
+    SIDECAR_HANDLER sidecar;    ///< @brief Runs the command from the sidecar, NULL if it needs the image
+} COMMAND;
+
+static SLINGA_ERROR cmd_list(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_stat(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_extract(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_inject(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_delete(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_format(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_check(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_convert(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR cmd_batch(PTOOL_CONTEXT context, int argc, char** argv);
+static SLINGA_ERROR sidecar_list(PSIDECAR sidecar, const char* image_path, int argc, char** argv);
+static SLINGA_ERROR sidecar_stat(PSIDECAR sidecar, const char* image_path, int argc, char** argv);
+static SLINGA_ERROR sidecar_extract(PSIDECAR sidecar, const char* image_path, int argc, char** argv);
+
+typedef SLINGA_ERROR (*ARCHIVE_HANDLER)(PARCHIVE archive, int argc, char** argv);
+
+/** @brief One archive subcommand */
+typedef struct _ARCHIVE_COMMAND
+{
+    const char* name;           ///< @brief Name on the command line
+    const char* usage;          ///< @brief Arguments, for the usage text
+    int min_args;               ///< @brief Arguments needed after the name
+    ARCHIVE_HANDLER handler;    ///< @brief Runs the command
+} ARCHIVE_COMMAND;
+
+typedef SLINGA_ERROR (*INDEX_HANDLER)(PCORPUS corpus, int argc, char** argv);
+
+/** @brief One index subcommand */
+typedef struct _INDEX_COMMAND
+{
+    const char* name;           ///< @brief Name on the command line
+    const char* usage;          ///< @brief Arguments, for the usage text
+    int min_args;               ///< @brief Arguments needed after the name
+    INDEX_HANDLER handler;      ///< @brief Runs the command
+} INDEX_COMMAND;
+
+static const COMMAND g_Commands[] =
+{
+    {"list",    "",                                                         0, cmd_list, sidecar_list},
+    {"stat",    "",                                                         0, cmd_stat, sidecar_stat},
+    {"extract", "NAME [FILE|-] [--bup]",                                    1, cmd_extract, sidecar_extract},
+    {"inject",  "NAME [FILE|-] [--bup] [--force] [--comment TEXT] [--language N] [--timestamp SECONDS]", 1, cmd_inject, NULL},
+    {"delete",  "NAME",                                                     1, cmd_delete, NULL},
+    {"format",  "[internal|512k|1mb|2mb|4mb]",                              0, cmd_format, NULL},
+    {"check",   "",                                                         0, cmd_check, NULL},
+    {"convert", "FILE [packed|interleaved]",                                1, cmd_convert, NULL},
+    {"batch",   "[FILE|-]",                                                 0, cmd_batch, NULL},
+};
+
+#define NUM_COMMANDS (sizeof(g_Commands) / sizeof(g_Commands[0]))
+
+static SLINGA_ERROR archive_import(PARCHIVE archive, int argc, char** argv);
+static SLINGA_ERROR archive_find(PARCHIVE archive, int argc, char** argv);
+static SLINGA_ERROR archive_get(PARCHIVE archive, int argc, char** argv);
+
+static const ARCHIVE_COMMAND g_Archive_Commands[] =
+{
+    {"import",  "[-j JOBS] IMAGE...",                                       1, archive_import},
+    {"find",    "FILE|-|HASH",                                              1, archive_find},
+    {"get",     "HASH [FILE|-]",                                            1, archive_get},
+};
+
+#define NUM_ARCHIVE_COMMANDS (sizeof(g_Archive_Commands) / sizeof(g_Archive_Commands[0]))
+
+static SLINGA_ERROR index_add(PCORPUS corpus, int argc, char** argv);
+static SLINGA_ERROR index_refresh(PCORPUS corpus, int argc, char** argv);
+static SLINGA_ERROR index_find(PCORPUS corpus, int argc, char** argv);
+
+static const INDEX_COMMAND g_Index_Commands[] =
+{
+    {"add",     "IMAGE...",                                                 1, index_add},
+    {"refresh", "",                                                         0, index_refresh},
+    {"find",    "[--name PREFIX] [--comment PREFIX] [--size MIN-MAX] [--timestamp MIN-MAX] [--limit N]", 0, index_find},
+};
+
+#define NUM_INDEX_COMMANDS (sizeof(g_Index_Commands) / sizeof(g_Index_Commands[0]))
+
+static void usage(void);
+static const COMMAND* find_command(const char* name);
+static SLINGA_ERROR run_command(PTOOL_CONTEXT context, int argc, char** argv);
+static int run_archive(int argc, char** argv);
+static int run_index(int argc, char** argv);
+static int run_watch(int argc, char** argv);
+static void print_watch_event(void* context, WATCH_EVENT event, const char* image_path, const WATCH_SAVE* save);
+static void handle_stop_signal(int signal_number);
+static int run_sidecar(const COMMAND* command, const char* image_path, IMAGE_LAYOUT layout, int argc, char** argv);
+static SLINGA_ERROR update_sidecar(const PIMAGE image, unsigned char is_written);
+static void print_save(const SAVE_METADATA* save, unsigned int num_blocks);
+static void print_stat(IMAGE_LAYOUT layout, unsigned int block_size, unsigned int total_blocks, unsigned int used_blocks, unsigned int saves_found);
+static SLINGA_ERROR write_save(const PSAVE_METADATA metadata, const unsigned char* data, unsigned int size, int argc, char** argv);
+static void print_corpus_stats(const CORPUS_STATS* stats);
+static SLINGA_ERROR parse_range(const char* text, unsigned int* min, unsigned int* max);
+static SLINGA_ERROR parse_layout(const char* name, IMAGE_LAYOUT* layout);
+static SLINGA_ERROR parse_digest(const char* text, unsigned char digest[SHA256_SIZE]);
+static int split_line(char* line, char** argv, int max_args);
+static const char* find_option(int argc, char** argv, const char* option);
+static int has_flag(int argc, char** argv, const char* flag);
+static SLINGA_ERROR read_stream(FILE* fp, unsigned int max_size, unsigned char** buffer, unsigned int* size);
+
+int main(int argc, char** argv)
+{
+    TOOL_CONTEXT context = {0};
+    IMAGE image = {0};
+    IMAGE_LAYOUT layout = IMAGE_LAYOUT_UNKNOWN;
+    IMAGE_TYPE type = IMAGE_TYPE_INTERNAL;
+    const COMMAND* command = NULL;
+    unsigned char use_sidecar = 0;
+    unsigned char is_written = 0;
+    int arg = 1;
+    SLINGA_ERROR result = 0;
+
+    if(argc > 1 && strcmp(argv[arg], "--archive") == 0)
+    {
+        return run_archive(argc - 2, &argv[2]);
+    }
+
+    if(argc > 1 && strcmp(argv[arg], "--index") == 0)
+    {
+        return run_index(argc - 2, &argv[2]);
+    }
+
+    if(argc > 1 && strcmp(argv[arg], "--watch") == 0)
+    {
+        return run_watch(argc - 2, &argv[2]);
+    }
+
+    while(argc - arg > 1 && strncmp(argv[arg], "--", 2) == 0)
+    {
+        if(strcmp(argv[arg], "--layout") == 0)
+        {
+            if(parse_layout(argv[arg + 1], &layout) != SLINGA_SUCCESS)
+            {
+                usage();
+                return 1;
+            }
+
+            arg += 2;
+        }
+        else if(strcmp(argv[arg], "--sidecar") == 0)
+        {
+            use_sidecar = 1;
+            arg++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    command = (argc - arg < 2) ? NULL : find_command(argv[arg + 1]);
+    if(!command)
+    {
+        usage();
+        return 1;
+    }
+
+    if(use_sidecar && command->sidecar && argc - arg - 2 >= command->min_args)
+    {
+        int status = run_sidecar(command, argv[arg], layout, argc - arg - 2, &argv[arg + 2]);
+        if(status >= 0)
+        {
+            return status;
+        }
+    }
+
+    // "format TYPE" creates the image, everything else needs an existing one
+    if(strcmp(argv[arg + 1], "format") == 0 && argc - arg > 2)
+    {
+        if(Image_GetTypeFromName(argv[arg + 2], &type) != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "slinga: unknown device type %s\n", argv[arg + 2]);
+            return 1;
+        }
+
+        result = Image_Create(&image, argv[arg], type, layout);
+    }
+    else
+    {
+        result = Image_Open(&image, argv[arg], layout);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: can't open %s (0x%x)\n", argv[arg], result);
+        return 1;
+    }
+
+    context.image = &image;
+
+    result = run_command(&context, argc - arg - 1, &argv[arg + 1]);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: %s failed (0x%x)\n", argv[arg + 1], result);
+    }
+
+    is_written = image.is_dirty;
+
+    // saved even after a failed batch line, the commands that worked are kept
+    if(Image_Save(&image) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: can't write %s\n", image.path);
+        Image_Close(&image);
+        return 1;
+    }
+
+    if(use_sidecar || (is_written && Sidecar_Exists(image.path)))
+    {
+        if(update_sidecar(&image, is_written) != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "slinga: can't write the sidecar of %s\n", image.path);
+            result = SLINGA_NOT_ENOUGH_SPACE;
+        }
+    }
+
+    Image_Close(&image);
+
+    return (result == SLINGA_SUCCESS) ? 0 : 1;
+}
+
+//
+// commands
+//
+
+static SLINGA_ERROR cmd_list(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    static SAVE_METADATA saves[MAX_SAVES];
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argc);
+    UNUSED(argv);
+
+    result = sat_list_saves(&context->image->partition_info, saves, MAX_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < saves_found; i++)
+    {
+        unsigned int num_blocks = 0;
+
+        sat_calc_blocks(&context->image->partition_info, saves[i].data_size, &num_blocks);
+        print_save(&saves[i], num_blocks);
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR cmd_stat(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    const PPARTITION_INFO partition_info = &context->image->partition_info;
+    unsigned int block_size = partition_info->block_size >> partition_info->skip_bytes;
+    unsigned int total_blocks = (partition_info->partition_size / partition_info->block_size) - 2;
+    unsigned int used_blocks = 0;
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argc);
+    UNUSED(argv);
+
+    result = sat_get_used_blocks(partition_info, &used_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = sat_list_saves(partition_info, NULL, 0, &saves_found);
+    if(result != SLINGA_SUCCESS && result != SLINGA_BUFFER_TOO_SMALL)
+    {
+        return result;
+    }
+
+    print_stat(context->image->layout, block_size, total_blocks, used_blocks, saves_found);
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR cmd_extract(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned char* data = NULL;
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
+
+    result = sat_query_file(argv[0], &context->image->partition_info, &metadata);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    data = malloc(metadata.data_size ? metadata.data_size : 1);
+    if(!data)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    result = sat_read(argv[0], data, metadata.data_size, &bytes_read, &context->image->partition_info);
+    if(result == SLINGA_SUCCESS)
+    {
+        result = write_save(&metadata, data, bytes_read, argc, argv);
+    }
+
+    free(data);
+
+    return result;
+}
+
+static SLINGA_ERROR cmd_inject(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    const PPARTITION_INFO partition_info = &context->image->partition_info;
+    SAVE_METADATA metadata = {0};
+    const char* path = (argc > 1 && strncmp(argv[1], "--", 2) != 0) ? argv[1] : "-";
+    const char* option = NULL;
+    unsigned char* buffer = NULL;
+    unsigned char* data = NULL;
+    unsigned int size = 0;
+    FILE* fp = stdin;
+    SLINGA_ERROR result = 0;
+
+    if(strlen(argv[0]) > SAT_MAX_SAVE_NAME)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(strcmp(path, "-") == 0)
+    {
+        if(context->stdin_busy)
+        {
+            fprintf(stderr, "slinga: inject: stdin is the batch script, give a file\n");
+            return SLINGA_INVALID_PARAMETER;
+        }
+    }
+    else
+    {
+        fp = fopen(path, "rb");
+        if(!fp)
+        {
+            return SLINGA_NOT_FOUND;
+        }
+    }
+
+    // nothing bigger than the partition can fit
+    result = read_stream(fp, (partition_info->partition_size >> partition_info->skip_bytes) + BUP_HEADER_SIZE, &buffer, &size);
+
+    if(fp != stdin)
+    {
+        fclose(fp);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        free(buffer);
+        return result;
+    }
+
+    data = buffer;
+
+    if(has_flag(argc, argv, "--bup"))
+    {
+        result = bup_parse_header(buffer, size, &metadata);
+        if(result != SLINGA_SUCCESS || metadata.data_size != size - BUP_HEADER_SIZE)
+        {
+            free(buffer);
+            return (result != SLINGA_SUCCESS) ? result : SLINGA_BUP_INVALID_HEADER;
+        }
+
+        data += BUP_HEADER_SIZE;
+        size -= BUP_HEADER_SIZE;
+    }
+    else
+    {
+        metadata.language = LANGUAGE_ENGLISH;
+        metadata.timestamp = (unsigned int)(time(NULL) - SECONDS_1970_TO_1980);
+    }
+
+    strcpy(metadata.savename, argv[0]);
+    metadata.data_size = size;
+
+    option = find_option(argc, argv, "--comment");
+    if(option)
+    {
+        strncpy(metadata.comment, option, SAT_MAX_SAVE_COMMENT);
+        metadata.comment[SAT_MAX_SAVE_COMMENT] = '\0';
+    }
+
+    option = find_option(argc, argv, "--language");
+    if(option)
+    {
+        metadata.language = (unsigned char)strtoul(option, NULL, 0);
+        if(metadata.language >= MAX_LANGUAGE)
+        {
+            free(buffer);
+            return SLINGA_INVALID_PARAMETER;
+        }
+    }
+
+    option = find_option(argc, argv, "--timestamp");
+    if(option)
+    {
+        metadata.timestamp = (unsigned int)strtoul(option, NULL, 0);
+    }
+
+    result = sat_write(has_flag(argc, argv, "--force") ? OVERWRITE_EXISTING_SAVE : 0,
+                       argv[0],
+                       &metadata,
+                       data,
+                       size,
+                       partition_info);
+
+    free(buffer);
+
+    if(result == SLINGA_SUCCESS)
+    {
+        context->image->is_dirty = 1;
+    }
+
+    return result;
+}
+
+static SLINGA_ERROR cmd_delete(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argc);
+
+    result = sat_delete(argv[0], 0, &context->image->partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    context->image->is_dirty = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR cmd_format(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argv);
+
+    // main() already created a formatted image
+    if(argc > 0 && !context->in_batch)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    if(argc > 0)
+    {
+        fprintf(stderr, "slinga: format: the device type can't be changed in a batch\n");
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = sat_format(&context->image->partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    context->image->is_dirty = 1;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR cmd_check(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    static SAVE_METADATA saves[MAX_SAVES];
+    const PPARTITION_INFO partition_info = &context->image->partition_info;
+    unsigned char* data = NULL;
+    unsigned int saves_found = 0;
+    unsigned int total_blocks = (partition_info->partition_size / partition_info->block_size) - 2;
+    unsigned int used_blocks = 0;
+    unsigned int errors = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argc);
+    UNUSED(argv);
+
+    result = sat_check_formatted(partition_info);
+    if(result != SLINGA_SUCCESS)
+    {
+        printf("not formatted (0x%x)\n", result);
+        return result;
+    }
+
+    result = sat_list_saves(partition_info, saves, MAX_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        printf("directory is corrupt (0x%x)\n", result);
+        return result;
+    }
+
+    data = malloc(partition_info->partition_size);
+    if(!data)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    // reading every save follows every chain and checks its tags and size
+    for(unsigned int i = 0; i < saves_found; i++)
+    {
+        unsigned int bytes_read = 0;
+
+        result = sat_read(saves[i].savename, data, saves[i].data_size, &bytes_read, partition_info);
+        if(result != SLINGA_SUCCESS || bytes_read != saves[i].data_size)
+        {
+            printf("%s: can't be read (0x%x)\n", saves[i].savename, result);
+            errors++;
+        }
+    }
+
+    free(data);
+
+    result = sat_get_used_blocks(partition_info, &used_blocks);
+    if(result != SLINGA_SUCCESS || used_blocks > total_blocks)
+    {
+        printf("saves need %u blocks, only %u blocks on the device\n", used_blocks, total_blocks);
+        errors++;
+    }
+
+    printf("%u saves, %u errors\n", saves_found, errors);
+
+    return errors ? SLINGA_SAT_INVALID_PARTITION : SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR cmd_convert(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    IMAGE_LAYOUT layout = IMAGE_LAYOUT_UNKNOWN;
+
+    if(argc > 1)
+    {
+        if(parse_layout(argv[1], &layout) != SLINGA_SUCCESS)
+        {
+            return SLINGA_INVALID_PARAMETER;
+        }
+    }
+    else
+    {
+        layout = (context->image->layout == IMAGE_LAYOUT_PACKED) ? IMAGE_LAYOUT_INTERLEAVED : IMAGE_LAYOUT_PACKED;
+    }
+
+    return Image_SaveAs(context->image, argv[0], layout);
+}
+
+static SLINGA_ERROR cmd_batch(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    char line[MAX_BATCH_LINE] = {0};
+    char* line_argv[MAX_ARGS] = {0};
+    unsigned int line_number = 0;
+    unsigned int errors = 0;
+    FILE* fp = stdin;
+    SLINGA_ERROR result = 0;
+
+    if(context->in_batch)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(argc > 0 && strcmp(argv[0], "-") != 0)
+    {
+        fp = fopen(argv[0], "r");
+        if(!fp)
+        {
+            return SLINGA_NOT_FOUND;
+        }
+    }
+
+    context->in_batch = 1;
+    context->stdin_busy = (fp == stdin);
+
+    while(fgets(line, sizeof(line), fp))
+    {
+        int line_argc = 0;
+
+        line_number++;
+
+        line_argc = split_line(line, line_argv, MAX_ARGS);
+        if(line_argc <= 0 || line_argv[0][0] == '#')
+        {
+            continue;
+        }
+
+        result = run_command(context, line_argc, line_argv);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "slinga: batch line %u: %s failed (0x%x)\n", line_number, line_argv[0], result);
+            errors++;
+        }
+    }
+
+    if(fp != stdin)
+    {
+        fclose(fp);
+    }
+
+    context->in_batch = 0;
+    context->stdin_busy = 0;
+
+    return errors ? SLINGA_INVALID_PARAMETER : SLINGA_SUCCESS;
+}
+
+//
+// sidecar commands
+//
+
+static SLINGA_ERROR sidecar_list(PSIDECAR sidecar, const char* image_path, int argc, char** argv)
+{
+    UNUSED(argc);
+    UNUSED(argv);
+
+    for(unsigned int i = 0; i < sidecar->header.num_saves; i++)
+    {
+        SAVE_METADATA metadata = {0};
+
+        Sidecar_ReadSave(sidecar, image_path, sidecar->saves[i].savename, &metadata, NULL, 0, NULL);
+        print_save(&metadata, sidecar->saves[i].num_blocks);
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR sidecar_stat(PSIDECAR sidecar, const char* image_path, int argc, char** argv)
+{
+    const PSIDECAR_HEADER header = &sidecar->header;
+    unsigned int total_blocks = (header->partition_size / header->block_size) - 2;
+
+    UNUSED(image_path);
+    UNUSED(argc);
+    UNUSED(argv);
+
+    print_stat(header->layout, header->block_size >> header->skip_bytes, total_blocks, header->used_blocks, header->num_saves);
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR sidecar_extract(PSIDECAR sidecar, const char* image_path, int argc, char** argv)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned char* data = NULL;
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Sidecar_ReadSave(sidecar, image_path, argv[0], &metadata, NULL, 0, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    data = malloc(metadata.data_size ? metadata.data_size : 1);
+    if(!data)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    result = Sidecar_ReadSave(sidecar, image_path, argv[0], NULL, data, metadata.data_size, &bytes_read);
+    if(result == SLINGA_SUCCESS)
+    {
+        result = write_save(&metadata, data, bytes_read, argc, argv);
+    }
+
+    free(data);
+
+    return result;
+}
+
+//
+// archive commands
+//
+
+static SLINGA_ERROR archive_import(PARCHIVE archive, int argc, char** argv)
+{
+    ARCHIVE_STATS stats = {0};
+    unsigned int jobs = 1;
+    SLINGA_ERROR result = 0;
+
+    if(argc > 1 && strcmp(argv[0], "-j") == 0)
+    {
+        jobs = (unsigned int)strtoul(argv[1], NULL, 0);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if(argc < 1)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = Archive_Import(archive, argv, (unsigned int)argc, jobs, &stats);
+
+    printf("%u images, %u saves, %llu bytes\n", stats.images, stats.saves, stats.bytes);
+    printf("%u new objects, %llu bytes stored\n", stats.new_objects, stats.new_bytes);
+
+    if(stats.failed_images || stats.failed_saves)
+    {
+        printf("%u images and %u saves failed\n", stats.failed_images, stats.failed_saves);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return (stats.failed_images || stats.failed_saves) ? SLINGA_NOT_FOUND : SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR archive_find(PARCHIVE archive, int argc, char** argv)
+{
+    static ARCHIVE_RECORD records[256];
+    unsigned char digest[SHA256_SIZE] = {0};
+    char hex[SHA256_HEX_SIZE] = {0};
+    unsigned int records_found = 0;
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argc);
+
+    result = parse_digest(argv[0], digest);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    SHA256_ToHex(digest, hex);
+
+    result = Archive_Find(archive, digest, records, sizeof(records) / sizeof(records[0]), &records_found);
+    if(result != SLINGA_SUCCESS && result != SLINGA_BUFFER_TOO_SMALL)
+    {
+        printf("%s not in the archive\n", hex);
+        return result;
+    }
+
+    printf("%s in %u images\n", hex, records_found);
+
+    for(unsigned int i = 0; i < records_found && i < sizeof(records) / sizeof(records[0]); i++)
+    {
+        BACKUP_DATE date = {0};
+
+        Slinga_ConvertTimestampToDate(records[i].metadata.timestamp, &date);
+
+        printf("%s %-11s %-10s %u %04u-%02u-%02u %02u:%02u %7u bytes\n",
+               records[i].image,
+               records[i].metadata.savename,
+               records[i].metadata.comment,
+               records[i].metadata.language,
+               date.year + EPOCH_YEAR, date.month, date.day, date.hour, date.minute,
+               records[i].metadata.data_size);
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR archive_get(PARCHIVE archive, int argc, char** argv)
+{
+    char path[ARCHIVE_MAX_PATH] = {0};
+    unsigned char digest[SHA256_SIZE] = {0};
+    unsigned char* data = NULL;
+    unsigned int size = 0;
+    FILE* fp = NULL;
+    FILE* out = stdout;
+    SLINGA_ERROR result = 0;
+
+    if(!SHA256_FromHex(argv[0], digest))
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = Archive_GetObjectPath(archive, digest, "", path, sizeof(path));
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    fp = fopen(path, "rb");
+    if(!fp)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    result = read_stream(fp, 0xFFFFFFF, &data, &size);
+    fclose(fp);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(argc > 1 && strcmp(argv[1], "-") != 0)
+    {
+        out = fopen(argv[1], "wb");
+        if(!out)
+        {
+            free(data);
+            return SLINGA_NOT_ENOUGH_SPACE;
+        }
+    }
+
+    if(fwrite(data, 1, size, out) != size)
+    {
+        result = SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+    else
+    {
+        fflush(stdout);
+    }
+
+    free(data);
+
+    return result;
+}
+
+//
+// index commands
+//
+
+static SLINGA_ERROR index_add(PCORPUS corpus, int argc, char** argv)
+{
+    CORPUS_STATS stats = {0};
+    SLINGA_ERROR result = 0;
+
+    result = Corpus_Update(corpus, argv, (unsigned int)argc, &stats);
+
+    print_corpus_stats(&stats);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return stats.failed ? SLINGA_NOT_FOUND : SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR index_refresh(PCORPUS corpus, int argc, char** argv)
+{
+    CORPUS_STATS stats = {0};
+    SLINGA_ERROR result = 0;
+
+    UNUSED(argc);
+    UNUSED(argv);
+
+    result = Corpus_Refresh(corpus, &stats);
+
+    print_corpus_stats(&stats);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return stats.failed ? SLINGA_NOT_FOUND : SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR index_find(PCORPUS corpus, int argc, char** argv)
+{
+    CORPUS_QUERY query = {0};
+    const char* option = NULL;
+    unsigned int* matches = NULL;
+    unsigned int limit = 1000;
+    unsigned int matches_found = 0;
+    SLINGA_ERROR result = 0;
+
+    Corpus_InitQuery(&query);
+
+    query.name = find_option(argc, argv, "--name");
+    query.comment = find_option(argc, argv, "--comment");
+
+    option = find_option(argc, argv, "--size");
+    if(option && parse_range(option, &query.min_size, &query.max_size) != SLINGA_SUCCESS)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    option = find_option(argc, argv, "--timestamp");
+    if(option && parse_range(option, &query.min_timestamp, &query.max_timestamp) != SLINGA_SUCCESS)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    option = find_option(argc, argv, "--limit");
+    if(option)
+    {
+        limit = (unsigned int)strtoul(option, NULL, 0);
+    }
+
+    matches = malloc((limit + 1) * sizeof(unsigned int));
+    if(!matches)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    result = Corpus_Find(corpus, &query, matches, limit, &matches_found);
+    if(result != SLINGA_SUCCESS && result != SLINGA_BUFFER_TOO_SMALL)
+    {
+        free(matches);
+        return result;
+    }
+
+    for(unsigned int i = 0; i < matches_found && i < limit; i++)
+    {
+        const CORPUS_SAVE* save = &corpus->saves[matches[i]];
+        BACKUP_DATE date = {0};
+
+        Slinga_ConvertTimestampToDate(save->timestamp, &date);
+
+        printf("%s %-11s %-10s %u %04u-%02u-%02u %02u:%02u %7u bytes\n",
+               Corpus_GetImagePath(corpus, save->image),
+               save->savename,
+               save->comment,
+               save->language,
+               date.year + EPOCH_YEAR, date.month, date.day, date.hour, date.minute,
+               save->data_size);
+    }
+
+    if(matches_found > limit)
+    {
+        printf("... %u more, raise --limit to see them\n", matches_found - limit);
+    }
+
+    free(matches);
+
+    return SLINGA_SUCCESS;
+}
+
+//
+// helper functions
+//
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: slinga [--layout packed|interleaved] [--sidecar] IMAGE COMMAND [ARGS]\n\n");
+
+    for(unsigned int i = 0; i < NUM_COMMANDS; i++)
+    {
+        fprintf(stderr, "  %-8s %s\n", g_Commands[i].name, g_Commands[i].usage);
+    }
+
+    fprintf(stderr, "\n       slinga --archive DIR COMMAND [ARGS]\n\n");
+
+    for(unsigned int i = 0; i < NUM_ARCHIVE_COMMANDS; i++)
+    {
+        fprintf(stderr, "  %-8s %s\n", g_Archive_Commands[i].name, g_Archive_Commands[i].usage);
+    }
+
+    fprintf(stderr, "\n       slinga --index FILE COMMAND [ARGS]\n\n");
+
+    for(unsigned int i = 0; i < NUM_INDEX_COMMANDS; i++)
+    {
+        fprintf(stderr, "  %-8s %s\n", g_Index_Commands[i].name, g_Index_Commands[i].usage);
+    }
+
+    fprintf(stderr, "\n       slinga --watch [--debounce MS] DIR...\n");
+
+    fprintf(stderr, "\n\"-\" is stdin for inject and batch, stdout for extract\n");
+}
+
+static const COMMAND* find_command(const char* name)
+{
+    for(unsigned int i = 0; i < NUM_COMMANDS; i++)
+    {
+        if(strcmp(name, g_Commands[i].name) == 0)
+        {
+            return &g_Commands[i];
+        }
+    }
+
+    return NULL;
+}
+
+static SLINGA_ERROR run_command(PTOOL_CONTEXT context, int argc, char** argv)
+{
+    const COMMAND* command = find_command(argv[0]);
+
+    if(!command)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    if(argc - 1 < command->min_args)
+    {
+        fprintf(stderr, "usage: %s %s\n", command->name, command->usage);
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    return command->handler(context, argc - 1, &argv[1]);
+}
+
+static int run_archive(int argc, char** argv)
+{
+    const ARCHIVE_COMMAND* command = NULL;
+    ARCHIVE archive = {0};
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; argc > 1 && i < NUM_ARCHIVE_COMMANDS; i++)
+    {
+        if(strcmp(argv[1], g_Archive_Commands[i].name) == 0)
+        {
+            command = &g_Archive_Commands[i];
+        }
+    }
+
+    if(!command)
+    {
+        usage();
+        return 1;
+    }
+
+    if(argc - 2 < command->min_args)
+    {
+        fprintf(stderr, "usage: %s %s\n", command->name, command->usage);
+        return 1;
+    }
+
+    result = Archive_Open(&archive, argv[0]);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: can't open archive %s (0x%x)\n", argv[0], result);
+        return 1;
+    }
+
+    result = command->handler(&archive, argc - 2, &argv[2]);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: %s failed (0x%x)\n", command->name, result);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int run_index(int argc, char** argv)
+{
+    const INDEX_COMMAND* command = NULL;
+    CORPUS corpus = {0};
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; argc > 1 && i < NUM_INDEX_COMMANDS; i++)
+    {
+        if(strcmp(argv[1], g_Index_Commands[i].name) == 0)
+        {
+            command = &g_Index_Commands[i];
+        }
+    }
+
+    if(!command)
+    {
+        usage();
+        return 1;
+    }
+
+    if(argc - 2 < command->min_args)
+    {
+        fprintf(stderr, "usage: %s %s\n", command->name, command->usage);
+        return 1;
+    }
+
+    result = Corpus_Open(&corpus, argv[0]);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: can't open index %s (0x%x)\n", argv[0], result);
+        return 1;
+    }
+
+    result = command->handler(&corpus, argc - 2, &argv[2]);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: %s failed (0x%x)\n", command->name, result);
+    }
+
+    // saved even if some images failed, the ones that worked are kept
+    if(Corpus_Save(&corpus) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: can't write %s\n", argv[0]);
+        result = SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    Corpus_Close(&corpus);
+
+    return (result == SLINGA_SUCCESS) ? 0 : 1;
+}
+
+static int run_watch(int argc, char** argv)
+{
+    WATCHER watcher = {0};
+    unsigned int debounce = WATCH_DEFAULT_DEBOUNCE;
+    SLINGA_ERROR result = 0;
+
+    if(argc > 1 && strcmp(argv[0], "--debounce") == 0)
+    {
+        debounce = (unsigned int)strtoul(argv[1], NULL, 0);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if(argc < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    result = Watch_Init(&watcher, debounce, print_watch_event, NULL);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: can't start watching (0x%x)\n", result);
+        return 1;
+    }
+
+    for(int i = 0; i < argc; i++)
+    {
+        result = Watch_AddDirectory(&watcher, argv[i]);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "slinga: can't watch %s (0x%x)\n", argv[i], result);
+            Watch_Close(&watcher);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+
+    result = Watch_Run(&watcher, &g_Stop);
+
+    Watch_Close(&watcher);
+
+    return (result == SLINGA_SUCCESS) ? 0 : 1;
+}
+
+static void print_watch_event(void* context, WATCH_EVENT event, const char* image_path, const WATCH_SAVE* save)
+{
+    UNUSED(context);
+
+    printf("%s\t%s\t%s\t%u\t%u\n", Watch_GetEventName(event), image_path, save->savename, save->data_size, save->timestamp);
+
+    // consumers read the events as they happen
+    fflush(stdout);
+}
+
+static void handle_stop_signal(int signal_number)
+{
+    UNUSED(signal_number);
+
+    g_Stop = 1;
+}
+
+// returns the exit status, or -1 if the sidecar can't be used and the image must be loaded
+static int run_sidecar(const COMMAND* command, const char* image_path, IMAGE_LAYOUT layout, int argc, char** argv)
+{
+    SIDECAR sidecar = {0};
+    SLINGA_ERROR result = 0;
+
+    if(Sidecar_Read(&sidecar, image_path) != SLINGA_SUCCESS)
+    {
+        return -1;
+    }
+
+    if(layout != IMAGE_LAYOUT_UNKNOWN && layout != sidecar.header.layout)
+    {
+        Sidecar_Free(&sidecar);
+        return -1;
+    }
+
+    result = command->sidecar(&sidecar, image_path, argc, argv);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "slinga: %s failed (0x%x)\n", command->name, result);
+    }
+
+    Sidecar_Free(&sidecar);
+
+    return (result == SLINGA_SUCCESS) ? 0 : 1;
+}
+
+// an image that wasn't written only needs a sidecar if it has none or it is stale
+static SLINGA_ERROR update_sidecar(const PIMAGE image, unsigned char is_written)
+{
+    SIDECAR sidecar = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!is_written && Sidecar_Read(&sidecar, image->path) == SLINGA_SUCCESS)
+    {
+        Sidecar_Free(&sidecar);
+        return SLINGA_SUCCESS;
+    }
+
+    result = Sidecar_Build(&sidecar, image);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = Sidecar_Write(&sidecar, image->path);
+
+    Sidecar_Free(&sidecar);
+
+    return result;
+}
+
+static void print_save(const SAVE_METADATA* save, unsigned int num_blocks)
+{
+    BACKUP_DATE date = {0};
+
+    Slinga_ConvertTimestampToDate(save->timestamp, &date);
+
+    printf("%-11s %-10s %u %04u-%02u-%02u %02u:%02u %7u bytes %5u blocks\n",
+           save->savename,
+           save->comment,
+           save->language,
+           date.year + EPOCH_YEAR, date.month, date.day, date.hour, date.minute,
+           save->data_size,
+           num_blocks);
+}
+
+static void print_stat(IMAGE_LAYOUT layout, unsigned int block_size, unsigned int total_blocks, unsigned int used_blocks, unsigned int saves_found)
+{
+    if(used_blocks > total_blocks)
+    {
+        used_blocks = total_blocks;
+    }
+
+    printf("layout:       %s\n", Image_GetLayoutName(layout));
+    printf("block size:   %u\n", block_size);
+    printf("total blocks: %u\n", total_blocks);
+    printf("used blocks:  %u\n", used_blocks);
+    printf("free blocks:  %u\n", total_blocks - used_blocks);
+    printf("free bytes:   %u\n", (total_blocks - used_blocks) * block_size);
+    printf("saves:        %u\n", saves_found);
+}
+
+// extract's output: NAME [FILE|-] [--bup]
+static SLINGA_ERROR write_save(const PSAVE_METADATA metadata, const unsigned char* data, unsigned int size, int argc, char** argv)
+{
+    unsigned char header[BUP_HEADER_SIZE] = {0};
+    const char* path = (argc > 1 && strncmp(argv[1], "--", 2) != 0) ? argv[1] : "-";
+    FILE* fp = stdout;
+    SLINGA_ERROR result = SLINGA_SUCCESS;
+
+    if(strcmp(path, "-") != 0)
+    {
+        fp = fopen(path, "wb");
+        if(!fp)
+        {
+            return SLINGA_NOT_ENOUGH_SPACE;
+        }
+    }
+
+    if(has_flag(argc, argv, "--bup"))
+    {
+        bup_build_header(metadata, size, header, sizeof(header));
+
+        if(fwrite(header, 1, sizeof(header), fp) != sizeof(header))
+        {
+            result = SLINGA_NOT_ENOUGH_SPACE;
+        }
+    }
+
+    if(result == SLINGA_SUCCESS && fwrite(data, 1, size, fp) != size)
+    {
+        result = SLINGA_NOT_ENOUGH_SPACE;
+    }
+
+    if(fp != stdout)
+    {
+        fclose(fp);
+    }
+    else
+    {
+        fflush(stdout);
+    }
+
+    return result;
+}
+
+static void print_corpus_stats(const CORPUS_STATS* stats)
+{
+    printf("%u images checked, %u unchanged, %u touched, %u indexed, %u removed, %u failed\n",
+           stats->checked, stats->unchanged, stats->touched, stats->indexed, stats->removed, stats->failed);
+}
+
+// "MIN-MAX", "MIN-" or "-MAX"
+static SLINGA_ERROR parse_range(const char* text, unsigned int* min, unsigned int* max)
+{
+    const char* dash = strchr(text, '-');
+
+    if(!dash)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(dash != text)
+    {
+        *min = (unsigned int)strtoul(text, NULL, 0);
+    }
+
+    if(dash[1])
+    {
+        *max = (unsigned int)strtoul(dash + 1, NULL, 0);
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR parse_layout(const char* name, IMAGE_LAYOUT* layout)
+{
+    if(strcmp(name, "packed") == 0)
+    {
+        *layout = IMAGE_LAYOUT_PACKED;
+        return SLINGA_SUCCESS;
+    }
+
+    if(strcmp(name, "interleaved") == 0)
+    {
+        *layout = IMAGE_LAYOUT_INTERLEAVED;
+        return SLINGA_SUCCESS;
+    }
+
+    return SLINGA_INVALID_PARAMETER;
+}
+
+// a hash as printed by find, or a file (- for stdin) holding the save data
+static SLINGA_ERROR parse_digest(const char* text, unsigned char digest[SHA256_SIZE])
+{
+    unsigned char* data = NULL;
+    unsigned int size = 0;
+    FILE* fp = stdin;
+    SLINGA_ERROR result = 0;
+
+    if(SHA256_FromHex(text, digest))
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    if(strcmp(text, "-") != 0)
+    {
+        fp = fopen(text, "rb");
+        if(!fp)
+        {
+            return SLINGA_NOT_FOUND;
+        }
+    }
+
+    result = read_stream(fp, 0xFFFFFFF, &data, &size);
+
+    if(fp != stdin)
+    {
+        fclose(fp);
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    SHA256_Hash(data, size, digest);
+    free(data);
+
+    return SLINGA_SUCCESS;
+}
+
+// splits a batch line on whitespace in place, "double quotes" keep spaces in comments
+static int split_line(char* line, char** argv, int max_args)
+{
+    int argc = 0;
+    char* c = line;
+
+    while(*c)
+    {
+        while(*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+        {
+            c++;
+        }
+
+        if(!*c)
+        {
+            break;
+        }
+
+        if(argc == max_args)
+        {
+            return -1;
+        }
+
+        if(*c == '"')
+        {
+            argv[argc++] = ++c;
+
+            while(*c && *c != '"')
+            {
+                c++;
+            }
+        }
+        else
+        {
+            argv[argc++] = c;
+
+            while(*c && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+            {
+                c++;
+            }
+        }
+
+        if(*c)
+        {
+            *c++ = '\0';
+        }
+    }
+
+    return argc;
+}
+
+// value following option, NULL if it isn't there
+static const char* find_option(int argc, char** argv, const char* option)
+{
+    for(int i = 0; i < argc - 1; i++)
+    {
+        if(strcmp(argv[i], option) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+
+    return NULL;
+}
+
+static int has_flag(int argc, char** argv, const char* flag)
+{
+    for(int i = 0; i < argc; i++)
+    {
+        if(strcmp(argv[i], flag) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// reads all of fp, growing the buffer as needed. Fails if there is more than max_size
+static SLINGA_ERROR read_stream(FILE* fp, unsigned int max_size, unsigned char** buffer, unsigned int* size)
+{
+    unsigned int capacity = 0x1000;
+    unsigned int used = 0;
+    unsigned char* data = malloc(capacity);
+
+    if(!data)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    for(;;)
+    {
+        size_t count = 0;
+
+        if(used == capacity)
+        {
+            unsigned char* bigger = NULL;
+
+            if(capacity > max_size)
+            {
+                free(data);
+                return SLINGA_NOT_ENOUGH_SPACE;
+            }
+
+            capacity *= 2;
+            bigger = realloc(data, capacity);
+            if(!bigger)
+            {
+                free(data);
+                return SLINGA_BUFFER_TOO_SMALL;
+            }
+
+            data = bigger;
+        }
+
+        count = fread(data + used, 1, capacity - used, fp);
+        used += count;
+
+        if(count == 0)
+        {
+            break;
+        }
+    }
+
+    if(ferror(fp) || used > max_size || used == 0)
+    {
+        free(data);
+        return used ? SLINGA_NOT_ENOUGH_SPACE : SLINGA_INVALID_PARAMETER;
+    }
+
+    *buffer = data;
+    *size = used;
+
+    return SLINGA_SUCCESS;
+}
@@ -0,0 +1,654 @@
+/** @file watch.c
+ *
+ *  @author Slinga
+ *  @brief Follows image directories and reports changed saves
+ *  @bug No known bugs.
+ */
+#include "watch.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE)
+
+static SLINGA_ERROR scan_directory(PWATCHER watcher, const char* directory, int is_baseline);
+static SLINGA_ERROR read_events(PWATCHER watcher);
+static SLINGA_ERROR mark_pending(PWATCHER watcher, const char* path);
+static void process_due(PWATCHER watcher, long long now);
+static int process_image(PWATCHER watcher, unsigned int index, int is_baseline);
+static SLINGA_ERROR read_saves(const char* path, PWATCH_SAVE* saves, unsigned int* num_saves);
+static void diff_saves(PWATCHER watcher, const WATCH_IMAGE* entry, const WATCH_SAVE* saves, unsigned int num_saves);
+static const WATCH_SAVE* find_save(const WATCH_SAVE* saves, unsigned int num_saves, const char* savename);
+static int find_image(const PWATCHER watcher, const char* path, unsigned int* index);
+static SLINGA_ERROR insert_image(PWATCHER watcher, const char* path, unsigned int index);
+static void remove_image(PWATCHER watcher, unsigned int index);
+static long long now_ms(void);
+
+/**
+ * @brief Start a watcher with nothing watched
+ *
+ * @param[out] watcher Watcher on success, release with Watch_Close()
+ * @param[in] debounce Milliseconds a file must be quiet before it is parsed
+ * @param[in] callback Called for every save that changed
+ * @param[in] context Passed to callback
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Watch_Init(PWATCHER watcher, unsigned int debounce, WATCH_CALLBACK callback, void* context)
+{
+    if(!watcher || !callback)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    memset(watcher, 0, sizeof(WATCHER));
+
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watcher->fd < 0)
+    {
+        return SLINGA_NOT_SUPPORTED;
+    }
+
+    watcher->debounce = debounce;
+    watcher->callback = callback;
+    watcher->context = context;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Watch a directory. The images already in it are parsed now, without reporting their saves
+ *
+ * @param[in] watcher Watcher
+ * @param[in] path Directory
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Watch_AddDirectory(PWATCHER watcher, const char* path)
+{
+    char full_path[PATH_MAX] = {0};
+    PWATCH_DIRECTORY directories = NULL;
+    int wd = 0;
+
+    if(!watcher || !path)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(!realpath(path, full_path))
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    // watch first so nothing written during the scan is missed
+    wd = inotify_add_watch(watcher->fd, full_path, WATCH_MASK | IN_ONLYDIR);
+    if(wd < 0)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    directories = realloc(watcher->directories, (watcher->num_directories + 1) * sizeof(WATCH_DIRECTORY));
+    if(!directories)
+    {
+        inotify_rm_watch(watcher->fd, wd);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    watcher->directories = directories;
+    directories[watcher->num_directories].wd = wd;
+    directories[watcher->num_directories].path = strdup(full_path);
+
+    if(!directories[watcher->num_directories].path)
+    {
+        inotify_rm_watch(watcher->fd, wd);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    watcher->num_directories++;
+
+    return scan_directory(watcher, full_path, 1);
+}
+
+/**
+ * @brief Report changes until stop is set, from a signal handler for example
+ *
+ * @param[in] watcher Watcher
+ * @param[in] stop Checked before every wait
+ *
+ * @return SLINGA_SUCCESS once stop is set
+ */
+SLINGA_ERROR Watch_Run(PWATCHER watcher, volatile int* stop)
+{
+    struct pollfd pfd = {0};
+    SLINGA_ERROR result = 0;
+
+    if(!watcher || !stop)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    pfd.fd = watcher->fd;
+    pfd.events = POLLIN;
+
+    while(!*stop)
+    {
+        long long now = now_ms();
+        long long next_deadline = 0;
+        int timeout = -1;
+        int ready = 0;
+
+        // sleep until the next image is due, or forever if none is
+        for(unsigned int i = 0; watcher->num_pending && i < watcher->num_images; i++)
+        {
+            long long deadline = watcher->images[i].deadline;
+
+            if(deadline && (!next_deadline || deadline < next_deadline))
+            {
+                next_deadline = deadline;
+            }
+        }
+
+        if(next_deadline)
+        {
+            timeout = (next_deadline > now) ? (int)(next_deadline - now) : 0;
+        }
+
+        ready = poll(&pfd, 1, timeout);
+        if(ready < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            return SLINGA_NOT_SUPPORTED;
+        }
+
+        if(ready > 0)
+        {
+            result = read_events(watcher);
+            if(result != SLINGA_SUCCESS)
+            {
+                return result;
+            }
+        }
+
+        if(watcher->num_pending)
+        {
+            process_due(watcher, now_ms());
+        }
+    }
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Stop watching and release everything
+ *
+ * @param[in] watcher Watcher
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR Watch_Close(PWATCHER watcher)
+{
+    if(!watcher)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    if(watcher->fd >= 0)
+    {
+        close(watcher->fd);
+    }
+
+    for(unsigned int i = 0; i < watcher->num_directories; i++)
+    {
+        free(watcher->directories[i].path);
+    }
+
+    for(unsigned int i = 0; i < watcher->num_images; i++)
+    {
+        free(watcher->images[i].path);
+        free(watcher->images[i].saves);
+    }
+
+    free(watcher->directories);
+    free(watcher->images);
+
+    memset(watcher, 0, sizeof(WATCHER));
+    watcher->fd = -1;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Printable name of an event
+ *
+ * @param[in] event Event
+ *
+ * @return "added", "modified" or "deleted"
+ */
+const char* Watch_GetEventName(WATCH_EVENT event)
+{
+    switch(event)
+    {
+        case WATCH_SAVE_ADDED:
+            return "added";
+        case WATCH_SAVE_MODIFIED:
+            return "modified";
+        case WATCH_SAVE_DELETED:
+            return "deleted";
+    }
+
+    return "unknown";
+}
+
+//
+// helper functions
+//
+
+// the baseline parses every file now, later scans only mark them pending
+static SLINGA_ERROR scan_directory(PWATCHER watcher, const char* directory, int is_baseline)
+{
+    char path[PATH_MAX] = {0};
+    struct dirent* entry = NULL;
+    DIR* dir = opendir(directory);
+    SLINGA_ERROR result = SLINGA_SUCCESS;
+
+    if(!dir)
+    {
+        return SLINGA_NOT_FOUND;
+    }
+
+    while(result == SLINGA_SUCCESS && (entry = readdir(dir)) != NULL)
+    {
+        struct stat st;
+        unsigned int index = 0;
+
+        if(entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+
+        if(stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            continue;
+        }
+
+        if(!is_baseline)
+        {
+            result = mark_pending(watcher, path);
+            continue;
+        }
+
+        if(find_image(watcher, path, &index))
+        {
+            continue;
+        }
+
+        result = insert_image(watcher, path, index);
+        if(result == SLINGA_SUCCESS)
+        {
+            process_image(watcher, index, 1);
+        }
+    }
+
+    closedir(dir);
+
+    return result;
+}
+
+static SLINGA_ERROR read_events(PWATCHER watcher)
+{
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[PATH_MAX] = {0};
+    ssize_t length = 0;
+    SLINGA_ERROR result = 0;
+
+    for(;;)
+    {
+        length = read(watcher->fd, buffer, sizeof(buffer));
+        if(length < 0)
+        {
+            return (errno == EAGAIN || errno == EINTR) ? SLINGA_SUCCESS : SLINGA_NOT_SUPPORTED;
+        }
+
+        for(char* c = buffer; c < buffer + length; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)c;
+
+            c += sizeof(struct inotify_event) + event->len;
+
+            // events were dropped, so anything may have changed
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                for(unsigned int i = 0; i < watcher->num_images; i++)
+                {
+                    mark_pending(watcher, watcher->images[i].path);
+                }
+
+                for(unsigned int i = 0; i < watcher->num_directories; i++)
+                {
+                    scan_directory(watcher, watcher->directories[i].path, 0);
+                }
+
+                continue;
+            }
+
+            if(!event->len || event->name[0] == '.' || (event->mask & IN_ISDIR))
+            {
+                continue;
+            }
+
+            for(unsigned int i = 0; i < watcher->num_directories; i++)
+            {
+                if(watcher->directories[i].wd == event->wd)
+                {
+                    snprintf(path, sizeof(path), "%s/%s", watcher->directories[i].path, event->name);
+
+                    result = mark_pending(watcher, path);
+                    if(result != SLINGA_SUCCESS)
+                    {
+                        return result;
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// every event pushes the deadline back, so a burst of writes is parsed once
+static SLINGA_ERROR mark_pending(PWATCHER watcher, const char* path)
+{
+    unsigned int index = 0;
+    SLINGA_ERROR result = 0;
+
+    if(!find_image(watcher, path, &index))
+    {
+        result = insert_image(watcher, path, index);
+        if(result != SLINGA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    if(!watcher->images[index].deadline)
+    {
+        watcher->num_pending++;
+    }
+
+    watcher->images[index].deadline = now_ms() + watcher->debounce;
+
+    return SLINGA_SUCCESS;
+}
+
+static void process_due(PWATCHER watcher, long long now)
+{
+    unsigned int i = 0;
+
+    while(watcher->num_pending && i < watcher->num_images)
+    {
+        if(!watcher->images[i].deadline || watcher->images[i].deadline > now)
+        {
+            i++;
+            continue;
+        }
+
+        watcher->images[i].deadline = 0;
+        watcher->num_pending--;
+
+        // the entry is gone if the file was deleted or isn't an image
+        if(process_image(watcher, i, 0))
+        {
+            i++;
+        }
+    }
+}
+
+// returns 0 if the entry was removed. An image new since the baseline reports all its saves as added
+static int process_image(PWATCHER watcher, unsigned int index, int is_baseline)
+{
+    PWATCH_IMAGE entry = &watcher->images[index];
+    PWATCH_SAVE saves = NULL;
+    unsigned int num_saves = 0;
+    struct stat st;
+
+    if(stat(entry->path, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        for(unsigned int i = 0; entry->is_image && i < entry->num_saves; i++)
+        {
+            watcher->callback(watcher->context, WATCH_SAVE_DELETED, entry->path, &entry->saves[i]);
+        }
+
+        remove_image(watcher, index);
+        return 0;
+    }
+
+    // half written, or not an image at all
+    if(read_saves(entry->path, &saves, &num_saves) != SLINGA_SUCCESS)
+    {
+        if(!entry->is_image)
+        {
+            remove_image(watcher, index);
+            return 0;
+        }
+
+        return 1;
+    }
+
+    if(!is_baseline)
+    {
+        diff_saves(watcher, entry, saves, num_saves);
+    }
+
+    free(entry->saves);
+    entry->saves = saves;
+    entry->num_saves = num_saves;
+    entry->is_image = 1;
+
+    return 1;
+}
+
+static SLINGA_ERROR read_saves(const char* path, PWATCH_SAVE* saves, unsigned int* num_saves)
+{
+    static SAVE_METADATA metadata[MAX_SAVES];
+    PWATCH_SAVE result_saves = NULL;
+    unsigned char* data = NULL;
+    unsigned int saves_found = 0;
+    IMAGE image = {0};
+    SLINGA_ERROR result = 0;
+
+    result = Image_Open(&image, path, IMAGE_LAYOUT_UNKNOWN);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    result = sat_list_saves(&image.partition_info, metadata, MAX_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS)
+    {
+        Image_Close(&image);
+        return result;
+    }
+
+    result_saves = calloc(saves_found + 1, sizeof(WATCH_SAVE));
+    data = malloc(image.size);
+    if(!result_saves || !data)
+    {
+        free(result_saves);
+        free(data);
+        Image_Close(&image);
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    for(unsigned int i = 0; i < saves_found; i++)
+    {
+        unsigned int bytes_read = 0;
+
+        result = sat_read(metadata[i].savename, data, metadata[i].data_size, &bytes_read, &image.partition_info);
+        if(result != SLINGA_SUCCESS)
+        {
+            break;
+        }
+
+        memcpy(result_saves[i].savename, metadata[i].savename, MAX_SAVENAME);
+        memcpy(result_saves[i].comment, metadata[i].comment, MAX_COMMENT);
+        result_saves[i].language = metadata[i].language;
+        result_saves[i].timestamp = metadata[i].timestamp;
+        result_saves[i].data_size = metadata[i].data_size;
+        SHA256_Hash(data, bytes_read, result_saves[i].digest);
+    }
+
+    free(data);
+    Image_Close(&image);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        free(result_saves);
+        return result;
+    }
+
+    *saves = result_saves;
+    *num_saves = saves_found;
+
+    return SLINGA_SUCCESS;
+}
+
+static void diff_saves(PWATCHER watcher, const WATCH_IMAGE* entry, const WATCH_SAVE* saves, unsigned int num_saves)
+{
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        const WATCH_SAVE* old_save = find_save(entry->saves, entry->num_saves, saves[i].savename);
+
+        if(!old_save)
+        {
+            watcher->callback(watcher->context, WATCH_SAVE_ADDED, entry->path, &saves[i]);
+        }
+        else if(memcmp(old_save, &saves[i], sizeof(WATCH_SAVE)) != 0)
+        {
+            watcher->callback(watcher->context, WATCH_SAVE_MODIFIED, entry->path, &saves[i]);
+        }
+    }
+
+    for(unsigned int i = 0; i < entry->num_saves; i++)
+    {
+        if(!find_save(saves, num_saves, entry->saves[i].savename))
+        {
+            watcher->callback(watcher->context, WATCH_SAVE_DELETED, entry->path, &entry->saves[i]);
+        }
+    }
+}
+
+// at most MAX_SAVES per image, a linear search is fine
+static const WATCH_SAVE* find_save(const WATCH_SAVE* saves, unsigned int num_saves, const char* savename)
+{
+    for(unsigned int i = 0; i < num_saves; i++)
+    {
+        if(strcmp(saves[i].savename, savename) == 0)
+        {
+            return &saves[i];
+        }
+    }
+
+    return NULL;
+}
+
+// binary search, index is where path is or would be inserted
+static int find_image(const PWATCHER watcher, const char* path, unsigned int* index)
+{
+    unsigned int low = 0;
+    unsigned int high = watcher->num_images;
+
+    while(low < high)
+    {
+        unsigned int middle = low + ((high - low) / 2);
+        int result = strcmp(watcher->images[middle].path, path);
+
+        if(result == 0)
+        {
+            *index = middle;
+            return 1;
+        }
+
+        if(result < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    *index = low;
+
+    return 0;
+}
+
+static SLINGA_ERROR insert_image(PWATCHER watcher, const char* path, unsigned int index)
+{
+    char* copy = NULL;
+
+    if(watcher->num_images == watcher->images_capacity)
+    {
+        unsigned int capacity = watcher->images_capacity ? watcher->images_capacity * 2 : 64;
+        PWATCH_IMAGE images = realloc(watcher->images, capacity * sizeof(WATCH_IMAGE));
+
+        if(!images)
+        {
+            return SLINGA_BUFFER_TOO_SMALL;
+        }
+
+        watcher->images = images;
+        watcher->images_capacity = capacity;
+    }
+
+    copy = strdup(path);
+    if(!copy)
+    {
+        return SLINGA_BUFFER_TOO_SMALL;
+    }
+
+    memmove(&watcher->images[index + 1], &watcher->images[index], (watcher->num_images - index) * sizeof(WATCH_IMAGE));
+    memset(&watcher->images[index], 0, sizeof(WATCH_IMAGE));
+    watcher->images[index].path = copy;
+    watcher->num_images++;
+
+    return SLINGA_SUCCESS;
+}
+
+static void remove_image(PWATCHER watcher, unsigned int index)
+{
+    if(watcher->images[index].deadline)
+    {
+        watcher->num_pending--;
+    }
+
+    free(watcher->images[index].path);
+    free(watcher->images[index].saves);
+
+    memmove(&watcher->images[index], &watcher->images[index + 1], (watcher->num_images - index - 1) * sizeof(WATCH_IMAGE));
+    watcher->num_images--;
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
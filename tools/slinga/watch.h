@@ -0,0 +1,84 @@
+/** @file watch.h
+ *
+ *  @author Slinga
+ *  @brief Follows image directories and reports changed saves
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "image.h"
+#include "sha256.h"
+
+//
+// The watcher remembers the save directory of every image in the watched
+// directories. inotify says which files were written, renamed or deleted;
+// each one is parsed again once it has been quiet for the debounce time,
+// so a burst of writes to one file costs one parse. The new directory is
+// diffed against the old one and every save that appeared, changed or went
+// away is reported. Files that aren't images are ignored, and an image
+// that can't be parsed mid write keeps its old directory until it can.
+//
+// Directories are not watched recursively.
+//
+
+#define WATCH_DEFAULT_DEBOUNCE  250     ///< @brief Milliseconds a file must be quiet before it is parsed
+
+/** @brief What happened to a save */
+typedef enum
+{
+    WATCH_SAVE_ADDED = 0,           ///< @brief Save is new
+    WATCH_SAVE_MODIFIED = 1,        ///< @brief Save data or metadata changed
+    WATCH_SAVE_DELETED = 2,         ///< @brief Save or its whole image is gone
+} WATCH_EVENT;
+
+/** @brief A save as last seen */
+typedef struct _WATCH_SAVE
+{
+    char savename[MAX_SAVENAME + 1];        ///< @brief Save name
+    char comment[MAX_COMMENT + 1];          ///< @brief Save comment
+    unsigned char language;                 ///< @brief Save language
+    unsigned int timestamp;                 ///< @brief Save timestamp
+    unsigned int data_size;                 ///< @brief Save size in bytes
+    unsigned char digest[SHA256_SIZE];      ///< @brief SHA-256 of the save data
+} WATCH_SAVE, *PWATCH_SAVE;
+
+typedef void (*WATCH_CALLBACK)(void* context, WATCH_EVENT event, const char* image_path, const WATCH_SAVE* save);
+
+/** @brief An image being followed */
+typedef struct _WATCH_IMAGE
+{
+    char* path;                     ///< @brief Path of the image
+    PWATCH_SAVE saves;              ///< @brief Directory when last parsed
+    unsigned int num_saves;         ///< @brief Entries in saves
+    long long deadline;             ///< @brief When to parse the image, 0 if nothing is pending
+    unsigned char is_image;         ///< @brief Parsed at least once, saves is valid
+} WATCH_IMAGE, *PWATCH_IMAGE;
+
+/** @brief A watched directory */
+typedef struct _WATCH_DIRECTORY
+{
+    int wd;                         ///< @brief inotify watch descriptor
+    char* path;                     ///< @brief Directory
+} WATCH_DIRECTORY, *PWATCH_DIRECTORY;
+
+/** @brief Watcher state */
+typedef struct _WATCHER
+{
+    int fd;                         ///< @brief inotify descriptor
+    unsigned int debounce;          ///< @brief Milliseconds a file must be quiet before it is parsed
+    WATCH_CALLBACK callback;        ///< @brief Called for every save that changed
+    void* context;                  ///< @brief Passed to callback
+    PWATCH_DIRECTORY directories;   ///< @brief Watched directories
+    unsigned int num_directories;   ///< @brief Entries in directories
+    PWATCH_IMAGE images;            ///< @brief Known files, sorted by path
+    unsigned int num_images;        ///< @brief Entries in images
+    unsigned int images_capacity;   ///< @brief Entries allocated for images
+    unsigned int num_pending;       ///< @brief Images waiting for their deadline
+} WATCHER, *PWATCHER;
+
+SLINGA_ERROR Watch_Init(PWATCHER watcher, unsigned int debounce, WATCH_CALLBACK callback, void* context);
+SLINGA_ERROR Watch_AddDirectory(PWATCHER watcher, const char* path);
+SLINGA_ERROR Watch_Run(PWATCHER watcher, volatile int* stop);
+SLINGA_ERROR Watch_Close(PWATCHER watcher);
+
+const char* Watch_GetEventName(WATCH_EVENT event);
@@ -0,0 +1,275 @@
+/** @file bundle_test.c
+ *
+ *  @author Slinga
+ *  @brief Host tests for the RAM device's save bundle
+ *  @bug No known bugs.
+ */
+#include "../../devices/ram.h"
+#include "../../devices/saturn.h"
+#include "host_sat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// bundle_test
+//
+// Dumps a SAT partition shaped like internal memory into a bundle and
+// restores it to a blank partition, then checks that overwriting saves at
+// the very end of an oddly sized region stays inside the region. Exits
+// non-zero on the first failure.
+//
+
+#define REGION_SIZE         (64 * 1024)
+#define ODD_REGION_SIZE     10002
+#define GUARD_SIZE          16
+#define GUARD_BYTE          0xA5
+
+/** @brief A save written to the partition before dumping it */
+typedef struct _TEST_SAVE
+{
+    const char* name;
+    unsigned int size;
+    unsigned int seed;
+} TEST_SAVE;
+
+static const TEST_SAVE g_Saves[] =
+{
+    {"GAME_01", 5, 1},
+    {"GAME_02", 1000, 2},
+    {"GAME_03", 3000, 3},
+    {"GAME_04", 64, 4},
+    {"GAME_05", 2047, 5},
+};
+
+#define NUM_SAVES (sizeof(g_Saves) / sizeof(g_Saves[0]))
+
+static unsigned char g_Partition[INTERNAL_MEMORY_SIZE];
+static unsigned char g_Region[REGION_SIZE + GUARD_SIZE];
+static unsigned char g_Data[MAX_SAVE_SIZE];
+static unsigned char g_Expected[MAX_SAVE_SIZE];
+
+static int test_dump_restore(void);
+static int test_odd_region(void);
+static int write_save(DEVICE_TYPE device_type, FLAGS flags, const char* name, unsigned int size, unsigned int seed);
+static int check_save(DEVICE_TYPE device_type, const char* name, unsigned int size, unsigned int seed);
+static int check_guard(unsigned int region_size);
+static void fill_data(unsigned char* data, unsigned int size, unsigned int seed);
+
+int main(int argc, char** argv)
+{
+    UNUSED(argv);
+
+    if(argc > 1)
+    {
+        fprintf(stderr, "usage: bundle_test\n");
+        return 2;
+    }
+
+    Slinga_Init();
+
+    if(test_dump_restore() || test_odd_region())
+    {
+        return 1;
+    }
+
+    printf("bundle: all tests passed\n");
+
+    return 0;
+}
+
+/**
+ * @brief Dump internal memory into a bundle and restore it to a blank partition
+ */
+static int test_dump_restore(void)
+{
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    memset(g_Partition, 0, sizeof(g_Partition));
+    HostSat_Attach(DEVICE_INTERNAL, g_Partition, sizeof(g_Partition), INTERNAL_MEMORY_BLOCK_SIZE, INTERNAL_MEMORY_SKIP_BYTES);
+
+    if(Slinga_Format(DEVICE_INTERNAL) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "formatting the partition failed\n");
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        if(write_save(DEVICE_INTERNAL, 0, g_Saves[i].name, g_Saves[i].size, g_Saves[i].seed))
+        {
+            return 1;
+        }
+    }
+
+    // every save is far smaller than the region, SAT reads need the exact size
+    memset(g_Region, GUARD_BYTE, sizeof(g_Region));
+    RAM_SetRegion(g_Region, REGION_SIZE);
+
+    result = RAM_DumpDevice(DEVICE_INTERNAL);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "dump failed %d\n", result);
+        return 1;
+    }
+
+    if(Slinga_List(DEVICE_RAM, 0, NULL, 0, &saves_found) != SLINGA_SUCCESS || saves_found != NUM_SAVES)
+    {
+        fprintf(stderr, "bundle has %u saves, expected %u\n", saves_found, (unsigned int)NUM_SAVES);
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        if(check_save(DEVICE_RAM, g_Saves[i].name, g_Saves[i].size, g_Saves[i].seed))
+        {
+            return 1;
+        }
+    }
+
+    // restore to a blank partition
+    memset(g_Partition, 0, sizeof(g_Partition));
+    HostSat_Attach(DEVICE_INTERNAL, g_Partition, sizeof(g_Partition), INTERNAL_MEMORY_BLOCK_SIZE, INTERNAL_MEMORY_SKIP_BYTES);
+    Slinga_Format(DEVICE_INTERNAL);
+
+    result = RAM_RestoreDevice(DEVICE_INTERNAL, 0);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "restore failed %d\n", result);
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        if(check_save(DEVICE_INTERNAL, g_Saves[i].name, g_Saves[i].size, g_Saves[i].seed))
+        {
+            return 1;
+        }
+    }
+
+    // a region too small for everything fails instead of writing past it
+    memset(g_Region, GUARD_BYTE, sizeof(g_Region));
+    RAM_SetRegion(g_Region, 4096);
+
+    result = RAM_DumpDevice(DEVICE_INTERNAL);
+    if(result != SLINGA_NOT_ENOUGH_SPACE || check_guard(4096))
+    {
+        fprintf(stderr, "dump into a small region gave %d\n", result);
+        return 1;
+    }
+
+    HostSat_Detach();
+    RAM_SetRegion(NULL, 0);
+
+    return 0;
+}
+
+/**
+ * @brief The last save's padding is cut off at the end of a region that isn't 4-byte aligned
+ */
+static int test_odd_region(void)
+{
+    SLINGA_ERROR result = 0;
+
+    memset(g_Region, GUARD_BYTE, sizeof(g_Region));
+    RAM_SetRegion(g_Region, ODD_REGION_SIZE);
+    Slinga_Format(DEVICE_RAM);
+
+    if(write_save(DEVICE_RAM, 0, "B", 1012, 1) || write_save(DEVICE_RAM, 0, "A", 5, 2))
+    {
+        return 1;
+    }
+
+    // fill the region up to its last byte
+    for(unsigned int size = 6; ; size++)
+    {
+        fill_data(g_Data, size, 3);
+
+        result = Slinga_Write(DEVICE_RAM, OVERWRITE_EXISTING_SAVE, "A", &(SAVE_METADATA){.savename = "A"}, g_Data, size);
+        if(check_guard(ODD_REGION_SIZE))
+        {
+            fprintf(stderr, "overwriting with %u bytes wrote past the region\n", size);
+            return 1;
+        }
+
+        if(result == SLINGA_NOT_ENOUGH_SPACE)
+        {
+            // the old save must survive a write that doesn't fit
+            if(check_save(DEVICE_RAM, "A", size - 1, 3) || check_save(DEVICE_RAM, "B", 1012, 1))
+            {
+                return 1;
+            }
+
+            break;
+        }
+
+        if(result != SLINGA_SUCCESS || check_save(DEVICE_RAM, "A", size, 3))
+        {
+            fprintf(stderr, "overwriting with %u bytes failed %d\n", size, result);
+            return 1;
+        }
+    }
+
+    RAM_SetRegion(NULL, 0);
+
+    return 0;
+}
+
+static int write_save(DEVICE_TYPE device_type, FLAGS flags, const char* name, unsigned int size, unsigned int seed)
+{
+    SAVE_METADATA metadata = {0};
+    SLINGA_ERROR result = 0;
+
+    strncpy(metadata.savename, name, sizeof(metadata.savename) - 1);
+    fill_data(g_Data, size, seed);
+
+    result = Slinga_Write(device_type, flags, name, &metadata, g_Data, size);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "writing %s (%u bytes) failed %d\n", name, size, result);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_save(DEVICE_TYPE device_type, const char* name, unsigned int size, unsigned int seed)
+{
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
+
+    fill_data(g_Expected, size, seed);
+    memset(g_Data, 0, size);
+
+    result = Slinga_Read(device_type, 0, name, g_Data, size, &bytes_read);
+    if(result != SLINGA_SUCCESS || bytes_read != size || memcmp(g_Data, g_Expected, size) != 0)
+    {
+        fprintf(stderr, "%s on device %d doesn't match (%d, %u bytes)\n", name, device_type, result, bytes_read);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_guard(unsigned int region_size)
+{
+    for(unsigned int i = region_size; i < region_size + GUARD_SIZE; i++)
+    {
+        if(g_Region[i] != GUARD_BYTE)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void fill_data(unsigned char* data, unsigned int size, unsigned int seed)
+{
+    for(unsigned int i = 0; i < size; i++)
+    {
+        data[i] = (unsigned char)((i * 31) + (seed * 17) + (i >> 8));
+    }
+}
@@ -0,0 +1,537 @@
+/** @file cd_test.c
+ *
+ *  @author Slinga
+ *  @brief Runs DEVICE_CD against generated ISO9660 images
+ *  @bug No known bugs.
+ */
+#include "../../devices/cd/cd.h"
+#include "../../devices/cd/cd_image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//
+// cd_test
+//
+// Builds a small ISO9660 image with a SATSAVES directory and writes it out
+// both cooked (.iso) and raw mode 1 (.bin). Each image is opened with
+// CD_Image_Open(), then the saves are listed, paged through and read back.
+// The sector counters are checked so read-ahead is measured: listing sweeps
+// the headers in CD_READ_AHEAD_SECTORS runs, a listing page only reads what
+// it needs, neighbouring saves are read from the window and a large save
+// goes straight into the caller's buffer. Exits non-zero on the first failure.
+//
+
+#define NUM_SAVES       40
+#define PAGE_LEN        16
+#define BIG_SAVE_SIZE   40000   ///< @brief The last save, larger than the read-ahead window
+#define MAX_SECTORS     96
+
+#define PVD_LBA         CD_PVD_LBA
+#define TERMINATOR_LBA  (PVD_LBA + 1)
+#define ROOT_LBA        (PVD_LBA + 2)
+#define SAVES_LBA       (PVD_LBA + 3)
+#define FIRST_FILE_LBA  (PVD_LBA + 4)
+
+/** @brief A file in the generated SATSAVES directory */
+typedef struct _TEST_FILE
+{
+    char name[MAX_FILENAME + 1];    ///< @brief ISO9660 name, with the ";1" version
+    unsigned int lba;               ///< @brief First sector
+    unsigned int size;              ///< @brief Size in bytes
+} TEST_FILE, *PTEST_FILE;
+
+static unsigned char g_Image[MAX_SECTORS * CD_SECTOR_SIZE];
+static unsigned int g_Image_Sectors;
+static TEST_FILE g_Files[NUM_SAVES + 2];
+static unsigned int g_Num_Files;
+static char g_Names[NUM_SAVES][MAX_SAVENAME];
+static unsigned char g_Data[NUM_SAVES][BIG_SAVE_SIZE];
+static unsigned char g_Read[BIG_SAVE_SIZE + 1];
+static SAVE_METADATA g_Saves[NUM_SAVES];
+static SAVE_METADATA g_Page[PAGE_LEN];
+
+static int build_image(void);
+static int write_image(char* path, unsigned int raw);
+static int run_image(const char* path, const char* type);
+static int test_list(void);
+static int test_list_page(void);
+static int test_read(void);
+static unsigned int add_file(const char* name, const unsigned char* header, const unsigned char* data, unsigned int size);
+static unsigned int put_record(unsigned char* dst, unsigned int lba, unsigned int size, unsigned char flags, const char* name);
+static void put_both32(unsigned char* dst, unsigned int value);
+static void put_both16(unsigned char* dst, unsigned int value);
+static unsigned int save_size(unsigned int index);
+
+int main(int argc, char** argv)
+{
+    char iso_path[64] = "/tmp/cd_test.XXXXXX";
+    char bin_path[64] = "/tmp/cd_test.XXXXXX";
+    int failed = 0;
+
+    UNUSED(argv);
+
+    if(argc > 1)
+    {
+        fprintf(stderr, "usage: cd_test\n");
+        return 2;
+    }
+
+    if(build_image() || write_image(iso_path, 0) || write_image(bin_path, 1))
+    {
+        return 1;
+    }
+
+    Slinga_Init();
+
+    failed = run_image(iso_path, "iso") || run_image(bin_path, "bin");
+
+    unlink(iso_path);
+    unlink(bin_path);
+
+    if(failed)
+    {
+        return 1;
+    }
+
+    printf("cd: all tests passed\n");
+
+    return 0;
+}
+
+/**
+ * @brief Lay out the volume descriptors, directories and saves in g_Image
+ */
+static int build_image(void)
+{
+    unsigned char header[BUP_HEADER_SIZE] = {0};
+    unsigned char* pvd = g_Image + PVD_LBA * CD_SECTOR_SIZE;
+    unsigned char* terminator = g_Image + TERMINATOR_LBA * CD_SECTOR_SIZE;
+    unsigned char* root = g_Image + ROOT_LBA * CD_SECTOR_SIZE;
+    unsigned char* saves = g_Image + SAVES_LBA * CD_SECTOR_SIZE;
+    unsigned int pos = 0;
+
+    memset(g_Image, 0, sizeof(g_Image));
+    g_Image_Sectors = FIRST_FILE_LBA;
+    g_Num_Files = 0;
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        SAVE_METADATA metadata = {0};
+        unsigned int size = save_size(i);
+        char name[MAX_FILENAME + 1] = {0};
+
+        snprintf(g_Names[i], sizeof(g_Names[i]), "GAME_%02u", i);
+        for(unsigned int j = 0; j < size; j++)
+        {
+            g_Data[i][j] = (unsigned char)((j / 64) * 13 + i);
+        }
+
+        Slinga_SetSaveMetadata(&metadata, g_Names[i], g_Names[i], "Slot", 0, 0x1000 + i, size);
+        if(bup_build_header(&metadata, size, header, sizeof(header)) != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "can't build the header of %s\n", g_Names[i]);
+            return 1;
+        }
+
+        snprintf(name, sizeof(name), "GAME_%02u.BUP;1", i);
+        if(!add_file(name, header, g_Data[i], size))
+        {
+            return 1;
+        }
+    }
+
+    // a .BUP that isn't a save and a file that isn't a .BUP, both skipped
+    memset(header, 0, sizeof(header));
+    if(!add_file("JUNK.BUP;1", header, g_Data[0], 16) || !add_file("README.TXT;1", NULL, g_Data[0], 16))
+    {
+        return 1;
+    }
+
+    // root directory holds SATSAVES
+    pos = put_record(root, ROOT_LBA, CD_SECTOR_SIZE, 0x02, "\0");
+    pos += put_record(root + pos, ROOT_LBA, CD_SECTOR_SIZE, 0x02, "\1");
+    put_record(root + pos, SAVES_LBA, CD_SECTOR_SIZE, 0x02, SAVES_DIRECTORY);
+
+    pos = put_record(saves, SAVES_LBA, CD_SECTOR_SIZE, 0x02, "\0");
+    pos += put_record(saves + pos, ROOT_LBA, CD_SECTOR_SIZE, 0x02, "\1");
+
+    for(unsigned int i = 0; i < g_Num_Files; i++)
+    {
+        pos += put_record(saves + pos, g_Files[i].lba, g_Files[i].size, 0, g_Files[i].name);
+        if(pos > CD_SECTOR_SIZE)
+        {
+            fprintf(stderr, "SATSAVES doesn't fit in a sector\n");
+            return 1;
+        }
+    }
+
+    pvd[0] = 1;
+    memcpy(pvd + 1, "CD001", 5);
+    pvd[6] = 1;
+    put_both32(pvd + 80, g_Image_Sectors);
+    put_both16(pvd + 120, 1);
+    put_both16(pvd + 124, 1);
+    put_both16(pvd + 128, CD_SECTOR_SIZE);
+    put_record(pvd + 156, ROOT_LBA, CD_SECTOR_SIZE, 0x02, "\0");
+
+    terminator[0] = 255;
+    memcpy(terminator + 1, "CD001", 5);
+    terminator[6] = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Write g_Image to a new temporary file, cooked or as raw mode 1 sectors
+ */
+static int write_image(char* path, unsigned int raw)
+{
+    static const unsigned char sync[12] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+    FILE* fp = NULL;
+    int fd = 0;
+    int failed = 0;
+
+    fd = mkstemp(path);
+    if(fd < 0 || !(fp = fdopen(fd, "wb")))
+    {
+        fprintf(stderr, "can't create %s\n", path);
+        return 1;
+    }
+
+    if(!raw)
+    {
+        failed = fwrite(g_Image, CD_SECTOR_SIZE, g_Image_Sectors, fp) != g_Image_Sectors;
+    }
+
+    for(unsigned int i = 0; raw && i < g_Image_Sectors && !failed; i++)
+    {
+        unsigned char sector[CD_RAW_SECTOR_SIZE] = {0};
+        unsigned int frame = i + 150;
+
+        // sync, BCD minute\second\frame, mode 1, data. EDC\ECC are left zeroed
+        memcpy(sector, sync, sizeof(sync));
+        sector[12] = (unsigned char)(((frame / 75 / 60) / 10) << 4 | ((frame / 75 / 60) % 10));
+        sector[13] = (unsigned char)((((frame / 75) % 60) / 10) << 4 | (((frame / 75) % 60) % 10));
+        sector[14] = (unsigned char)(((frame % 75) / 10) << 4 | ((frame % 75) % 10));
+        sector[15] = 1;
+        memcpy(sector + CD_RAW_DATA_OFFSET, g_Image + i * CD_SECTOR_SIZE, CD_SECTOR_SIZE);
+
+        failed = fwrite(sector, sizeof(sector), 1, fp) != 1;
+    }
+
+    if(fclose(fp) != 0 || failed)
+    {
+        fprintf(stderr, "can't write %s\n", path);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int run_image(const char* path, const char* type)
+{
+    CD_IMAGE image = {0};
+    CD_SECTOR_READER reader = {0};
+    int failed = 0;
+
+    if(CD_Image_Open(&image, path, &reader) != SLINGA_SUCCESS || CD_SetSectorReader(&reader) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "can't open the %s image\n", type);
+        return 1;
+    }
+
+    if(image.sector_size != (strcmp(type, "bin") == 0 ? CD_RAW_SECTOR_SIZE : CD_SECTOR_SIZE))
+    {
+        fprintf(stderr, "%s image detected with %u byte sectors\n", type, image.sector_size);
+        failed = 1;
+    }
+
+    if(!failed)
+    {
+        failed = test_list() || test_list_page() || test_read();
+        if(failed)
+        {
+            fprintf(stderr, "%s image failed\n", type);
+        }
+    }
+
+    CD_SetSectorReader(NULL);
+    CD_Image_Close(&image);
+
+    return failed;
+}
+
+/**
+ * @brief Listing sweeps the headers in disc order, a read-ahead window at a time
+ */
+static int test_list(void)
+{
+    CD_STATS stats = {0};
+    unsigned int saves_found = 0;
+    unsigned int max_calls = 0;
+    SLINGA_ERROR result = 0;
+
+    CD_Invalidate();
+    CD_ResetStats();
+
+    result = Slinga_List(DEVICE_CD, 0, g_Saves, NUM_SAVES, &saves_found);
+    if(result != SLINGA_SUCCESS || saves_found != NUM_SAVES)
+    {
+        fprintf(stderr, "listed %u saves, expected %u (%d)\n", saves_found, NUM_SAVES, result);
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        if(strcmp(g_Saves[i].savename, g_Names[i]) != 0 || g_Saves[i].data_size != save_size(i))
+        {
+            fprintf(stderr, "listed %s (%u bytes), expected %s\n", g_Saves[i].savename, g_Saves[i].data_size, g_Names[i]);
+            return 1;
+        }
+    }
+
+    // the primary volume descriptor, then one window per CD_READ_AHEAD_SECTORS from the root on
+    max_calls = 1 + (g_Image_Sectors - ROOT_LBA + CD_READ_AHEAD_SECTORS - 1) / CD_READ_AHEAD_SECTORS;
+
+    CD_GetStats(&stats);
+    if(stats.read_calls > max_calls || stats.window_hits < NUM_SAVES)
+    {
+        fprintf(stderr, "listing took %u reads (at most %u), %u window hits\n", stats.read_calls, max_calls, stats.window_hits);
+        return 1;
+    }
+
+    // the directory and headers are cached
+    CD_ResetStats();
+    if(Slinga_List(DEVICE_CD, 0, NULL, 0, &saves_found) != SLINGA_SUCCESS || saves_found != NUM_SAVES)
+    {
+        fprintf(stderr, "listing again found %u saves\n", saves_found);
+        return 1;
+    }
+
+    CD_GetStats(&stats);
+    if(stats.read_calls)
+    {
+        fprintf(stderr, "listing again took %u reads\n", stats.read_calls);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief A listing page only reads the headers it returns
+ */
+static int test_list_page(void)
+{
+    CD_STATS stats = {0};
+    unsigned int cursor = SLINGA_LIST_START;
+    unsigned int total = 0;
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    CD_Invalidate();
+    CD_ResetStats();
+
+    // the volume descriptor, then a window covering the directories and the first headers
+    result = Slinga_ListPage(DEVICE_CD, 0, SLINGA_LIST_START, g_Page, 4, &saves_found, &cursor);
+    CD_GetStats(&stats);
+    if(result != SLINGA_SUCCESS || saves_found != 4 || cursor != 4 || stats.read_calls != 2)
+    {
+        fprintf(stderr, "first page returned %d, %u saves in %u reads\n", result, saves_found, stats.read_calls);
+        return 1;
+    }
+
+    cursor = SLINGA_LIST_START;
+
+    while(cursor != SLINGA_LIST_END)
+    {
+        result = Slinga_ListPage(DEVICE_CD, 0, cursor, g_Page, PAGE_LEN, &saves_found, &cursor);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "list page failed %d\n", result);
+            return 1;
+        }
+
+        for(unsigned int i = 0; i < saves_found; i++)
+        {
+            if(total + i >= NUM_SAVES || strcmp(g_Page[i].savename, g_Names[total + i]) != 0)
+            {
+                fprintf(stderr, "listed %s at %u\n", g_Page[i].savename, total + i);
+                return 1;
+            }
+        }
+
+        total += saves_found;
+    }
+
+    if(total != NUM_SAVES)
+    {
+        fprintf(stderr, "paged through %u saves, expected %u\n", total, NUM_SAVES);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Neighbouring saves come from the read-ahead window, a large one straight from the disc
+ */
+static int test_read(void)
+{
+    CD_STATS stats = {0};
+    unsigned int bytes_read = 0;
+    unsigned int window_saves = 0;
+    SLINGA_ERROR result = 0;
+
+    // headers cached, the window ends up at the last save
+    CD_Invalidate();
+    if(Slinga_List(DEVICE_CD, 0, NULL, 0, &bytes_read) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "listing before reading failed\n");
+        return 1;
+    }
+
+    CD_ResetStats();
+
+    // every small save takes one sector, so a window holds this many
+    window_saves = CD_READ_AHEAD_SECTORS;
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        memset(g_Read, 0, sizeof(g_Read));
+
+        result = Slinga_Read(DEVICE_CD, 0, g_Names[i], g_Read, sizeof(g_Read), &bytes_read);
+        if(result != SLINGA_SUCCESS || bytes_read != save_size(i) || memcmp(g_Read, g_Data[i], bytes_read) != 0)
+        {
+            fprintf(stderr, "reading %s failed %d\n", g_Names[i], result);
+            return 1;
+        }
+
+        if(i == window_saves - 1)
+        {
+            CD_GetStats(&stats);
+            if(stats.read_calls != 1 || stats.window_hits < window_saves)
+            {
+                fprintf(stderr, "reading %u neighbouring saves took %u reads\n", window_saves, stats.read_calls);
+                return 1;
+            }
+        }
+
+        if(i == NUM_SAVES - 2)
+        {
+            CD_ResetStats();
+        }
+    }
+
+    //
+    // the big save: its whole sectors past the window go straight into the
+    // buffer with one read, only its ends go through the window
+    //
+    CD_GetStats(&stats);
+    if(stats.read_calls > 3 || stats.sectors_read > (BUP_HEADER_SIZE + BIG_SAVE_SIZE) / CD_SECTOR_SIZE + 1 + CD_READ_AHEAD_SECTORS)
+    {
+        fprintf(stderr, "reading %s took %u reads, %u sectors\n", g_Names[NUM_SAVES - 1], stats.read_calls, stats.sectors_read);
+        return 1;
+    }
+
+    if(Slinga_Write(DEVICE_CD, 0, g_Names[0], &g_Saves[0], g_Data[0], save_size(0)) != SLINGA_NOT_SUPPORTED)
+    {
+        fprintf(stderr, "writing to the CD didn't fail\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Append a file to the image, header first, padded to a whole sector
+ *
+ * @return Sectors used, 0 if the image is full
+ */
+static unsigned int add_file(const char* name, const unsigned char* header, const unsigned char* data, unsigned int size)
+{
+    PTEST_FILE file = &g_Files[g_Num_Files];
+    unsigned int header_size = header ? BUP_HEADER_SIZE : 0;
+    unsigned int sectors = (header_size + size + CD_SECTOR_SIZE - 1) / CD_SECTOR_SIZE;
+    unsigned char* dst = g_Image + g_Image_Sectors * CD_SECTOR_SIZE;
+
+    if(g_Image_Sectors + sectors > MAX_SECTORS)
+    {
+        fprintf(stderr, "image is full at %s\n", name);
+        return 0;
+    }
+
+    strcpy(file->name, name);
+    file->lba = g_Image_Sectors;
+    file->size = header_size + size;
+
+    if(header)
+    {
+        memcpy(dst, header, BUP_HEADER_SIZE);
+    }
+    memcpy(dst + header_size, data, size);
+
+    g_Image_Sectors += sectors;
+    g_Num_Files++;
+
+    return sectors;
+}
+
+/**
+ * @brief Write an ISO9660 directory record. name "\0" and "\1" are "." and ".."
+ *
+ * @return Size of the record in bytes
+ */
+static unsigned int put_record(unsigned char* dst, unsigned int lba, unsigned int size, unsigned char flags, const char* name)
+{
+    unsigned int name_len = name[0] ? strlen(name) : 1;
+    unsigned int record_size = 33 + name_len + ((name_len & 1) ? 0 : 1);
+
+    memset(dst, 0, record_size);
+    dst[0] = (unsigned char)record_size;
+    put_both32(dst + 2, lba);
+    put_both32(dst + 10, size);
+    dst[25] = flags;
+    put_both16(dst + 28, 1);
+    dst[32] = (unsigned char)name_len;
+    memcpy(dst + 33, name, name_len);
+
+    return record_size;
+}
+
+/**
+ * @brief ISO9660 both-endian 32-bit field, little-endian first
+ */
+static void put_both32(unsigned char* dst, unsigned int value)
+{
+    for(unsigned int i = 0; i < 4; i++)
+    {
+        dst[i] = (unsigned char)(value >> (8 * i));
+        dst[7 - i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief ISO9660 both-endian 16-bit field, little-endian first
+ */
+static void put_both16(unsigned char* dst, unsigned int value)
+{
+    dst[0] = (unsigned char)value;
+    dst[1] = (unsigned char)(value >> 8);
+    dst[2] = (unsigned char)(value >> 8);
+    dst[3] = (unsigned char)value;
+}
+
+static unsigned int save_size(unsigned int index)
+{
+    // small enough to share a sector with the header, except the last
+    if(index == NUM_SAVES - 1)
+    {
+        return BIG_SAVE_SIZE;
+    }
+
+    return 1 + (index * 997) % (CD_SECTOR_SIZE - BUP_HEADER_SIZE);
+}
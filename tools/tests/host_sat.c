@@ -0,0 +1,248 @@
+/** @file host_sat.c
+ *
+ *  @author Slinga
+ *  @brief A SAT partition in host memory standing in for internal memory or a cartridge
+ *  @bug No known bugs.
+ */
+#include "host_sat.h"
+#include "../../devices/sat/sat.h"
+#include "../../libslinga/payload_cache.h"
+
+extern PDEVICE_HANDLER g_Device_Handlers[MAX_DEVICE_TYPE];
+
+static DEVICE_HANDLER g_Host_Sat_Handler = {0};
+static PARTITION_INFO g_Host_Sat_Partition = {0};
+static DEVICE_TYPE g_Host_Sat_Device = DEVICE_INTERNAL;
+
+static SLINGA_ERROR host_sat_init(DEVICE_TYPE device_type);
+static SLINGA_ERROR host_sat_get_device_name(DEVICE_TYPE device_type, char** device_name);
+static SLINGA_ERROR host_sat_is_present(DEVICE_TYPE device_type);
+static SLINGA_ERROR host_sat_stat(DEVICE_TYPE device_type, PBACKUP_STAT stat);
+static SLINGA_ERROR host_sat_calc_blocks(DEVICE_TYPE device_type, unsigned int size, unsigned int* num_blocks);
+static SLINGA_ERROR host_sat_list(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found);
+static SLINGA_ERROR host_sat_list_page(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor);
+static SLINGA_ERROR host_sat_query_file(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save);
+static SLINGA_ERROR host_sat_read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read);
+static SLINGA_ERROR host_sat_write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR host_sat_reserve(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned int max_size);
+static SLINGA_ERROR host_sat_delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename);
+static SLINGA_ERROR host_sat_format(DEVICE_TYPE device_type);
+
+/**
+ * @brief Back device_type with a SAT partition in host memory
+ *
+ * @param[in] device_type Device to replace, usually DEVICE_INTERNAL or DEVICE_CARTRIDGE
+ * @param[in] partition_buf Partition, used as is. Format it with Slinga_Format() if it's blank
+ * @param[in] partition_size Size of partition_buf in bytes
+ * @param[in] block_size Block size in bytes, skip bytes included
+ * @param[in] skip_bytes 1 if only every other byte is used, like internal memory and cartridges
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR HostSat_Attach(DEVICE_TYPE device_type, unsigned char* partition_buf, unsigned int partition_size, unsigned int block_size, unsigned int skip_bytes)
+{
+    if(device_type < 0 || device_type >= MAX_DEVICE_TYPE || !partition_buf || !block_size || partition_size % block_size)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    HostSat_Detach();
+
+    g_Host_Sat_Handler.init = host_sat_init;
+    g_Host_Sat_Handler.fini = host_sat_init;
+    g_Host_Sat_Handler.get_device_name = host_sat_get_device_name;
+    g_Host_Sat_Handler.is_present = host_sat_is_present;
+    g_Host_Sat_Handler.is_readable = host_sat_is_present;
+    g_Host_Sat_Handler.is_writeable = host_sat_is_present;
+    g_Host_Sat_Handler.stat = host_sat_stat;
+    g_Host_Sat_Handler.calc_blocks = host_sat_calc_blocks;
+    g_Host_Sat_Handler.list = host_sat_list;
+    g_Host_Sat_Handler.list_page = host_sat_list_page;
+    g_Host_Sat_Handler.query_file = host_sat_query_file;
+    g_Host_Sat_Handler.read = host_sat_read;
+    g_Host_Sat_Handler.write = host_sat_write;
+    g_Host_Sat_Handler.reserve = host_sat_reserve;
+    g_Host_Sat_Handler.delete = host_sat_delete;
+    g_Host_Sat_Handler.format = host_sat_format;
+
+    g_Host_Sat_Device = device_type;
+    g_Host_Sat_Partition.partition_buf = partition_buf;
+    g_Host_Sat_Partition.partition_size = partition_size;
+    g_Host_Sat_Partition.block_size = block_size;
+    g_Host_Sat_Partition.skip_bytes = skip_bytes;
+
+    g_Device_Handlers[device_type] = &g_Host_Sat_Handler;
+
+    return SLINGA_SUCCESS;
+}
+
+/**
+ * @brief Disconnect the partition. The device reports SLINGA_DEVICE_NOT_PRESENT until the next attach
+ *
+ * @return SLINGA_SUCCESS on success
+ */
+SLINGA_ERROR HostSat_Detach(void)
+{
+    if(!g_Host_Sat_Partition.partition_buf)
+    {
+        return SLINGA_SUCCESS;
+    }
+
+    // the next partition may reuse the buffer
+    sat_release(&g_Host_Sat_Partition);
+
+#ifdef INCLUDE_PAYLOAD_CACHE
+    Slinga_InvalidatePayloadCache(g_Host_Sat_Device);
+#endif
+
+    memset(&g_Host_Sat_Partition, 0, sizeof(g_Host_Sat_Partition));
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR host_sat_init(DEVICE_TYPE device_type)
+{
+    return device_type == g_Host_Sat_Device ? SLINGA_SUCCESS : SLINGA_INVALID_DEVICE_TYPE;
+}
+
+static SLINGA_ERROR host_sat_get_device_name(DEVICE_TYPE device_type, char** device_name)
+{
+    if(device_type != g_Host_Sat_Device || !device_name)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    *device_name = "Host SAT";
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR host_sat_is_present(DEVICE_TYPE device_type)
+{
+    if(device_type != g_Host_Sat_Device)
+    {
+        return SLINGA_INVALID_DEVICE_TYPE;
+    }
+
+    return g_Host_Sat_Partition.partition_buf ? SLINGA_SUCCESS : SLINGA_DEVICE_NOT_PRESENT;
+}
+
+static SLINGA_ERROR host_sat_stat(DEVICE_TYPE device_type, PBACKUP_STAT stat)
+{
+    unsigned int used_blocks = 0;
+    unsigned int valid_block_size = 0;
+    SLINGA_ERROR result = 0;
+
+    result = host_sat_is_present(device_type);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    if(!stat)
+    {
+        return SLINGA_INVALID_PARAMETER;
+    }
+
+    result = sat_get_used_blocks(&g_Host_Sat_Partition, &used_blocks);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // same numbers Saturn_Stat() reports, two blocks of headers
+    valid_block_size = g_Host_Sat_Partition.block_size >> g_Host_Sat_Partition.skip_bytes;
+
+    memset(stat, 0, sizeof(BACKUP_STAT));
+    stat->block_size = valid_block_size;
+    stat->total_blocks = (g_Host_Sat_Partition.partition_size / g_Host_Sat_Partition.block_size) - 2;
+    stat->total_bytes = stat->total_blocks * valid_block_size;
+    stat->free_blocks = stat->total_blocks - LIBSLINGA_MIN(used_blocks, stat->total_blocks);
+    stat->free_bytes = stat->free_blocks * valid_block_size;
+    stat->max_saves_possible = stat->free_blocks;
+
+    return SLINGA_SUCCESS;
+}
+
+static SLINGA_ERROR host_sat_calc_blocks(DEVICE_TYPE device_type, unsigned int size, unsigned int* num_blocks)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    return result != SLINGA_SUCCESS ? result : sat_calc_blocks(&g_Host_Sat_Partition, size, num_blocks);
+}
+
+static SLINGA_ERROR host_sat_list(DEVICE_TYPE device_type, FLAGS flags, PSAVE_METADATA saves, unsigned int num_saves, unsigned int* saves_found)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    UNUSED(flags);
+
+    return result != SLINGA_SUCCESS ? result : sat_list_saves(&g_Host_Sat_Partition, saves, num_saves, saves_found);
+}
+
+static SLINGA_ERROR host_sat_list_page(DEVICE_TYPE device_type, FLAGS flags, unsigned int cursor, PSAVE_METADATA page, unsigned int page_len, unsigned int* saves_found, unsigned int* next_cursor)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    UNUSED(flags);
+
+    return result != SLINGA_SUCCESS ? result : sat_list_page(&g_Host_Sat_Partition, cursor, page, page_len, saves_found, next_cursor);
+}
+
+static SLINGA_ERROR host_sat_query_file(DEVICE_TYPE device_type, FLAGS flags, const char* filename, PSAVE_METADATA save)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    UNUSED(flags);
+
+    return result != SLINGA_SUCCESS ? result : sat_query_file(filename, &g_Host_Sat_Partition, save);
+}
+
+static SLINGA_ERROR host_sat_read(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned char* buffer, unsigned int size, unsigned int* bytes_read)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    UNUSED(flags);
+
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    // like Saturn_Read()
+    result = sat_check_formatted(&g_Host_Sat_Partition);
+    if(result != SLINGA_SUCCESS)
+    {
+        return result;
+    }
+
+    return sat_read(filename, buffer, size, bytes_read, &g_Host_Sat_Partition);
+}
+
+static SLINGA_ERROR host_sat_write(DEVICE_TYPE device_type, FLAGS flags, const char* filename, const PSAVE_METADATA save_metadata, const unsigned char* buffer, unsigned int size)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    return result != SLINGA_SUCCESS ? result : sat_write(flags, filename, save_metadata, buffer, size, &g_Host_Sat_Partition);
+}
+
+static SLINGA_ERROR host_sat_reserve(DEVICE_TYPE device_type, FLAGS flags, const char* filename, unsigned int max_size)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    return result != SLINGA_SUCCESS ? result : sat_reserve(flags, filename, max_size, &g_Host_Sat_Partition);
+}
+
+static SLINGA_ERROR host_sat_delete(DEVICE_TYPE device_type, FLAGS flags, const char* filename)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    return result != SLINGA_SUCCESS ? result : sat_delete(filename, flags, &g_Host_Sat_Partition);
+}
+
+static SLINGA_ERROR host_sat_format(DEVICE_TYPE device_type)
+{
+    SLINGA_ERROR result = host_sat_is_present(device_type);
+
+    return result != SLINGA_SUCCESS ? result : sat_format(&g_Host_Sat_Partition);
+}
@@ -0,0 +1,19 @@
+/** @file host_sat.h
+ *
+ *  @author Slinga
+ *  @brief A SAT partition in host memory standing in for internal memory or a cartridge
+ *  @bug No known bugs.
+ */
+#pragma once
+
+#include "../../libslinga.h"
+
+//
+// Installs a device handler that runs the SAT engine over a host buffer, so
+// tests can exercise the same code paths the console uses for
+// DEVICE_INTERNAL and DEVICE_CARTRIDGE. Call after Slinga_Init(). One
+// partition can be attached at a time.
+//
+
+SLINGA_ERROR HostSat_Attach(DEVICE_TYPE device_type, unsigned char* partition_buf, unsigned int partition_size, unsigned int block_size, unsigned int skip_bytes);
+SLINGA_ERROR HostSat_Detach(void);
@@ -0,0 +1,399 @@
+/** @file ode_test.c
+ *
+ *  @author Slinga
+ *  @brief Runs DEVICE_SATIATIOR against the ODE simulator
+ *  @bug No known bugs.
+ */
+#include "../../devices/ode/ode.h"
+#include "../../devices/ode/ode_sim.h"
+#include "../../libslinga/payload_cache.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//
+// ode_test
+//
+// Attaches the ODE simulator, serving a temporary directory, to
+// DEVICE_SATIATIOR and checks how many round trips each operation costs:
+// a new save is two (the exclusive header write, then the data), an
+// overwrite, a read or a delete is one, listing the whole directory is one
+// and each listing page is one. Reads are also timed on the simulator's
+// virtual clock to check the chunks are in flight together. Exits non-zero
+// on the first failure.
+//
+
+#define NUM_SAVES       40
+#define PAGE_LEN        16
+#define MAX_TEST_SAVE   3000
+#define LATENCY_US      1000
+
+static char g_Root[64];
+static ODE_SIM g_Sim;
+static ODE_TRANSPORT g_Transport;
+static char g_Names[NUM_SAVES][MAX_SAVENAME];
+static unsigned char g_Data[NUM_SAVES][MAX_TEST_SAVE];
+static unsigned char g_Read[MAX_TEST_SAVE + 1];
+static SAVE_METADATA g_Page[PAGE_LEN];
+static unsigned char g_Payload_Cache[4 * MAX_TEST_SAVE];
+
+static int test_write(void);
+static int test_read(void);
+static int test_list(void);
+static int test_list_page(void);
+static int test_delete(void);
+static unsigned int get_round_trips(void);
+static unsigned int save_size(unsigned int index);
+static void remove_root(void);
+
+int main(int argc, char** argv)
+{
+    ODE_SIM_CONFIG config = {0};
+    int failed = 0;
+
+    UNUSED(argv);
+
+    if(argc > 1)
+    {
+        fprintf(stderr, "usage: ode_test\n");
+        return 2;
+    }
+
+    strcpy(g_Root, "/tmp/ode_test.XXXXXX");
+    if(!mkdtemp(g_Root))
+    {
+        fprintf(stderr, "can't create the host directory\n");
+        return 1;
+    }
+
+    // small transfers so every save is split into several chunks, and a
+    // link fast enough that the latency dominates
+    config.latency_us = LATENCY_US;
+    config.command_us = 50;
+    config.bytes_per_ms = 10000;
+    config.max_outstanding = ODE_MAX_OUTSTANDING;
+    config.max_transfer = 1024;
+
+    Slinga_Init();
+    Slinga_SetPayloadCache(g_Payload_Cache, sizeof(g_Payload_Cache));
+
+    if(ODE_Sim_Init(&g_Sim, g_Root, &config, &g_Transport) != SLINGA_SUCCESS ||
+       ODE_SetTransport(DEVICE_SATIATIOR, &g_Transport) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "can't attach the simulator\n");
+        remove_root();
+        return 1;
+    }
+
+    failed = test_write() || test_read() || test_list() || test_list_page() || test_delete();
+
+    ODE_SetTransport(DEVICE_SATIATIOR, NULL);
+    remove_root();
+
+    if(failed)
+    {
+        return 1;
+    }
+
+    printf("ode: all tests passed\n");
+
+    return 0;
+}
+
+/**
+ * @brief New saves cost two round trips, overwrites one
+ */
+static int test_write(void)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned int round_trips = 0;
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        unsigned int size = save_size(i);
+
+        snprintf(g_Names[i], sizeof(g_Names[i]), "GAME_%02u", NUM_SAVES - 1 - i);
+        for(unsigned int j = 0; j < size; j++)
+        {
+            g_Data[i][j] = (unsigned char)((j / 64) * 13 + i);
+        }
+
+        Slinga_SetSaveMetadata(&metadata, g_Names[i], g_Names[i], "Slot", 0, 0x1000 + i, size);
+
+        round_trips = get_round_trips();
+
+        result = Slinga_Write(DEVICE_SATIATIOR, 0, g_Names[i], &metadata, g_Data[i], size);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "writing %s failed %d\n", g_Names[i], result);
+            return 1;
+        }
+
+        round_trips = get_round_trips() - round_trips;
+        if(round_trips != 2)
+        {
+            fprintf(stderr, "writing %s took %u round trips\n", g_Names[i], round_trips);
+            return 1;
+        }
+    }
+
+    // the exclusive header write fails before any data is queued
+    Slinga_SetSaveMetadata(&metadata, g_Names[0], g_Names[0], "Slot", 0, 0x1000, save_size(1));
+    round_trips = get_round_trips();
+
+    result = Slinga_Write(DEVICE_SATIATIOR, 0, g_Names[0], &metadata, g_Data[1], save_size(1));
+    if(result != SLINGA_FILE_EXISTS || get_round_trips() - round_trips != 1)
+    {
+        fprintf(stderr, "writing an existing save returned %d in %u round trips\n", result, get_round_trips() - round_trips);
+        return 1;
+    }
+
+    // header and data are queued together
+    Slinga_SetSaveMetadata(&metadata, g_Names[0], g_Names[0], "Slot", 0, 0x1000, save_size(0));
+    round_trips = get_round_trips();
+
+    result = Slinga_Write(DEVICE_SATIATIOR, OVERWRITE_EXISTING_SAVE, g_Names[0], &metadata, g_Data[0], save_size(0));
+    if(result != SLINGA_SUCCESS || get_round_trips() - round_trips != 1)
+    {
+        fprintf(stderr, "overwriting returned %d in %u round trips\n", result, get_round_trips() - round_trips);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Each save comes back in one round trip with its chunks in flight together
+ */
+static int test_read(void)
+{
+    unsigned long long elapsed_us = 0;
+    unsigned int round_trips = 0;
+    unsigned int bytes_read = 0;
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        memset(g_Read, 0, sizeof(g_Read));
+        ODE_Sim_ResetClock(&g_Sim);
+        round_trips = get_round_trips();
+
+        // one byte spare so the read is short and the payload cache takes it
+        result = Slinga_Read(DEVICE_SATIATIOR, 0, g_Names[i], g_Read, sizeof(g_Read), &bytes_read);
+        if(result != SLINGA_SUCCESS || bytes_read != save_size(i) || memcmp(g_Read, g_Data[i], bytes_read) != 0)
+        {
+            fprintf(stderr, "reading %s failed %d\n", g_Names[i], result);
+            return 1;
+        }
+
+        round_trips = get_round_trips() - round_trips;
+        if(round_trips != 1)
+        {
+            fprintf(stderr, "reading %s took %u round trips\n", g_Names[i], round_trips);
+            return 1;
+        }
+
+        // the header and up to three chunks wait on a single latency
+        ODE_Sim_GetElapsed(&g_Sim, &elapsed_us);
+        if(elapsed_us >= 2 * LATENCY_US)
+        {
+            fprintf(stderr, "reading %s took %llu us\n", g_Names[i], elapsed_us);
+            return 1;
+        }
+    }
+
+    // reading the last save again comes from the payload cache
+    round_trips = get_round_trips();
+    if(Slinga_Read(DEVICE_SATIATIOR, 0, g_Names[NUM_SAVES - 1], g_Read, sizeof(g_Read), &bytes_read) != SLINGA_SUCCESS || get_round_trips() != round_trips)
+    {
+        fprintf(stderr, "cached read went to the ODE\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief The whole directory fits in one window of listing batches
+ */
+static int test_list(void)
+{
+    unsigned int round_trips = 0;
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    round_trips = get_round_trips();
+
+    result = Slinga_List(DEVICE_SATIATIOR, 0, NULL, 0, &saves_found);
+    if(result != SLINGA_SUCCESS || saves_found != NUM_SAVES)
+    {
+        fprintf(stderr, "counted %u saves, expected %u (%d)\n", saves_found, NUM_SAVES, result);
+        return 1;
+    }
+
+    round_trips = get_round_trips() - round_trips;
+    if(round_trips != 1)
+    {
+        fprintf(stderr, "listing took %u round trips\n", round_trips);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Page through the directory, one round trip per page
+ */
+static int test_list_page(void)
+{
+    unsigned int cursor = SLINGA_LIST_START;
+    unsigned int round_trips = 0;
+    unsigned int total = 0;
+    unsigned int pages = 0;
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    round_trips = get_round_trips();
+
+    while(cursor != SLINGA_LIST_END)
+    {
+        result = Slinga_ListPage(DEVICE_SATIATIOR, 0, cursor, g_Page, PAGE_LEN, &saves_found, &cursor);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "list page failed %d\n", result);
+            return 1;
+        }
+
+        for(unsigned int i = 0; i < saves_found; i++)
+        {
+            char expected[MAX_SAVENAME] = {0};
+
+            // the simulator sorts by file name, GAME_00 was written last
+            snprintf(expected, sizeof(expected), "GAME_%02u", total + i);
+            if(strcmp(g_Page[i].savename, expected) != 0 || g_Page[i].data_size != save_size(NUM_SAVES - 1 - total - i))
+            {
+                fprintf(stderr, "listed %s (%u bytes), expected %s\n", g_Page[i].savename, g_Page[i].data_size, expected);
+                return 1;
+            }
+        }
+
+        total += saves_found;
+        pages++;
+    }
+
+    round_trips = get_round_trips() - round_trips;
+
+    if(total != NUM_SAVES)
+    {
+        fprintf(stderr, "listed %u saves, expected %u\n", total, NUM_SAVES);
+        return 1;
+    }
+
+    if(round_trips != pages || pages != (NUM_SAVES + PAGE_LEN - 1) / PAGE_LEN)
+    {
+        fprintf(stderr, "listing took %u round trips for %u pages\n", round_trips, pages);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Each delete is one round trip and the save is gone afterwards
+ */
+static int test_delete(void)
+{
+    SAVE_METADATA metadata = {0};
+    unsigned int round_trips = 0;
+    unsigned int saves_found = 0;
+    SLINGA_ERROR result = 0;
+
+    // every other save
+    for(unsigned int i = 0; i < NUM_SAVES; i += 2)
+    {
+        round_trips = get_round_trips();
+
+        result = Slinga_Delete(DEVICE_SATIATIOR, 0, g_Names[i]);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "deleting %s failed %d\n", g_Names[i], result);
+            return 1;
+        }
+
+        round_trips = get_round_trips() - round_trips;
+        if(round_trips != 1)
+        {
+            fprintf(stderr, "deleting %s took %u round trips\n", g_Names[i], round_trips);
+            return 1;
+        }
+
+        if(Slinga_QueryFile(DEVICE_SATIATIOR, 0, g_Names[i], &metadata) != SLINGA_NOT_FOUND)
+        {
+            fprintf(stderr, "%s is still there\n", g_Names[i]);
+            return 1;
+        }
+    }
+
+    if(Slinga_Delete(DEVICE_SATIATIOR, 0, g_Names[0]) != SLINGA_NOT_FOUND)
+    {
+        fprintf(stderr, "deleting a missing save didn't fail\n");
+        return 1;
+    }
+
+    if(Slinga_List(DEVICE_SATIATIOR, 0, NULL, 0, &saves_found) != SLINGA_SUCCESS || saves_found != NUM_SAVES / 2)
+    {
+        fprintf(stderr, "counted %u saves after deleting, expected %u\n", saves_found, NUM_SAVES / 2);
+        return 1;
+    }
+
+    return 0;
+}
+
+static unsigned int get_round_trips(void)
+{
+    ODE_STATS stats = {0};
+
+    ODE_GetStats(DEVICE_SATIATIOR, &stats);
+
+    return stats.round_trips;
+}
+
+static unsigned int save_size(unsigned int index)
+{
+    return 1 + (index * 997) % MAX_TEST_SAVE;
+}
+
+static void remove_root(void)
+{
+    char path[256] = {0};
+    struct dirent* entry = NULL;
+    DIR* dir = NULL;
+
+    snprintf(path, sizeof(path), "%s/SATSAVES", g_Root);
+
+    dir = opendir(path);
+    while(dir && (entry = readdir(dir)))
+    {
+        char file[512] = {0};
+
+        if(entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+
+    if(dir)
+    {
+        closedir(dir);
+    }
+
+    rmdir(path);
+    rmdir(g_Root);
+}
@@ -0,0 +1,475 @@
+/** @file serial_test.c
+ *
+ *  @author Slinga
+ *  @brief Runs DEVICE_SERIAL against the host stand-in over a socketpair
+ *  @bug No known bugs.
+ */
+#include "../../devices/serial/serial.h"
+#include "../../devices/serial/serial_host.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//
+// serial_test
+//
+// Forks Serial_Host_Serve() on one end of a socketpair, serving a temporary
+// directory, and drives DEVICE_SERIAL from the other end. Every request the
+// Saturn side sends is counted so batching can be checked in round trips:
+// a batch write, a batch read and each listing page must cost one request
+// each, and a page only carries its own saves. One test corrupts a frame on the way to the host, which must be
+// NAKed and resent. Exits non-zero on the first failure.
+//
+
+#define NUM_SAVES       40
+#define PAGE_LEN        16
+#define MAX_TEST_SAVE   3000
+
+/** @brief Port to the host that counts requests and can corrupt a frame */
+typedef struct _TEST_PORT
+{
+    SERIAL_FD_PORT fd_port;     ///< @brief Socket to the host
+    SERIAL_PORT fd;             ///< @brief Port that sends and receives on fd_port
+    unsigned int requests;      ///< @brief Last frames of messages sent
+    unsigned int received;      ///< @brief Bytes received from the host
+    unsigned int corrupt;       ///< @brief Data frames left to pass before one is corrupted, 0 for none
+} TEST_PORT, *PTEST_PORT;
+
+static char g_Root[64];
+static TEST_PORT g_Test_Port;
+static SERIAL_PORT g_Port;
+static SERIAL_BATCH_ENTRY g_Entries[NUM_SAVES];
+static char g_Names[NUM_SAVES][MAX_SAVENAME];
+static unsigned char g_Data[NUM_SAVES][MAX_TEST_SAVE];
+static unsigned char g_Read[NUM_SAVES][MAX_TEST_SAVE];
+static SAVE_METADATA g_Page[PAGE_LEN];
+
+static int start_host(pid_t* pid);
+static int stop_host(pid_t pid);
+static int test_write_batch(void);
+static int test_read_batch(void);
+static int test_list(void);
+static int test_resend(void);
+static int read_all(void);
+static unsigned int save_size(unsigned int index);
+static SLINGA_ERROR test_send(void* context, const unsigned char* buffer, unsigned int size);
+static SLINGA_ERROR test_receive(void* context, unsigned char* buffer, unsigned int size, unsigned int timeout_ms, unsigned int* bytes_received);
+static void remove_root(void);
+
+int main(int argc, char** argv)
+{
+    pid_t pid = 0;
+    int failed = 0;
+
+    UNUSED(argv);
+
+    if(argc > 1)
+    {
+        fprintf(stderr, "usage: serial_test\n");
+        return 2;
+    }
+
+    if(start_host(&pid))
+    {
+        return 1;
+    }
+
+    Slinga_Init();
+    Serial_SetPort(&g_Port);
+
+    failed = test_write_batch() || test_read_batch() || test_list() || test_resend();
+
+    if(stop_host(pid))
+    {
+        failed = 1;
+    }
+
+    remove_root();
+
+    if(failed)
+    {
+        return 1;
+    }
+
+    printf("serial: all tests passed\n");
+
+    return 0;
+}
+
+/**
+ * @brief Fork the host stand-in serving a fresh temporary directory
+ */
+static int start_host(pid_t* pid)
+{
+    char saves_dir[128] = {0};
+    int fds[2] = {0};
+
+    strcpy(g_Root, "/tmp/serial_test.XXXXXX");
+    if(!mkdtemp(g_Root))
+    {
+        fprintf(stderr, "can't create the host directory\n");
+        return 1;
+    }
+
+    snprintf(saves_dir, sizeof(saves_dir), "%s/SATSAVES", g_Root);
+    if(mkdir(saves_dir, 0755) != 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        fprintf(stderr, "can't set up the host\n");
+        return 1;
+    }
+
+    *pid = fork();
+    if(*pid < 0)
+    {
+        fprintf(stderr, "fork failed\n");
+        return 1;
+    }
+
+    if(*pid == 0)
+    {
+        SERIAL_FD_PORT fd_port = {0};
+        SERIAL_PORT port = {0};
+        SERIAL_HOST host = {0};
+
+        close(fds[0]);
+
+        if(Serial_Host_InitFdPort(&fd_port, fds[1], &port) != SLINGA_SUCCESS ||
+           Serial_Host_Init(&host, g_Root, &port) != SLINGA_SUCCESS)
+        {
+            _exit(1);
+        }
+
+        _exit(Serial_Host_Serve(&host) == SLINGA_SUCCESS ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    Serial_Host_InitFdPort(&g_Test_Port.fd_port, fds[0], &g_Test_Port.fd);
+    g_Port.context = &g_Test_Port;
+    g_Port.send = test_send;
+    g_Port.receive = test_receive;
+
+    return 0;
+}
+
+/**
+ * @brief Say goodbye and check the host exited cleanly
+ */
+static int stop_host(pid_t pid)
+{
+    int status = 0;
+    SLINGA_ERROR result = 0;
+
+    result = Serial_Close();
+    close(g_Test_Port.fd_port.fd);
+
+    if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "host didn't exit cleanly\n");
+        return 1;
+    }
+
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "BYE failed %d\n", result);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Every save goes to the host in a single request
+ */
+static int test_write_batch(void)
+{
+    SLINGA_ERROR result = 0;
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        unsigned int size = save_size(i);
+
+        snprintf(g_Names[i], sizeof(g_Names[i]), "GAME_%02u", NUM_SAVES - 1 - i);
+        for(unsigned int j = 0; j < size; j++)
+        {
+            g_Data[i][j] = (unsigned char)((j / 64) * 13 + i);
+        }
+
+        g_Entries[i].filename = g_Names[i];
+        g_Entries[i].buffer = g_Data[i];
+        g_Entries[i].size = size;
+        Slinga_SetSaveMetadata(&g_Entries[i].metadata, g_Names[i], g_Names[i], "Slot", 0, 0x1000 + i, size);
+    }
+
+    g_Test_Port.requests = 0;
+
+    result = Serial_WriteBatch(0, g_Entries, NUM_SAVES);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "write batch failed %d\n", result);
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        if(g_Entries[i].result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "writing %s failed %d\n", g_Names[i], g_Entries[i].result);
+            return 1;
+        }
+    }
+
+    if(g_Test_Port.requests != 1)
+    {
+        fprintf(stderr, "write batch took %u requests\n", g_Test_Port.requests);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Every save comes back in a single request
+ */
+static int test_read_batch(void)
+{
+    g_Test_Port.requests = 0;
+
+    if(read_all())
+    {
+        return 1;
+    }
+
+    if(g_Test_Port.requests != 1)
+    {
+        fprintf(stderr, "read batch took %u requests\n", g_Test_Port.requests);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Page through the directory, one request per page
+ */
+static int test_list(void)
+{
+    unsigned int cursor = SLINGA_LIST_START;
+    unsigned int total = 0;
+    unsigned int pages = 0;
+    unsigned int saves_found = 0;
+    unsigned int one_save = 0;
+    SLINGA_ERROR result = 0;
+
+    // the host only sends the page asked for
+    g_Test_Port.received = 0;
+    if(Slinga_ListPage(DEVICE_SERIAL, 0, SLINGA_LIST_START, g_Page, 1, &saves_found, &cursor) != SLINGA_SUCCESS || saves_found != 1 || cursor != 1)
+    {
+        fprintf(stderr, "listing one save failed\n");
+        return 1;
+    }
+
+    one_save = g_Test_Port.received;
+    g_Test_Port.received = 0;
+    if(Slinga_ListPage(DEVICE_SERIAL, 0, SLINGA_LIST_START, g_Page, PAGE_LEN, &saves_found, &cursor) != SLINGA_SUCCESS || g_Test_Port.received <= one_save * 2)
+    {
+        fprintf(stderr, "a page of one save took %u bytes, %u saves took %u\n", one_save, PAGE_LEN, g_Test_Port.received);
+        return 1;
+    }
+
+    cursor = SLINGA_LIST_START;
+    g_Test_Port.requests = 0;
+
+    while(cursor != SLINGA_LIST_END)
+    {
+        result = Slinga_ListPage(DEVICE_SERIAL, 0, cursor, g_Page, PAGE_LEN, &saves_found, &cursor);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "list page failed %d\n", result);
+            return 1;
+        }
+
+        for(unsigned int i = 0; i < saves_found; i++)
+        {
+            char expected[MAX_SAVENAME] = {0};
+
+            // the host sorts by file name, GAME_00 was written last
+            snprintf(expected, sizeof(expected), "GAME_%02u", total + i);
+            if(strcmp(g_Page[i].savename, expected) != 0 || g_Page[i].data_size != save_size(NUM_SAVES - 1 - total - i))
+            {
+                fprintf(stderr, "listed %s (%u bytes), expected %s\n", g_Page[i].savename, g_Page[i].data_size, expected);
+                return 1;
+            }
+        }
+
+        total += saves_found;
+        pages++;
+    }
+
+    if(total != NUM_SAVES)
+    {
+        fprintf(stderr, "listed %u saves, expected %u\n", total, NUM_SAVES);
+        return 1;
+    }
+
+    if(g_Test_Port.requests != pages || pages != (NUM_SAVES + PAGE_LEN - 1) / PAGE_LEN)
+    {
+        fprintf(stderr, "listing took %u requests for %u pages\n", g_Test_Port.requests, pages);
+        return 1;
+    }
+
+    if(Slinga_List(DEVICE_SERIAL, 0, NULL, 0, &saves_found) != SLINGA_SUCCESS || saves_found != NUM_SAVES)
+    {
+        fprintf(stderr, "counted %u saves, expected %u\n", saves_found, NUM_SAVES);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief A corrupted frame is NAKed and resent, the read still succeeds
+ */
+static int test_resend(void)
+{
+    SERIAL_LINK_STATS stats = {0};
+
+    Serial_ResetStats();
+
+    // somewhere in the middle of the write batch
+    g_Test_Port.corrupt = 5;
+
+    if(Serial_WriteBatch(0, g_Entries, NUM_SAVES) != SLINGA_SUCCESS || read_all())
+    {
+        fprintf(stderr, "batch with a corrupted frame failed\n");
+        return 1;
+    }
+
+    Serial_GetStats(&stats);
+    if(g_Test_Port.corrupt || !stats.resends)
+    {
+        fprintf(stderr, "corrupted frame wasn't resent\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read every save back in one batch and compare it
+ */
+static int read_all(void)
+{
+    SERIAL_BATCH_ENTRY entries[NUM_SAVES] = {0};
+    SLINGA_ERROR result = 0;
+
+    memset(g_Read, 0, sizeof(g_Read));
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        entries[i].filename = g_Names[i];
+        entries[i].buffer = g_Read[i];
+        entries[i].size = sizeof(g_Read[i]);
+    }
+
+    result = Serial_ReadBatch(0, entries, NUM_SAVES);
+    if(result != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "read batch failed %d\n", result);
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < NUM_SAVES; i++)
+    {
+        if(entries[i].result != SLINGA_SUCCESS || entries[i].bytes_read != save_size(i) || memcmp(g_Read[i], g_Data[i], save_size(i)) != 0)
+        {
+            fprintf(stderr, "reading %s failed %d\n", g_Names[i], entries[i].result);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static unsigned int save_size(unsigned int index)
+{
+    return 1 + (index * 997) % MAX_TEST_SAVE;
+}
+
+static SLINGA_ERROR test_send(void* context, const unsigned char* buffer, unsigned int size)
+{
+    PTEST_PORT port = (PTEST_PORT)context;
+    unsigned char frame[SERIAL_MAX_FRAME] = {0};
+
+    if(size <= SERIAL_FRAME_HEADER_SIZE || size > sizeof(frame) || buffer[2] != SERIAL_FRAME_DATA)
+    {
+        return port->fd.send(port->fd.context, buffer, size);
+    }
+
+    if(buffer[5] & SERIAL_FLAG_END)
+    {
+        port->requests++;
+    }
+
+    if(!port->corrupt || --port->corrupt)
+    {
+        return port->fd.send(port->fd.context, buffer, size);
+    }
+
+    // flip a payload bit, the CRC no longer matches
+    memcpy(frame, buffer, size);
+    frame[SERIAL_FRAME_HEADER_SIZE] ^= 0x01;
+
+    return port->fd.send(port->fd.context, frame, size);
+}
+
+static SLINGA_ERROR test_receive(void* context, unsigned char* buffer, unsigned int size, unsigned int timeout_ms, unsigned int* bytes_received)
+{
+    PTEST_PORT port = (PTEST_PORT)context;
+    SLINGA_ERROR result = 0;
+
+    result = port->fd.receive(port->fd.context, buffer, size, timeout_ms, bytes_received);
+    if(result == SLINGA_SUCCESS)
+    {
+        port->received += *bytes_received;
+    }
+
+    return result;
+}
+
+static void remove_root(void)
+{
+    char path[256] = {0};
+    struct dirent* entry = NULL;
+    DIR* dir = NULL;
+
+    snprintf(path, sizeof(path), "%s/SATSAVES", g_Root);
+
+    dir = opendir(path);
+    while(dir && (entry = readdir(dir)))
+    {
+        char file[512] = {0};
+
+        if(entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+
+    if(dir)
+    {
+        closedir(dir);
+    }
+
+    rmdir(path);
+    rmdir(g_Root);
+}
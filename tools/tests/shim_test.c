@@ -0,0 +1,512 @@
+/** @file shim_test.c
+ *
+ *  @author Slinga
+ *  @brief Replays recorded BUP call sequences against the shim
+ *  @bug No known bugs.
+ */
+#include "../../libslinga/shim.h"
+#include "../../libslinga/payload_cache.h"
+#include "../../devices/ram.h"
+#include "../../devices/saturn.h"
+#include "host_sat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// shim_test FILE...
+//
+// Each file is a BUP call sequence recorded from a game, one call per line,
+// with the result the real BUP library gave after "=>". BUP device 0 is
+// backed by the RAM device, devices 1 and 2 are left disconnected unless a
+// sequence backs one with a SAT partition. Reads go through the payload
+// cache. Blank lines and lines starting with # are
+// ignored.
+//
+// region SIZE                                      fresh, unformatted device 0 of SIZE bytes
+// sat DEV                                          back DEV with a fresh, unformatted internal memory partition
+// init => UNIT0 UNIT1 UNIT2                        BUP_Init, unit ids from BupConfig
+// selpart DEV NUM => RESULT
+// format DEV => RESULT
+// stat DEV DATASIZE => RESULT [FIELD=VALUE...]     FIELD is any BupStat member
+// write DEV NAME COMMENT LANG DATE SIZE SEED on|off => RESULT
+// read DEV NAME SIZE SEED => RESULT                the data must match SEED
+// verify DEV NAME SIZE SEED => RESULT
+// delete DEV NAME => RESULT
+// dir DEV PREFIX TBSIZE => COUNT [NAME...]         * for an empty PREFIX
+// getdate DATE => YEAR MONTH DAY HOUR MINUTE WEEK  YEAR is the offset from 1980
+// setdate YEAR MONTH DAY HOUR MINUTE => DATE
+// slinga_write NAME SIZE SEED                      write device 0 behind the shim's back
+// invalidate DEV
+//
+// Save data is generated from SEED so sequences don't need data files. "-"
+// stands for an empty COMMENT.
+//
+
+#define MAX_REGION_SIZE     (1024 * 1024)
+#define MAX_LINE            512
+#define MAX_TOKENS          32
+#define VERIFY_BUFFER_SIZE  (64 * 1024)
+#define PAYLOAD_CACHE_SIZE  (16 * 1024)
+
+static unsigned char g_Region[MAX_REGION_SIZE];
+static unsigned char g_Partition[INTERNAL_MEMORY_SIZE];
+static unsigned char g_Data[MAX_SAVE_SIZE];
+static unsigned char g_Expected[MAX_SAVE_SIZE];
+static unsigned char g_Verify_Buffer[VERIFY_BUFFER_SIZE];
+static unsigned char g_Payload_Cache[PAYLOAD_CACHE_SIZE];
+static SHIM_DIR g_Dir[MAX_SAVES];
+
+static int run_file(const char* path);
+static int run_line(char** tokens, int num_tokens, char** expected, int num_expected);
+static int check_result(const char* call, long actual, char** expected, int num_expected);
+static int check_stat(const SHIM_STAT* stat, char** expected, int num_expected);
+static int check_dir(int found, unsigned short tbsize, char** expected, int num_expected);
+static void fill_data(unsigned char* data, unsigned int size, unsigned int seed);
+static unsigned int to_uint(const char* token);
+
+int main(int argc, char** argv)
+{
+    int failed = 0;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: shim_test FILE...\n");
+        return 2;
+    }
+
+    Shim_SetVerifyBuffer(g_Verify_Buffer, sizeof(g_Verify_Buffer));
+    Slinga_SetPayloadCache(g_Payload_Cache, sizeof(g_Payload_Cache));
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(run_file(argv[i]))
+        {
+            failed++;
+        }
+    }
+
+    if(failed)
+    {
+        fprintf(stderr, "shim: %d of %d sequences failed\n", failed, argc - 1);
+        return 1;
+    }
+
+    printf("shim: all %d sequences passed\n", argc - 1);
+
+    return 0;
+}
+
+/**
+ * @brief Replay one sequence file from a fresh, detached device 0
+ */
+static int run_file(const char* path)
+{
+    char line[MAX_LINE] = {0};
+    unsigned int line_number = 0;
+    FILE* file = NULL;
+
+    file = fopen(path, "r");
+    if(!file)
+    {
+        fprintf(stderr, "%s: can't open\n", path);
+        return 1;
+    }
+
+    // every sequence starts with device 0 disconnected, mapping invalidates the shim's caches
+    RAM_SetRegion(NULL, 0);
+    HostSat_Detach();
+    Shim_MapDevice(0, DEVICE_RAM);
+    Shim_MapDevice(1, DEVICE_CD);
+    Shim_MapDevice(2, DEVICE_SERIAL);
+
+    while(fgets(line, sizeof(line), file))
+    {
+        char* tokens[MAX_TOKENS] = {0};
+        char** expected = NULL;
+        int num_tokens = 0;
+        int num_expected = 0;
+
+        line_number++;
+
+        for(char* token = strtok(line, " \t\r\n"); token && num_tokens < MAX_TOKENS; token = strtok(NULL, " \t\r\n"))
+        {
+            tokens[num_tokens++] = token;
+        }
+
+        if(!num_tokens || tokens[0][0] == '#')
+        {
+            continue;
+        }
+
+        for(int i = 0; i < num_tokens; i++)
+        {
+            if(strcmp(tokens[i], "=>") == 0)
+            {
+                expected = &tokens[i + 1];
+                num_expected = num_tokens - i - 1;
+                num_tokens = i;
+                break;
+            }
+        }
+
+        if(run_line(tokens, num_tokens, expected, num_expected))
+        {
+            fprintf(stderr, "%s:%u: %s failed\n", path, line_number, tokens[0]);
+            fclose(file);
+            return 1;
+        }
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+/**
+ * @brief Make one BUP call and compare what it returned with the recording
+ */
+static int run_line(char** tokens, int num_tokens, char** expected, int num_expected)
+{
+    const char* call = tokens[0];
+    int args = num_tokens - 1;
+
+    if(strcmp(call, "region") == 0 && args == 1)
+    {
+        unsigned int size = to_uint(tokens[1]);
+
+        if(size > sizeof(g_Region))
+        {
+            fprintf(stderr, "region too large\n");
+            return 1;
+        }
+
+        memset(g_Region, 0, size);
+        return RAM_SetRegion(g_Region, size) != SLINGA_SUCCESS;
+    }
+
+    if(strcmp(call, "sat") == 0 && args == 1)
+    {
+        // registers the real handlers first so they don't replace ours later
+        Slinga_Init();
+
+        memset(g_Partition, 0, sizeof(g_Partition));
+        if(HostSat_Attach(DEVICE_INTERNAL, g_Partition, sizeof(g_Partition), INTERNAL_MEMORY_BLOCK_SIZE, INTERNAL_MEMORY_SKIP_BYTES) != SLINGA_SUCCESS)
+        {
+            return 1;
+        }
+
+        return Shim_MapDevice(to_uint(tokens[1]), DEVICE_INTERNAL) != SLINGA_SUCCESS;
+    }
+
+    if(strcmp(call, "init") == 0 && args == 0)
+    {
+        SHIM_CONFIG config[SHIM_MAX_DEVICES] = {0};
+
+        Shim_Init(NULL, NULL, config);
+
+        if(num_expected != SHIM_MAX_DEVICES)
+        {
+            fprintf(stderr, "init needs %d unit ids\n", SHIM_MAX_DEVICES);
+            return 1;
+        }
+
+        for(int i = 0; i < SHIM_MAX_DEVICES; i++)
+        {
+            if(check_result("unit_id", config[i].unit_id, &expected[i], 1))
+            {
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    if(strcmp(call, "selpart") == 0 && args == 2)
+    {
+        return check_result(call, Shim_SelPart(to_uint(tokens[1]), (unsigned short)to_uint(tokens[2])), expected, num_expected);
+    }
+
+    if(strcmp(call, "format") == 0 && args == 1)
+    {
+        return check_result(call, Shim_Format(to_uint(tokens[1])), expected, num_expected);
+    }
+
+    if(strcmp(call, "stat") == 0 && args == 2)
+    {
+        SHIM_STAT stat = {0};
+        int result = Shim_Stat(to_uint(tokens[1]), to_uint(tokens[2]), &stat);
+
+        return check_result(call, result, expected, LIBSLINGA_MIN(num_expected, 1)) ||
+               check_stat(&stat, expected + 1, num_expected - 1);
+    }
+
+    if(strcmp(call, "write") == 0 && args == 8)
+    {
+        SHIM_DIR dir = {0};
+
+        strncpy(dir.filename, tokens[2], sizeof(dir.filename) - 1);
+        if(strcmp(tokens[3], "-") != 0)
+        {
+            strncpy(dir.comment, tokens[3], sizeof(dir.comment) - 1);
+        }
+        dir.language = (unsigned char)to_uint(tokens[4]);
+        dir.date = to_uint(tokens[5]);
+        dir.datasize = to_uint(tokens[6]);
+
+        if(dir.datasize > sizeof(g_Data))
+        {
+            fprintf(stderr, "save too large\n");
+            return 1;
+        }
+
+        fill_data(g_Data, dir.datasize, to_uint(tokens[7]));
+
+        return check_result(call, Shim_Write(to_uint(tokens[1]), &dir, g_Data, strcmp(tokens[8], "on") == 0 ? SHIM_OVERWRITE_ON : SHIM_OVERWRITE_OFF), expected, num_expected);
+    }
+
+    if((strcmp(call, "read") == 0 || strcmp(call, "verify") == 0) && args == 4)
+    {
+        unsigned int size = to_uint(tokens[3]);
+        int result = 0;
+
+        if(size >= sizeof(g_Expected))
+        {
+            fprintf(stderr, "save too large\n");
+            return 1;
+        }
+
+        fill_data(g_Expected, size, to_uint(tokens[4]));
+
+        if(call[0] == 'v')
+        {
+            return check_result(call, Shim_Verify(to_uint(tokens[1]), tokens[2], g_Expected), expected, num_expected);
+        }
+
+        // anything past the save must be left alone
+        memset(g_Data, 0xA5, sizeof(g_Data));
+
+        result = Shim_Read(to_uint(tokens[1]), tokens[2], g_Data);
+        if(check_result(call, result, expected, num_expected))
+        {
+            return 1;
+        }
+
+        if(result == SHIM_BUP_SUCCESS && (memcmp(g_Data, g_Expected, size) != 0 || g_Data[size] != 0xA5))
+        {
+            fprintf(stderr, "read: data doesn't match\n");
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if(strcmp(call, "delete") == 0 && args == 2)
+    {
+        return check_result(call, Shim_Delete(to_uint(tokens[1]), tokens[2]), expected, num_expected);
+    }
+
+    if(strcmp(call, "dir") == 0 && args == 3)
+    {
+        unsigned short tbsize = (unsigned short)LIBSLINGA_MIN(to_uint(tokens[3]), MAX_SAVES);
+        const char* prefix = strcmp(tokens[2], "*") == 0 ? "" : tokens[2];
+
+        memset(g_Dir, 0, sizeof(g_Dir));
+
+        return check_dir(Shim_Dir(to_uint(tokens[1]), prefix, tbsize, g_Dir), tbsize, expected, num_expected);
+    }
+
+    if(strcmp(call, "getdate") == 0 && args == 1)
+    {
+        BACKUP_DATE date = {0};
+        unsigned int fields[6] = {0};
+
+        Shim_GetDate(to_uint(tokens[1]), &date);
+
+        fields[0] = date.year;
+        fields[1] = date.month;
+        fields[2] = date.day;
+        fields[3] = date.hour;
+        fields[4] = date.minute;
+        fields[5] = date.day_of_week;
+
+        if(num_expected != 6)
+        {
+            fprintf(stderr, "getdate needs 6 fields\n");
+            return 1;
+        }
+
+        for(int i = 0; i < 6; i++)
+        {
+            if(check_result(call, fields[i], &expected[i], 1))
+            {
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    if(strcmp(call, "setdate") == 0 && args == 5)
+    {
+        BACKUP_DATE date = {0};
+
+        date.year = (unsigned char)to_uint(tokens[1]);
+        date.month = (unsigned char)to_uint(tokens[2]);
+        date.day = (unsigned char)to_uint(tokens[3]);
+        date.hour = (unsigned char)to_uint(tokens[4]);
+        date.minute = (unsigned char)to_uint(tokens[5]);
+
+        return check_result(call, Shim_SetDate(&date), expected, num_expected);
+    }
+
+    if(strcmp(call, "slinga_write") == 0 && args == 3)
+    {
+        SAVE_METADATA metadata = {0};
+        unsigned int size = to_uint(tokens[2]);
+
+        if(size > sizeof(g_Data))
+        {
+            fprintf(stderr, "save too large\n");
+            return 1;
+        }
+
+        fill_data(g_Data, size, to_uint(tokens[3]));
+
+        if(Slinga_SetSaveMetadata(&metadata, tokens[1], tokens[1], "", 0, 0, size) != SLINGA_SUCCESS)
+        {
+            return 1;
+        }
+
+        return Slinga_Write(DEVICE_RAM, OVERWRITE_EXISTING_SAVE, tokens[1], &metadata, g_Data, size) != SLINGA_SUCCESS;
+    }
+
+    if(strcmp(call, "invalidate") == 0 && args == 1)
+    {
+        return Shim_Invalidate(to_uint(tokens[1])) != SLINGA_SUCCESS;
+    }
+
+    fprintf(stderr, "unknown call or wrong number of arguments\n");
+    return 1;
+}
+
+static int check_result(const char* call, long actual, char** expected, int num_expected)
+{
+    if(num_expected < 1)
+    {
+        fprintf(stderr, "%s: no expected result\n", call);
+        return 1;
+    }
+
+    if(actual != strtol(expected[0], NULL, 0))
+    {
+        fprintf(stderr, "%s: got %ld, expected %s\n", call, actual, expected[0]);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_stat(const SHIM_STAT* stat, char** expected, int num_expected)
+{
+    const struct
+    {
+        const char* name;
+        unsigned int value;
+    } fields[] =
+    {
+        {"totalsize", stat->totalsize},
+        {"totalblock", stat->totalblock},
+        {"blocksize", stat->blocksize},
+        {"freesize", stat->freesize},
+        {"freeblock", stat->freeblock},
+        {"datanum", stat->datanum},
+    };
+
+    for(int i = 0; i < num_expected; i++)
+    {
+        char* value = strchr(expected[i], '=');
+        unsigned int j = 0;
+
+        if(!value)
+        {
+            fprintf(stderr, "stat: expected FIELD=VALUE, got %s\n", expected[i]);
+            return 1;
+        }
+
+        *value++ = '\0';
+
+        for(j = 0; j < sizeof(fields) / sizeof(fields[0]); j++)
+        {
+            if(strcmp(fields[j].name, expected[i]) == 0)
+            {
+                break;
+            }
+        }
+
+        if(j == sizeof(fields) / sizeof(fields[0]))
+        {
+            fprintf(stderr, "stat: unknown field %s\n", expected[i]);
+            return 1;
+        }
+
+        if(fields[j].value != to_uint(value))
+        {
+            fprintf(stderr, "stat: %s is %u, expected %s\n", fields[j].name, fields[j].value, value);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int check_dir(int found, unsigned short tbsize, char** expected, int num_expected)
+{
+    int listed = 0;
+
+    if(check_result("dir", found, expected, LIBSLINGA_MIN(num_expected, 1)))
+    {
+        return 1;
+    }
+
+    // only the entries that fit were copied out, a small negative count is an error
+    if(found >= 0)
+    {
+        listed = found;
+    }
+    else if(-found > tbsize)
+    {
+        listed = tbsize;
+    }
+
+    if(num_expected - 1 != listed)
+    {
+        fprintf(stderr, "dir: %d entries listed, %d expected\n", listed, num_expected - 1);
+        return 1;
+    }
+
+    for(int i = 0; i < listed; i++)
+    {
+        if(strcmp(g_Dir[i].filename, expected[i + 1]) != 0)
+        {
+            fprintf(stderr, "dir: entry %d is %s, expected %s\n", i, g_Dir[i].filename, expected[i + 1]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void fill_data(unsigned char* data, unsigned int size, unsigned int seed)
+{
+    for(unsigned int i = 0; i < size; i++)
+    {
+        data[i] = (unsigned char)(seed * 31 + i * 7 + (i >> 8));
+    }
+}
+
+static unsigned int to_uint(const char* token)
+{
+    return (unsigned int)strtoul(token, NULL, 0);
+}
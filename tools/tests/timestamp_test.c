@@ -0,0 +1,266 @@
+/** @file timestamp_test.c
+ *
+ *  @author Slinga
+ *  @brief Host tests and benchmark for the timestamp conversions
+ *  @bug No known bugs.
+ */
+#include "../../libslinga/timestamp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//
+// timestamp_test [--bench]
+//
+// Without arguments every minute of the 32-bit range is converted to a date
+// and back, every day is checked against gmtime(), and dates that don't
+// exist must be rejected. Exits non-zero on the first mismatch.
+//
+// --bench times both conversions over the whole 32-bit range instead.
+//
+
+#define SECONDS_1970_TO_1980    315532800
+#define MAX_TIMESTAMP           0xFFFFFFFF
+#define BATCH_SIZE              MAX_SAVES
+
+static int test_round_trip(void);
+static int test_gmtime(void);
+static int test_invalid_dates(void);
+static int test_batch(void);
+static int bench(void);
+static double elapsed_seconds(const struct timespec* start);
+
+int main(int argc, char** argv)
+{
+    if(argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        return bench();
+    }
+
+    if(argc > 1)
+    {
+        fprintf(stderr, "usage: timestamp_test [--bench]\n");
+        return 2;
+    }
+
+    if(test_round_trip() || test_gmtime() || test_invalid_dates() || test_batch())
+    {
+        return 1;
+    }
+
+    printf("timestamp: all tests passed\n");
+
+    return 0;
+}
+
+/**
+ * @brief Every whole minute converts to a date and back to the same timestamp
+ */
+static int test_round_trip(void)
+{
+    for(unsigned long long timestamp = 0; timestamp <= MAX_TIMESTAMP; timestamp += SECONDS_IN_MINUTE)
+    {
+        BACKUP_DATE date = {0};
+        unsigned int converted = 0;
+        SLINGA_ERROR result = 0;
+
+        result = Slinga_ConvertTimestampToDate((unsigned int)timestamp, &date);
+        if(result != SLINGA_SUCCESS)
+        {
+            fprintf(stderr, "timestamp %llu: ConvertTimestampToDate failed %d\n", timestamp, result);
+            return 1;
+        }
+
+        result = Slinga_ConvertDateToTimestamp(&date, &converted);
+        if(result != SLINGA_SUCCESS || converted != timestamp)
+        {
+            fprintf(stderr, "timestamp %llu: round trip gave %u (%d)\n", timestamp, converted, result);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Every day in range matches the C library's calendar, including the day of the week
+ */
+static int test_gmtime(void)
+{
+    for(unsigned long long timestamp = 0; timestamp <= MAX_TIMESTAMP; timestamp += SECONDS_IN_DAY)
+    {
+        time_t unix_time = (time_t)(timestamp + SECONDS_1970_TO_1980);
+        BACKUP_DATE date = {0};
+        struct tm tm = {0};
+
+        if(!gmtime_r(&unix_time, &tm))
+        {
+            fprintf(stderr, "gmtime failed for %llu\n", timestamp);
+            return 1;
+        }
+
+        Slinga_ConvertTimestampToDate((unsigned int)timestamp, &date);
+
+        if(date.year + EPOCH_YEAR != tm.tm_year + 1900 ||
+           date.month != tm.tm_mon + 1 ||
+           date.day != tm.tm_mday ||
+           date.hour != tm.tm_hour ||
+           date.minute != tm.tm_min ||
+           date.day_of_week != tm.tm_wday)
+        {
+            fprintf(stderr, "timestamp %llu: got %d-%02d-%02d %02d:%02d (%d), expected %d-%02d-%02d %02d:%02d (%d)\n",
+                    timestamp,
+                    date.year + EPOCH_YEAR, date.month, date.day, date.hour, date.minute, date.day_of_week,
+                    tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_wday);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Dates that don't exist, or don't fit in 32 bits, are rejected
+ */
+static int test_invalid_dates(void)
+{
+    BACKUP_DATE invalid[] =
+    {
+        {.year = 0,   .month = 0,  .day = 1},   // month 0
+        {.year = 0,   .month = 13, .day = 1},   // month 13
+        {.year = 0,   .month = 1,  .day = 0},   // day 0
+        {.year = 0,   .month = 1,  .day = 32},  // January 32nd
+        {.year = 0,   .month = 4,  .day = 31},  // April 31st
+        {.year = 1,   .month = 2,  .day = 29},  // 1981 isn't a leap year
+        {.year = 20,  .month = 2,  .day = 30},  // 2000 is, but only up to the 29th
+        {.year = 120, .month = 2,  .day = 29},  // 2100 isn't
+        {.year = 0,   .month = 1,  .day = 1, .hour = 24},
+        {.year = 0,   .month = 1,  .day = 1, .minute = 60},
+        {.year = 136, .month = 2,  .day = 7, .hour = 6, .minute = 29},  // first minute past 0xFFFFFFFF
+        {.year = 255, .month = 12, .day = 31},
+    };
+    BACKUP_DATE leap_day = {.year = 20, .month = 2, .day = 29};
+    unsigned int timestamp = 0;
+
+    for(unsigned int i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        if(Slinga_ConvertDateToTimestamp(&invalid[i], &timestamp) != SLINGA_INVALID_PARAMETER)
+        {
+            fprintf(stderr, "invalid date %u was accepted\n", i);
+            return 1;
+        }
+    }
+
+    if(Slinga_ConvertDateToTimestamp(&leap_day, &timestamp) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "Feb 29, 2000 was rejected\n");
+        return 1;
+    }
+
+    if(Slinga_ConvertDateToTimestamp(NULL, &timestamp) != SLINGA_INVALID_PARAMETER ||
+       Slinga_ConvertTimestampToDate(0, NULL) != SLINGA_INVALID_PARAMETER)
+    {
+        fprintf(stderr, "NULL arguments were accepted\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief The batch conversion matches converting one timestamp at a time
+ */
+static int test_batch(void)
+{
+    static SAVE_METADATA saves[BATCH_SIZE];
+    static BACKUP_DATE dates[BATCH_SIZE];
+
+    for(unsigned int i = 0; i < BATCH_SIZE; i++)
+    {
+        saves[i].timestamp = (unsigned int)((MAX_TIMESTAMP / BATCH_SIZE) * i) + i;
+    }
+
+    if(Slinga_ConvertTimestampsToDates(saves, BATCH_SIZE, dates) != SLINGA_SUCCESS)
+    {
+        fprintf(stderr, "ConvertTimestampsToDates failed\n");
+        return 1;
+    }
+
+    for(unsigned int i = 0; i < BATCH_SIZE; i++)
+    {
+        BACKUP_DATE date = {0};
+
+        Slinga_ConvertTimestampToDate(saves[i].timestamp, &date);
+
+        if(memcmp(&date, &dates[i], sizeof(BACKUP_DATE)) != 0)
+        {
+            fprintf(stderr, "batch entry %u doesn't match\n", i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Time both conversions over every minute of the 32-bit range
+ */
+static int bench(void)
+{
+    struct timespec start = {0};
+    unsigned long long count = 0;
+    unsigned int checksum = 0;
+    double to_date = 0;
+    double to_timestamp = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(unsigned long long timestamp = 0; timestamp <= MAX_TIMESTAMP; timestamp += SECONDS_IN_MINUTE)
+    {
+        BACKUP_DATE date = {0};
+
+        Slinga_ConvertTimestampToDate((unsigned int)timestamp, &date);
+        checksum += date.day + date.minute;
+        count++;
+    }
+
+    to_date = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(unsigned int year = 0; year <= 135; year++)
+    {
+        for(unsigned int month = 1; month <= MAX_MONTH; month++)
+        {
+            for(unsigned int day = 1; day <= 28; day++)
+            {
+                for(unsigned int minute = 0; minute < HOURS_IN_DAY * MINUTES_IN_HOUR; minute++)
+                {
+                    BACKUP_DATE date = {.year = year, .month = month, .day = day, .hour = minute / MINUTES_IN_HOUR, .minute = minute % MINUTES_IN_HOUR};
+                    unsigned int timestamp = 0;
+
+                    Slinga_ConvertDateToTimestamp(&date, &timestamp);
+                    checksum += timestamp;
+                }
+            }
+        }
+    }
+
+    to_timestamp = elapsed_seconds(&start);
+
+    printf("ConvertTimestampToDate: %llu conversions, %.1f ns each\n", count, (to_date * 1e9) / count);
+    printf("ConvertDateToTimestamp: %u conversions, %.1f ns each\n", 136 * MAX_MONTH * 28 * HOURS_IN_DAY * MINUTES_IN_HOUR, (to_timestamp * 1e9) / (136.0 * MAX_MONTH * 28 * HOURS_IN_DAY * MINUTES_IN_HOUR));
+    printf("checksum %08x\n", checksum);
+
+    return 0;
+}
+
+static double elapsed_seconds(const struct timespec* start)
+{
+    struct timespec end = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}